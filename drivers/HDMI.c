@@ -7,10 +7,10 @@
 #include "debug_log.h"
 #include "hardware/dma.h"
 #include "hardware/pio.h"
-#include "pico/time.h"
 #include "pico/multicore.h"
 #include "hardware/clocks.h"
 #include "hardware/irq.h"
+#include "hardware/timer.h"
 #include "pico/platform.h"
 #include "disk_ui.h"
 
@@ -112,9 +112,17 @@ static uint32_t* DMA_BUF_ADDR[2];
 //в хвосте этой памяти выделяется dma_data
 alignas(4096) uint32_t conv_color[1224];
 
-//индекс, проверяющий зависание
+//счётчик прерываний DMA (отладка)
 static uint32_t irq_inx = 0;
-static uint32_t last_check_irq = 0;
+
+// Stall watchdog: a timer alarm that dma_handler_HDMI pushes back at every
+// vsync. If it ever fires, no frame went out for HDMI_STALL_US; the alarm IRQ
+// only flags it, hdmi_check_and_restart() restarts the DMA chain: from core
+// 1 once it runs, from core 0's boot steps before that.
+#define HDMI_STALL_US 33000
+static int hdmi_alarm = -1;
+static volatile bool hdmi_restart_pending = false;
+static volatile bool hdmi_paused = false;
 
 #include "mii.h"
 #include "mii_sw.h"
@@ -129,38 +137,50 @@ uint32_t hdmi_get_irq_count(void) {
     return irq_inx;
 }
 
-// Forward declaration
+// Forward declarations
 static inline bool hdmi_init(void);
+static void hdmi_restart_dma(void);
 
-// Check if HDMI DMA has stalled and restart if needed.
-// Call this periodically during long operations to maintain HDMI signal.
-bool hdmi_check_and_restart(void) {
-    static uint32_t last_check_time = 0;
-    uint32_t now = time_us_32();
-    
-    // Don't check more often than approx 2 frames (33ms) to avoid false positives
-    // when called from tight loops (like SD card transfers).
-    if (now - last_check_time < 33000) {
-        return false;
-    }
+static inline void __scratch_x() hdmi_watchdog_kick(void) {
+    timer_hw->alarm[hdmi_alarm] = timer_hw->timerawl + HDMI_STALL_US;
+}
 
-    uint32_t current = irq_inx;
-    if (current == last_check_irq) {
-        // IRQ count hasn't changed in >33ms - HDMI has likely stalled
-        MII_DEBUG_PRINTF("HDMI: DMA stalled (irq_inx=%lu), restarting...\n", (unsigned long)current);
-        hdmi_init();
-        last_check_irq = irq_inx;
-        last_check_time = now;
-        return true;
+static void __scratch_x() hdmi_watchdog_irq(void) {
+    hw_clear_bits(&timer_hw->intr, 1u << hdmi_alarm);
+    if (!hdmi_paused)
+        hdmi_restart_pending = true;
+}
+
+static void hdmi_watchdog_start(void) {
+    if (hdmi_alarm < 0) {
+        hdmi_alarm = hardware_alarm_claim_unused(true);
+        uint irq = hardware_alarm_get_irq_num(hdmi_alarm);
+        irq_set_exclusive_handler(irq, hdmi_watchdog_irq);
+        hw_set_bits(&timer_hw->inte, 1u << hdmi_alarm);
+        irq_set_enabled(irq, true);
     }
-    
-    last_check_irq = current;
-    last_check_time = now;
-    return false;
+    hdmi_paused = false;
+    hdmi_restart_pending = false;
+    hdmi_watchdog_kick();
+}
+
+// Restarts the DMA chain if the watchdog saw it stall. Nothing to do but a
+// flag test otherwise, so it can sit in core 1's frame loop and core 0's boot
+// waits. Only one core may poll it at a time.
+bool hdmi_check_and_restart(void) {
+    if (!hdmi_restart_pending)
+        return false;
+    MII_DEBUG_PRINTF("HDMI: DMA stalled (irq_inx=%lu), restarting...\n", (unsigned long)irq_inx);
+    hdmi_restart_dma();
+    return true;
 }
 
 // Pause HDMI output - stops DMA but keeps configuration
 void hdmi_pause(void) {
+    // No frames from now on, that's not a stall
+    hdmi_paused = true;
+    hdmi_restart_pending = false;
+
     // Disable IRQ
     irq_set_enabled(VIDEO_DMA_IRQ, false);
     
@@ -299,6 +319,7 @@ static void __scratch_x() dma_handler_HDMI() {
 
     if (line >= mode.h_total ) {
         line = 0;
+        hdmi_watchdog_kick();
         vsync_handler();
     } else {
         ++line;
@@ -386,6 +407,7 @@ static inline void irq_set_exclusive_handler_DMA_core1() {
 }
 
 void graphics_set_palette_hdmi(const uint8_t i, const uint32_t color888);
+static void hdmi_dma_setup(void);
 
 //деинициализация - инициализация ресурсов
 static inline bool hdmi_init() {
@@ -515,7 +537,20 @@ static inline bool hdmi_init() {
     pio_sm_init(PIO_VIDEO, SM_video, offs_prg0, &c_c);
     pio_sm_set_enabled(PIO_VIDEO, SM_video, true);
 
-    //настройки DMA
+    hdmi_dma_setup();
+
+    // the alarm must exist before the first vsync re-arms it
+    hdmi_watchdog_start();
+
+    irq_set_exclusive_handler_DMA_core1();
+
+    dma_start_channel_mask((1u << dma_chan_ctrl));
+
+    return true;
+};
+
+//настройка каналов DMA; цепочку запускает вызывающий (dma_chan_ctrl)
+static void hdmi_dma_setup(void) {
     dma_lines[0] = &conv_color[1024];
     dma_lines[1] = &conv_color[1124];
 
@@ -621,13 +656,41 @@ static inline bool hdmi_init() {
         dma_channel_acknowledge_irq1(dma_chan_ctrl);
         dma_channel_set_irq1_enabled(dma_chan_ctrl, true);
     }
+}
 
-    irq_set_exclusive_handler_DMA_core1();
+// Stall recovery: stops the four channels, empties and rewinds both SMs so
+// no half line is left in their FIFOs, and starts the DMA chain again.
+// Programs, pins, clock divider and the palette are left alone. The NVIC
+// isn't touched either, the DMA IRQ stays on the core that installed it.
+static void hdmi_restart_dma(void) {
+    hdmi_restart_pending = false;
+    if (VIDEO_DMA_IRQ == DMA_IRQ_0) {
+        dma_channel_set_irq0_enabled(dma_chan_ctrl, false);
+    }
+    else {
+        dma_channel_set_irq1_enabled(dma_chan_ctrl, false);
+    }
+    dma_hw->abort = (1 << dma_chan_ctrl) | (1 << dma_chan) | (1 << dma_chan_pal_conv) | (
+                        1 << dma_chan_pal_conv_ctrl);
+    while (dma_hw->abort) tight_loop_contents();
 
-    dma_start_channel_mask((1u << dma_chan_ctrl));
+    pio_sm_set_enabled(PIO_VIDEO, SM_video, false);
+    pio_sm_set_enabled(PIO_VIDEO_ADDR, SM_conv, false);
+    pio_sm_clear_fifos(PIO_VIDEO, SM_video);
+    pio_sm_clear_fifos(PIO_VIDEO_ADDR, SM_conv);
+    // X goes through the ISR, the restart then clears it
+    pio_set_x(PIO_VIDEO_ADDR, SM_conv, ((uint32_t)conv_color >> 12));
+    pio_sm_restart(PIO_VIDEO, SM_video);
+    pio_sm_restart(PIO_VIDEO_ADDR, SM_conv);
+    pio_sm_exec(PIO_VIDEO, SM_video, pio_encode_jmp(offs_prg0));
+    pio_sm_exec(PIO_VIDEO_ADDR, SM_conv, pio_encode_jmp(offs_prg1));
+    pio_sm_set_enabled(PIO_VIDEO_ADDR, SM_conv, true);
+    pio_sm_set_enabled(PIO_VIDEO, SM_video, true);
 
-    return true;
-};
+    hdmi_dma_setup();
+    hdmi_watchdog_kick();
+    dma_start_channel_mask((1u << dma_chan_ctrl));
+}
 
 void graphics_set_palette_hdmi(uint8_t i, uint32_t color888) {
     palette[i] = color888 & 0x00ffffff;
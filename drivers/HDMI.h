@@ -57,8 +57,8 @@ void graphics_init(g_out g_out);
 uint32_t get_frame_count(void);
 // Returns the HDMI DMA IRQ count (for detecting stalls).
 uint32_t hdmi_get_irq_count(void);
-// Check if HDMI DMA is still running and restart if stalled.
-// Returns true if a restart was needed.
+// Restart the DMA chain if the stall watchdog (a timer alarm re-armed at
+// every vsync) has fired. Called from core 1's loop; returns true if it did.
 bool hdmi_check_and_restart(void);
 // Pause HDMI output (stops DMA, keeps PIO configured)
 void hdmi_pause(void);
@@ -1,7 +1,10 @@
 #include "nespad.h"
 #include "hardware/pio.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
 #include <stdio.h>
+#include "mii_input_latency.h"
 
 #define nespad_wrap_target 0
 #define nespad_wrap 6
@@ -36,6 +39,35 @@ static uint8_t sm = -1;
 uint32_t nespad_state = 0;  // Joystick 1
 uint32_t nespad_state2 = 0; // Joystick 2
 
+// The pad is latched from a timer IRQ; it fills the back buffer then flips
+// 'front', so nespad_read() always copies a complete sample.
+#define NESPAD_SAMPLE_US 1000
+static struct {
+    uint32_t joy1, joy2;
+} snapshot[2];
+static volatile uint8_t front = 0;
+static repeating_timer_t sample_timer;
+
+static bool __not_in_flash_func(nespad_sample)(repeating_timer_t *rt) {
+    (void)rt;
+    if (pio_sm_is_rx_fifo_empty(pio, sm))
+        return true;  // previous latch still shifting in
+
+    // Right-shift was used in sm config so bit order matches NES controller
+    uint32_t temp = pio->rxf[sm] ^ 0xFFFFFFFF;
+    pio->txf[sm] = 0;  // start the next latch right away
+
+    uint8_t back = front ^ 1;
+    uint32_t prev = snapshot[front].joy1;
+    snapshot[back].joy1 = temp & 0x555555;        // Joy1
+    snapshot[back].joy2 = temp >> 1 & 0x555555;   // Joy2
+    __dmb();
+    front = back;
+    if (snapshot[back].joy1 & ~prev & (DPAD_A | DPAD_B | DPAD_START))
+        mii_latency_arrival(MII_LAT_NESPAD);
+    return true;
+}
+
 bool nespad_begin(uint32_t cpu_khz, uint8_t clkPin, uint8_t dataPin, uint8_t latPin) {
     if (pio_can_add_program(pio, &nespad_program) &&
         ((sm = pio_claim_unused_sm(pio, true)) >= 0)) {
@@ -65,22 +97,17 @@ bool nespad_begin(uint32_t cpu_khz, uint8_t clkPin, uint8_t dataPin, uint8_t lat
         pio_sm_init(pio, sm, offset, &c);
         pio_sm_set_enabled(pio, sm, true);
         pio->txf[sm] = 0;
+        add_repeating_timer_us(-NESPAD_SAMPLE_US, nespad_sample, NULL, &sample_timer);
         return true; // Success
     }
     return false;
 }
 
-// Read NES/SNES gamepad state
+// Pick up the latest NES/SNES gamepad sample
 void nespad_read() {
     if (sm < 0)
         return;
-    if (pio_sm_is_rx_fifo_empty(pio, sm))
-        return;
-
-    // Right-shift was used in sm config so bit order matches NES controller
-    uint32_t temp = pio->rxf[sm] ^ 0xFFFFFFFF;
-    pio->txf[sm] = 0;
-    
-    nespad_state = temp & 0x555555;        // Joy1
-    nespad_state2 = temp >> 1 & 0x555555;  // Joy2
+    uint8_t f = front;
+    nespad_state = snapshot[f].joy1;
+    nespad_state2 = snapshot[f].joy2;
 }
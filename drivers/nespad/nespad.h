@@ -18,6 +18,16 @@
 #define DPAD_LT     0x100000
 #define DPAD_RT     0x400000
 
+// The 8 NES buttons (A B SELECT START UP DOWN LEFT RIGHT, the even bits
+// 0-14 above) packed into a byte, to index lookup tables
+static inline uint8_t nespad_buttons8(uint32_t state) {
+    state &= 0x5555;
+    state = (state | (state >> 1)) & 0x3333;
+    state = (state | (state >> 2)) & 0x0f0f;
+    state = (state | (state >> 4)) & 0x00ff;
+    return (uint8_t)state;
+}
+
 extern uint32_t nespad_state;  // (S)NES Joystick1
 extern uint32_t nespad_state2; // (S)NES Joystick2
 
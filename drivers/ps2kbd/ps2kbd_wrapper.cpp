@@ -6,6 +6,7 @@
 #include "../../src/board_config.h"
 #include "ps2kbd_wrapper.h"
 #include "ps2kbd_mrmltr.h"
+#include "mii_input_latency.h"
 #include <queue>
 
 struct KeyEvent {
@@ -193,6 +194,7 @@ static void key_handler(hid_keyboard_report_t *curr, hid_keyboard_report_t *prev
                 unsigned char k = hid_to_apple2(kc, curr->modifier);
                 if (k) {
                     event_queue.push({1, k});
+                    mii_latency_arrival(MII_LAT_PS2_KBD);
                 }
             }
         }
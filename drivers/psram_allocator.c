@@ -1,6 +1,7 @@
 #include "psram_allocator.h"
-#include "psram_allocator.h"
+#ifndef PSRAM_HOST_ARENA
 #include <pico.h>
+#endif
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -12,8 +13,15 @@
 // Flash is at 0x10000000.
 // PSRAM (CS1) is usually mapped at 0x11000000.
 
+#ifdef PSRAM_HOST_ARENA
+// Host build: a plain array stands in for the PSRAM window
+uint8_t psram_host_arena[PSRAM_HOST_ARENA] __attribute__((aligned(16)));
+#define PSRAM_BASE ((uintptr_t)psram_host_arena)
+#define PSRAM_SIZE ((size_t)PSRAM_HOST_ARENA)
+#else
 #define PSRAM_BASE 0x11000000
 #define PSRAM_SIZE ((size_t)MURM_PSRAM_SIZE_BYTES)
+#endif
 
 static uint8_t *psram_start = (uint8_t *)PSRAM_BASE;
 // Reserve 512KB for scratch buffers at the beginning
@@ -21,7 +29,6 @@ static uint8_t *psram_start = (uint8_t *)PSRAM_BASE;
 // 64-128KB: Scratch 2 (Conversion)
 // 128-384KB: File Load Buffer (256KB)
 #define SCRATCH_SIZE (512 * 1024)
-static size_t psram_offset = SCRATCH_SIZE;
 
 // Temp allocator support
 // Some MIDI files exceed available temp memory - game continues without music
@@ -30,7 +37,216 @@ static size_t psram_offset = SCRATCH_SIZE;
 static size_t psram_temp_offset = 0;
 static int psram_temp_mode = 0;
 static int psram_sram_mode = 0; // Force SRAM allocation (proper malloc/free)
-static size_t psram_session_mark = 0; // Save point for game session memory
+
+/*
+ * The permanent area (SCRATCH_SIZE..PERM_SIZE) is a TLSF heap: free blocks
+ * sit in segregated lists, one per size class, found with two bitmaps so
+ * malloc and free are O(1). A first level class per power of two, split in
+ * PSRAM_SL_COUNT linear second level classes; blocks under PSRAM_SMALL bytes
+ * all go in first level 0. Freed blocks merge with their free neighbours
+ * straight away.
+ *
+ * Every block starts with a header; the arena ends with a zero sized used
+ * block so the last real block always has a next one.
+ */
+#define PSRAM_ALIGN     8
+#define PSRAM_SL_LOG2   4
+#define PSRAM_SL_COUNT  (1 << PSRAM_SL_LOG2)
+#define PSRAM_FL_SHIFT  (PSRAM_SL_LOG2 + 3)             // log2(PSRAM_ALIGN)
+#define PSRAM_SMALL     (1 << PSRAM_FL_SHIFT)           // 128 bytes
+
+#define BLOCK_FREE      1u
+
+typedef struct psram_block_t {
+    struct psram_block_t *prev_phys;    // block just before in memory
+    uint32_t size;                      // whole block with header | BLOCK_FREE
+    uint32_t session;                   // allocation generation
+    // free blocks only, in the payload:
+    struct psram_block_t *next_free, *prev_free;
+} psram_block_t;
+
+#define BLOCK_HDR   ((offsetof(psram_block_t, next_free) + PSRAM_ALIGN - 1) & ~(PSRAM_ALIGN - 1))
+#define BLOCK_MIN   ((sizeof(psram_block_t) + PSRAM_ALIGN - 1) & ~(PSRAM_ALIGN - 1))
+
+static struct {
+    int ready;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[PSRAM_FL_COUNT];
+    psram_block_t *free[PSRAM_FL_COUNT][PSRAM_SL_COUNT];
+    psram_block_t *first;
+    uint32_t session;       // current generation, bumped by psram_mark_session()
+    uint32_t session_mark;  // 0: no mark
+    size_t used;
+    uint32_t failed;
+    uint32_t class_live[PSRAM_FL_COUNT];
+    uint32_t class_allocs[PSRAM_FL_COUNT];
+    size_t class_bytes[PSRAM_FL_COUNT];
+} heap;
+
+static inline uint32_t block_size(const psram_block_t *b) {
+    return b->size & ~BLOCK_FREE;
+}
+
+static inline int block_is_free(const psram_block_t *b) {
+    return b->size & BLOCK_FREE;
+}
+
+static inline psram_block_t *block_next(psram_block_t *b) {
+    return (psram_block_t *)((uint8_t *)b + block_size(b));
+}
+
+static inline int fls32(uint32_t v) {
+    return 31 - __builtin_clz(v);
+}
+
+static inline void mapping(uint32_t size, int *fl, int *sl) {
+    if (size < PSRAM_SMALL) {
+        *fl = 0;
+        *sl = size / (PSRAM_SMALL / PSRAM_SL_COUNT);
+    } else {
+        int f = fls32(size);
+        *sl = (size >> (f - PSRAM_SL_LOG2)) ^ PSRAM_SL_COUNT;
+        *fl = f - PSRAM_FL_SHIFT + 1;
+    }
+}
+
+static void block_insert(psram_block_t *b) {
+    int fl, sl;
+    mapping(block_size(b), &fl, &sl);
+    b->prev_free = NULL;
+    b->next_free = heap.free[fl][sl];
+    if (b->next_free)
+        b->next_free->prev_free = b;
+    heap.free[fl][sl] = b;
+    heap.fl_bitmap |= 1u << fl;
+    heap.sl_bitmap[fl] |= 1u << sl;
+}
+
+static void block_remove(psram_block_t *b) {
+    int fl, sl;
+    mapping(block_size(b), &fl, &sl);
+    if (b->next_free)
+        b->next_free->prev_free = b->prev_free;
+    if (b->prev_free)
+        b->prev_free->next_free = b->next_free;
+    else {
+        heap.free[fl][sl] = b->next_free;
+        if (!b->next_free) {
+            heap.sl_bitmap[fl] &= ~(1u << sl);
+            if (!heap.sl_bitmap[fl])
+                heap.fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+// First free block of a class that is sure to hold 'size', NULL if none
+static psram_block_t *block_find(uint32_t size) {
+    int fl, sl;
+    if (size >= PSRAM_SMALL)  // round up to the next class
+        size += (1u << (fls32(size) - PSRAM_SL_LOG2)) - 1;
+    mapping(size, &fl, &sl);
+    if (fl >= PSRAM_FL_COUNT)
+        return NULL;
+    uint32_t sl_map = heap.sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = fl + 1 < 32 ? heap.fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map)
+            return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap.sl_bitmap[fl];
+    }
+    return heap.free[fl][__builtin_ctz(sl_map)];
+}
+
+// Cut 'b' down to 'size', the rest (if big enough) becomes a free block
+static void block_trim(psram_block_t *b, uint32_t size) {
+    uint32_t total = block_size(b);
+    if (total - size < BLOCK_MIN)
+        return;
+    psram_block_t *rest = (psram_block_t *)((uint8_t *)b + size);
+    rest->size = (total - size) | BLOCK_FREE;
+    rest->prev_phys = b;
+    block_next(rest)->prev_phys = rest;
+    b->size = size | (b->size & BLOCK_FREE);
+    // the block after might be free too
+    psram_block_t *next = block_next(rest);
+    if (block_is_free(next)) {
+        block_remove(next);
+        rest->size += block_size(next);
+        block_next(rest)->prev_phys = rest;
+    }
+    block_insert(rest);
+}
+
+static void heap_init(void) {
+    memset(&heap, 0, sizeof(heap));
+    uint8_t *base = psram_start + SCRATCH_SIZE;
+    uint32_t size = (PERM_SIZE - SCRATCH_SIZE - BLOCK_HDR) & ~(PSRAM_ALIGN - 1);
+    psram_block_t *b = (psram_block_t *)base;
+    b->prev_phys = NULL;
+    b->size = size | BLOCK_FREE;
+    psram_block_t *end = block_next(b);
+    end->prev_phys = b;
+    end->size = 0;
+    heap.first = b;
+    heap.session = 1;
+    block_insert(b);
+    heap.ready = 1;
+}
+
+static inline uint32_t block_class(uint32_t size) {
+    int fl, sl;
+    mapping(size, &fl, &sl);
+    return fl;
+}
+
+// Counts 'b' in (or out of) the used memory and its size class
+static void block_account(psram_block_t *b, int used) {
+    uint32_t fl = block_class(block_size(b));
+    if (used) {
+        heap.used += block_size(b);
+        heap.class_live[fl]++;
+        heap.class_bytes[fl] += block_size(b);
+    } else {
+        heap.used -= block_size(b);
+        heap.class_live[fl]--;
+        heap.class_bytes[fl] -= block_size(b);
+    }
+}
+
+// Returns the free block 'b' ended up in, after merging
+static psram_block_t *block_release(psram_block_t *b) {
+    block_account(b, 0);
+    b->size |= BLOCK_FREE;
+    psram_block_t *next = block_next(b);
+    if (block_is_free(next)) {
+        block_remove(next);
+        b->size += block_size(next);
+    }
+    psram_block_t *prev = b->prev_phys;
+    if (prev && block_is_free(prev)) {
+        block_remove(prev);
+        prev->size += block_size(b);
+        b = prev;
+    }
+    block_next(b)->prev_phys = b;
+    block_insert(b);
+    return b;
+}
+
+static inline uint32_t block_request(size_t size) {
+    size = (size + BLOCK_HDR + PSRAM_ALIGN - 1) & ~(size_t)(PSRAM_ALIGN - 1);
+    return size < BLOCK_MIN ? BLOCK_MIN : size;
+}
+
+static inline int psram_is_heap(const void *ptr) {
+    return (const uint8_t *)ptr >= psram_start + SCRATCH_SIZE &&
+           (const uint8_t *)ptr < psram_start + PERM_SIZE;
+}
+
+static inline int psram_is_psram(const void *ptr) {
+    return (uintptr_t)ptr >= PSRAM_BASE && (uintptr_t)ptr < PSRAM_BASE + PSRAM_SIZE;
+}
 
 void psram_set_temp_mode(int enable) {
     psram_temp_mode = enable;
@@ -57,14 +273,11 @@ void *psram_malloc(size_t size) {
     if (psram_sram_mode) {
         return malloc(size);
     }
-    
-    // Align to 4 bytes
-    size = (size + 3) & ~3;
-    
-    // Add header for size tracking (needed for realloc)
-    size_t total_size = size + sizeof(size_t);
 
     if (psram_temp_mode) {
+        // Temp area stays a bump allocator, dropped as a whole
+        size = (size + 3) & ~3;
+        size_t total_size = size + sizeof(size_t);
         if (psram_temp_offset + total_size > TEMP_SIZE) {
             printf("PSRAM Temp OOM! Req %d, free %d\n", (int)size, (int)(TEMP_SIZE - psram_temp_offset));
             return NULL;
@@ -74,35 +287,73 @@ void *psram_malloc(size_t size) {
         void *ptr = (void *)(header + 1);
         psram_temp_offset += total_size;
         return ptr;
-    } else {
-        if (psram_offset + total_size > PERM_SIZE) {
-            printf("PSRAM Perm OOM! Req %d, free %d\n", (int)size, (int)(PERM_SIZE - psram_offset));
-            fflush(stdout);
-            return NULL;
-        }
-        
-        size_t *header = (size_t *)(psram_start + psram_offset);
-        *header = size;
-        
-        void *ptr = (void *)(header + 1);
-        // Only log large allocations or when getting low on memory
-        size_t remaining = PERM_SIZE - (psram_offset + total_size);
-        if (size >= 65536 || remaining < 256 * 1024) {
-            printf("psram_malloc(%d) -> %p Total: %d Remaining: %d\n", 
-                   (int)size, ptr, (int)(psram_offset + total_size), (int)remaining);
-            fflush(stdout);
-        }
-        psram_offset += total_size;
-        return ptr;
     }
+
+    if (!heap.ready)
+        heap_init();
+    if (size > PERM_SIZE)
+        return NULL;
+    uint32_t want = block_request(size);
+    psram_block_t *b = block_find(want);
+    if (!b) {
+        heap.failed++;
+        printf("PSRAM Perm OOM! Req %d, free %d\n", (int)size,
+               (int)(PERM_SIZE - SCRATCH_SIZE - heap.used));
+        fflush(stdout);
+        return NULL;
+    }
+    block_remove(b);
+    b->size &= ~BLOCK_FREE;
+    block_trim(b, want);
+    b->session = heap.session;
+    block_account(b, 1);
+    heap.class_allocs[block_class(block_size(b))]++;
+
+    void *ptr = (uint8_t *)b + BLOCK_HDR;
+    // Only log large allocations or when getting low on memory
+    size_t remaining = PERM_SIZE - SCRATCH_SIZE - heap.used;
+    if (size >= 65536 || remaining < 256 * 1024) {
+        printf("psram_malloc(%d) -> %p Used: %d Remaining: %d\n",
+               (int)size, ptr, (int)heap.used, (int)remaining);
+        fflush(stdout);
+    }
+    return ptr;
 }
 
 void *psram_realloc(void *ptr, size_t new_size) {
     if (ptr == NULL) return psram_malloc(new_size);
     if (new_size == 0) { psram_free(ptr); return NULL; }
 
-    if ((uintptr_t)ptr >= PSRAM_BASE && (uintptr_t)ptr < (PSRAM_BASE + PSRAM_SIZE)) {
-        // It's in PSRAM
+    if (psram_is_heap(ptr)) {
+        psram_block_t *b = (psram_block_t *)((uint8_t *)ptr - BLOCK_HDR);
+        uint32_t want = block_request(new_size);
+        uint32_t have = block_size(b);
+        if (want <= have) {
+            block_account(b, 0);
+            block_trim(b, want);
+            block_account(b, 1);
+            return ptr;
+        }
+        // grow in place into a free block just after
+        psram_block_t *next = block_next(b);
+        if (block_is_free(next) && have + block_size(next) >= want) {
+            block_account(b, 0);
+            block_remove(next);
+            b->size += block_size(next);
+            block_next(b)->prev_phys = b;
+            block_trim(b, want);
+            block_account(b, 1);
+            return ptr;
+        }
+        void *new_ptr = psram_malloc(new_size);
+        if (new_ptr) {
+            memcpy(new_ptr, ptr, have - BLOCK_HDR);
+            psram_free(ptr);
+        }
+        return new_ptr;
+    }
+    if (psram_is_psram(ptr)) {
+        // Temp area: keep the old bump allocator behaviour
         size_t *header = (size_t *)ptr - 1;
         size_t old_size = *header;
 
@@ -113,7 +364,6 @@ void *psram_realloc(void *ptr, size_t new_size) {
         void *new_ptr = psram_malloc(new_size);
         if (new_ptr) {
             memcpy(new_ptr, ptr, old_size);
-            // psram_free(ptr); // No-op for bump allocator
         }
         return new_ptr;
     }
@@ -142,8 +392,19 @@ void *psram_get_file_buffer(size_t size) {
 
 
 void psram_free(void *ptr) {
-    if (ptr >= (void*)PSRAM_BASE && ptr < (void*)(PSRAM_BASE + PSRAM_SIZE)) {
-        // It's in PSRAM, do nothing (bump allocator)
+    if (!ptr)
+        return;
+    if (psram_is_heap(ptr)) {
+        psram_block_t *b = (psram_block_t *)((uint8_t *)ptr - BLOCK_HDR);
+        if (block_is_free(b)) {
+            printf("psram_free(%p): already free\n", ptr);
+            return;
+        }
+        block_release(b);
+        return;
+    }
+    if (psram_is_psram(ptr)) {
+        // Temp area, do nothing (bump allocator)
         return;
     }
     // It's not in PSRAM, assume it's from malloc
@@ -151,29 +412,78 @@ void psram_free(void *ptr) {
 }
 
 void psram_reset(void) {
-    psram_offset = SCRATCH_SIZE; // Reset to after scratch area
+    heap_init();
     psram_temp_offset = 0;
-    psram_session_mark = 0;
 }
 
 void psram_mark_session(void) {
-    psram_session_mark = psram_offset;
-    printf("PSRAM: Session marked at offset %d (%.2f MB used)\n", 
-           (int)psram_session_mark, psram_session_mark / (1024.0 * 1024.0));
+    if (!heap.ready)
+        heap_init();
+    heap.session_mark = ++heap.session;
+    printf("PSRAM: Session marked (%.2f MB used)\n",
+           heap.used / (1024.0 * 1024.0));
 }
 
+// Frees everything allocated since psram_mark_session()
 void psram_restore_session(void) {
-    if (psram_session_mark == 0) {
+    if (heap.session_mark == 0) {
         printf("PSRAM: Warning - no session mark set, cannot restore\n");
         return;
     }
-    size_t freed = psram_offset - psram_session_mark;
-    psram_offset = psram_session_mark;
+    size_t before = heap.used;
+    for (psram_block_t *b = heap.first; block_size(b); b = block_next(b)) {
+        if (!block_is_free(b) && b->session >= heap.session_mark)
+            b = block_release(b);
+    }
     psram_temp_offset = 0;
-    printf("PSRAM: Session restored to offset %d (freed %.2f MB)\n",
-           (int)psram_offset, freed / (1024.0 * 1024.0));
+    printf("PSRAM: Session restored (freed %.2f MB)\n",
+           (before - heap.used) / (1024.0 * 1024.0));
+}
+
+void psram_get_stats(psram_stats_t *st) {
+    if (!heap.ready)
+        heap_init();
+    memset(st, 0, sizeof(*st));
+    st->total = PERM_SIZE - SCRATCH_SIZE;
+    st->used = heap.used;
+    st->failed = heap.failed;
+    for (psram_block_t *b = heap.first; block_size(b); b = block_next(b)) {
+        if (block_is_free(b)) {
+            st->free += block_size(b) - BLOCK_HDR;
+            st->free_blocks++;
+            if (block_size(b) - BLOCK_HDR > st->largest_free)
+                st->largest_free = block_size(b) - BLOCK_HDR;
+        } else
+            st->used_blocks++;
+    }
+    memcpy(st->class_live, heap.class_live, sizeof(st->class_live));
+    memcpy(st->class_allocs, heap.class_allocs, sizeof(st->class_allocs));
+    memcpy(st->class_bytes, heap.class_bytes, sizeof(st->class_bytes));
 }
 
+void psram_print_stats(void) {
+    psram_stats_t st;
+    psram_get_stats(&st);
+    // 0% when all the free memory is one block
+    int frag = st.free ? (int)(100 - (uint64_t)st.largest_free * 100 / st.free) : 0;
+    printf("PSRAM heap: %d KB used in %d blocks, %d KB free in %d blocks "
+           "(largest %d KB, %d%% fragmented), %d failed\n",
+           (int)(st.used / 1024), (int)st.used_blocks, (int)(st.free / 1024),
+           (int)st.free_blocks, (int)(st.largest_free / 1024), frag, (int)st.failed);
+    for (int i = 0; i < PSRAM_FL_COUNT; i++) {
+        if (!st.class_allocs[i])
+            continue;
+        printf("  <%7d: %4d live %8d bytes, %6d allocations\n",
+               i ? PSRAM_SMALL << i : PSRAM_SMALL, (int)st.class_live[i],
+               (int)st.class_bytes[i], (int)st.class_allocs[i]);
+    }
+}
+
+#ifdef PSRAM_HOST_ARENA
+unsigned int butter_psram_size() {
+    return PSRAM_SIZE;
+}
+#else
 static int BUTTER_PSRAM_SIZE = -1;
 #define MB16 (16ul << 20)
 #define MB8 (8ul << 20)
@@ -197,3 +507,4 @@ unsigned int __not_in_flash_func() butter_psram_size() {
     BUTTER_PSRAM_SIZE = res << 20;
     return BUTTER_PSRAM_SIZE;
 }
+#endif
@@ -8,14 +8,38 @@
 #ifndef MURM_PSRAM_SIZE_BYTES
 #define MURM_PSRAM_SIZE_BYTES (8u * 1024u * 1024u)
 #endif
+#ifdef PSRAM_HOST_ARENA
+// Host build (tests, benchmarks): the heap lives in a static array
+#include <stdint.h>
+extern uint8_t psram_host_arena[];
+#define PSRAM_DATA psram_host_arena
+#else
 #define PSRAM_DATA ((uint8_t*)(intptr_t)0x11000000)
+#endif
+
+// First level size classes of the heap: < 128 bytes, then one per power of 2
+#define PSRAM_FL_COUNT 18
+
+typedef struct psram_stats_t {
+    size_t total;           // heap size
+    size_t used;            // allocated, headers included
+    size_t free;            // sum of the free blocks
+    size_t largest_free;    // biggest single allocation that would succeed
+    unsigned int used_blocks, free_blocks;
+    unsigned int failed;    // allocations that returned NULL
+    unsigned int class_live[PSRAM_FL_COUNT];    // per size class
+    unsigned int class_allocs[PSRAM_FL_COUNT];
+    size_t class_bytes[PSRAM_FL_COUNT];
+} psram_stats_t;
 
 void *psram_malloc(size_t size);
 void *psram_realloc(void *ptr, size_t size);
 void psram_free(void *ptr);
 void psram_reset(void);
-void psram_mark_session(void);    // Mark current offset for game session
-void psram_restore_session(void); // Restore to marked offset
+void psram_mark_session(void);    // Mark the start of a game session
+void psram_restore_session(void); // Free everything allocated since the mark
+void psram_get_stats(psram_stats_t *st);
+void psram_print_stats(void);
 void *psram_get_scratch_1(size_t size);
 void *psram_get_scratch_2(size_t size);
 void *psram_get_file_buffer(size_t size);
@@ -13,9 +13,6 @@
 #include "hardware/gpio.h"
 //#include "hardware/gpio_ex.h"
 
-// Keep HDMI timing alive during long SD operations
-#include "../HDMI.h"
-
 #include "ff.h"
 #include "diskio.h"
 
@@ -223,9 +220,7 @@ void rcvr_spi_multi (
 		spi_read_blocking(SDCARD_SPI_BUS, 0xff, b, chunk);
 		b += chunk;
 		btr -= chunk;
-		// Brief yield and periodic HDMI stall check
 		tight_loop_contents();
-		hdmi_check_and_restart();
 	}
 #else
 	pio_spi_repeat8_read8_blocking(&pio_spi, 0xff, b, btr);
@@ -249,7 +244,6 @@ int wait_ready (	/* 1:Ready, 0:Timeout */
 		d = xchg_spi(0xFF);
 		/* Allow interrupts to be processed (e.g., HDMI DMA) */
 		tight_loop_contents();
-		hdmi_check_and_restart();
 	} while (d != 0xFF && _millis() < t + wt);	/* Wait for card goes ready or timeout */
 
 	return (d == 0xFF) ? 1 : 0;
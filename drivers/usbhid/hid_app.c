@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "debug_log.h"
+#include "mii_input_latency.h"
 
 #define HID_DEBUG_PRINTF(...) MII_DEBUG_PRINTF(__VA_ARGS__)
 
@@ -46,6 +47,13 @@ static volatile int mouse_has_motion = 0;
 // Gamepad state
 static volatile int8_t gamepad_axis_x = 0;
 static volatile int8_t gamepad_axis_y = 0;
+// Axis samples summed since the last usbhid_get_gamepad_axes() call, so
+// the consumer gets one coalesced sample per frame whatever the report rate
+static volatile int32_t gamepad_axis_sum_x = 0;
+static volatile int32_t gamepad_axis_sum_y = 0;
+static volatile uint16_t gamepad_axis_samples = 0;
+// Set once an axis reports a value a digital pad never sends
+static volatile int gamepad_analog = 0;
 static volatile uint8_t gamepad_dpad = 0;
 static volatile uint16_t gamepad_buttons = 0;
 static volatile int gamepad_connected = 0;
@@ -134,6 +142,7 @@ static void process_kbd_report(hid_keyboard_report_t const *report, hid_keyboard
         uint8_t keycode = report->keycode[i];
         if (keycode && !find_keycode_in_report(prev_report, keycode)) {
             queue_key_action(keycode, 1); // Key pressed
+            mii_latency_arrival(MII_LAT_USB_KBD);
         }
     }
 }
@@ -189,8 +198,22 @@ static void process_gamepad_report(uint8_t const *report, uint16_t len) {
     if (report[3] > 0x9F) gamepad_dpad |= 0x08; // Right (0xA0-0xFF)
     if (report[4] < 0x60) gamepad_dpad |= 0x01; // Up (0x00-0x5F)
     if (report[4] > 0x80) gamepad_dpad |= 0x02; // Down (0x81-0xFF) - lowered threshold
+
+    // Same bytes, as analog axes (centered on 0). Digital pads only ever
+    // send 0x00/0x7F/0x80/0xFF there, anything else means a real stick.
+    for (int i = 3; i <= 4; i++) {
+        uint8_t v = report[i];
+        if (v != 0x00 && v != 0x7F && v != 0x80 && v != 0xFF)
+            gamepad_analog = 1;
+    }
+    gamepad_axis_x = (int8_t)(report[3] ^ 0x80);
+    gamepad_axis_y = (int8_t)(report[4] ^ 0x80);
+    gamepad_axis_sum_x += gamepad_axis_x;
+    gamepad_axis_sum_y += gamepad_axis_y;
+    gamepad_axis_samples++;
     
     // Buttons
+    uint16_t prev_buttons = gamepad_buttons;
     gamepad_buttons = 0;
     if (report[5] & 0x20) gamepad_buttons |= 0x01; // A → Genesis A
     if (report[5] & 0x40) gamepad_buttons |= 0x02; // B → Genesis B
@@ -200,6 +223,8 @@ static void process_gamepad_report(uint8_t const *report, uint16_t len) {
     if (report[6] & 0x02) gamepad_buttons |= 0x20; // R-shift → Genesis Z
     if (report[6] & 0x20) gamepad_buttons |= 0x40; // Start → Start
     if (report[6] & 0x10) gamepad_buttons |= 0x80; // Select → Mode
+    if (gamepad_buttons & ~prev_buttons & 0x7F)
+        mii_latency_arrival(MII_LAT_USB_PAD);
 }
 
 //--------------------------------------------------------------------
@@ -325,8 +350,12 @@ void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
         gamepad_connected = 0;
         gamepad_buttons = 0;
         gamepad_dpad = 0;
-        gamepad_axis_x = 128;
-        gamepad_axis_y = 128;
+        gamepad_axis_x = 0;
+        gamepad_axis_y = 0;
+        gamepad_axis_sum_x = 0;
+        gamepad_axis_sum_y = 0;
+        gamepad_axis_samples = 0;
+        gamepad_analog = 0;
     }
 }
 
@@ -463,4 +492,22 @@ void usbhid_get_gamepad_state(usbhid_gamepad_state_t *state) {
     }
 }
 
+int usbhid_get_gamepad_axes(int8_t *x, int8_t *y) {
+    if (!gamepad_connected || !gamepad_analog)
+        return 0;
+    uint16_t n = gamepad_axis_samples;
+    if (n) {
+        *x = (int8_t)(gamepad_axis_sum_x / n);
+        *y = (int8_t)(gamepad_axis_sum_y / n);
+        gamepad_axis_sum_x = 0;
+        gamepad_axis_sum_y = 0;
+        gamepad_axis_samples = 0;
+    } else {
+        // no report since last time, stick hasn't moved
+        *x = gamepad_axis_x;
+        *y = gamepad_axis_y;
+    }
+    return 1;
+}
+
 #endif // CFG_TUH_ENABLED
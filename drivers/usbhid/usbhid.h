@@ -103,6 +103,15 @@ int usbhid_gamepad_connected(void);
  */
 void usbhid_get_gamepad_state(usbhid_gamepad_state_t *state);
 
+/**
+ * Get the left stick position, averaged over all reports received since
+ * the previous call (one coalesced sample per frame)
+ * @param x Output: -128 (left) to 127 (right)
+ * @param y Output: -128 (up) to 127 (down)
+ * @return Non-zero if an analog stick is connected
+ */
+int usbhid_get_gamepad_axes(int8_t *x, int8_t *y);
+
 #ifdef __cplusplus
 }
 #endif
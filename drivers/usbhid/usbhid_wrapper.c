@@ -23,6 +23,27 @@ extern bool turbo_latched;   // Scroll Lock toggled
 extern bool turbo_momentary; // F12 held
 extern bool show_speed; // F9 toggled
 
+// Stick to paddle mapping: deadzone around center, then a blend of linear
+// and cubic response (more precision near center, full range at the ends)
+#define ANALOG_DEADZONE 10      // out of 128
+#define ANALOG_EXPO     0.25f   // 0 = linear, 1 = cubic
+static uint8_t analog_lut[256];  // indexed by axis + 128
+
+static void analog_lut_init(void) {
+    for (int i = 0; i < 256; i++) {
+        int v = i - 128;
+        int mag = v < 0 ? -v : v;
+        float t = 0;
+        if (mag > ANALOG_DEADZONE) {
+            t = (float)(mag - ANALOG_DEADZONE) / (float)(128 - ANALOG_DEADZONE);
+            if (t > 1.0f) t = 1.0f;
+            t = (1.0f - ANALOG_EXPO) * t + ANALOG_EXPO * t * t * t;
+        }
+        int out = 127 + (int)(t * (v < 0 ? -127.0f : 128.0f) + (v < 0 ? -0.5f : 0.5f));
+        analog_lut[i] = out < 0 ? 0 : out > 255 ? 255 : out;
+    }
+}
+
 //--------------------------------------------------------------------
 // HID Keycode to Apple II ASCII Mapping
 // Returns the Apple II ASCII character for a given HID keycode
@@ -102,6 +123,7 @@ static unsigned char hid_to_apple2(uint8_t hid_keycode, uint8_t modifiers) {
 
 void usbhid_wrapper_init(void) {
     usbhid_init();
+    analog_lut_init();
     current_modifiers = 0;
     delete_key_pressed = false;
 }
@@ -243,4 +265,13 @@ uint32_t usbhid_wrapper_get_gamepad_state(void) {
     return buttons | numpad_state;
 }
 
+bool usbhid_wrapper_get_analog(uint8_t *x, uint8_t *y) {
+    int8_t ax, ay;
+    if (!usbhid_get_gamepad_axes(&ax, &ay))
+        return false;
+    *x = analog_lut[(uint8_t)(ax + 128)];
+    *y = analog_lut[(uint8_t)(ay + 128)];
+    return true;
+}
+
 #endif // USB_HID_ENABLED
@@ -72,6 +72,15 @@ bool usbhid_wrapper_is_reset_combo(void);
  */
 uint32_t usbhid_wrapper_get_gamepad_state(void);
 
+/**
+ * Get the USB gamepad stick as Apple II paddle values, with deadzone and
+ * response curve applied. Call once per frame.
+ * @param x Output: paddle 0, 0 (left) to 255 (right)
+ * @param y Output: paddle 1, 0 (up) to 255 (down)
+ * @return true if an analog stick is connected (x/y are valid)
+ */
+bool usbhid_wrapper_get_analog(uint8_t *x, uint8_t *y);
+
 #else // !USB_HID_ENABLED
 
 // Stub functions when USB HID is disabled
@@ -83,6 +92,7 @@ static inline int usbhid_wrapper_get_key(int *pressed, unsigned char *key) { (vo
 static inline uint8_t usbhid_wrapper_get_modifiers(void) { return 0; }
 static inline bool usbhid_wrapper_is_reset_combo(void) { return false; }
 static inline uint32_t usbhid_wrapper_get_gamepad_state(void) { return 0; }
+static inline bool usbhid_wrapper_get_analog(uint8_t *x, uint8_t *y) { (void)x; (void)y; return false; }
 
 #endif // USB_HID_ENABLED
 
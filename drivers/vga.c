@@ -55,6 +55,15 @@ static bool is_flash_frame = false;
 //буфер 1к графической палитры
 static uint16_t palette[2][256];
 
+/*
+ * Two 4bpp pixels (one framebuffer byte) to their two palette[0] entries,
+ * low nibble in the low half, so a line is one load and one 32 bit store per
+ * byte. palette[1] is always palette[0] with the bytes of each entry
+ * swapped, the other phase is a REV16 of the same word; that keeps it to 1K,
+ * scratch X can't take 2K next to the core 1 stack.
+ */
+static uint32_t palette_pair[256] __scratch_x("palette_pair");
+
 static uint32_t bg_color[2];
 static uint16_t palette16_mask = 0;
 
@@ -80,6 +89,45 @@ void __scratch_x() vsync_handler() {
     graphics_frame_count++;
 }
 
+// Refreshes the palette_pair entries that use colour 'i'
+static void update_palette_pair(const uint8_t i) {
+    if (i >= 16) return;
+    for (int j = 0; j < 16; j++) {
+        palette_pair[i | j << 4] = palette[0][i] | (uint32_t)palette[0][j] << 16;
+        palette_pair[j | i << 4] = palette[0][j] | (uint32_t)palette[0][i] << 16;
+    }
+}
+
+static inline uint32_t __attribute__((always_inline)) rev16(const uint32_t w) {
+    return (w & 0x00ff00ff) << 8 | (w >> 8 & 0x00ff00ff);
+}
+
+// 'bytes' framebuffer bytes to 'output', 4 at a time; both are word aligned
+static inline void __attribute__((always_inline))
+convert_line(uint32_t* output, const uint8_t* input, int bytes, const bool swap) {
+    const uint32_t* input_32bit = (const uint32_t *)input;
+    for (; bytes >= 4; bytes -= 4) {
+        const uint32_t in = *input_32bit++;
+        uint32_t p0 = palette_pair[in & 0xff];
+        uint32_t p1 = palette_pair[in >> 8 & 0xff];
+        uint32_t p2 = palette_pair[in >> 16 & 0xff];
+        uint32_t p3 = palette_pair[in >> 24];
+        if (swap) {
+            p0 = rev16(p0); p1 = rev16(p1); p2 = rev16(p2); p3 = rev16(p3);
+        }
+        output[0] = p0;
+        output[1] = p1;
+        output[2] = p2;
+        output[3] = p3;
+        output += 4;
+    }
+    input = (const uint8_t *)input_32bit;
+    while (bytes--) {
+        const uint32_t p = palette_pair[*input++];
+        *output++ = swap ? rev16(p) : p;
+    }
+}
+
 
 void __time_critical_func() dma_handler_VGA() {
     dma_hw->ints0 = 1u << dma_chan_ctrl;
@@ -159,16 +207,15 @@ void __time_critical_func() dma_handler_VGA() {
     if (width < 0) return; // TODO: detect a case
 
     // Индекс палитры в зависимости от настроек чередования строк и кадров
-    uint16_t* current_palette = palette[(y && is_flash_line) + (graphics_frame_count & is_flash_frame) & 1];
+    const int phase = (y && is_flash_line) + (graphics_frame_count & is_flash_frame) & 1;
 
     //4bit buf
     register uint8_t* input_buffer = graphics_get_buffer() + y * (SCREEN_WIDTH / 2);
     lock_y = y;
-    for (register int x = width / 2; x--;) {
-        *output_buffer_16bit++ = current_palette[*input_buffer & 15];
-        *output_buffer_16bit++ = current_palette[*input_buffer >> 4];
-        input_buffer++;
-    }
+    if (phase)
+        convert_line((uint32_t *)output_buffer_16bit, input_buffer, width / 2, true);
+    else
+        convert_line((uint32_t *)output_buffer_16bit, input_buffer, width / 2, false);
     lock_y = -1;
     dma_channel_set_read_addr(dma_chan_ctrl, output_buffer, false);
 }
@@ -216,6 +263,8 @@ void graphics_set_mode() {
         palette[0][i] = palette[0][i] & 0x3f3f | palette16_mask;
         palette[1][i] = palette[1][i] & 0x3f3f | palette16_mask;
     }
+    for (int i = 0; i < 16; i++)
+        update_palette_pair(i);
 
     //инициализация шаблонов строк и синхросигнала
     if (!lines_pattern_data) //выделение памяти, если не выделено
@@ -303,6 +352,7 @@ void graphics_set_palette(const uint8_t i, const uint32_t color888) {
 
     palette[0][i] = (c_hi << 8 | c_lo) & 0x3f3f | palette16_mask;
     palette[1][i] = (c_lo << 8 | c_hi) & 0x3f3f | palette16_mask;
+    update_palette_pair(i);
 }
 
 void graphics_init() {
@@ -321,6 +371,8 @@ void graphics_init() {
         palette[0][i] = c_hi << 8 | c_lo;
         palette[1][i] = c_lo << 8 | c_hi;
     }
+    for (int i = 0; i < 16; i++)
+        update_palette_pair(i);
 #endif
     //текстовая палитра
     for (int i = 0; i < 16; i++) {
@@ -423,4 +475,4 @@ void startVIDEO(uint8_t vol) {
     // Stub
 }
 
-bool hdmi_check_and_restart(void) { }
+bool hdmi_check_and_restart(void) { return false; }
@@ -0,0 +1,244 @@
+/*
+ * disk_journal.c
+ *
+ * Append-only track log at the end of a .bdsk sidecar for murmapple
+ *
+ * File layout:
+ *   [0, BDSK_BYTES)            header, the 35 fixed track slots and the
+ *                              quarter track map
+ *   [BDSK_JOURNAL_BASE, BDSK_JOURNAL_END)
+ *                              records, BDSK_JOURNAL_REC apart:
+ *                              track data, then bdsk_journal_rec_t
+ * Records are numbered from 0 since the log was last emptied; replay stops
+ * at the first one that doesn't have the next number or a good CRC. The
+ * log area isn't given back when the log is emptied, the header of record
+ * 0 is zeroed instead; the records of older logs after it stay, but every
+ * append zeroes the header after its own first, so none of them can carry
+ * on from the current log.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "disk_journal.h"
+#include "mii_floppy.h"
+
+// CRC-32 (zlib's), a nibble at a time: 64 bytes of table
+static const uint32_t disk_journal_crc_nib[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t disk_journal_crc32(uint32_t crc, const uint8_t *p, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ disk_journal_crc_nib[crc & 15];
+        crc = (crc >> 4) ^ disk_journal_crc_nib[crc & 15];
+    }
+    return ~crc;
+}
+
+static uint32_t disk_journal_rec_crc(const bdsk_journal_rec_t *hdr, const uint8_t *data) {
+    bdsk_journal_rec_t h = *hdr;
+    h.crc = 0;
+    uint32_t crc = disk_journal_crc32(0, data, BDSK_TRACK_DATA_SIZE);
+    return disk_journal_crc32(crc, (const uint8_t *)&h, sizeof(h));
+}
+
+static bool disk_journal_rec_ok(const bdsk_journal_rec_t *hdr, const uint8_t *data) {
+    return memcmp(hdr->magic, BDSK_JOURNAL_MAGIC, 4) == 0 &&
+        hdr->track < BDSK_TRACKS &&
+        hdr->bit_count && hdr->bit_count <= BDSK_MAX_BITS &&
+        hdr->crc == disk_journal_rec_crc(hdr, data);
+}
+
+static int disk_journal_read_rec(FIL *fp, uint32_t off, bdsk_journal_rec_t *hdr, uint8_t *data) {
+    UINT br = 0;
+    if (f_lseek(fp, off) != FR_OK)
+        return -1;
+    FRESULT fr = f_read(fp, data, BDSK_TRACK_DATA_SIZE, &br);
+    if (fr != FR_OK || br != BDSK_TRACK_DATA_SIZE)
+        return -1;
+    fr = f_read(fp, hdr, sizeof(*hdr), &br);
+    if (fr != FR_OK || br != sizeof(*hdr))
+        return -1;
+    return 0;
+}
+
+// The sector of a record header, written whole so FatFs doesn't read it
+// first: the header and zeroes, or all zeroes to drop the record
+static uint8_t disk_journal_sec[512];
+
+static int disk_journal_write_hdr(FIL *fp, uint32_t n, const bdsk_journal_rec_t *hdr) {
+    UINT bw = 0;
+    memset(disk_journal_sec, 0, sizeof(disk_journal_sec));
+    if (hdr)
+        memcpy(disk_journal_sec, hdr, sizeof(*hdr));
+    if (f_lseek(fp, BDSK_JOURNAL_BASE + n * BDSK_JOURNAL_REC + BDSK_TRACK_DATA_SIZE) != FR_OK)
+        return -1;
+    FRESULT fr = f_write(fp, disk_journal_sec, sizeof(disk_journal_sec), &bw);
+    return fr == FR_OK && bw == sizeof(disk_journal_sec) ? 0 : -1;
+}
+
+// Grows the file over the whole log area, once. The new clusters hold
+// whatever they held before, so the record headers past the old end are
+// zeroed: one could pass for the next record of the log.
+static int disk_journal_extend(FIL *fp) {
+    const uint32_t size = (uint32_t)f_size(fp);
+    if (size >= BDSK_JOURNAL_END)
+        return 0;
+    // seeking past the end of a file open for writing allocates the clusters
+    if (f_lseek(fp, BDSK_JOURNAL_END) != FR_OK || f_tell(fp) != BDSK_JOURNAL_END)
+        return -1;
+    for (uint32_t n = 0; n < BDSK_JOURNAL_MAX; n++) {
+        uint32_t hdr = BDSK_JOURNAL_BASE + n * BDSK_JOURNAL_REC + BDSK_TRACK_DATA_SIZE;
+        if (hdr + sizeof(disk_journal_sec) > size && disk_journal_write_hdr(fp, n, NULL) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static inline uint32_t disk_journal_slot(uint8_t track) {
+    return sizeof(bdsk_header_t) +
+        track * (sizeof(bdsk_track_desc_t) + BDSK_TRACK_DATA_SIZE);
+}
+
+int disk_journal_replay(disk_journal_t *j, FIL *fp, uint8_t *image) {
+    memset(j, 0, sizeof(*j));
+    j->end = BDSK_JOURNAL_BASE;
+
+    const uint32_t size = (uint32_t)f_size(fp);
+    bdsk_journal_rec_t hdr;
+    while (j->end + BDSK_TRACK_DATA_SIZE + sizeof(hdr) <= size) {
+        // growing the file (or a truncate by an older build) cut short by a
+        // power cut leaves the size past the end of the cluster chain: the
+        // log ends where the reads do
+        if (disk_journal_read_rec(fp, j->end, &hdr, track_buf) < 0)
+            break;
+        // torn append (power cut), or what was there before the log
+        if (hdr.seq != j->seq || !disk_journal_rec_ok(&hdr, track_buf))
+            break;
+        if (!j->rec[hdr.track])
+            j->pending++;
+        j->rec[hdr.track] = j->end;
+        if (image) {
+            bdsk_track_desc_t desc = { .bit_count = hdr.bit_count };
+            uint8_t *slot = image + disk_journal_slot(hdr.track);
+            memcpy(slot, &desc, sizeof(desc));
+            memcpy(slot + sizeof(desc), track_buf, BDSK_TRACK_DATA_SIZE);
+        }
+        j->seq++;
+        j->end += BDSK_JOURNAL_REC;
+    }
+    if (j->seq)
+        printf("%s: %lu records, %u tracks to fold\n", __func__,
+               (unsigned long)j->seq, j->pending);
+    return 0;
+}
+
+int disk_journal_read_track(disk_journal_t *j, FIL *fp, uint8_t track,
+                            bdsk_track_desc_t *desc, uint8_t *data) {
+    if (track >= BDSK_TRACKS || !j->rec[track])
+        return 0;
+    bdsk_journal_rec_t hdr;
+    if (disk_journal_read_rec(fp, j->rec[track], &hdr, data) < 0)
+        return -1;
+    if (hdr.track != track || !disk_journal_rec_ok(&hdr, data))
+        return -1;
+    desc->bit_count = hdr.bit_count;
+    return 1;
+}
+
+int disk_journal_append(disk_journal_t *j, FIL *fp, uint8_t track,
+                        uint32_t bit_count, const uint8_t *data) {
+    if (track >= BDSK_TRACKS)
+        return -1;
+    if (j->seq >= BDSK_JOURNAL_MAX && disk_journal_compact(j, fp) < 0)
+        return -1;
+
+    bdsk_journal_rec_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BDSK_JOURNAL_MAGIC, 4);
+    hdr.seq = j->seq;
+    hdr.bit_count = bit_count;
+    hdr.track = track;
+    hdr.crc = disk_journal_rec_crc(&hdr, data);
+
+    if (disk_journal_extend(fp) < 0)
+        return -1;
+    // a record of an older log in the next slot could pass for the next
+    // one of this log once this one is in
+    if (j->seq + 1 < BDSK_JOURNAL_MAX && disk_journal_write_hdr(fp, j->seq + 1, NULL) < 0)
+        return -1;
+    if (f_lseek(fp, j->end) != FR_OK)
+        return -1;
+    UINT bw = 0;
+    FRESULT fr = f_write(fp, data, BDSK_TRACK_DATA_SIZE, &bw);
+    if (fr != FR_OK || bw != BDSK_TRACK_DATA_SIZE)
+        return -1;
+    if (disk_journal_write_hdr(fp, j->seq, &hdr) < 0)
+        return -1;
+
+    if (!j->rec[track])
+        j->pending++;
+    j->rec[track] = j->end;
+    j->seq++;
+    j->end += BDSK_JOURNAL_REC;
+    return 0;
+}
+
+int disk_journal_fold(disk_journal_t *j, FIL *fp) {
+    if (!j->pending)
+        return 0;
+    uint8_t track = 0;
+    while (!j->rec[track])
+        track++;
+
+    bdsk_track_desc_t desc;
+    if (disk_journal_read_track(j, fp, track, &desc, track_buf) <= 0)
+        return -1;
+    if (f_lseek(fp, disk_journal_slot(track)) != FR_OK)
+        return -1;
+    UINT bw = 0;
+    FRESULT fr = f_write(fp, &desc, sizeof(desc), &bw);
+    if (fr != FR_OK || bw != sizeof(desc))
+        return -1;
+    fr = f_write(fp, track_buf, BDSK_TRACK_DATA_SIZE, &bw);
+    if (fr != FR_OK || bw != BDSK_TRACK_DATA_SIZE)
+        return -1;
+    // the slot has to be on the card before its record can go
+    if (f_sync(fp) != FR_OK)
+        return -1;
+
+    j->rec[track] = 0;
+    if (--j->pending == 0)
+        return disk_journal_reset(j, fp);
+    return j->pending;
+}
+
+int disk_journal_compact(disk_journal_t *j, FIL *fp) {
+    int res;
+    do {
+        res = disk_journal_fold(j, fp);
+    } while (res > 0);
+    return res;
+}
+
+int disk_journal_reset(disk_journal_t *j, FIL *fp) {
+    memset(j, 0, sizeof(*j));
+    j->end = BDSK_JOURNAL_BASE;
+    // one write empties the log, nothing replays without record 0. Zeroing
+    // the records newest first instead, a power cut part way leaves the
+    // start of the log: older copies of a track logged twice, replayed
+    // over what the fold put in its slot.
+    const uint32_t size = (uint32_t)f_size(fp);
+    if (size >= BDSK_JOURNAL_BASE + BDSK_JOURNAL_REC && disk_journal_write_hdr(fp, 0, NULL) < 0)
+        return -1;
+    // a freshly converted sidecar gets its log area now, not on the
+    // first write the guest does
+    if (disk_journal_extend(fp) < 0)
+        return -1;
+    return f_sync(fp) == FR_OK ? 0 : -1;
+}
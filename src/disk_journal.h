@@ -0,0 +1,78 @@
+/*
+ * disk_journal.h
+ *
+ * Append-only track log at the end of a .bdsk sidecar for murmapple
+ *
+ * Written tracks are appended after the fixed track slots instead of
+ * being rewritten in place; an idle-time compactor copies them back to
+ * their slots and empties the log. A power cut mid-append only loses
+ * that record (its CRC won't match), and one mid-fold is redone on the
+ * next mount, the record is still in the log.
+ */
+
+#ifndef DISK_JOURNAL_H
+#define DISK_JOURNAL_H
+
+#include <stdint.h>
+#include "ff.h"
+#include "disk_loader.h"
+
+// The log starts on the first sector after the slots. A record is the
+// track data (13 sectors) then a sector with the header, so an append is
+// whole sector writes, straight from the track buffer.
+#define BDSK_JOURNAL_BASE   ((BDSK_BYTES + 511) & ~511u)
+#define BDSK_JOURNAL_REC    (BDSK_TRACK_DATA_SIZE + 512)
+#define BDSK_JOURNAL_MAGIC  "BDJR"
+// Full log (~450KB): it's all folded back before the next append
+#define BDSK_JOURNAL_MAX    64
+// The file is grown to hold a full log on the first append and stays that
+// size, so an append only writes sectors the file already has: no FAT or
+// directory entry update besides the one the sync does anyway.
+#define BDSK_JOURNAL_END    (BDSK_JOURNAL_BASE + BDSK_JOURNAL_MAX * BDSK_JOURNAL_REC)
+
+typedef struct bdsk_journal_rec {
+    char     magic[4];      // "BDJR"
+    uint32_t seq;           // record number since the log was last emptied
+    uint32_t bit_count;
+    uint8_t  track;
+    uint8_t  pad[3];
+    uint32_t crc;           // CRC-32 of the track data, then this header with crc = 0
+} bdsk_journal_rec_t;
+
+typedef struct disk_journal_t {
+    uint32_t end;               // file offset of the next record
+    uint32_t seq;               // of the next record
+    uint16_t pending;           // logged tracks not folded back yet
+    uint32_t rec[BDSK_TRACKS];  // offset of the newest record per track, 0 for none
+} disk_journal_t;
+
+// CRC-32 (zlib's), in software
+uint32_t disk_journal_crc32(uint32_t crc, const uint8_t *p, uint32_t len);
+
+// Scans the log of an open sidecar, up to the first torn, bad or
+// unreadable record. 'image' is an in-memory copy of the file (BDSK_BYTES)
+// or NULL; logged tracks are copied over their slot there.
+int disk_journal_replay(disk_journal_t *j, FIL *fp, uint8_t *image);
+
+// Newest logged copy of a track: 1 if found, 0 if not logged, -1 on error
+int disk_journal_read_track(disk_journal_t *j, FIL *fp, uint8_t track,
+                            bdsk_track_desc_t *desc, uint8_t *data);
+
+// Appends a track, growing the file to BDSK_JOURNAL_END first if it is
+// short; the caller syncs the file
+int disk_journal_append(disk_journal_t *j, FIL *fp, uint8_t track,
+                        uint32_t bit_count, const uint8_t *data);
+
+// Copies one logged track back to its slot, empties the log after the
+// last one. Returns the number still pending, -1 on error.
+int disk_journal_fold(disk_journal_t *j, FIL *fp);
+
+// Folds everything back; returns 0, or -1 on error
+int disk_journal_compact(disk_journal_t *j, FIL *fp);
+
+// Drops the log (the slots were just rewritten by a conversion, or it
+// was all folded back): the header of record 0 is zeroed. Grows the file
+// to BDSK_JOURNAL_END if it is short.
+int disk_journal_reset(disk_journal_t *j, FIL *fp);
+
+#endif // DISK_JOURNAL_H
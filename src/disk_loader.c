@@ -9,8 +9,12 @@
 #include <string.h>
 #include <ctype.h>
 #include "disk_loader.h"
+#include "disk_journal.h"
 #include "ff.h"
 #include "pico/stdlib.h"
+#if PICO_RP2350
+#include "hardware/dma.h"
+#endif
 #include "../drivers/psram_allocator.h"
 
 // MII emulator headers
@@ -39,6 +43,22 @@ loaded_disk_t g_loaded_disks[2] = {0};
 // Static mii_dd_file_t structures for the two drives
 static mii_dd_file_t g_dd_files[2] = {0};
 
+// Track log of the mounted .bdsk of each drive (see disk_journal.h)
+static disk_journal_t g_journal[2];
+// Format of the mounted .bdsk, a v1 file keeps its header on write-back
+static uint8_t g_bdsk_version[2];
+
+extern const uint8_t noize[MII_FLOPPY_MAX_TRACK_SIZE]; // mii_disk2.c
+
+// What each track of the mounted .bdsk holds on the card, taken when it's
+// loaded or written; a dirty track that hashes the same isn't written back
+typedef struct disk_track_sum_t {
+    uint32_t crc;
+    uint32_t bit_count;     // 0: not known, write it
+} disk_track_sum_t;
+static disk_track_sum_t g_track_sum[2][BDSK_TRACKS];
+static disk_write_stats_t g_write_stats;
+
 // FatFS objects
 static FATFS fs;
 static bool sd_mounted = false;
@@ -121,6 +141,116 @@ static inline uint16_t disk_le16(const void *p) {
 	return (uint16_t)b[0] | ((uint16_t)b[1] << 8);
 }
 
+#if PICO_RP2350
+static int crc_dma_chan = -1;
+
+// CRC-32 of a track by the DMA sniffer, ~1700 cycles for 6656 bytes
+static uint32_t disk_track_crc(const uint8_t *data) {
+    static uint32_t sink;
+    if ((uintptr_t)data & 3)    // word transfers only
+        return disk_journal_crc32(0, data, BDSK_TRACK_DATA_SIZE);
+    if (crc_dma_chan < 0)
+        crc_dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config cfg = dma_channel_get_default_config(crc_dma_chan);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_sniff_enable(&cfg, true);
+    dma_sniffer_enable(crc_dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_data_accumulator(0xffffffff);
+    dma_channel_configure(crc_dma_chan, &cfg, &sink, data,
+                          BDSK_TRACK_DATA_SIZE / 4, true);
+    dma_channel_wait_for_finish_blocking(crc_dma_chan);
+    uint32_t crc = dma_sniffer_get_data_accumulator();
+    dma_sniffer_disable();
+    return crc;
+}
+#else
+static uint32_t disk_track_crc(const uint8_t *data) {
+    return disk_journal_crc32(0, data, BDSK_TRACK_DATA_SIZE);
+}
+#endif
+
+static void disk_track_sum_set(int drive, uint8_t track_id, uint32_t bit_count,
+                               const uint8_t *data) {
+    if (track_id >= BDSK_TRACKS)
+        return;
+    g_track_sum[drive][track_id].crc = disk_track_crc(data);
+    g_track_sum[drive][track_id].bit_count = bit_count;
+}
+
+// The dirty track is what the card already has: the guest rewrote the same
+// sectors (DOS does it with the VTOC and catalog all the time)
+static bool disk_track_unchanged(int drive, mii_floppy_t *floppy, uint8_t track_id) {
+    if (track_id >= BDSK_TRACKS || !floppy->tracks[track_id].dirty)
+        return false;
+    const disk_track_sum_t *sum = &g_track_sum[drive][track_id];
+    return sum->bit_count == floppy->tracks[track_id].bit_count &&
+        sum->crc == disk_track_crc(floppy->curr_track_data);
+}
+
+void disk_get_write_stats(disk_write_stats_t *st) {
+    *st = g_write_stats;
+}
+
+// In-memory copy of the drive's sidecar: SRAM for drive #0, PSRAM for drive #1
+static uint8_t *disk_bdsk_cache(int drive) {
+#if PICO_RP2350
+    if (!drive)
+        return drive0_cache;
+    if (butter_psram_size())
+        return PSRAM_DATA;
+#endif
+    return NULL;
+}
+
+static void disk_cache_track(int drive, uint32_t track_offset,
+                             const bdsk_track_desc_t *desc, const uint8_t *data) {
+    uint8_t *cache = disk_bdsk_cache(drive);
+    if (!cache)
+        return;
+    memcpy(cache + track_offset, desc, sizeof(*desc));
+    memcpy(cache + track_offset + sizeof(*desc), data, BDSK_TRACK_DATA_SIZE);
+}
+
+// Quarter track map of a v2 .bdsk, from/to floppy->track_id
+static int disk_dump_qtrack_map(int drive, mii_floppy_t *floppy, FIL *target) {
+    uint8_t map[BDSK_QTRACKS];
+    for (int q = 0; q < BDSK_QTRACKS; q++)
+        map[q] = floppy->track_id[q] < BDSK_TRACKS ? floppy->track_id[q] : BDSK_QMAP_NONE;
+    if (f_lseek(target, BDSK_QMAP_OFFSET) != FR_OK)
+        return -1;
+    UINT bw = 0;
+    FRESULT fr = f_write(target, map, sizeof(map), &bw);
+    if (fr != FR_OK || bw != sizeof(map))
+        return -1;
+    uint8_t *cache = disk_bdsk_cache(drive);
+    if (cache)
+        memcpy(cache + BDSK_QMAP_OFFSET, map, sizeof(map));
+    return 0;
+}
+
+static int disk_load_qtrack_map(int drive, mii_floppy_t *floppy, FIL *fp) {
+    uint8_t map[BDSK_QTRACKS];
+    uint8_t *cache = disk_bdsk_cache(drive);
+    if (cache) {
+        memcpy(map, cache + BDSK_QMAP_OFFSET, sizeof(map));
+    } else {
+        if (f_lseek(fp, BDSK_QMAP_OFFSET) != FR_OK)
+            return -1;
+        UINT br = 0;
+        FRESULT fr = f_read(fp, map, sizeof(map), &br);
+        if (fr != FR_OK || br != sizeof(map))
+            return -1;
+    }
+    for (int q = 0; q < BDSK_QTRACKS; q++) {
+        if (map[q] >= BDSK_TRACKS && map[q] != BDSK_QMAP_NONE)
+            return -1;
+        floppy->track_id[q] = map[q] < BDSK_TRACKS ? map[q] : MII_FLOPPY_NOISE_TRACK;
+    }
+    return 0;
+}
+
 static int
 disk_dump_current_track(
     int drive,
@@ -141,7 +271,9 @@ disk_dump_current_track(
     if (track_id == 0) {
         bdsk_header_t hdr;
         memcpy(hdr.magic, BDSK_MAGIC, 4);
-        hdr.version = BDSK_VERSION;
+        hdr.version = g_bdsk_version[drive];
+        // default stays 0, the header of a 4us disk is what it always was
+        hdr.bit_timing = floppy->bit_timing == MII_FLOPPY_BIT_TIMING ? 0 : floppy->bit_timing;
         hdr.tracks  = DSK_TRACKS;
 
         FRESULT fr = f_lseek(target, 0);
@@ -182,15 +314,8 @@ disk_dump_current_track(
     if (fr != FR_OK || bw != BDSK_TRACK_DATA_SIZE)
         return -1;
 
-#if PICO_RP2350
-    if (!drive) { // drive #0
-        memcpy(drive0_cache + track_offset, &desc, sizeof(desc));
-        memcpy(drive0_cache + track_offset + sizeof(desc), floppy->curr_track_data, BDSK_TRACK_DATA_SIZE);
-    } else if (butter_psram_size()) { // drive #1
-        memcpy(PSRAM_DATA + track_offset, &desc, sizeof(desc));
-        memcpy(PSRAM_DATA + track_offset + sizeof(desc), floppy->curr_track_data, BDSK_TRACK_DATA_SIZE);
-    }
-#endif
+    disk_cache_track(drive, track_offset, &desc, floppy->curr_track_data);
+    disk_track_sum_set(drive, track_id, desc.bit_count, floppy->curr_track_data);
 
     return 0;
 }
@@ -285,9 +410,6 @@ static bool disk_woz_chunk_id_is(const mii_woz_chunk_t *chunk, const char id[4])
 
 static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_dd_file_t *file, FIL *fp) {
     FIL target;
-    if (!disk_open_bdsk_image_file(&target, file->pathname, path, sizeof(path))) {
-        return -1;
-    }
 
 	// Read header magic
 	uint8_t magic[4];
@@ -308,6 +430,7 @@ static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_
 
 	// Scan chunks (WOZ chunk ordering is not guaranteed)
 	const uint32_t file_size = (uint32_t)f_size(fp);
+	uint32_t info_payload_off = 0, info_payload_size = 0;
 	uint32_t tmap_payload_off = 0, tmap_payload_size = 0;
 	uint32_t trks_payload_off = 0, trks_payload_size = 0;
 
@@ -325,7 +448,10 @@ static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_
 		const uint32_t payload_off = off + (uint32_t)sizeof(chunk);
 		if (payload_off + size > file_size)
 			break;
-		if (disk_woz_chunk_id_is(&chunk, "TMAP")) {
+		if (disk_woz_chunk_id_is(&chunk, "INFO")) {
+			info_payload_off = payload_off;
+			info_payload_size = size;
+		} else if (disk_woz_chunk_id_is(&chunk, "TMAP")) {
 			tmap_payload_off = payload_off;
 			tmap_payload_size = size;
 		} else if (disk_woz_chunk_id_is(&chunk, "TRKS")) {
@@ -337,49 +463,100 @@ static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_
 
 	if (!tmap_payload_off || !trks_payload_off) {
 		printf("%s: missing required chunks (TMAP/TRKS)\n", __func__);
-    	goto fail;
+		return -1;
+	}
+
+	// Bit timing the image was taken at (INFO v2 and up, WOZ2 only)
+	mii_woz2_info_t info;
+	if (is_woz2 && info_payload_off &&
+			info_payload_size >= sizeof(info) - sizeof(mii_woz_chunk_t)) {
+		fr = f_lseek(fp, info_payload_off - sizeof(mii_woz_chunk_t));
+		if (fr != FR_OK)
+			return -1;
+		br = 0;
+		fr = f_read(fp, &info, sizeof(info), &br);
+		if (fr != FR_OK || br != sizeof(info))
+			return -1;
+		if (info.version >= 2)
+			floppy->bit_timing = mii_floppy_bit_timing(info.optimal_bit_timing);
+		if (floppy->bit_timing != MII_FLOPPY_BIT_TIMING)
+			printf("%s: bit timing %d (%d.%03dus)\n", __func__, floppy->bit_timing,
+					floppy->bit_timing / 8, (floppy->bit_timing % 8) * 125);
 	}
 
 	// Read TMAP
 	uint8_t tmap_track_id[160];
 	if (tmap_payload_size < sizeof(tmap_track_id)) {
         printf("%s: TMAP too small (%lu)\n", __func__, (unsigned long)tmap_payload_size);
-    	goto fail;
+		return -1;
 	}
 	fr = f_lseek(fp, tmap_payload_off);
 	if (fr != FR_OK)
-    	goto fail;
+		return -1;
 	br = 0;
 	fr = f_read(fp, tmap_track_id, sizeof(tmap_track_id), &br);
 	if (fr != FR_OK || br != sizeof(tmap_track_id))
-    	goto fail;
+		return -1;
 
-	uint64_t used_tracks = 0;
+	// Which TRKS entries have data: WOZ2 has an index of 160 (start block
+	// and bit count 0 for an unused one), WOZ1 entries are 6656 bytes apart
+	// up to the end of the chunk
+	struct {
+		uint16_t start_block_le;
+		uint16_t block_count_le;
+		uint32_t bit_count_le;
+	} track[160];
+	bool present[160];
+	if (is_woz2) {
+		fr = f_lseek(fp, trks_payload_off);
+		if (fr != FR_OK)
+			return -1;
+		br = 0;
+		fr = f_read(fp, track, sizeof(track), &br);
+		if (fr != FR_OK || br != sizeof(track))
+			return -1;
+	}
+	for (int i = 0; i < 160; i++)
+		present[i] = is_woz2 ?
+				le16toh(track[i].start_block_le) && le32toh(track[i].bit_count_le) :
+				(uint32_t)(i + 1) * 6656 <= trks_payload_size;
+
+	// TRKS entries get a slot each, in head order, the quarter tracks that
+	// point at the same entry share it; one that's not there is noise
+	uint8_t slot_of[160];
+	bool seen[160] = {};
+	memset(slot_of, 0xff, sizeof(slot_of));
+	int slots = 0, lost = 0;
+	for (int ti = 0; ti < (int)sizeof(floppy->track_id) && ti < (int)sizeof(tmap_track_id); ti++) {
+		uint8_t tid = tmap_track_id[ti];
+		if (tid >= 160 || !present[tid] || seen[tid])
+			continue;
+		seen[tid] = true;
+		if (slots < MII_FLOPPY_TRACK_COUNT)
+			slot_of[tid] = slots++;
+		else
+			lost++;
+	}
+	// the .bdsk has MII_FLOPPY_TRACK_COUNT slots: the outermost entries of
+	// a disk that needs more read noise, the rest of it still mounts
+	if (lost)
+		printf("%s: %d distinct tracks, only %d fit in a .bdsk: "
+				"the last %d read noise\n", __func__,
+				slots + lost, MII_FLOPPY_TRACK_COUNT, lost);
 	for (int ti = 0; ti < (int)sizeof(floppy->track_id) && ti < (int)sizeof(tmap_track_id); ti++) {
 		uint8_t tid = tmap_track_id[ti];
-		floppy->track_id[ti] = (tid == 0xff) ? MII_FLOPPY_NOISE_TRACK : tid;
-		if (tid != 0xff && tid < 64)
-			used_tracks |= (1ULL << tid);
+		floppy->track_id[ti] = tid < 160 && slot_of[tid] != 0xff ?
+				slot_of[tid] : MII_FLOPPY_NOISE_TRACK;
 	}
 
 	// Load tracks from TRKS
-	fr = f_lseek(fp, trks_payload_off);
-	if (fr != FR_OK)
-    	goto fail;
-
+    if (!disk_open_bdsk_image_file(&target, file->pathname, path, sizeof(path))) {
+        return -1;
+    }
 	if (is_woz2) {
-		// Track entries (160)
-		struct {
-			uint16_t start_block_le;
-			uint16_t block_count_le;
-			uint32_t bit_count_le;
-		} track[160];
-		br = 0;
-		fr = f_read(fp, track, sizeof(track), &br);
-		if (fr != FR_OK || br != sizeof(track))
-        	goto fail;
-		for (int i = 0; i < MII_FLOPPY_TRACK_COUNT; i++) {
-			if (!(used_tracks & (1ULL << i)))
+		for (int i = 0; i < 160; i++) {
+			const int slot = slot_of[i];
+			if (slot == 0xff)
 				continue;
 			const uint32_t bit_count = le32toh(track[i].bit_count_le);
 			const uint32_t byte_count = (bit_count + 7) >> 3;
@@ -395,23 +572,27 @@ static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_
 		    fr = f_read(fp, floppy->curr_track_data, byte_count, &br);
 			if (fr != FR_OK || br != byte_count)
 				goto fail;
-			floppy->tracks[i].virgin = 0;
-			floppy->tracks[i].bit_count = bit_count;
-            if (disk_dump_current_track(drive, i, floppy, file, &target) < 0)
+			floppy->tracks[slot].virgin = 0;
+			floppy->tracks[slot].bit_count = bit_count;
+            if (disk_dump_current_track(drive, slot, floppy, file, &target) < 0)
                 goto fail;
 		}
         f_close(&target);
 		return 2;
 	}
-    // WOZ1 TRKS payload is 35 fixed-size track entries (6656 bytes)
-    for (int i = 0; i < 35 && i < MII_FLOPPY_TRACK_COUNT; i++) {
+    // WOZ1 TRKS payload is fixed-size track entries (6656 bytes)
+    for (int i = 0; i < 160; i++) {
+        const int slot = slot_of[i];
+        if (slot == 0xff)
+            continue;
         uint8_t entry[6656];
+        fr = f_lseek(fp, trks_payload_off + i * 6656);
+        if (fr != FR_OK)
+            goto fail;
         br = 0;
         fr = f_read(fp, entry, sizeof(entry), &br);
         if (fr != FR_OK || br != sizeof(entry))
             goto fail;
-        if (!(used_tracks & (1ULL << i)))
-            continue;
         // Layout: bits[6646] then byte_count_le at offset 6646
         const uint16_t byte_count = disk_le16(entry + 6646);
         const uint16_t bit_count = disk_le16(entry + 6648);
@@ -419,10 +600,10 @@ static int disk_load_floppy_woz_from_fatfs(int drive, mii_floppy_t *floppy, mii_
             printf("%s: WOZ1 track %d too large (%u bytes)\n", __func__, i, byte_count);
             goto fail;
         }
-        floppy->tracks[i].virgin = 0;
+        floppy->tracks[slot].virgin = 0;
         memcpy(floppy->curr_track_data, entry, byte_count);
-        floppy->tracks[i].bit_count = bit_count;
-        if (disk_dump_current_track(drive, i, floppy, file, &target) < 0)
+        floppy->tracks[slot].bit_count = bit_count;
+        if (disk_dump_current_track(drive, slot, floppy, file, &target) < 0)
             goto fail;
     }
     f_close(&target);
@@ -450,18 +631,20 @@ disk_load_floppy_bdsk_track_from_fatfs(
 
     /* --- read descriptor --- */
     bdsk_track_desc_t desc;
-#if PICO_RP2350
-    if (!drive) { // drive #0
-        memcpy(&desc, drive0_cache + track_offset, sizeof(bdsk_track_desc_t));
-        memcpy(floppy->curr_track_data, drive0_cache + track_offset + sizeof(bdsk_track_desc_t), BDSK_TRACK_DATA_SIZE);
+    uint8_t *cache = disk_bdsk_cache(drive);
+    if (cache) {
+        memcpy(&desc, cache + track_offset, sizeof(bdsk_track_desc_t));
+        memcpy(floppy->curr_track_data, cache + track_offset + sizeof(bdsk_track_desc_t), BDSK_TRACK_DATA_SIZE);
         goto ok;
     }
-    if (butter_psram_size()) { // drive #1
-        memcpy(&desc, PSRAM_DATA + track_offset, sizeof(bdsk_track_desc_t));
-        memcpy(floppy->curr_track_data, PSRAM_DATA + track_offset + sizeof(bdsk_track_desc_t), BDSK_TRACK_DATA_SIZE);
+    // the log has the newest copy, if the track was written since the fold
+    int logged = disk_journal_read_track(&g_journal[drive], fp, track_id,
+                                         &desc, floppy->curr_track_data);
+    if (logged < 0)
+        return -1;
+    if (logged)
         goto ok;
-    }
-#endif
+
     FRESULT fr = f_lseek(fp, track_offset);
     if (fr != FR_OK)
         return -1;
@@ -483,6 +666,7 @@ disk_load_floppy_bdsk_track_from_fatfs(
 ok:
     if (desc.bit_count == 0 || desc.bit_count > BDSK_MAX_BITS)
         return -1;
+    disk_track_sum_set(drive, track_id, desc.bit_count, floppy->curr_track_data);
     /* --- update floppy state --- */
     mii_floppy_track_t *dst = &floppy->tracks[track_id];
     dst->bit_count = desc.bit_count;
@@ -504,14 +688,14 @@ static int disk_load_floppy_bdsk_from_fatfs(int drive, mii_floppy_t *floppy, mii
 #if PICO_RP2350
     if (!drive) { // drive #0
         fr = f_read(fp, drive0_cache, sizeof(drive0_cache), &br);
-        if (fr != FR_OK || br != sizeof(drive0_cache))
+        if (fr != FR_OK || br < BDSK_QMAP_OFFSET)   // v1 ends there
             return -1;
         memcpy(&hdr, drive0_cache, sizeof hdr);
         goto ok;
     }
     if (butter_psram_size()) { // drive #1
         fr = f_read(fp, PSRAM_DATA, sizeof(drive0_cache), &br);
-        if (fr != FR_OK || br != sizeof(drive0_cache))
+        if (fr != FR_OK || br < BDSK_QMAP_OFFSET)
             return -1;
         memcpy(&hdr, PSRAM_DATA, sizeof hdr);
         goto ok;
@@ -525,11 +709,28 @@ ok:
     if (memcmp(hdr.magic, BDSK_MAGIC, 4) != 0)
         return -1;
 
-    if (hdr.version != BDSK_VERSION || hdr.tracks != BDSK_TRACKS)
+    if (hdr.version < 1 || hdr.version > BDSK_VERSION || hdr.tracks != BDSK_TRACKS)
+        return -1;
+    g_bdsk_version[drive] = hdr.version;
+    floppy->bit_timing = mii_floppy_bit_timing(hdr.bit_timing);
+    // v1 keeps the whole track map of mii_floppy_init()
+    if (hdr.version >= 2 && disk_load_qtrack_map(drive, floppy, fp) < 0) {
+        printf("%s: bad quarter track map\n", __func__);
+        return -1;
+    }
+
+    // tracks written since the last fold, over the slots of the cached copy
+    if (disk_journal_replay(&g_journal[drive], fp, disk_bdsk_cache(drive)) < 0)
         return -1;
 
-    // all tracks validation loading
+    // all tracks validation loading, the ones the head can get to
+    uint64_t used = 0;
+    for (int q = 0; q < MII_FLOPPY_QTRACK_COUNT; q++)
+        if (floppy->track_id[q] < BDSK_TRACKS)
+            used |= 1ULL << floppy->track_id[q];
     for (int track = 0; track < hdr.tracks; track++) {
+        if (!(used & (1ULL << track)))
+            continue;
         if (disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, fp, track) < 0) {
             return -1;
         }
@@ -834,6 +1035,7 @@ int disk_mount_to_emulator(int drive, mii_t *mii, int slot, int preserve_state,
     
     // Initialize the floppy (clears all tracks)
     mii_floppy_init(floppy);
+    memset(g_track_sum[drive], 0, sizeof(g_track_sum[drive]));
     
     // Restore drive state if preserving (INSERT mode)
     if (preserve_state) {
@@ -844,12 +1046,12 @@ int disk_mount_to_emulator(int drive, mii_t *mii, int slot, int preserve_state,
         printf("Preserved drive state: motor=%d qtrack=%d bit_pos=%lu\n",
                saved_motor, saved_qtrack, (unsigned long)saved_bit_position);
     }
-    // we shoul load selected track as last operation, to make floppy->curr_track_data persistent
-    uint8_t track_id = floppy->track_id[floppy->qtrack];
-
     // Load the disk image into the floppy structure
     res = -1;
+    bool converted = false;
     if (bdsk_recreate || !disk_bdsk_exists(file->pathname)) {
+        converted = file->format != MII_DD_FILE_BDSK;
+        g_bdsk_version[drive] = BDSK_VERSION;
         // Open the image on SD
         if (!disk_open_original_image_file(disk->filename, &fp, path, sizeof(path))) {
             printf("Failed to open disk image %s\n", disk->filename);
@@ -886,7 +1088,19 @@ int disk_mount_to_emulator(int drive, mii_t *mii, int slot, int preserve_state,
         if (!disk_open_bdsk_image_file(&fp, file->pathname, path, sizeof(path))) {
             return -1;
         }
-        res = disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, &fp, track_id);
+        // fresh slots, a log from an earlier mount would shadow them
+        if (converted) {
+            res = disk_dump_qtrack_map(drive, floppy, &fp);
+            if (res >= 0)
+                res = disk_journal_reset(&g_journal[drive], &fp);
+        }
+        // we shoul load selected track as last operation, to make floppy->curr_track_data persistent
+        // (the image's quarter track map is loaded by now)
+        uint8_t track_id = floppy->track_id[floppy->qtrack];
+        if (res >= 0 && track_id < DSK_TRACKS)
+            res = disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, &fp, track_id);
+        else if (res >= 0)
+            memcpy(floppy->curr_track_data, noize, MII_FLOPPY_MAX_TRACK_SIZE);
         f_close(&fp);
     }
 
@@ -922,14 +1136,19 @@ void disk_reload_track(uint8_t drive, uint8_t track_id, mii_t* mii) {
         printf("Failed to get floppy structure for drive %d (slot %d)\n", drive + 1, g_disk2_slot);
         return;
     }
-    if (!disk_open_bdsk_image_file(&fp, disk->filename, path, sizeof(path))) {
-        printf("Failed to open disk image %s\n", disk->filename);
-        return;
-    }
     mii_floppy_t *floppy = floppies[drive];
     mii_dd_file_t *file = &g_dd_files[drive];
-    res = disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, &fp, track_id);
-    f_close(&fp);
+    if (disk_bdsk_cache(drive)) {
+        // the whole image is in memory, a head step doesn't touch the card
+        res = disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, NULL, track_id);
+    } else {
+        if (!disk_open_bdsk_image_file(&fp, disk->filename, path, sizeof(path))) {
+            printf("Failed to open disk image %s\n", disk->filename);
+            return;
+        }
+        res = disk_load_floppy_bdsk_track_from_fatfs(drive, floppy, file, &fp, track_id);
+        f_close(&fp);
+    }
 
     if (res < 0) {
         printf("Failed to load disk image track %d to floppy: %d\n", track_id, res);
@@ -952,14 +1171,30 @@ disk_write_floppy_bdsk_track_to_fatfs(
     if (!src->dirty)
         return 0;
 
+#if WITH_BDSK_JOURNAL
+    if (disk_journal_append(&g_journal[drive], fp, track_id, src->bit_count,
+                            floppy->curr_track_data) < 0)
+        return -1;
+    bdsk_track_desc_t desc = { .bit_count = src->bit_count };
+    disk_cache_track(drive,
+        sizeof(bdsk_header_t) + track_id * (sizeof(bdsk_track_desc_t) + BDSK_TRACK_DATA_SIZE),
+        &desc, floppy->curr_track_data);
+    disk_track_sum_set(drive, track_id, desc.bit_count, floppy->curr_track_data);
+#else
+    // a log left by a journal build would shadow the in-place write
+    if (g_journal[drive].pending && disk_journal_compact(&g_journal[drive], fp) < 0)
+        return -1;
     if (disk_dump_current_track(drive, track_id, floppy, file, fp) < 0)
         return -1;
+#endif
 
     if (f_sync(fp) != FR_OK)
         return -1;
 
     src->dirty = 0;
     floppy->seed_saved = floppy->seed_dirty;
+    g_write_stats.writes++;
+    g_write_stats.bytes_written += BDSK_TRACK_DATA_SIZE;
     return 0;
 }
 
@@ -1000,11 +1235,18 @@ void disk_write_track(uint8_t drive, uint8_t track_id, mii_t* mii) {
         printf("Failed to get floppy structure for drive %d (slot %d)\n", drive + 1, g_disk2_slot);
         return;
     }
+    mii_floppy_t *floppy = floppies[drive];
+    if (disk_track_unchanged(drive, floppy, track_id)) {
+        floppy->tracks[track_id].dirty = 0;
+        floppy->seed_saved = floppy->seed_dirty;
+        g_write_stats.unchanged++;
+        g_write_stats.bytes_avoided += BDSK_TRACK_DATA_SIZE;
+        return;
+    }
     if (!disk_open_bdsk_image_file(&fp, disk->filename, path, sizeof(path))) {
         printf("Failed to open disk image %s\n", disk->filename);
         return;
     }
-    mii_floppy_t *floppy = floppies[drive];
     mii_dd_file_t *file = &g_dd_files[drive];
     res = disk_write_floppy_bdsk_track_to_fatfs(drive, floppy, file, &fp, track_id);
     f_close(&fp);
@@ -1014,6 +1256,35 @@ void disk_write_track(uint8_t drive, uint8_t track_id, mii_t* mii) {
     }
 }
 
+// Folds the track log of a drive back into the slots: one track, or all
+static void disk_fold_journal(int drive, bool all) {
+    loaded_disk_t *disk = &g_loaded_disks[drive];
+    disk_journal_t *j = &g_journal[drive];
+    if (!j->pending || !disk->loaded || !disk->write_back)
+        return;
+    if (!disk_open_bdsk_image_file(&fp, disk->filename, path, sizeof(path)))
+        return;
+    int res = all ? disk_journal_compact(j, &fp) : disk_journal_fold(j, &fp);
+    f_close(&fp);
+    if (res < 0)
+        printf("Failed to fold the track log of drive %d\n", drive + 1);
+}
+
+void disk_loader_idle(mii_t *mii) {
+    if (!g_journal[0].pending && !g_journal[1].pending)
+        return;
+    mii_floppy_t *floppies[2] = {NULL, NULL};
+    if (mii_slot_command(mii, g_disk2_slot, MII_SLOT_D2_GET_FLOPPY, floppies) < 0)
+        return;
+    for (int drive = 0; drive < 2; drive++) {
+        // the guest is between disk accesses once the motor is off
+        if (g_journal[drive].pending && floppies[drive] && !floppies[drive]->motor) {
+            disk_fold_journal(drive, false);
+            return;     // one track (~13KB of I/O) per frame
+        }
+    }
+}
+
 // Eject a disk from the emulator
 void disk_eject_from_emulator(int drive, mii_t *mii, int slot) {
     if (drive < 0 || drive > 1) return;
@@ -1034,6 +1305,11 @@ void disk_eject_from_emulator(int drive, mii_t *mii, int slot) {
     {
         disk_write_track(drive, track_id, mii);
     }
+    // leave a plain .bdsk behind
+    disk_fold_journal(drive, true);
+    printf("Track writes: %lu written, %lu unchanged (%lu KB not written)\n",
+           (unsigned long)g_write_stats.writes, (unsigned long)g_write_stats.unchanged,
+           (unsigned long)(g_write_stats.bytes_avoided / 1024));
     
     // Re-initialize the floppy (clears all data, makes it "empty")
     mii_floppy_init(floppies[drive]);
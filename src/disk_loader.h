@@ -47,8 +47,9 @@ typedef struct {
 } loaded_disk_t;
 
 #define BDSK_MAGIC "BDSK"
-#define BDSK_VERSION 1
+#define BDSK_VERSION 2
 #define BDSK_TRACKS 35
+#define BDSK_QTRACKS 160    // head positions, quarter tracks like the WOZ TMAP
 #define BDSK_TRACK_DATA_SIZE 6656
 #define BDSK_MAX_BITS (BDSK_TRACK_DATA_SIZE * 8)
 
@@ -58,17 +59,32 @@ typedef struct {
 // Bits are circular: bit positions wrap at bit_count.
 typedef struct bdsk_header {
     char     magic[4];      // "BDSK"
-    uint16_t version;       // 1
-    uint16_t tracks;        // 35
+    uint8_t  version;       // 1, 2 with the quarter track map
+    uint8_t  bit_timing;    // 125ns units, 0 for the default 32 (4us)
+    uint16_t tracks;        // 35 track slots
 } bdsk_header_t;
 
 typedef struct bdsk_track_desc {
-    uint32_t bit_count;     // ≤ 6656*8
+    uint32_t bit_count;     // ≤ 6656*8, 0 for a slot no quarter track uses (v2)
 //    uint32_t byte_count;    // fixed for this version (v1): 6656 == NIBBLE_TRACK_SIZE
 // Bits beyond bit_count up to BDSK_TRACK_DATA_SIZE*8 are undefined (padding).
 } bdsk_track_desc_t;
 
-#define BDSK_BYTES (sizeof(bdsk_header_t) + BDSK_TRACKS * (sizeof(bdsk_track_desc_t) + BDSK_TRACK_DATA_SIZE))
+// Version 2 has a quarter track map after the slots, like the WOZ TMAP: the
+// slot under the head at each quarter track, BDSK_QMAP_NONE where there's
+// no data. A whole track's quarter tracks share its slot, a half track has
+// one of its own. Version 1 is the default map, whole track N in slot N.
+#define BDSK_QMAP_NONE 0xff
+#define BDSK_QMAP_OFFSET (sizeof(bdsk_header_t) + BDSK_TRACKS * (sizeof(bdsk_track_desc_t) + BDSK_TRACK_DATA_SIZE))
+#define BDSK_BYTES (BDSK_QMAP_OFFSET + BDSK_QTRACKS)
+
+// Track write-back, both drives since boot
+typedef struct disk_write_stats_t {
+    uint32_t writes;        // dirty tracks written to the .bdsk
+    uint32_t unchanged;     // dirty tracks that hashed the same as on the card
+    uint32_t bytes_written;
+    uint32_t bytes_avoided; // by the unchanged ones
+} disk_write_stats_t;
 
 // Global state
 extern disk_entry_t* g_disk_list;
@@ -112,4 +128,11 @@ int disk_mount_to_emulator(int drive, struct mii_t *mii, int slot, int preserve_
 // slot: slot number where disk2 card is installed (usually 6)
 void disk_eject_from_emulator(int drive, struct mii_t *mii, int slot);
 
+// Track write-back counters
+void disk_get_write_stats(disk_write_stats_t *st);
+
+// Once per frame: folds a track written to the .bdsk log back into its
+// slot while that drive's motor is off (see disk_journal.h)
+void disk_loader_idle(struct mii_t *mii);
+
 #endif // DISK_LOADER_H
@@ -16,6 +16,9 @@
 #include "mii_sw.h"
 #include "mii_bank.h"
 #include "debug_log.h"
+#if WITH_INPUT_REPLAY
+#include "mii_replay.h"
+#endif
 
 // External function to clear held key state (from main.c)
 extern void clear_held_key(void);
@@ -441,23 +444,24 @@ static bool disk_ui_delete_selected_file(void)
     return true;
 }
 
-// Handle loading complete - mount disk and perform action
-static void handle_disk_loaded(void) {
-    disk_ui_hide();
+// Mount the disk selected for 'drive', then boot from it or just insert it
+static bool disk_ui_mount(int drive, bool boot, bool ro, bool recreate) {
+    bool ok = false;
     if (g_mii) {
-        int preserve_state = (selected_action == 1) ? 1 : 0;  // INSERT preserves state
+        int preserve_state = boot ? 0 : 1;  // INSERT preserves state
         if (0 == disk_mount_to_emulator(
-                selected_drive,
+                drive,
                 g_mii,
                 g_disk2_slot,
                 preserve_state,
-                read_only,
-                bdsk_recreate
+                ro,
+                recreate
             )
         ) {
             printf("Disk UI: disk mounted successfully\n");
+            ok = true;
             
-            if (selected_action == 0) {  // BOOT
+            if (boot) {  // BOOT
                 printf("Disk UI: resetting CPU for disk boot\n");
                 mii_reset(g_mii, true);
                 
@@ -486,7 +490,57 @@ static void handle_disk_loaded(void) {
     } else {
         MII_DEBUG_PRINTF("Disk UI: warning - no emulator reference, disk not mounted\n");
     }
+    return ok;
+}
+
+// Handle loading complete - mount disk and perform action
+static void handle_disk_loaded(void) {
+    disk_ui_hide();
+    bool boot = selected_action == 0;
+    if (!disk_ui_mount(selected_drive, boot, read_only, bdsk_recreate))
+        return;
+#if WITH_INPUT_REPLAY
+    if (mii_replay_recording()) {
+        // [drive, flags, full path]
+        uint8_t ev[2 + sizeof(selected_dir) + MAX_FILENAME_LEN];
+        ev[0] = selected_drive;
+        ev[1] = (boot ? MII_REPLAY_MOUNT_BOOT : 0) |
+                (read_only ? MII_REPLAY_MOUNT_RO : 0);
+        int len = snprintf((char *)ev + 2, sizeof(ev) - 2, "%s/%s",
+                strcmp(selected_dir, "/") ? selected_dir : "",
+                g_loaded_disks[selected_drive].filename);
+        if (len > 0 && len <= 253)
+            mii_replay_log(g_mii, MII_REPLAY_MOUNT, ev, 2 + len);
+    }
+#endif
+}
+
+#if WITH_INPUT_REPLAY
+int disk_ui_replay_mount(int drive, uint8_t flags, const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash || drive < 0 || drive > 1)
+        return -1;
+    if (slash == path)
+        strcpy(selected_dir, "/");
+    else
+        snprintf(selected_dir, sizeof(selected_dir), "%.*s",
+                (int)(slash - path), path);
+    int count = disk_scan_directory(selected_dir);
+    if (count < 0)
+        count = -count;
+    for (int i = 0; i < count && i < g_disk_count; i++) {
+        if (strcmp(g_disk_list[i].filename, slash + 1))
+            continue;
+        bool ro = flags & MII_REPLAY_MOUNT_RO;
+        if (disk_load_image(drive, i, !ro) != 0)
+            return -1;
+        return disk_ui_mount(drive, flags & MII_REPLAY_MOUNT_BOOT, ro,
+                false) ? 0 : -1;
+    }
+    printf("Replay: %s not found\n", path);
+    return -1;
 }
+#endif
 
 static bool disk_ui_select_loaded_file(int drive)
 {
@@ -59,4 +59,10 @@ int disk_ui_get_selected_drive(void);
 // Show loading screen
 void disk_ui_show_loading(void);
 
+#if WITH_INPUT_REPLAY
+// Mount 'path' (as logged by a recording) in drive 0 or 1 the way the UI
+// would, flags are MII_REPLAY_MOUNT_*. Returns 0 on success.
+int disk_ui_replay_mount(int drive, uint8_t flags, const char *path);
+#endif
+
 #endif // DISK_UI_H
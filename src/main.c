@@ -36,18 +36,34 @@
 #include "mii_startscreen.h"
 #include "disk_ui.h"
 #include "debug_log.h"
+#include "mii_input_latency.h"
+#include "mii_hle.h"
+#include "mii_bench.h"
+#include "mii_replay.h"
+#include "mii_capture.h"
+#include "mii_nibcap.h"
 
 #ifdef MII_RP2350
 #include "mii_disk2_asm.h"
 #endif
 
 // Special key codes from keyboard driver
+#define KEY_F10 0xFA
 #define KEY_F11 0xFB
 
 #define CPU_STAT_WINDOW 16
 
 // Flag to indicate emulator is ready
 static volatile bool g_emulator_ready = false;
+#if WITH_FAST_BOOT
+// SD card mount done on core 1: -2 pending, then disk_loader_init() result
+static volatile int g_sd_state = -2;
+#endif
+
+// Boot progress on serial, in us since power on
+static void boot_mark(const char *what) {
+    printf("boot: %8lu us %s\n", (unsigned long)time_us_32(), what);
+}
 static volatile bool video_core_iteration_in_progress = false;
 
 typedef struct {
@@ -163,6 +179,47 @@ extern bool ps2kbd_is_reset_combo(void);  // Ctrl+Alt+Delete pressed
 // USB HID keyboard/gamepad interface
 #include "usbhid/usbhid_wrapper.h"
 
+// Pad to Apple II mapping. Paddle 0 = X axis (left/right): 0=left,
+// 127=center, 255=right; Paddle 1 = Y axis (up/down): 0=up, 255=down.
+// For paddle/analog games like Arkanoid the D-pad moves the paddle
+// gradually instead of snapping to extremes.
+// Speed: ~4 per frame = full range in ~32 frames (~0.5 sec)
+#define PADDLE_CENTER 127
+#define PADDLE_SPEED 4
+
+// Apple II view of a pad state, indexed by nespad_buttons8()
+typedef struct pad_map_t {
+    uint8_t btn[3];     // $C061-$C063 values
+    int8_t dx, dy;      // paddle step per frame, 0 means recenter
+} pad_map_t;
+static pad_map_t pad_map[256];
+
+static void pad_map_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint32_t st = 0;
+        for (int b = 0; b < 8; b++)
+            if (i & (1 << b))
+                st |= 1u << (b * 2);
+        pad_map_t *m = &pad_map[i];
+        // NES A -> Open Apple, B -> Closed Apple, Start -> Button 2
+        m->btn[0] = (st & DPAD_A) ? 0x80 : 0x00;
+        m->btn[1] = (st & DPAD_B) ? 0x80 : 0x00;
+        m->btn[2] = (st & DPAD_START) ? 0x80 : 0x00;
+        // Left wins over right, up over down
+        m->dx = (st & DPAD_LEFT) ? -PADDLE_SPEED :
+                (st & DPAD_RIGHT) ? PADDLE_SPEED : 0;
+        m->dy = (st & DPAD_UP) ? -PADDLE_SPEED :
+                (st & DPAD_DOWN) ? PADDLE_SPEED : 0;
+    }
+}
+
+static inline uint8_t paddle_step(uint8_t v, int8_t d) {
+    if (!d)
+        return PADDLE_CENTER;
+    int n = v + d;
+    return n < 0 ? 0 : n > 255 ? 255 : n;
+}
+
 #if PICO_RP2350
 // Flash timing configuration for overclocking
 #define FLASH_MAX_FREQ_MHZ 88
@@ -222,6 +279,103 @@ static void init_palette(void) {
     }
 }
 
+/*
+ * Everything that reaches the guest from the outside goes through these,
+ * so it can be logged with the cycle it was applied at (-DINPUT_REPLAY),
+ * and is ignored while a log is played back.
+ */
+static void input_key(uint8_t key) {
+#if WITH_INPUT_REPLAY
+    if (mii_replay_playing())
+        return;
+    mii_replay_log(&g_mii, MII_REPLAY_KEY, &key, 1);
+#endif
+    mii_keypress(&g_mii, key);
+}
+
+static void input_buttons(const uint8_t btn[3]) {
+    mii_bank_t *sw = &g_mii.bank[MII_BANK_SW];
+#if WITH_INPUT_REPLAY
+    if (mii_replay_playing())
+        return;
+    // these are applied every frame, only log changes
+    if (mii_bank_peek(sw, 0xc061) != btn[0] ||
+            mii_bank_peek(sw, 0xc062) != btn[1] ||
+            mii_bank_peek(sw, 0xc063) != btn[2])
+        mii_replay_log(&g_mii, MII_REPLAY_BUTTONS, btn, 3);
+#endif
+    mii_bank_poke(sw, 0xc061, btn[0]);
+    mii_bank_poke(sw, 0xc062, btn[1]);
+    mii_bank_poke(sw, 0xc063, btn[2]);
+}
+
+static void input_paddles(uint8_t x, uint8_t y) {
+#if WITH_INPUT_REPLAY
+    if (mii_replay_playing())
+        return;
+    if (g_mii.analog.v[0].value != x || g_mii.analog.v[1].value != y) {
+        const uint8_t xy[2] = { x, y };
+        mii_replay_log(&g_mii, MII_REPLAY_PADDLES, xy, 2);
+    }
+#endif
+    g_mii.analog.v[0].value = x;
+    g_mii.analog.v[1].value = y;
+}
+
+static void input_reset(void) {
+#if WITH_INPUT_REPLAY
+    if (mii_replay_playing())
+        return;
+    mii_replay_log(&g_mii, MII_REPLAY_RESET, NULL, 0);
+#endif
+    mii_reset(&g_mii, true);
+}
+
+#if WITH_INPUT_REPLAY
+// Apply the logged events due at this frame boundary
+static void input_replay_frame(void) {
+    mii_replay_ev_t ev;
+    mii_replay_frame(&g_mii);
+    while (mii_replay_next(&g_mii, &ev)) {
+        switch (ev.type) {
+            case MII_REPLAY_KEY:
+                mii_keypress(&g_mii, ev.data[0]);
+                break;
+            case MII_REPLAY_BUTTONS: {
+                mii_bank_t *sw = &g_mii.bank[MII_BANK_SW];
+                mii_bank_poke(sw, 0xc061, ev.data[0]);
+                mii_bank_poke(sw, 0xc062, ev.data[1]);
+                mii_bank_poke(sw, 0xc063, ev.data[2]);
+            }   break;
+            case MII_REPLAY_PADDLES:
+                g_mii.analog.v[0].value = ev.data[0];
+                g_mii.analog.v[1].value = ev.data[1];
+                break;
+            case MII_REPLAY_RESET:
+                mii_reset(&g_mii, true);
+                break;
+            case MII_REPLAY_MOUNT:
+                if (ev.len > 2) {
+                    ev.data[ev.len] = 0;
+                    disk_ui_replay_mount(ev.data[0], ev.data[1],
+                            (const char *)ev.data + 2);
+                }
+                break;
+        }
+    }
+}
+#endif
+
+#if WITH_CAPTURE
+// F10, gameplay capture to SD
+static void input_capture_toggle(void) {
+    if (mii_capture_active())
+        mii_capture_stop();
+    else
+        mii_capture_start("/apple", apple2_rgb888, MII_I2S_SAMPLE_RATE);
+}
+#endif
+
 // Process PS/2 keyboard input
 // Track currently held key for games that need key-hold detection
 // Apple II keyboard repeat: ~500ms initial delay, then ~67ms repeat rate
@@ -240,15 +394,24 @@ static void process_keyboard(void) {
         if (pressed) {
             // Check for F11 - disk selector toggle
             if (key == KEY_F11) {
+                mii_latency_drop(MII_LAT_KEY);
                 do {
                     __dmb();
                 } while(video_core_iteration_in_progress);
                 disk_ui_toggle();
                 continue;
             }
+#if WITH_CAPTURE
+            // F10 - start/stop the gameplay capture
+            if (key == KEY_F10) {
+                input_capture_toggle();
+                continue;
+            }
+#endif
             
             // If disk UI is visible, send keys to it
             if (disk_ui_is_visible()) {
+                mii_latency_drop(MII_LAT_KEY);
                 disk_ui_handle_key(key);
                 currently_held_key = key;
                 key_hold_frames = 0;
@@ -257,7 +420,8 @@ static void process_keyboard(void) {
             }
             
             // Normal key - send to emulator and track as held
-            mii_keypress(&g_mii, key);
+            input_key(key);
+            mii_latency_deliver(MII_LAT_KEY);
             currently_held_key = key;
             key_hold_frames = 0;  // Reset repeat timer
         } else {
@@ -276,15 +440,24 @@ static void process_keyboard(void) {
         if (pressed) {
             // Check for F11 - disk selector toggle
             if (key == KEY_F11) {
+                mii_latency_drop(MII_LAT_KEY);
                 do {
                     __dmb();
                 } while(video_core_iteration_in_progress);
                 disk_ui_toggle();
                 continue;
             }
+#if WITH_CAPTURE
+            // F10 - start/stop the gameplay capture
+            if (key == KEY_F10) {
+                input_capture_toggle();
+                continue;
+            }
+#endif
             
             // If disk UI is visible, send keys to it
             if (disk_ui_is_visible()) {
+                mii_latency_drop(MII_LAT_KEY);
                 disk_ui_handle_key(key);
                 currently_held_key = key;
                 key_hold_frames = 0;
@@ -293,7 +466,8 @@ static void process_keyboard(void) {
             }
             
             // Normal key - send to emulator and track as held
-            mii_keypress(&g_mii, key);
+            input_key(key);
+            mii_latency_deliver(MII_LAT_KEY);
             currently_held_key = key;
             key_hold_frames = 0;
         } else {
@@ -323,7 +497,7 @@ static void process_keyboard(void) {
                     uint8_t strobe = mii_bank_peek(sw, 0xc010);
                     if (!(strobe & 0x80)) {
                         // Strobe is clear, game processed the key - re-latch
-                        mii_keypress(&g_mii, currently_held_key);
+                        input_key(currently_held_key);
                     }
                 }
             }
@@ -351,8 +525,18 @@ static __not_in_flash() void video_core_iteration(void) {
         cpu_calc_speed(&khz, &percent);
         char tmp[32];
         snprintf(tmp, sizeof(tmp), "CPU %4u kHz %3u%%", khz, percent);
-        memset(graphics_get_buffer(), 0, 320 * 8 / 2);
+        // line N of the OSD is the 8 pixel band N + 1, y is a glyph's top
+        memset(graphics_get_buffer() + 320 * 8 / 2, 0, 320 * 8 / 2);
         draw_string(graphics_get_buffer(), 320, 0, 8, tmp, 15);
+        // input latency, p50/p99 from device to guest read
+        int line = 1;
+        for (int s = 0; s < MII_LAT_SOURCE_COUNT; s++) {
+            if (!mii_latency_format(s, tmp, sizeof(tmp)))
+                continue;
+            memset(graphics_get_buffer() + 320 * 8 * (line + 1) / 2, 0, 320 * 8 / 2);
+            draw_string(graphics_get_buffer(), 320, 0, 8 * (line + 1), tmp, 15);
+            line++;
+        }
     }
     video_core_iteration_in_progress = false;
 }
@@ -360,11 +544,18 @@ static __not_in_flash() void video_core_iteration(void) {
 #if defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL))
 // Core 1 - Video rendering loop
 static __not_in_flash() void core1_main(void) {
+#if WITH_FAST_BOOT
+    // Core 1 is started early, mount the SD card while core 0 brings up
+    // HDMI and the emulator
+    g_sd_state = disk_loader_init();
+    __dmb();
+#endif
     MII_DEBUG_PRINTF("Core 1: Waiting for emulator ready...\n");
     
     // Wait for Core 0 to finish initialization
     while (!g_emulator_ready) {
         sleep_ms(10);
+        hdmi_check_and_restart();
     }
 	__dmb();          // Data Memory Barrier
     
@@ -376,14 +567,20 @@ static __not_in_flash() void core1_main(void) {
         sleep_ms(16);
         if (!disk_ui_is_visible()) {
             video_core_iteration();
+#if WITH_CAPTURE
+            mii_capture_frame(graphics_get_buffer(), g_mii.video.frame_count);
+#endif
         }
 
         // Wait until the swap has actually happened (vsync tick), then rotate buffers.
         // This avoids writing into the buffer currently being scanned out.
+        // If the scanout stalled, the HDMI watchdog has flagged it by now and
+        // the DMA chain gets restarted here, so the wait can't hang.
         uint32_t f;
         do {
             f = get_frame_count();
             if (f != last_frame) break;
+            hdmi_check_and_restart();
             sleep_ms(1);
         } while (1);
         last_frame = f;
@@ -488,16 +685,22 @@ int main() {
 
     // Initialize stdio (USB serial)
     stdio_init_all();
+    boot_mark("stdio");
     
 #ifdef PICO_DEFAULT_LED_PIN
     gpio_init(PICO_DEFAULT_LED_PIN);
     gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
+#if WITH_FAST_BOOT
+    // lit until the first guest frame
+    gpio_put(PICO_DEFAULT_LED_PIN, true);
+#else
     for (int i = 0; i < 6; i++) {
         sleep_ms(33);
         gpio_put(PICO_DEFAULT_LED_PIN, true);
         sleep_ms(33);
         gpio_put(PICO_DEFAULT_LED_PIN, false);
     }
+#endif
 #endif
 
     MII_DEBUG_PRINTF("\n\n");
@@ -529,6 +732,14 @@ int main() {
     if (psram[0] != 0xAB || psram[1] != 0xCD || psram[2] != 0xEF) {
         MII_DEBUG_PRINTF("ERROR: PSRAM read/write failed!\n");
     }
+    uint32_t bs = butter_psram_size();
+    boot_mark("PSRAM");
+#endif
+
+#if WITH_FAST_BOOT && (defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL)))
+    // The SD card mount (card init, mkdirs) runs on core 1 from here, core 1
+    // then waits for g_emulator_ready to start rendering
+    multicore_launch_core1(core1_main);
 #endif
     
     // IMPORTANT: Set buffer and resolution BEFORE graphics_init()
@@ -546,10 +757,18 @@ int main() {
     // Initialize palette
     init_palette();
     graphics_restore_sync_colors();  // Restore HDMI sync colors after palette init
+    boot_mark("HDMI");
 
+#if !WITH_FAST_BOOT
     // Allow HDMI signal to stabilize before drawing anything
-    // This gives the monitor time to lock onto the sync signal
-    sleep_ms(500);
+    // This gives the monitor time to lock onto the sync signal.
+    // Core 1 only starts once the emulator is ready, until then core 0
+    // restarts a stalled scanout itself, here and between the boot steps
+    for (int i = 0; i < 50; i++) {
+        sleep_ms(10);
+        hdmi_check_and_restart();
+    }
+#endif
 
     // Verify palette entry 15 was set
     MII_DEBUG_PRINTF("Palette initialized, verifying...\n");
@@ -571,10 +790,20 @@ int main() {
         .cpu_mhz = CPU_CLOCK_MHZ,
 #if PSRAM_MAX_FREQ_MHZ
         .psram_mhz = PSRAM_MAX_FREQ_MHZ,
+#if WITH_FAST_BOOT
+        .psram_sz = bs,
+#endif
 #endif
         .board_variant = board_num_early,
+#if WITH_FAST_BOOT
+        // stays up while the rest boots, see the ROM warm-up below
+        .hold_ms = 0,
+#else
+        .hold_ms = 3000,
+#endif
     };
     mii_startscreen_show(&screen_info_early);
+    boot_mark("splash");
 #endif
 
     // Initialize PS/2 keyboard
@@ -586,8 +815,9 @@ int main() {
     MII_DEBUG_PRINTF("PS/2 keyboard disabled\n");
 #endif
     
-    // Initialize NES/SNES gamepad
+    // Initialize NES/SNES gamepad, sampled from a timer from here on
     MII_DEBUG_PRINTF("Initializing NES gamepad...\n");
+    pad_map_init();
     if (nespad_begin(clock_get_hz(clk_sys) / 1000, NESPAD_GPIO_CLK, NESPAD_GPIO_DATA, NESPAD_GPIO_LATCH)) {
         MII_DEBUG_PRINTF("NES gamepad initialized (CLK=%d, DATA=%d, LATCH=%d)\n",
                NESPAD_GPIO_CLK, NESPAD_GPIO_DATA, NESPAD_GPIO_LATCH);
@@ -602,6 +832,7 @@ int main() {
     MII_DEBUG_PRINTF("USB HID Host initialized\n");
 #endif
     
+#if !WITH_FAST_BOOT || !(defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL)))
     // Initialize SD card and scan for disk images
     MII_DEBUG_PRINTF("Initializing SD card and disk images...\n");
     if (disk_loader_init() == 0) {
@@ -609,6 +840,10 @@ int main() {
     } else {
         MII_DEBUG_PRINTF("SD card not available (will run without disks)\n");
     }
+#if !WITH_FAST_BOOT
+    hdmi_check_and_restart();
+#endif
+#endif
     
     // Initialize the Apple IIe emulator
     MII_DEBUG_PRINTF("Initializing Apple IIe emulator...\n");
@@ -650,8 +885,37 @@ int main() {
         MII_DEBUG_PRINTF("Slot 2 signature bytes: $C205=%02X, $C207=%02X\n",
                mii_bank_peek(card_rom, 0xC205), mii_bank_peek(card_rom, 0xC207));
     }
+#if WITH_FAST_BOOT && (defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL)))
+    // SmartPort opens its drive images right away, and FatFs isn't
+    // reentrant: the SD card mount on core 1 has to be over first
+    while (g_sd_state == -2)
+        tight_loop_contents();
+    __dmb();
+    if (g_sd_state == 0) {
+        MII_DEBUG_PRINTF("SD card ready, found %d disk images\n", g_disk_count);
+    } else {
+        MII_DEBUG_PRINTF("SD card not available (will run without disks)\n");
+    }
+    boot_mark("SD");
+#endif
     slot_res = mii_slot_drv_register(&g_mii, 5, "smartport");
     // TODO: log
+#if !WITH_FAST_BOOT
+    // SmartPort opened its drive images from the SD card
+    hdmi_check_and_restart();
+#endif
+#if WITH_ROMDISK
+    // Flash ROM disk in slot 7, the autostart ROM boots it first
+    if (mii_slot_drv_register(&g_mii, 7, "eecard") == 0) {
+        MII_DEBUG_PRINTF("ROM disk card installed in slot 7\n");
+    }
+#endif
+
+    // No Slot Clock isn't a slot card, it is probed like on the desktop
+    mii_slot_drv_t *nsc_drv = mii_slot_drv_find(&g_mii, "nsc");
+    if (nsc_drv && nsc_drv->probe && nsc_drv->probe(&g_mii, MII_INIT_NSC)) {
+        MII_DEBUG_PRINTF("No Slot Clock installed\n");
+    }
     
     // Initialize disk UI with emulator pointer (slot 6 is standard for Disk II)
     disk_ui_init_with_emulator(&g_mii, 6);
@@ -659,6 +923,11 @@ int main() {
     // Load Apple IIe ROM (16K at $C000-$FFFF)
     MII_DEBUG_PRINTF("Loading Apple IIe ROM...\n");
     load_rom(&g_mii, mii_rom_iiee, 16384, 0xC000);
+#if WITH_ROM_HLE
+    // Run the ROM's WAIT/scroll/clear loops natively, see mii_hle.c
+    int hle = mii_hle_install(&g_mii);
+    MII_DEBUG_PRINTF("ROM HLE: %d loops trapped\n", hle);
+#endif
 
     // Debug: Check reset vector in ROM
     mii_bank_t *rom_bank = &g_mii.bank[MII_BANK_ROM];
@@ -702,6 +971,7 @@ int main() {
     startVIDEO(0);
     MII_DEBUG_PRINTF("HDMI started\n");
     
+#if !WITH_FAST_BOOT
     // Display start screen with system information
     MII_DEBUG_PRINTF("Displaying start screen...\n");
     uint32_t board_num = 1;  // Default to M1
@@ -709,9 +979,6 @@ int main() {
     board_num = 2;
 #endif
 
-#if PSRAM_MAX_FREQ_MHZ
-    uint32_t bs = butter_psram_size();
-#endif
     mii_startscreen_info_t screen_info = {
         .title = "MurmApple",
         .subtitle = "Apple IIe Emulator",
@@ -722,24 +989,56 @@ int main() {
         .psram_sz = bs,
 #endif
         .board_variant = board_num,
+        .hold_ms = 3000,
     };
     mii_startscreen_show(&screen_info);
 
-    // Let ROM boot naturally
+    // Let ROM boot naturally, a frame at a time for the stall check
     MII_DEBUG_PRINTF("Running ROM boot sequence (1M cycles)...\n");
-    mii_run_cycles(&g_mii, 1000000);
+    for (uint64_t boot_end = g_mii.cpu.total_cycle + 1000000;
+            g_mii.cpu.total_cycle < boot_end; ) {
+        mii_run_cycles(&g_mii, cycles_per_frame);
+        hdmi_check_and_restart();
+    }
+#else
+    /*
+     * Run the ROM boot unthrottled behind the splash. Once it is in the
+     * Disk II boot ROM there is nothing left to do until a disk is picked,
+     * so stop there rather than spinning the whole 1M cycles. A ROM disk
+     * boots from slot 7 first and gets the full warm-up.
+     */
+    uint64_t warmup_end = g_mii.cpu.total_cycle + 1000000;
+    while (g_mii.cpu.total_cycle < warmup_end &&
+            (g_mii.cpu.PC >> 8) != 0xc6)
+        mii_run_cycles(&g_mii, cycles_per_frame);
+#endif
     MII_DEBUG_PRINTF("ROM boot complete, PC=$%04X\n", g_mii.cpu.PC);
+    boot_mark("ROM warm-up");
     
     // Debug: Check state after boot
     MII_DEBUG_PRINTF("Post-boot: Text page $0400: %02X %02X %02X %02X\n",
            mii_read_one(&g_mii, 0x400), mii_read_one(&g_mii, 0x401),
            mii_read_one(&g_mii, 0x402), mii_read_one(&g_mii, 0x403));
 
+#if WITH_FAST_BOOT
+    // Holding a pad button or a modifier keeps the splash up (up to 10s)
+    for (uint32_t t0 = time_us_32(); time_us_32() - t0 < 10000000; ) {
+#if ENABLE_PS2_KEYBOARD
+        ps2kbd_tick();
+        if (ps2kbd_get_modifiers())
+            continue;
+#endif
+        nespad_read();
+        if (!nespad_state)
+            break;
+    }
+#endif
+
     // Signal that emulator is ready for Core 1 BEFORE launching it
     g_emulator_ready = true;
     
     // Launch video rendering on core 1
-#if defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL))
+#if !WITH_FAST_BOOT && (defined(PICO_RP2350) || (defined(RAM_PAGES_PER_POOL) && defined(MAX_PAGES_PER_POOL) && (RAM_PAGES_PER_POOL == MAX_PAGES_PER_POOL)))
     MII_DEBUG_PRINTF("Starting video rendering on core 1...\n");
     multicore_launch_core1(core1_main);
     MII_DEBUG_PRINTF("Core 1 launched\n");
@@ -764,6 +1063,11 @@ int main() {
     PWM_init_pin(BEEPER_PIN, (1 << 12) - 1);
 #endif
 
+#if WITH_GUEST_BENCH
+    // Video and audio are up, so the numbers include their load
+    mii_bench_run(&g_mii, 2000000);
+#endif
+
     MII_DEBUG_PRINTF("Starting emulation on core 0...\n");
     MII_DEBUG_PRINTF("Initial PC: $%04X\n", g_mii.cpu.PC);
     MII_DEBUG_PRINTF("=================================\n\n");
@@ -784,6 +1088,16 @@ int main() {
     uint32_t last_mode_key = 0xffffffffu;
     uint32_t last_fb_hash = 0;
     int last_fb_nonzero = -1;
+
+#if WITH_INPUT_REPLAY
+    // replay.mir is played back if it is there, otherwise the session is
+    // recorded to record.mir (rename it to replay it on the next boot)
+    if (mii_replay_play(&g_mii, "/apple/replay.mir") != 0)
+        mii_replay_record(&g_mii, "/apple/record.mir");
+#endif
+#if WITH_NIBBLE_CAPTURE
+    mii_nibcap_start(&g_mii, MII_NIBCAP_SECONDS);
+#endif
     
     while (1) {
         uint32_t frame_start = time_us_32();
@@ -791,6 +1105,14 @@ int main() {
         uint64_t cycles_after  = 0;
         bool cpu_ran = false;
 
+#if WITH_INPUT_REPLAY
+        input_replay_frame();
+#endif
+#if WITH_NIBBLE_CAPTURE
+        mii_nibcap_poll(&g_mii, "/apple");
+#endif
+        disk_loader_idle(&g_mii);
+
         // Poll keyboard at start of frame
 #if ENABLE_PS2_KEYBOARD
         ps2kbd_tick();
@@ -814,7 +1136,7 @@ int main() {
             if (!reset_combo_active) {
                 reset_combo_active = true;
                 MII_DEBUG_PRINTF("Reset combo detected (Ctrl+Alt+Delete)\n");
-                mii_reset(&g_mii, true);
+                input_reset();
             }
         } else {
             reset_combo_active = false;
@@ -822,7 +1144,16 @@ int main() {
         
         process_keyboard();
         
-        // Poll NES gamepad and update Apple II buttons
+        // Turning the speed OSD on also dumps the latency histograms
+        {
+            static bool osd_was_on = false;
+            bool osd_on = ps2kbd_is_show_speed();
+            if (osd_on && !osd_was_on)
+                mii_latency_dump();
+            osd_was_on = osd_on;
+        }
+        
+        // Latest NES gamepad sample, then update Apple II buttons
         nespad_read();
         
         // Merge USB gamepad state with NES gamepad state
@@ -844,7 +1175,7 @@ int main() {
                 if (!gamepad_reset_combo_active) {
                     gamepad_reset_combo_active = true;
                     MII_DEBUG_PRINTF("Reset combo detected (Start+A+B)\n");
-                    mii_reset(&g_mii, true);
+                    input_reset();
                 }
                 // Skip all gamepad processing while reset combo is held
                 prev_gamepad_state = combined_gamepad_state;
@@ -920,13 +1251,13 @@ int main() {
                 }
                 
                 // Don't update joystick/buttons while in UI
+                mii_latency_drop(MII_LAT_BUTTON);
                 prev_gamepad_state = combined_gamepad_state;
                 goto skip_gamepad_emulation;
             }
             
             prev_gamepad_state = combined_gamepad_state;
             
-            mii_bank_t *sw = &g_mii.bank[MII_BANK_SW];
             // Map NES buttons + keyboard modifiers to Apple II buttons:
             // NES A/B or Left Alt -> Open Apple (Button 0, $C061)
             // NES A/B or Right Alt -> Closed Apple (Button 1, $C062)
@@ -939,62 +1270,31 @@ int main() {
 #ifdef USB_HID_ENABLED
             mods |= usbhid_wrapper_get_modifiers();
 #endif
-            uint8_t btn0 = (combined_gamepad_state & DPAD_A) ? 0x80 : 0x00;
-            uint8_t btn1 = (combined_gamepad_state & DPAD_B) ? 0x80 : 0x00;
-            uint8_t btn2 = (combined_gamepad_state & DPAD_START) ? 0x80 : 0x00;
-            mii_bank_poke(sw, 0xc061, btn0);
-            mii_bank_poke(sw, 0xc062, btn1);
-            mii_bank_poke(sw, 0xc063, btn2);
+            const pad_map_t *map = &pad_map[nespad_buttons8(combined_gamepad_state)];
+            static uint8_t prev_btns = 0;
+            uint8_t btns = (map->btn[0] >> 7) | (map->btn[1] >> 6) | (map->btn[2] >> 5);
+            input_buttons(map->btn);
+            if (btns & ~prev_btns)
+                mii_latency_deliver(MII_LAT_BUTTON);
+            prev_btns = btns;
             
-            // Map NES D-pad to Apple II joystick
-            // For paddle/analog games like Arkanoid, we use gradual movement
-            // instead of snapping to extremes, as these games rely on analog control.
-            // Paddle 0 = X axis (left/right): 0=left, 127=center, 255=right
-            // Paddle 1 = Y axis (up/down): 0=up, 255=down
-            #define PADDLE_CENTER 127
             static uint8_t joy_x = PADDLE_CENTER;  // Persistent X position
             static uint8_t joy_y = PADDLE_CENTER;  // Persistent Y position
             
-            // NES D-pad controls - gradual movement for paddle games
-            // Speed: ~4 per frame = full range in ~32 frames (~0.5 sec)
-            #define PADDLE_SPEED 4
-            
-            /* X axis */
-            if (combined_gamepad_state & DPAD_LEFT) {
-                if (joy_x > PADDLE_SPEED)
-                    joy_x -= PADDLE_SPEED;
-                else
-                    joy_x = 0;
-            }
-            else if (combined_gamepad_state & DPAD_RIGHT) {
-                if (joy_x < 255 - PADDLE_SPEED)
-                    joy_x += PADDLE_SPEED;
-                else
-                    joy_x = 255;
-            }
-            else {
-                joy_x = PADDLE_CENTER;
-            }
-
-            /* Y axis */
-            if (combined_gamepad_state & DPAD_UP) {
-                if (joy_y > PADDLE_SPEED)
-                    joy_y -= PADDLE_SPEED;
-                else
-                    joy_y = 0;
-            }
-            else if (combined_gamepad_state & DPAD_DOWN) {
-                if (joy_y < 255 - PADDLE_SPEED)
-                    joy_y += PADDLE_SPEED;
-                else
-                    joy_y = 255;
+            // A USB pad with a real stick drives the paddles directly, one
+            // coalesced sample per frame; the NES pad D-pad still wins if
+            // it is being used.
+            uint8_t ana_x, ana_y;
+            if (usbhid_wrapper_get_analog(&ana_x, &ana_y) &&
+                    !(nespad_state & (DPAD_LEFT | DPAD_RIGHT | DPAD_UP | DPAD_DOWN))) {
+                joy_x = ana_x;
+                joy_y = ana_y;
+            } else {
+                joy_x = paddle_step(joy_x, map->dx);
+                joy_y = paddle_step(joy_y, map->dy);
             }
-            else {
-                joy_y = PADDLE_CENTER;
-            }            
 
-            g_mii.analog.v[0].value = joy_x;
-            g_mii.analog.v[1].value = joy_y;
+            input_paddles(joy_x, joy_y);
             
             skip_gamepad_emulation:;  // Label for skipping when UI is visible
         }
@@ -1085,10 +1385,22 @@ int main() {
         total_emu_time += (frame_end - frame_start);
 
         if (cpu_ran) {
+            if (frame_count == 0) {
+                boot_mark("first guest frame");
+#if WITH_FAST_BOOT && defined(PICO_DEFAULT_LED_PIN)
+                gpio_put(PICO_DEFAULT_LED_PIN, false);
+#endif
+            }
             // Throttle to real time so the emulator doesn't run too fast.
             next_frame_deadline += target_frame_us;
             int32_t wait = (int32_t)(next_frame_deadline - frame_end);
             if (wait > 0 && !ps2kbd_is_turbo()) {
+#if WITH_CAPTURE
+                // the capture only gets written to the card in the slack
+                mii_capture_idle(next_frame_deadline);
+                wait = (int32_t)(next_frame_deadline - time_us_32());
+                if (wait > 0)
+#endif
                 sleep_us((uint32_t)wait);
             } else {
                 // мы опоздали — не пытаемся догонять прошлое
@@ -21,7 +21,11 @@
 #include "mii_65c02.h"
 #include "minipt.h"
 #include "debug_log.h"
+#include "mii_input_latency.h"
 #include "ff.h"
+#if WITH_NSC
+#include "mii_noslotclock.h"
+#endif
 
 #if MII_65C02_DIRECT_ACCESS
 static mii_cpu_state_t
@@ -219,6 +223,12 @@ mii_page_set(
 		uint8_t bank,
 		uint8_t end )
 {
+	if (read != _SAME && write != _SAME) {
+		// one byte per page, so a range is a memset
+		typeof(mii->mem[0]) m = { .write = write, .read = read };
+		memset(&mii->mem[bank], *(uint8_t *)&m, end - bank + 1);
+		return;
+	}
 	for (int i = bank; i <= end; i++) {
 		if (read != _SAME)
 			mii->mem[i].read = read;
@@ -226,6 +236,7 @@ mii_page_set(
 			mii->mem[i].write = write;
 	}
 }
+_Static_assert(sizeof(((mii_t *)0)->mem[0]) == 1, "mem[] entries are bytes");
 
 static inline uint8_t
 mii_sw(
@@ -235,6 +246,19 @@ mii_sw(
 	return mii_bank_peek(&mii->bank[MII_BANK_SW], sw);
 }
 
+/*
+ * Soft switches each region of mem[] depends on. Only the regions whose
+ * switches changed since the last update are rebuilt, and a switch flip
+ * that doesn't change the mapping at all (PAGE2/HIRES without 80STORE,
+ * BSRPREWRITE, video switches...) costs nothing.
+ */
+#define MII_MAP_ZP		(M_SWALTPZ)
+#define MII_MAP_MAIN	(M_SWRAMRD | M_SWRAMWRT | \
+						M_SW80STORE | M_SWPAGE2 | M_SWHIRES)
+#define MII_MAP_CX		(M_SWINTCXROM | M_SWSLOTC3ROM | M_INTC8ROM)
+#define MII_MAP_LC		(M_BSRREAD | M_BSRWRITE | M_BSRPAGE2 | M_SWALTPZ)
+#define MII_MAP_VALID	(1u << 31)	// mem_map holds a built state
+
 static void
 mii_page_table_update(
 		mii_t *mii)
@@ -253,35 +277,47 @@ mii_page_table_update(
 	bool slotc3rom 	= SWW_GETSTATE(sw, SWSLOTC3ROM);
 	bool intc8rom	= SWW_GETSTATE(sw, INTC8ROM);
 
+	uint32_t map = MII_MAP_VALID |
+			(sw & (MII_MAP_ZP | MII_MAP_MAIN | MII_MAP_CX | MII_MAP_LC));
+	// PAGE2 and HIRES only matter to the mapping with 80STORE
+	if (!store80)
+		map &= ~(M_SWPAGE2 | M_SWHIRES);
+	uint32_t changed = mii->mem_map & MII_MAP_VALID ?
+							map ^ mii->mem_map : ~0u;
+	if (!changed)
+		return;
+	mii->mem_map = map;
+
 	if (unlikely(mii->trace_cpu))
 		MII_DEBUG_PRINTF("%04x: MEM update altzp:%d page2:%d store80:%d "
 			"hires:%d ramrd:%d ramwrt:%d intcxrom:%d "
 			"slotc3rom:%d\n", mii->cpu.PC,
 			altzp, page2, store80, hires, ramrd, ramwrt, intcxrom, slotc3rom);
-	// clean slate
-	mii_page_set(mii, MII_BANK_MAIN, MII_BANK_MAIN, 0x00, 0xbf);
-	mii_page_set(mii, MII_BANK_SW, MII_BANK_SW, 0xc0, 0xc0);
-	mii_page_set(mii, MII_BANK_ROM, MII_BANK_ROM, 0xc1, 0xff);
-	if (altzp)
-		mii_page_set(mii, MII_BANK_AUX, MII_BANK_AUX, 0x00, 0x01);
-	mii_page_set(mii,
-		ramrd ? MII_BANK_AUX : MII_BANK_MAIN,
-		ramwrt ? MII_BANK_AUX : MII_BANK_MAIN, 0x02, 0xbf);
-	if (store80) {
+	if (changed & MII_MAP_VALID)	// first time around
+		mii_page_set(mii, MII_BANK_SW, MII_BANK_SW, 0xc0, 0xc0);
+	if (changed & MII_MAP_ZP) {
+		uint8_t zp = altzp ? MII_BANK_AUX : MII_BANK_MAIN;
+		mii_page_set(mii, zp, zp, 0x00, 0x01);
+	}
+	if (changed & MII_MAP_MAIN) {
 		mii_page_set(mii,
-			page2 ? MII_BANK_AUX : MII_BANK_MAIN,
-			page2 ? MII_BANK_AUX : MII_BANK_MAIN, 0x04, 0x07);
-		if (hires)
+			ramrd ? MII_BANK_AUX : MII_BANK_MAIN,
+			ramwrt ? MII_BANK_AUX : MII_BANK_MAIN, 0x02, 0xbf);
+		if (store80) {
 			mii_page_set(mii,
 				page2 ? MII_BANK_AUX : MII_BANK_MAIN,
-				page2 ? MII_BANK_AUX : MII_BANK_MAIN, 0x20, 0x3f);
+				page2 ? MII_BANK_AUX : MII_BANK_MAIN, 0x04, 0x07);
+			if (hires)
+				mii_page_set(mii,
+					page2 ? MII_BANK_AUX : MII_BANK_MAIN,
+					page2 ? MII_BANK_AUX : MII_BANK_MAIN, 0x20, 0x3f);
+		}
 	}
-	// c1-cf are at ROM state when we arrive here
-	if (mii->emu == MII_EMU_IIC) {
-	//	mii_page_set(mii, MII_BANK_ROM, MII_BANK_ROM, 0xc1, 0xcf);
-	//	mii_page_set(mii, MII_BANK_ROM, MII_BANK_ROM, 0xd0, 0xff);
-	} else {
-		if (!intcxrom) {
+	if (changed & MII_MAP_CX) {
+		mii_page_set(mii, MII_BANK_ROM, MII_BANK_ROM, 0xc1, 0xcf);
+		if (mii->emu == MII_EMU_IIC) {
+		//	mii_page_set(mii, MII_BANK_ROM, MII_BANK_ROM, 0xc1, 0xcf);
+		} else if (!intcxrom) {
 			mii_page_set(mii, MII_BANK_CARD_ROM, MII_BANK_CARD_ROM, 0xc1, 0xcf);
 			if (!slotc3rom)
 				mii_page_set(mii, MII_BANK_ROM, _SAME, 0xc3, 0xc3);
@@ -289,26 +325,21 @@ mii_page_table_update(
 				mii_page_set(mii, MII_BANK_ROM, _SAME, 0xc8, 0xcf);
 		}
 	}
-	bool bsrread 	= SWW_GETSTATE(sw, BSRREAD);
-	bool bsrwrite 	= SWW_GETSTATE(sw, BSRWRITE);
-	bool bsrpage2 	= SWW_GETSTATE(sw, BSRPAGE2);
-	mii_page_set(mii,
-		bsrread ?
-			altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR :
-					MII_BANK_ROM,
-		bsrwrite ?
-			altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR :
-					MII_BANK_ROM,
-				0xd0, 0xff);
-	// BSR P2
-	mii_page_set(mii,
-		bsrread ?
-			(altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR) + bsrpage2 :
-					MII_BANK_ROM,
-		bsrwrite ?
-			(altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR) + bsrpage2 :
-					MII_BANK_ROM,
-				0xd0, 0xdf);
+	if (changed & MII_MAP_LC) {
+		bool bsrread 	= SWW_GETSTATE(sw, BSRREAD);
+		bool bsrwrite 	= SWW_GETSTATE(sw, BSRWRITE);
+		bool bsrpage2 	= SWW_GETSTATE(sw, BSRPAGE2);
+		uint8_t lc = altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR;
+		mii_page_set(mii,
+			bsrread ? lc : MII_BANK_ROM,
+			bsrwrite ? lc : MII_BANK_ROM,
+					0xe0, 0xff);
+		// BSR P2
+		mii_page_set(mii,
+			bsrread ? lc + bsrpage2 : MII_BANK_ROM,
+			bsrwrite ? lc + bsrpage2 : MII_BANK_ROM,
+					0xd0, 0xdf);
+	}
 }
 
 #if !MII_RP2350
@@ -669,6 +700,7 @@ mii_access_keyboard(
 			if (!write) {
 				res = true;
 				*byte = mii_bank_peek(sw, SWAKD);
+				mii_latency_observe(MII_LAT_KEY);
 			}
 			break;
 		case SWAKD: {
@@ -684,6 +716,7 @@ mii_access_keyboard(
 			res = true;
 			if (!write) {
 				*byte = mii_bank_peek(sw, addr);
+				mii_latency_observe(MII_LAT_BUTTON);
 			}
 			break;
 	}
@@ -1023,7 +1056,7 @@ _mii_handle_trap(
 	uint8_t trap = mii_read_one(mii, mii->cpu.PC);
 	mii->cpu.PC += 1;
 //	printf("%s TRAP %02x return PC %04x\n", __func__, trap, mii->cpu.PC);
-	if (mii->trap.map & (1 << trap)) {
+	if (trap < sizeof(mii->trap.map) * 8 && (mii->trap.map & (1u << trap))) {
 		if (mii->trap.trap[trap].cb)
 			mii->trap.trap[trap].cb(mii, trap);
 	} else {
@@ -1038,13 +1071,13 @@ mii_register_trap(
 		mii_t *mii,
 		mii_trap_handler_cb cb)
 {
-	if (mii->trap.map == 0xffff) {
+	if (mii->trap.map == 0xffffffff) {
 		MII_DEBUG_PRINTF("%s no more traps!!\n", __func__);
 		return 0xff;
 	}
 	for (int i = 0; i < (int)sizeof(mii->trap.map) * 8; i++) {
-		if (!(mii->trap.map & (1 << i))) {
-			mii->trap.map |= 1 << i;
+		if (!(mii->trap.map & (1u << i))) {
+			mii->trap.map |= 1u << i;
 			mii->trap.trap[i].cb = cb;
 			return i;
 		}
@@ -1185,6 +1218,7 @@ mii_irq_raise(
 	if (!(mii->irq.raised & (1 << irq_id)))
 		mii->irq.irq[irq_id].count++;
 	mii->irq.raised |= 1 << irq_id;
+	mii_cpu_irq(&mii->cpu, 1);
 }
 
 void
@@ -1195,6 +1229,7 @@ mii_irq_clear(
 	if (irq_id >= (int)sizeof(mii->irq.map) * 8)
 		return;
 	mii->irq.raised &= ~(1 << irq_id);
+	mii_cpu_irq(&mii->cpu, !!mii->irq.raised);
 }
 
 
@@ -1212,6 +1247,8 @@ mii_irq_clear(
  * 3. Timer run batched every N cycles
  * 4. Fast path for RAM and ROM (direct memory access)
  * 5. Only I/O ($C000-$C0FF) goes through slow path
+ * The inline fetch/store in mii_65c02.c only calls here for $C0xx, and
+ * for $C8xx when the No Slot Clock is built in.
  */
 static mii_cpu_state_t
 _mii_cpu_direct_access_cb(
@@ -1245,10 +1282,20 @@ _mii_cpu_direct_access_cb(
 			if (likely(!b->ro)) {
 				mii_bank_poke(b, addr, access.data);
 			}
+#if WITH_NSC
+			else if (unlikely(page == 0xc8) && m == MII_BANK_ROM)
+				mii_nsc_access(mii, addr, &mii->cpu_state.data, true);
+#endif
 		} else {
 			// Read
 			uint8_t m = mii->mem[page].read;
 			mii_bank_t *b = &mii->bank[m];
+#if WITH_NSC
+			// No Slot Clock lives under the $C8xx internal ROM
+			if (unlikely(page == 0xc8) && m == MII_BANK_ROM &&
+					mii_nsc_access(mii, addr, &mii->cpu_state.data, false))
+				goto done;
+#endif
 			mii->cpu_state.data = mii_bank_peek(b, addr);
 		}
 	} else {
@@ -1256,9 +1303,10 @@ _mii_cpu_direct_access_cb(
 		mii_mem_access(mii, addr, &mii->cpu_state.data, access.w, true);
 	}
 	
-	// IRQ check
-	mii->cpu_state.irq = mii->cpu_state.irq | !!mii->irq.raised;
-	
+#if WITH_NSC
+done:
+#endif
+	// the IRQ line is set by mii_irq_raise/clear, nothing to check here
 	return mii->cpu_state;
 }
 #else
@@ -1309,7 +1357,6 @@ _mii_cpu_direct_access_cb(
 		}
 	}
 	mii_mem_access(mii, addr, &mii->cpu_state.data, wr, true);
-	mii->cpu_state.irq = mii->cpu_state.irq | !!mii->irq.raised;
 	return mii->cpu_state;
 }
 #endif // MII_RP2350
@@ -58,10 +58,10 @@ typedef void (*mii_trap_handler_cb)(
 				struct mii_t * mii,
 				uint8_t trap);
 typedef struct mii_trap_t {
-	uint16_t 	map;
+	uint32_t 	map;
 	struct {
 		mii_trap_handler_cb cb;
-	}		trap[16];
+	}		trap[32];
 } mii_trap_t;
 
 // state of the emulator
@@ -160,6 +160,7 @@ typedef struct mii_t {
 		        read  : 4; // bank # for read operations
 	}	mem[256];
 	int mem_dirty;	// recalculate mem[] on next access
+	uint32_t mem_map;	// mapping switches mem[] was last built for
 	/*
 	 * RAMWORKS card emulation, this is a 16MB address space, with 128
 	 * possible 64KB banks. The 'avail' bitfield marks the banks that
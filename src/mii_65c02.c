@@ -42,7 +42,8 @@ mii_cpu_init(
  * Avoids function pointer overhead by inlining the memory access directly.
  * 
  * Fast path: addresses outside $C000-$C0FF (RAM, stack, ROM, etc.)
- * Slow path: only $C000-$C0FF (I/O soft switches)
+ * Slow path: only $C000-$C0FF (I/O soft switches), plus $C800-$C8FF
+ *            when the No Slot Clock is built in
  * 
  * Performance optimizations:
  * 1. Timer runs only on I/O access (disk LSS only needs timing when accessing $C0Ex)
@@ -55,8 +56,14 @@ mii_cpu_init(
 /* Forward declare timer run */
 extern void mii_timer_run(mii_t *mii, uint64_t cycles);
 
-/* Check if address is in I/O range ($C000-$C0FF) */
+/* Check if address is in I/O range ($C000-$C0FF). With the No Slot Clock,
+ * $C800-$C8FF also has to go through cpu->access(), as the clock hides
+ * under the internal ROM there; the mask matches both pages in one test */
+#if WITH_NSC
+#define _IS_IO_ADDR(_a) (((_a) & 0xF700) == 0xC000)
+#else
 #define _IS_IO_ADDR(_a) (((_a) & 0xFF00) == 0xC000)
+#endif
 
 /* 
  * Run timers - only called on I/O access now.
@@ -150,6 +157,11 @@ _run_timers_inline(mii_cpu_t *cpu) {
 #define _C(_val) { \
 		cpu->P.C = !!(_val); \
 	}
+/* An instruction cleared P.I, look at pending interrupts at the next boundary */
+#define _UNMASKED() { \
+		if (!cpu->P.I && (cpu->irq_line || s.irq || s.nmi)) \
+			cpu->attention = 1; \
+	}
 
 mii_cpu_state_t
 mii_cpu_run(
@@ -162,45 +174,52 @@ mii_cpu_run(
 	mii_op_desc_t d = mii_cpu_op[cpu->IR].desc;
 	pt_start(cpu->state);
 #endif
+	s.trap = 0;
+	if (unlikely(s.reset || s.irq || s.nmi))
+		cpu->attention = 1;
 next_instruction:
-	if (unlikely(s.reset)) {
-		s.reset = 0;
-		_FETCH(0xfffc); cpu->cpu_P = s.data;
-		_FETCH(0xfffd);	cpu->cpu_P |= s.data << 8;
-		cpu->PC = cpu->cpu_P;
-	  	cpu->S = 0xFF;
-		MII_SET_P(cpu, 0);
-	}
-	if (unlikely(s.irq && cpu->P.I == 0)) {
-		if (!cpu->IRQ)
-			cpu->IRQ = MII_CPU_IRQ_IRQ;
-	}
-	if (unlikely(s.nmi && cpu->P.I == 0)) {
-		if (!cpu->IRQ)
-			cpu->IRQ = MII_CPU_IRQ_NMI;
-	}
-	if (unlikely(cpu->IRQ)) {
-		s.irq = 0;
-		cpu->P.B = cpu->IRQ == MII_CPU_IRQ_BRK;
-		cpu->cpu_D = cpu->PC;
-		_STORE(0x0100 | cpu->S--, cpu->cpu_D >> 8);
-		_STORE(0x0100 | cpu->S--, cpu->cpu_D & 0xff);
-		uint8_t p = 0;
-		MII_GET_P(cpu, p);
-		_STORE(0x0100 | cpu->S--, p);
-		cpu->P.I = 1;
-		if (cpu->IRQ == MII_CPU_IRQ_BRK)
-			cpu->P.D = 0;
-		if (cpu->IRQ == MII_CPU_IRQ_NMI) {
-		//	printf("NMI!\n");
-			_FETCH(0xfffa); cpu->cpu_P = s.data;
-			_FETCH(0xfffb);	cpu->cpu_P |= s.data << 8;
-		} else {
-			_FETCH(0xfffe); cpu->cpu_P = s.data;
-			_FETCH(0xffff);	cpu->cpu_P |= s.data << 8;
+	if (unlikely(cpu->attention)) {
+		if (unlikely(s.reset)) {
+			s.reset = 0;
+			_FETCH(0xfffc); cpu->cpu_P = s.data;
+			_FETCH(0xfffd);	cpu->cpu_P |= s.data << 8;
+			cpu->PC = cpu->cpu_P;
+		  	cpu->S = 0xFF;
+			MII_SET_P(cpu, 0);
+		}
+		if ((s.irq || cpu->irq_line) && cpu->P.I == 0) {
+			if (!cpu->IRQ)
+				cpu->IRQ = MII_CPU_IRQ_IRQ;
+		}
+		if (s.nmi && cpu->P.I == 0) {
+			if (!cpu->IRQ)
+				cpu->IRQ = MII_CPU_IRQ_NMI;
+		}
+		if (cpu->IRQ) {
+			s.irq = 0;
+			cpu->trap_pc = 0;
+			cpu->P.B = cpu->IRQ == MII_CPU_IRQ_BRK;
+			cpu->cpu_D = cpu->PC;
+			_STORE(0x0100 | cpu->S--, cpu->cpu_D >> 8);
+			_STORE(0x0100 | cpu->S--, cpu->cpu_D & 0xff);
+			uint8_t p = 0;
+			MII_GET_P(cpu, p);
+			_STORE(0x0100 | cpu->S--, p);
+			cpu->P.I = 1;
+			if (cpu->IRQ == MII_CPU_IRQ_BRK)
+				cpu->P.D = 0;
+			if (cpu->IRQ == MII_CPU_IRQ_NMI) {
+			//	printf("NMI!\n");
+				_FETCH(0xfffa); cpu->cpu_P = s.data;
+				_FETCH(0xfffb);	cpu->cpu_P |= s.data << 8;
+			} else {
+				_FETCH(0xfffe); cpu->cpu_P = s.data;
+				_FETCH(0xffff);	cpu->cpu_P |= s.data << 8;
+			}
+			cpu->IRQ = 0;
+			cpu->PC = cpu->cpu_P;
 		}
-		cpu->IRQ = 0;
-		cpu->PC = cpu->cpu_P;
+		cpu->attention = (s.irq || s.nmi || cpu->irq_line) && !cpu->P.I;
 	}
 	s.sync = 1;
 	// we dont' reset the cycle here, that way calling code has a way of knowing
@@ -212,14 +231,6 @@ next_instruction:
 	cpu->PC++;
 	cpu->IR = s.data;
 	d = mii_cpu_op[cpu->IR].desc;
-	cpu->ir_log = (cpu->ir_log << 8) | cpu->IR;
-	s.trap = cpu->trap && (cpu->ir_log & 0xffff) == cpu->trap;
-	if (unlikely(s.trap)) {
-		cpu->ir_log = 0;
-#if MII_65C02_DIRECT_ACCESS
-		return s;
-#endif
-	}
 	switch (d.mode) {
 		case IMM:
 			_FETCH(cpu->PC++);		cpu->cpu_D = s.data;
@@ -275,6 +286,10 @@ next_instruction:
 			_FETCH((cpu->cpu_D + 1) & 0xff);
 			cpu->cpu_P |= s.data << 8;
 			cpu->cpu_P += cpu->Y;
+			// a read is a cycle longer across a page, a write always is
+			if (!d.w && (cpu->cpu_P & 0xff00) != (s.data << 8)) {
+				_FETCH(cpu->PC - 1); // false read
+			}
 		}	break;
 		case IND: {	// ($xxxx)
 			_FETCH(cpu->PC++); 		cpu->cpu_D = s.data;
@@ -408,11 +423,14 @@ next_instruction:
 			_FETCH(cpu->PC++);
 			s.irq = 1;
 			cpu->IRQ = MII_CPU_IRQ_BRK;		// BRK sort of IRQ interrupt
+			cpu->attention = 1;
 		}	break;
 		case 0x18: case 0xD8: case 0x58: case 0xB8:
 		{ // CLC, CLD, CLI, CLV
 			_FETCH(cpu->PC);
 			MII_SET_P_BIT(cpu, d.s_bit, 0);
+			if (cpu->IR == 0x58)
+				_UNMASKED();
 		}	break;
 		case 0xC9: case 0xC5: case 0xD5: case 0xCD: case 0xDD:
 		case 0xD9: case 0xC1: case 0xD1: case 0xD2:
@@ -561,6 +579,7 @@ next_instruction:
 		{ // PLP
 			_FETCH(0x0100 | ++cpu->S);cpu->cycle++;
 			MII_SET_P(cpu, s.data);cpu->cycle++;
+			_UNMASKED();
 		}	break;
 		case 0xFA:
 		{ // PLX
@@ -617,6 +636,7 @@ next_instruction:
 //				MII_SET_P_BIT(cpu, i, i == B_B || (s.data & (1 << i)));
 				MII_SET_P_BIT(cpu, i, !(i == B_B) && (s.data & (1 << i)));
 			cpu->P.cpu_R = 1;
+			_UNMASKED();
 			cpu->S++; _FETCH(0x0100 | cpu->S);
 			cpu->cpu_P = s.data;
 			cpu->S++; _FETCH(0x0100 | cpu->S);
@@ -695,7 +715,11 @@ next_instruction:
 		{ // SEC, SED, SEI
 			MII_SET_P_BIT(cpu, d.s_bit, 1);
 		}	break;
-		case 0x85: case 0x95: case 0x8D: case 0x9D:
+		case 0x85: case 0x8D:
+		{ // STA, no index to add
+			cpu->cpu_D = cpu->A;
+		}	break;
+		case 0x95: case 0x9D:
 		case 0x99: case 0x81: case 0x91: case 0x92:
 		{ // STA
 			cpu->cpu_D = cpu->A;cpu->cycle++;
@@ -714,11 +738,13 @@ next_instruction:
 		}	break;
 		case 0x14: case 0x1c:
 		{	// TRB
+			_FETCH(cpu->cpu_P);	// false read, before the write
 			cpu->P.Z = !(cpu->A & cpu->cpu_D);
 			cpu->cpu_D &= ~cpu->A;
 		}	break;
 		case 0x04: case 0x0c:
 		{	// TSB
+			_FETCH(cpu->cpu_P);	// false read, before the write
 			cpu->P.Z = !(cpu->A & cpu->cpu_D);
 			cpu->cpu_D |= cpu->A;
 		}	break;
@@ -772,15 +798,28 @@ next_instruction:
 		// trap NOPs / STP (WDC)
 			_FETCH(cpu->PC++); // FD: Added to pass HARTE's test
 			break;
+		// these two are SPECIAL, 0xebfb is used as the 'trap' that calls
+		// back into the emulator. This is used by the smartport driver.
+		// The first one notes where the second should be, so nothing
+		// needs checking for the other opcodes
+		case 0xEB: case 0xFB:
+			if (cpu->IR == (cpu->trap >> 8))
+				cpu->trap_pc = cpu->PC + 1;
+			else if (cpu->trap && cpu->IR == (cpu->trap & 0xff) &&
+						cpu->trap_pc == (uint16_t)(cpu->PC - 1) + 1u) {
+				cpu->trap_pc = 0;
+				s.trap = 1;
+#if MII_65C02_DIRECT_ACCESS
+				return s;
+#endif
+			}
+			break;
 		case 0xCB :
 		// FD: Added to pass HARTE's test
 		// WAI for WDC65C02 not in R65C02
 		// FD: Added to properly pass HARTE's test
 		case 0x0B: case 0x1B: case 0x2B: case 0x3B: case 0x4B: case 0x5B:
 		case 0x6B: case 0x7B: case 0x8B: case 0x9B: case 0xAB: case 0xBB:
-		// these two are SPECIAL, 0xebfb is used as the 'trap' that calls
-		// back into the emulator. This is used by the smartport driver
-		case 0xEB: case 0xFB:
 		case 0x03: case 0X13: case 0X23: case 0X33: case 0x43: case 0x53:
 		case 0x63: case 0x73: case 0x83: case 0x93: case 0xA3: case 0xB3:
 		case 0xC3: case 0xD3: case 0xE3: case 0xF3:
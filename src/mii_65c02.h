@@ -111,8 +111,16 @@ typedef struct mii_cpu_t {
 	 * typically use a pair of NOPs sequence that is unlikely to exist in
 	 * real code. */
 	uint16_t 	trap;
-	// last 4 instructions, as a shift register, used for traps or debug
-	uint32_t	ir_log;
+	// 1 + address following the last trap first opcode, 0 for none
+	uint32_t	trap_pc;
+	/* Level of the IRQ input, set with mii_cpu_irq() */
+	uint8_t		irq_line;
+	/* Non zero when the next instruction boundary needs a look: reset,
+	 * an unmasked IRQ/NMI, BRK. This is the only thing the instruction
+	 * loop tests; it is set by mii_cpu_irq(), the caller passing
+	 * reset/irq/nmi in the state, and CLI/PLP/RTI unmasking a pending
+	 * IRQ. It can be stale (set for nothing), never the reverse. */
+	uint8_t		attention;
 
 	uint64_t 	total_cycle;
 #if MII_65C02_DIRECT_ACCESS
@@ -138,6 +146,18 @@ mii_cpu_run(
 		mii_cpu_t *cpu,
 		mii_cpu_state_t s);
 
+/* Set the level of the IRQ input. It is sampled at the next instruction
+ * boundary, as long as P.I is clear */
+static inline void
+mii_cpu_irq(
+		mii_cpu_t *cpu,
+		uint8_t level)
+{
+	cpu->irq_line = level;
+	if (level && !cpu->P.I)
+		cpu->attention = 1;
+}
+
 
 #ifdef MII_PACK_P
 #define MII_SET_P(_cpu, _byte) { \
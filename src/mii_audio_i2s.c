@@ -19,6 +19,7 @@
 #include <hardware/clocks.h>
 
 #include "mii_audio.h"
+#include "mii_capture.h"
 
 // We need pico_audio_i2s from pico-extras
 #if defined(FEATURE_AUDIO_I2S)
@@ -453,6 +454,9 @@ int mii_audio_update(uint64_t current_cycle, uint64_t cycles_per_second)
             // Output stereo samples
             samples[i * 2] = clamp_s16(left);
             samples[i * 2 + 1] = clamp_s16(right);
+#if WITH_CAPTURE
+            mii_capture_audio(samples[i * 2], samples[i * 2 + 1]);
+#endif
         }
         
         buffer->sample_count = sample_count;
@@ -493,6 +497,9 @@ int mii_audio_update(uint64_t current_cycle, uint64_t cycles_per_second)
         }
 
         pwm_submit_one_sample(clamp_s16(left), clamp_s16(right));
+#if WITH_CAPTURE
+        mii_capture_audio(clamp_s16(left), clamp_s16(right));
+#endif
     }
 #endif
     
@@ -0,0 +1,277 @@
+/*
+ * mii_bench.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Guest side benchmarks: each workload is a small endless 6502 program
+ * that hammers one part of the emulator, so a change to the core, the
+ * page table or a driver shows up as a speed difference here rather than
+ * as "that game feels faster". The programs are assembled at run time
+ * with mii_65c02_asm.c; keep to its syntax (labels in column 0, '$' hex
+ * only, no data labels as operands -- only EQUs).
+ *
+ * The program is copied to $0800 in both main and aux RAM so the RAMRD
+ * flips in the 'switch' workload keep running the same code.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mii.h"
+#include "mii_bank.h"
+#include "mii_65c02_asm.h"
+#include "mii_bench.h"
+
+#if MII_RP2350
+#include <pico/time.h>
+#define _now_us()	time_us_32()
+#else
+#include <time.h>
+static uint32_t
+_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+#endif
+
+#define MII_BENCH_ORG	0x0800
+
+typedef struct mii_bench_t {
+	const char *		name;
+	const char *		src;
+} mii_bench_t;
+
+static const mii_bench_t _mii_bench[] = {
+	{ "alu",
+	/* plain ALU/RMW on zero page, the core's fast path */
+		"	.org $0800\n"
+		"loop	clc\n"
+		"	lda $10\n"
+		"	adc #$03\n"
+		"	sta $10\n"
+		"	eor $11\n"
+		"	asl\n"
+		"	rol $12\n"
+		"	and #$7f\n"
+		"	ora $13\n"
+		"	inx\n"
+		"	bne loop\n"
+		"	iny\n"
+		"	jmp loop\n"
+	},
+	{ "copy",
+	/* zp,X copy of half the zero page, then 16 pages with (zp),Y */
+		"	.org $0800\n"
+		"src	= $06\n"
+		"dst	= $08\n"
+		"start	ldx #$7f\n"
+		"zpcp	lda $10,x\n"
+		"	sta $90,x\n"
+		"	dex\n"
+		"	bpl zpcp\n"
+		"	lda #$00\n"
+		"	sta src\n"
+		"	sta dst\n"
+		"	lda #$40\n"
+		"	sta $07\n"
+		"	lda #$60\n"
+		"	sta $09\n"
+		"	ldx #$10\n"
+		"	ldy #$00\n"
+		"cp	lda (src),y\n"
+		"	sta (dst),y\n"
+		"	iny\n"
+		"	bne cp\n"
+		"	inc $07\n"
+		"	inc $09\n"
+		"	dex\n"
+		"	bne cp\n"
+		"	jmp start\n"
+	},
+	{ "switch",
+	/* RAMRD/RAMWRT, 80STORE+PAGE2 and language card flips, each of
+	 * which rebuilds part of the page table */
+		"	.org $0800\n"
+		"loop	sta $c003\n"
+		"	sta $c005\n"
+		"	lda $0400\n"
+		"	sta $0300\n"
+		"	sta $c002\n"
+		"	sta $c004\n"
+		"	sta $c001\n"
+		"	sta $c055\n"
+		"	sta $0400\n"
+		"	sta $c054\n"
+		"	sta $c000\n"
+		"	lda $c08b\n"
+		"	lda $c08b\n"
+		"	lda $d000\n"
+		"	lda $c081\n"
+		"	inx\n"
+		"	bne loop\n"
+		"	jmp loop\n"
+	},
+	{ "hgr",
+	/* toggle one pixel per HGR line, the row base computed the way
+	 * HPOSN does, with the display in HGR page 1 */
+		"	.org $0800\n"
+		"gbas	= $26\n"
+		"ycur	= $e0\n"
+		"phase	= $e2\n"
+		"	sta $c050\n"
+		"	sta $c052\n"
+		"	sta $c054\n"
+		"	sta $c057\n"
+		"frame	inc phase\n"
+		"	lda #$00\n"
+		"	sta ycur\n"
+		"row	lda ycur\n"
+		"	and #$07\n"
+		"	asl\n"
+		"	asl\n"
+		"	ora #$20\n"
+		"	sta $27\n"
+		"	lda ycur\n"
+		"	lsr\n"
+		"	lsr\n"
+		"	lsr\n"
+		"	and #$07\n"
+		"	lsr\n"
+		"	ora $27\n"
+		"	sta $27\n"
+		"	lda #$00\n"
+		"	ror\n"
+		"	sta gbas\n"
+		"	lda ycur\n"
+		"	rol\n"
+		"	rol\n"
+		"	rol\n"
+		"	and #$03\n"
+		"	tax\n"
+		"	beq col\n"
+		"add40	lda gbas\n"
+		"	clc\n"
+		"	adc #$28\n"
+		"	sta gbas\n"
+		"	dex\n"
+		"	bne add40\n"
+		"col	lda ycur\n"
+		"	clc\n"
+		"	adc phase\n"
+		"	and #$1f\n"
+		"	tay\n"
+		"	lda ycur\n"
+		"	and #$07\n"
+		"	tax\n"
+		"	lda #$01\n"
+		"	cpx #$00\n"
+		"	beq plot\n"
+		"shift	asl\n"
+		"	dex\n"
+		"	bne shift\n"
+		"plot	eor (gbas),y\n"
+		"	sta (gbas),y\n"
+		"	inc ycur\n"
+		"	lda ycur\n"
+		"	cmp #$c0\n"
+		"	bne row\n"
+		"	jmp frame\n"
+	},
+	{ "disk",
+	/* slot 6 motor on, drive 1, poll the data latch like RWTS does */
+		"	.org $0800\n"
+		"	lda $c0e9\n"
+		"	lda $c0ea\n"
+		"	lda $c0ee\n"
+		"poll	lda $c0ec\n"
+		"	bpl poll\n"
+		"	cmp #$d5\n"
+		"	bne poll\n"
+		"	inx\n"
+		"	jmp poll\n"
+	},
+	{ "speaker",
+	/* a ~3.9KHz square wave */
+		"	.org $0800\n"
+		"loop	sta $c030\n"
+		"	ldy #$18\n"
+		"dly	dey\n"
+		"	bne dly\n"
+		"	inx\n"
+		"	jmp loop\n"
+	},
+};
+
+/* Assembles and loads a workload, returns its length, 0 if it failed */
+static uint16_t
+_mii_bench_load(
+		mii_t *mii,
+		const mii_bench_t *b)
+{
+	mii_cpu_asm_program_t prog = {};
+	if (mii_cpu_asm(&prog, b->src) || !prog.output_len) {
+		printf("%s %s: assembly failed\n", __func__, b->name);
+		mii_cpu_asm_free(&prog);
+		return 0;
+	}
+	const uint16_t len = prog.output_len;
+	mii_reset(mii, true);
+	mii_bank_write(&mii->bank[MII_BANK_MAIN],
+			prog.org, prog.output, prog.output_len);
+	mii_bank_write(&mii->bank[MII_BANK_AUX],
+			prog.org, prog.output, prog.output_len);
+	mii->cpu_state.reset = 0;
+	mii->cpu.IRQ = 0;
+	mii->cpu.trap_pc = 0;
+	mii->cpu.S = 0xff;
+	MII_SET_P(&mii->cpu, 0);
+	mii->cpu.P.I = 1;
+	mii->cpu.PC = prog.org;
+	mii_cpu_asm_free(&prog);
+	return len;
+}
+
+int
+mii_bench_run(
+		mii_t *mii,
+		uint32_t cycles)
+{
+	int count = 0;
+	printf("Guest benchmark, %lu cycles per workload\n",
+			(unsigned long)cycles);
+	for (unsigned i = 0; i < sizeof(_mii_bench) / sizeof(_mii_bench[0]); i++) {
+		const mii_bench_t *b = &_mii_bench[i];
+		const uint16_t len = _mii_bench_load(mii, b);
+		if (!len)
+			continue;
+		uint64_t c0 = mii->cpu.total_cycle;
+		uint32_t t0 = _now_us();
+		mii_run_cycles(mii, cycles);
+		uint32_t us = _now_us() - t0;
+		uint64_t ran = mii->cpu.total_cycle - c0;
+		if (!us)
+			us = 1;
+		// kHz, so the 1.023MHz Apple II reads as 1023
+		uint32_t khz = (uint32_t)(ran * 1000 / us);
+		printf("  %-8s %7lu us %2lu.%03lu MHz (x%lu.%02lu) PC $%04X\n",
+				b->name, (unsigned long)us,
+				(unsigned long)(khz / 1000), (unsigned long)(khz % 1000),
+				(unsigned long)(khz / 1023),
+				(unsigned long)(khz % 1023 * 100 / 1023),
+				mii->cpu.PC);
+		// a workload that BRKed or ran off into the ROM timed something else
+		if (ran < cycles || mii->cpu.PC < MII_BENCH_ORG ||
+				mii->cpu.PC >= MII_BENCH_ORG + len) {
+			printf("  %-8s FAILED, %llu of %lu cycles, PC $%04X, code at "
+					"$%04X-$%04X\n", b->name, (unsigned long long)ran,
+					(unsigned long)cycles, mii->cpu.PC, MII_BENCH_ORG,
+					MII_BENCH_ORG + len - 1);
+			continue;
+		}
+		count++;
+	}
+	mii_reset(mii, true);
+	return count;
+}
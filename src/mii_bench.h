@@ -0,0 +1,26 @@
+/*
+ * mii_bench.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct mii_t;
+
+/*
+ * Synthetic guest workloads (ALU loop, zero page and (zp),Y copies, soft
+ * switch bank flipping, HGR plotting, Disk II polling, speaker toggles)
+ * kept as 6502 source and assembled with the built-in assembler. Each one
+ * is run for 'cycles' guest cycles from a cold reset and the emulated
+ * speed is printed on serial. The machine is left cold reset afterward.
+ *
+ * Returns the number of workloads that ran: all their cycles, and still
+ * in their own code at the end (one that BRKs or jumps into the ROM
+ * fails).
+ */
+int
+mii_bench_run(
+		struct mii_t *mii,
+		uint32_t cycles);
@@ -0,0 +1,436 @@
+/*
+ * mii_capture.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Capture format, little endian:
+ *	"MIIC", version (1), bits per pixel (4), audio channels (2), 0,
+ *	width (2 bytes), height (2 bytes), audio rate (4 bytes),
+ *	palette, 16 x RGB (48 bytes)
+ * then records of:
+ *	type, payload length (3 bytes), payload
+ *
+ * 'V' payload: guest frame number (4 bytes) then the XOR of the frame with
+ * the previous one recorded (black for the first one), RLE compressed:
+ *	0x00-0x7f	n = c + 1 literal bytes follow
+ *	0x80-0xbf	n = ((c & 0x3f) << 8 | next) + 1 bytes unchanged
+ *	0xc0-0xff	n = ((c & 0x3f) << 8 | next) + 1 times the following byte
+ * 'A' payload: index of the first sample (4 bytes) then 16 bit L/R samples.
+ * Gaps in the sample indexes are audio that was lost, play them as silence.
+ *
+ * The video core encodes straight into a ring buffer in PSRAM, and only
+ * if there's room for a worst case frame; the emulation core drains the
+ * ring into the file in the time left at the end of its frames, one
+ * MII_CAPTURE_CHUNK at a time. A busy card costs captured frames, never
+ * emulated ones.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "mii_capture.h"
+
+#if MII_RP2350
+#include <pico/time.h>
+#include <hardware/sync.h>
+#include "../drivers/psram_allocator.h"
+#define _now_us()	time_us_32()
+#else
+#include <stdlib.h>
+#include <time.h>
+#define __dmb()		__sync_synchronize()
+static uint32_t
+_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+#endif
+
+#define MII_CAPTURE_MAGIC		"MIIC"
+#define MII_CAPTURE_VERSION		1
+#define MII_CAPTURE_HEADER		64
+#define MII_CAPTURE_W			320
+#define MII_CAPTURE_H			240
+#define MII_CAPTURE_FB			(MII_CAPTURE_W * MII_CAPTURE_H / 2)
+// encoded frames, ~8 full screen changes (power of 2)
+#define MII_CAPTURE_RING		(256 * 1024)
+// worst case frame: all literals, plus record and frame number
+#define MII_CAPTURE_FRAME_MAX	(MII_CAPTURE_FB + MII_CAPTURE_FB / 128 + 8)
+// stereo samples, ~370ms at 11025Hz (power of 2)
+#define MII_CAPTURE_AUDIO		4096
+#define MII_CAPTURE_AUDIO_REC	1024
+// what the audio output may add while a write is in progress
+#define MII_CAPTURE_AUDIO_SLACK	512
+// largest single f_write(), and the time left needed to start one
+#define MII_CAPTURE_CHUNK		4096
+#define MII_CAPTURE_WRITE_US	3000
+
+typedef struct mii_capture_t {
+	volatile bool		on;
+	volatile bool		busy;		// video core is encoding a frame
+	bool				failed;		// write error, file to be closed
+	FIL					f;
+	uint8_t *			ring;
+	uint8_t *			prev;		// last frame recorded
+	uint32_t *			audio;		// L | R << 16
+	volatile uint32_t	head;		// ring, written by the video core
+	volatile uint32_t	tail;
+	volatile uint32_t	a_head;		// sample count, written by the audio
+	uint32_t			a_tail, a_base;
+	uint32_t			rec_left;	// of the record being written
+	// statistics
+	uint32_t			frames, dropped, a_lost;
+	uint32_t			bytes;
+	uint64_t			enc_us, write_us;
+} mii_capture_t;
+
+static mii_capture_t _capture;
+
+typedef struct mii_capture_rle_t {
+	uint8_t *			ring;
+	uint32_t			h;
+	uint32_t			run;		// pending run of 'val'
+	uint8_t				val;
+	uint8_t				nlit;
+	uint8_t				lit[128];
+} mii_capture_rle_t;
+
+static inline void
+_mii_capture_put(
+		mii_capture_rle_t *e,
+		uint8_t b)
+{
+	e->ring[e->h++ & (MII_CAPTURE_RING - 1)] = b;
+}
+
+static void
+_mii_capture_flush_lit(
+		mii_capture_rle_t *e)
+{
+	if (!e->nlit)
+		return;
+	_mii_capture_put(e, e->nlit - 1);
+	for (int i = 0; i < e->nlit; i++)
+		_mii_capture_put(e, e->lit[i]);
+	e->nlit = 0;
+}
+
+static void
+_mii_capture_flush_run(
+		mii_capture_rle_t *e)
+{
+	if (e->run >= 4) {
+		_mii_capture_flush_lit(e);
+		uint32_t n = e->run - 1;
+		_mii_capture_put(e, (e->val ? 0xc0 : 0x80) | (n >> 8));
+		_mii_capture_put(e, n);
+		if (e->val)
+			_mii_capture_put(e, e->val);
+	} else {
+		for (uint32_t i = 0; i < e->run; i++) {
+			e->lit[e->nlit++] = e->val;
+			if (e->nlit == sizeof(e->lit))
+				_mii_capture_flush_lit(e);
+		}
+	}
+	e->run = 0;
+}
+
+static inline void
+_mii_capture_rle(
+		mii_capture_rle_t *e,
+		uint8_t b)
+{
+	if (b == e->val && e->run < 0x4000) {
+		e->run++;
+		return;
+	}
+	_mii_capture_flush_run(e);
+	e->val = b;
+	e->run = 1;
+}
+
+/* Encode 'fb' as a 'V' record at 'h', returns the new ring head */
+static uint32_t
+_mii_capture_encode(
+		mii_capture_t *c,
+		const uint8_t *fb,
+		uint32_t frame,
+		uint32_t h)
+{
+	mii_capture_rle_t e = { .ring = c->ring, .h = h + 8 };
+	const uint32_t *src = (const uint32_t *)fb;
+	uint32_t *prev = (uint32_t *)c->prev;
+
+	for (int i = 0; i < MII_CAPTURE_FB / 4; i++) {
+		uint32_t x = src[i] ^ prev[i];
+		// unchanged pixels are the common case
+		if (!x && !e.val && e.run <= 0x4000 - 4) {
+			e.run += 4;
+			continue;
+		}
+		prev[i] = src[i];
+		for (int b = 0; b < 4; b++, x >>= 8)
+			_mii_capture_rle(&e, x);
+	}
+	_mii_capture_flush_run(&e);
+	_mii_capture_flush_lit(&e);
+
+	uint32_t len = e.h - h - 4;
+	e.h = h;
+	_mii_capture_put(&e, 'V');
+	for (int i = 0; i < 3; i++)
+		_mii_capture_put(&e, len >> (i * 8));
+	for (int i = 0; i < 4; i++)
+		_mii_capture_put(&e, frame >> (i * 8));
+	return h + 4 + len;
+}
+
+/* Returns false, and stops the capture, on a write error */
+static bool
+_mii_capture_write(
+		mii_capture_t *c,
+		const void *buf,
+		uint32_t len)
+{
+	UINT bw = 0;
+	if (f_write(&c->f, buf, len, &bw) != FR_OK || bw != len) {
+		printf("%s write failed, capture stopped\n", __func__);
+		c->on = false;
+		c->failed = true;
+		return false;
+	}
+	c->bytes += len;
+	return true;
+}
+
+static bool
+_mii_capture_write_audio(
+		mii_capture_t *c,
+		uint32_t max)
+{
+	uint32_t head = c->a_head;
+	// the oldest samples were overwritten
+	if (head - c->a_tail > MII_CAPTURE_AUDIO - MII_CAPTURE_AUDIO_SLACK) {
+		uint32_t t = head - (MII_CAPTURE_AUDIO - MII_CAPTURE_AUDIO_SLACK);
+		c->a_lost += t - c->a_tail;
+		c->a_tail = t;
+	}
+	uint32_t n = head - c->a_tail;
+	if (n > max)
+		n = max;
+	if (!n)
+		return true;
+	uint32_t len = 4 + n * 4;
+	uint32_t first = c->a_tail - c->a_base;
+	uint8_t h[8] = { 'A', len, len >> 8, len >> 16,
+			first, first >> 8, first >> 16, first >> 24 };
+	if (!_mii_capture_write(c, h, sizeof(h)))
+		return false;
+	while (n) {
+		uint32_t off = c->a_tail & (MII_CAPTURE_AUDIO - 1);
+		uint32_t cnt = MII_CAPTURE_AUDIO - off;
+		if (cnt > n)
+			cnt = n;
+		if (!_mii_capture_write(c, c->audio + off, cnt * 4))
+			return false;
+		c->a_tail += cnt;
+		n -= cnt;
+	}
+	return true;
+}
+
+/*
+ * Write the ring out, up to 'deadline' (forever if 'all'). Audio goes in
+ * between frame records.
+ */
+static void
+_mii_capture_drain(
+		mii_capture_t *c,
+		uint32_t deadline,
+		bool all)
+{
+	while (all || (int32_t)(deadline - _now_us()) > MII_CAPTURE_WRITE_US) {
+		if (!c->rec_left) {
+			if (c->a_head - c->a_tail >= (all ? 1 : MII_CAPTURE_AUDIO_REC)) {
+				if (!_mii_capture_write_audio(c, MII_CAPTURE_AUDIO_REC))
+					return;
+				continue;
+			}
+			uint32_t head = c->head;
+			__dmb();
+			if (head == c->tail)
+				return;
+			const uint8_t *r = c->ring;
+			uint32_t t = c->tail;
+			c->rec_left = 4 + (r[(t + 1) & (MII_CAPTURE_RING - 1)] |
+					(r[(t + 2) & (MII_CAPTURE_RING - 1)] << 8) |
+					(r[(t + 3) & (MII_CAPTURE_RING - 1)] << 16));
+		}
+		uint32_t off = c->tail & (MII_CAPTURE_RING - 1);
+		uint32_t n = c->rec_left;
+		if (n > MII_CAPTURE_RING - off)
+			n = MII_CAPTURE_RING - off;
+		if (n > MII_CAPTURE_CHUNK)
+			n = MII_CAPTURE_CHUNK;
+		if (!_mii_capture_write(c, c->ring + off, n))
+			return;
+		c->rec_left -= n;
+		__dmb();
+		c->tail += n;
+	}
+}
+
+int
+mii_capture_start(
+		const char *dir,
+		const uint32_t *palette,
+		uint32_t audio_rate)
+{
+	mii_capture_t *c = &_capture;
+	if (c->on)
+		return 0;
+	if (!c->ring) {
+		size_t sz = MII_CAPTURE_RING + MII_CAPTURE_FB + MII_CAPTURE_AUDIO * 4;
+#if MII_RP2350
+		if (butter_psram_size() >= 1024 * 1024)
+			c->ring = psram_malloc(sz);
+#else
+		c->ring = malloc(sz);
+#endif
+		if (!c->ring) {
+			printf("%s no PSRAM for the capture buffers\n", __func__);
+			return -1;
+		}
+		c->prev = c->ring + MII_CAPTURE_RING;
+		c->audio = (uint32_t *)(c->prev + MII_CAPTURE_FB);
+	}
+	char path[64];
+	FRESULT fr = FR_EXIST;
+	for (int i = 0; i < 1000 && fr == FR_EXIST; i++) {
+		snprintf(path, sizeof(path), "%s/cap%03d.mic", dir, i);
+		fr = f_open(&c->f, path, FA_WRITE | FA_CREATE_NEW);
+	}
+	if (fr != FR_OK) {
+		printf("%s can't create a capture file in %s\n", __func__, dir);
+		return -1;
+	}
+	uint8_t h[MII_CAPTURE_HEADER] = {
+		'M', 'I', 'I', 'C', MII_CAPTURE_VERSION, 4, 2, 0,
+		MII_CAPTURE_W & 0xff, MII_CAPTURE_W >> 8,
+		MII_CAPTURE_H & 0xff, MII_CAPTURE_H >> 8,
+		audio_rate, audio_rate >> 8, audio_rate >> 16, audio_rate >> 24,
+	};
+	for (int i = 0; i < 16; i++) {
+		h[16 + i * 3 + 0] = palette[i] >> 16;
+		h[16 + i * 3 + 1] = palette[i] >> 8;
+		h[16 + i * 3 + 2] = palette[i];
+	}
+	c->bytes = 0;
+	c->failed = false;
+	if (!_mii_capture_write(c, h, sizeof(h))) {
+		f_close(&c->f);
+		return -1;
+	}
+	memset(c->prev, 0, MII_CAPTURE_FB);
+	c->head = c->tail = 0;
+	c->rec_left = 0;
+	c->a_tail = c->a_base = c->a_head;
+	c->frames = c->dropped = c->a_lost = 0;
+	c->enc_us = c->write_us = 0;
+	__dmb();
+	c->on = true;
+	printf("Capture: recording to %s\n", path);
+	return 0;
+}
+
+static void
+_mii_capture_close(
+		mii_capture_t *c)
+{
+	c->on = false;
+	__dmb();
+	while (c->busy)
+		;
+	if (!c->failed)
+		_mii_capture_drain(c, 0, true);
+	if (f_close(&c->f) != FR_OK)
+		printf("%s close failed\n", __func__);
+	uint32_t n = c->frames ? c->frames : 1;
+	printf("Capture: %lu frames, %lu dropped, %lu KB, %lu audio samples lost\n",
+			(unsigned long)c->frames, (unsigned long)c->dropped,
+			(unsigned long)(c->bytes / 1024), (unsigned long)c->a_lost);
+	printf("Capture: %lu us encoding, %lu us writing per frame\n",
+			(unsigned long)(c->enc_us / n), (unsigned long)(c->write_us / n));
+}
+
+void
+mii_capture_stop(void)
+{
+	mii_capture_t *c = &_capture;
+	if (c->on)
+		_mii_capture_close(c);
+}
+
+bool
+mii_capture_active(void)
+{
+	return _capture.on;
+}
+
+void
+mii_capture_frame(
+		const uint8_t *fb,
+		uint32_t frame)
+{
+	mii_capture_t *c = &_capture;
+	c->busy = true;
+	__dmb();
+	if (!c->on) {
+		c->busy = false;
+		return;
+	}
+	uint32_t h = c->head;
+	if (MII_CAPTURE_RING - (h - c->tail) < MII_CAPTURE_FRAME_MAX) {
+		c->dropped++;
+	} else {
+		uint32_t t0 = _now_us();
+		h = _mii_capture_encode(c, fb, frame, h);
+		c->enc_us += _now_us() - t0;
+		c->frames++;
+		__dmb();
+		c->head = h;
+	}
+	__dmb();
+	c->busy = false;
+}
+
+void
+mii_capture_audio(
+		int16_t left,
+		int16_t right)
+{
+	mii_capture_t *c = &_capture;
+	if (!c->on)
+		return;
+	uint32_t h = c->a_head;
+	c->audio[h & (MII_CAPTURE_AUDIO - 1)] =
+			(uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+	c->a_head = h + 1;
+}
+
+void
+mii_capture_idle(
+		uint32_t deadline)
+{
+	mii_capture_t *c = &_capture;
+	if (!c->on)
+		return;
+	uint32_t t0 = _now_us();
+	_mii_capture_drain(c, deadline, false);
+	c->write_us += _now_us() - t0;
+	if (c->failed)
+		_mii_capture_close(c);
+}
@@ -0,0 +1,53 @@
+/*
+ * mii_capture.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Gameplay capture to SD: every rendered 320x240 4bpp frame is XORed
+ * against the previous one and RLE compressed, the audio output is logged
+ * alongside. The file is only written to in the slack at the end of each
+ * emulated frame; when the card can't keep up, frames are dropped rather
+ * than the emulation being held up.
+ *
+ * tools/mii_capture_decode.py turns a capture into PNG frames and a WAV.
+ */
+
+/*
+ * Start a capture to the first free 'dir'/capNNN.mic. 'palette' is the 16
+ * RGB888 colours of the framebuffer. Returns -1 if there is no memory for
+ * the buffers (needs PSRAM) or the file can't be created.
+ */
+int
+mii_capture_start(
+		const char *dir,
+		const uint32_t *palette,
+		uint32_t audio_rate);
+/* Flush what is buffered, close the file and print the statistics */
+void
+mii_capture_stop(void);
+bool
+mii_capture_active(void);
+/* Video core, after a frame was rendered to 'fb' */
+void
+mii_capture_frame(
+		const uint8_t *fb,
+		uint32_t frame);
+/* From the audio output, one stereo sample */
+void
+mii_capture_audio(
+		int16_t left,
+		int16_t right);
+/*
+ * Emulation core, with nothing left to do until 'deadline' (time_us_32()
+ * time). Writes buffered data to the card as long as it looks like it
+ * fits before the deadline.
+ */
+void
+mii_capture_idle(
+		uint32_t deadline);
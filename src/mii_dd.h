@@ -45,6 +45,7 @@ typedef struct mii_dd_file_t {
 	uint8_t 		format;
 	uint8_t 		read_only;
 	uint8_t 		drive_idx;
+	uint8_t *		map;	// memory mapped image (ie flash), if any
 } mii_dd_file_t;
 
 /*
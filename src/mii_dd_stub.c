@@ -162,6 +162,14 @@ mii_dd_read(
 {
 	if (!dd->file || !dd->file->pathname) return -1;
 
+	if (dd->file->map) {
+		// mapped in place (XIP flash), no need to go thru FatFS
+		if ((blk + blockcount) * 512 > dd->file->size)
+			return -1;
+		const uint8_t *src = dd->file->map + (blk * 512);
+		mii_bank_write(bank, addr, src, blockcount * 512);
+		return 0;
+	}
 	FIL* f = &mii_ff_files[dd->file->drive_idx];
     if (f_lseek(f, 512 * blk) != FR_OK) goto err;
 
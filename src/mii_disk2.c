@@ -16,6 +16,7 @@
 
 #include "mii_woz.h"
 #include "mii_disk2.h"
+#include "mii_nibcap.h"
 
 #ifdef MII_RP2350
 #include "mii_disk2_asm.h"
@@ -143,8 +144,8 @@ _mii_disk2_switch_track(
 	mii_floppy_t *f = &c->floppy[c->selected];
 	int qtrack = f->qtrack + delta;
 	if (qtrack < 0) qtrack = 0;
-	if (qtrack >= MII_FLOPPY_TRACK_COUNT * 4)
-			qtrack = (MII_FLOPPY_TRACK_COUNT * 4) -1;
+	if (qtrack >= MII_FLOPPY_QTRACK_COUNT)
+			qtrack = MII_FLOPPY_QTRACK_COUNT - 1;
 	printf("switch_track qt: %d -> %d\n", f->qtrack, qtrack);
 	if (qtrack == f->qtrack)
 		return f->qtrack;
@@ -726,6 +727,9 @@ _mii_disk2_lss_batch(
 	// Prefetch the first track byte
 	uint8_t current_byte = track[bp >> 3];
 	uint32_t current_byte_idx = bp >> 3;
+#if WITH_NIBBLE_CAPTURE
+	uint8_t latch = data_reg;
+#endif
 	
 	while (ticks > 0) {
 		clock += 4;
@@ -777,6 +781,13 @@ _mii_disk2_lss_batch(
 		} else if (action == 0) {
 			data_reg = 0;
 		}
+#if WITH_NIBBLE_CAPTURE
+		// a nibble is complete when a 1 gets shifted into bit 7
+		if (data_reg & ~latch & 0x80)
+			mii_nibcap_byte(c->mii->cpu.total_cycle - (ticks >> 1),
+					c->selected, f->qtrack, bp, bit_count, data_reg);
+		latch = data_reg;
+#endif
 		
 		ticks--;
 	}
@@ -59,73 +59,109 @@ const uint8_t TRANS62[] = {
 	0xed, 0xee, 0xef, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
 	0xf7, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
 };
-const int8_t  DETRANS62[] = {
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
-	0x00, 0x00, 0x02, 0x03, 0x00, 0x04, 0x05, 0x06,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x08,
-	0x00, 0x00, 0x00, 0x09, 0x0A, 0x0B, 0x0C, 0x0D,
-	0x00, 0x00, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13,
-	0x00, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x1B, 0x00, 0x1C, 0x1D, 0x1E,
-	0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x20, 0x21,
-	0x00, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x29, 0x2A, 0x2B,
-	0x00, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32,
-	0x00, 0x00, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38,
-	0x00, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F
+// Indexed by the disk nibble itself; 0xff for the ones that can't be data
+const uint8_t DETRANS62[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x01,
+	0xff, 0xff, 0x02, 0x03, 0xff, 0x04, 0x05, 0x06,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x07, 0x08,
+	0xff, 0xff, 0xff, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+	0xff, 0xff, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+	0xff, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x1b, 0xff, 0x1c, 0x1d, 0x1e,
+	0xff, 0xff, 0xff, 0x1f, 0xff, 0xff, 0x20, 0x21,
+	0xff, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0x29, 0x2a, 0x2b,
+	0xff, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32,
+	0xff, 0xff, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38,
+	0xff, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
 };
 
 
+// the 2 low bits of a byte go in the auxiliary nibbles swapped around
+static const uint8_t SWAP2[4] = { 0, 2, 1, 3 };
+
+/*
+ * 6-and-2 encode a 256 byte sector into its 342 data nibbles + checksum.
+ * The auxiliary nibble j holds the low bits of bytes j, j + 0x56 and
+ * j + 0xac; every nibble is XORed with the previous 6 bit value as it goes
+ * out, so the last one is the checksum.
+ */
+void
+mii_floppy_encode_sector(
+		const uint8_t data[256],
+		uint8_t data_sector[342 + 1])
+{
+	uint8_t *dst = data_sector;
+	uint8_t last = 0;
+
+	for (int j = 0; j < 0x56; j++) {
+		// bytes 0x100/0x101 don't exist, 0 and 1 fill these (as DOS does)
+		uint8_t aux = SWAP2[data[j] & 3] |
+				(SWAP2[data[j + 0x56] & 3] << 2) |
+				(SWAP2[data[(j + 0xac) & 0xff] & 3] << 4);
+		*dst++ = TRANS62[aux ^ last];
+		last = aux;
+	}
+	for (int j = 0; j < 0x100; j++) {
+		uint8_t val = data[j] >> 2;
+		*dst++ = TRANS62[val ^ last];
+		last = val;
+	}
+	*dst = TRANS62[last];
+}
+
 /*
  * take a normalized nibble sector, and decode it to a 256 byte sector.
- * return 0 if the checksum is correct, -1 if not.
+ * return 0 if the checksum is correct and every nibble is a valid one,
+ * -1 if not.
  */
 int
 mii_floppy_decode_sector(
 		uint8_t data_sector[342 + 1],
 		uint8_t data[256])
 {
-	int res = 0;
-	uint8_t data2[0x56] = {};
-	uint8_t last = 0;
-	int val = 0;
-	uint8_t didx = 0;
-	uint8_t *src = data_sector;
-
-	for (int jdx = 0x55; jdx >= 0; jdx--) {
-		didx = *src++ - 0x80;
-		val = DETRANS62[didx] ^ last;
-		data2[jdx] = val;
-		last = val;
-	}
-	for (int jdx = 0; jdx < 0x100; jdx++) {
-		didx = *src++ - 0x80;
-		val = DETRANS62[didx] ^ last;
-		data[jdx] = val;
-		last = val;
+	uint8_t aux[0x56];
+	uint8_t last = 0, bad = 0;
+	const uint8_t *src = data_sector;
+
+	for (int j = 0; j < 0x56; j++) {
+		uint8_t val = DETRANS62[*src++];
+		bad |= val;		// bit 7 only comes from an invalid nibble
+		last ^= val;
+		aux[j] = last;
 	}
-	didx = *src++ - 0x80;
-	uint8_t checkSum = DETRANS62[didx] ^ last;
-	if (checkSum)
-		res = -1;
-	for (int kdx = 0, jdx = 0x55; kdx < 0x100; kdx++) {
-		data[kdx] <<= 1;
-		if ((data2[jdx] & 0x01) != 0) {
-			data[kdx] |= 0x01;
-		}
-		data2[jdx] >>= 1;
-		data[kdx] <<= 1;
-		if ((data2[jdx] & 0x01) != 0) {
-			data[kdx] |= 0x01;
+	// the auxiliary buffer is walked 3 times, 2 bits further each time
+	for (int j = 0, shift = 0; j < 0x100; shift += 2) {
+		for (int k = 0; k < 0x56 && j < 0x100; k++, j++) {
+			uint8_t val = DETRANS62[*src++];
+			bad |= val;
+			last ^= val;
+			data[j] = (last << 2) | SWAP2[(aux[k] >> shift) & 3];
 		}
-		data2[jdx] >>= 1;
-		if (--jdx < 0)
-			jdx = 0x55;
 	}
-	return res;
+	uint8_t val = DETRANS62[*src];
+	bad |= val;
+	last ^= val;
+	return (last || (bad & 0x80)) ? -1 : 0;
 }
 
 // This function is derived from Scullin Steel Co.'s apple2js code
@@ -141,70 +177,57 @@ mii_floppy_dsk_render_sector(
         uint8_t *track_data            // destination bitstream buffer
 ) {
     unsigned int gap;
+    mii_floppy_cursor_t c;
+
+    mii_floppy_cursor_write_init(&c, dst, track_data);
 
     // Gap before address field
     gap = (sector == 0) ? 100 : 20;
 
     for (uint8_t i = 0; i < gap; ++i)
-        mii_floppy_write_track_bits(dst, track_data, 0xFF << 2, 10);
+        mii_floppy_cursor_write(&c, 0xFF << 2, 10);
 
     /* -------- Address Field -------- */
     const uint8_t checksum = vol ^ track ^ sector;
 
-    mii_floppy_write_track_bits(dst, track_data, 0xD5AA96, 24);
+    mii_floppy_cursor_write(&c, 0xD5AA96, 24);
 
-    mii_floppy_write_track_bits(dst, track_data, (vol >> 1)    | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data,  vol           | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data, (track >> 1)  | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data,  track         | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data, (sector >> 1) | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data,  sector        | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data, (checksum >> 1) | 0xAA, 8);
-    mii_floppy_write_track_bits(dst, track_data,  checksum       | 0xAA, 8);
+    mii_floppy_cursor_write(&c, (vol >> 1)    | 0xAA, 8);
+    mii_floppy_cursor_write(&c,  vol           | 0xAA, 8);
+    mii_floppy_cursor_write(&c, (track >> 1)  | 0xAA, 8);
+    mii_floppy_cursor_write(&c,  track         | 0xAA, 8);
+    mii_floppy_cursor_write(&c, (sector >> 1) | 0xAA, 8);
+    mii_floppy_cursor_write(&c,  sector        | 0xAA, 8);
+    mii_floppy_cursor_write(&c, (checksum >> 1) | 0xAA, 8);
+    mii_floppy_cursor_write(&c,  checksum       | 0xAA, 8);
 
-    mii_floppy_write_track_bits(dst, track_data, 0xDEAAEB, 24);
+    mii_floppy_cursor_write(&c, 0xDEAAEB, 24);
 
     /* -------- Gap 2 -------- */
     for (int i = 0; i < 5; ++i)
-        mii_floppy_write_track_bits(dst, track_data, 0xFF << 2, 10);
+        mii_floppy_cursor_write(&c, 0xFF << 2, 10);
 
     // 48 bits sync to keep byte alignment
-    mii_floppy_write_track_bits(dst, track_data, 0xFF, 8);
+    mii_floppy_cursor_write(&c, 0xFF, 8);
 
     /* -------- Data Field -------- */
-    mii_floppy_write_track_bits(dst, track_data, 0xD5AAAD, 24);
-
-    uint8_t nibbles[0x158] = {0};
-    const unsigned ptr2 = 0;
-    const unsigned ptr6 = 0x56;
-
-    int i2 = 0x55;
-    for (int i6 = 0x101; i6 >= 0; --i6) {
-        uint8_t val6 = data[i6 & 0xFF];
-        uint8_t val2 = nibbles[ptr2 + i2];
-
-        val2 = (val2 << 1) | (val6 & 1); val6 >>= 1;
-        val2 = (val2 << 1) | (val6 & 1); val6 >>= 1;
-
-        nibbles[ptr6 + i6] = val6;
-        nibbles[ptr2 + i2] = val2;
-
-        if (--i2 < 0)
-            i2 = 0x55;
-    }
+    mii_floppy_cursor_write(&c, 0xD5AAAD, 24);
 
-    uint8_t last = 0;
-    for (int i = 0; i < 342; ++i) {
-        const uint8_t val = nibbles[i];
-        mii_floppy_write_track_bits(dst, track_data, TRANS62[last ^ val], 8);
-        last = val;
-    }
+    uint8_t nibbles[342 + 1];
+    mii_floppy_encode_sector(data, nibbles);
 
-    mii_floppy_write_track_bits(dst, track_data, TRANS62[last], 8);
-    mii_floppy_write_track_bits(dst, track_data, 0xDEAAEB, 24);
+    // 4 nibbles per cursor write, then the odd 3
+    int i = 0;
+    for (; i + 4 <= 342 + 1; i += 4)
+        mii_floppy_cursor_write(&c, ((uint32_t)nibbles[i] << 24) |
+                (nibbles[i + 1] << 16) | (nibbles[i + 2] << 8) | nibbles[i + 3], 32);
+    for (; i < 342 + 1; i++)
+        mii_floppy_cursor_write(&c, nibbles[i], 8);
+    mii_floppy_cursor_write(&c, 0xDEAAEB, 24);
 
     /* -------- Gap 3 -------- */
-    mii_floppy_write_track_bits(dst, track_data, 0xFF << 2, 10);
+    mii_floppy_cursor_write(&c, 0xFF << 2, 10);
+    mii_floppy_cursor_flush(&c, dst);
 }
 
 void
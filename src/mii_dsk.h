@@ -34,6 +34,12 @@ _mii_floppy_dsk_write_sector(
 		uint8_t track_id,
 		uint8_t sector,
 		uint8_t data_sector[342 + 1] );
+// 6-and-2 encode a sector to its 342 data nibbles plus the checksum one
+void
+mii_floppy_encode_sector(
+		const uint8_t data[256],
+		uint8_t data_sector[342 + 1]);
+// returns -1 on a bad checksum, or a nibble that isn't a 6-and-2 one
 int
 mii_floppy_decode_sector(
 		uint8_t data_sector[342 + 1],
@@ -7,6 +7,12 @@
  *
  * This is a driver for these eprom/flash cards from
  * Terence J. Boldt and the likes
+ *
+ * On RP2350 the card contents are a disk image linked into its own
+ * flash section (see mii_romdisk.S) and read in place through XIP, there
+ * is no copy to SRAM or PSRAM. If the image carries the card firmware
+ * (at offset $300) it is used as is, otherwise the card gets a trap
+ * based ProDOS block driver that reads the same storage.
  */
 #define _GNU_SOURCE // for asprintf
 #include <errno.h>
@@ -16,28 +22,109 @@
 #include <stdlib.h>
 
 #include <fcntl.h>
+#if !MII_RP2350
 #include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "mii.h"
 #include "mii_bank.h"
+#include "debug_log.h"
+
+#if MII_RP2350
+// from mii_romdisk.S, in the .romdisk flash section
+extern const uint8_t mii_romdisk_start[];
+extern const uint8_t mii_romdisk_end[];
+
+static mii_rom_t _mii_rom_epromcard = {
+	.name = "epromcard",
+	.class = "card",
+	.description = "Flash ROM disk image",
+	.rom = mii_romdisk_start,
+};
+MII_ROM(_mii_rom_epromcard);
+#endif
 
 typedef struct mii_card_ee_t {
 	mii_dd_t 	drive[1];
 	uint8_t * 	file;
+	uint32_t	size;
 	uint16_t  	latch;
+#if MII_RP2350
+	mii_dd_file_t	dd_file;	// flash mapped file for the block driver
+#endif
 } mii_card_ee_t;
 
+#if MII_RP2350
+/*
+ * ProDOS block driver entry point, the card ROM is the generic
+ * SmartPort one, with the SmartPort signature removed.
+ */
+static void
+_mii_ee_block_callback(
+		mii_t *mii,
+		uint8_t trap)
+{
+	int sid = ((mii->cpu.PC >> 8) & 0xf) - 1;
+	mii_card_ee_t *c = mii->slot[sid].drv_priv;
+
+	uint8_t command 	= mii_read_one(mii, 0x42);
+	uint16_t buffer 	= mii_read_word(mii, 0x44);
+	uint16_t blk 		= mii_read_word(mii, 0x46);
+	uint32_t nblocks 	= c->size / 512;
+
+	mii->cpu.P.C = 1;
+	switch (command) {
+		case 0: // get status
+			mii->cpu.X = nblocks & 0xff;
+			mii->cpu.Y = nblocks >> 8;
+			mii->cpu.A = 0;
+			mii->cpu.P.C = 0;
+			break;
+		case 1: { // read block
+			if (blk >= nblocks) {
+				mii->cpu.A = 0x27;	// I/O error
+				break;
+			}
+			mii_bank_t * bank = &mii->bank[mii->mem[buffer >> 8].write];
+			mii->cpu.P.C = mii_dd_read(
+							&c->drive[0], bank, buffer, blk, 1) != 0;
+			mii->cpu.A = mii->cpu.P.C ? 0x27 : 0;
+			// if Prodos is reading a block that happens to be video memory,
+			// make sure the video driver knows about it
+			mii_video_OOB_write_check(mii, buffer, 512);
+		}	break;
+		default:	// write, format
+			mii->cpu.A = 0x2b;	// write protected
+			break;
+	}
+}
+
+/*
+ * Card firmware is recognized by the ProDOS block device signature
+ */
+static bool
+_mii_ee_has_firmware(
+		const uint8_t *fw)
+{
+	return fw[1] == 0x20 && fw[3] == 0x00 && fw[5] == 0x03;
+}
+#endif
 
 static int
 _mii_ee_init(
 		mii_t * mii,
 		struct mii_slot_t *slot )
 {
+#if MII_RP2350
+	static mii_card_ee_t _c = { 0 };
+	mii_card_ee_t *c = &_c;
+#else
 	mii_card_ee_t *c = calloc(1, sizeof(*c));
+#endif
 
 	slot->drv_priv = c;
-	printf("%s loading in slot %d\n", __func__, slot->id + 1);
+	MII_DEBUG_PRINTF("%s loading in slot %d\n", __func__, slot->id + 1);
 
 	for (int i = 0; i < 1; i++) {
 		mii_dd_t *dd = &c->drive[i];
@@ -52,7 +139,12 @@ _mii_ee_init(
 
 #if 1
 	mii_rom_t *rom = mii_rom_get("epromcard");
-	c->file = (uint8_t*)rom->rom;
+	c->file = rom ? (uint8_t*)rom->rom : NULL;
+#if MII_RP2350
+	c->size = mii_romdisk_end - mii_romdisk_start;
+#else
+	c->size = rom ? rom->len : 0;
+#endif
 #else
 	const char *fname = "disks/GamesWithFirmware.po";
 
@@ -60,15 +152,52 @@ _mii_ee_init(
 	mii_dd_drive_load(&c->drive[0], file);
 	c->file = file->map;
 #endif
-	if (c->file) {
-		uint16_t addr = 0xc100 + (slot->id * 0x100);
+	if (!c->file || c->size < 0x400)
+		return 0;
+	uint16_t addr = 0xc100 + (slot->id * 0x100);
+#if MII_RP2350
+	c->dd_file = (mii_dd_file_t) {
+		.pathname = "romdisk",
+		.size = c->size,
+		.format = MII_DD_FILE_ROM,
+		.read_only = 1,
+		.map = c->file,
+	};
+	mii_dd_drive_load(&c->drive[0], &c->dd_file);
+	if (!_mii_ee_has_firmware(c->file + 0x300)) {
+		mii_rom_t *sm = mii_rom_get("smartport");
+		if (!sm)
+			return -1;
+		uint8_t trap = mii_register_trap(mii, _mii_ee_block_callback);
 		mii_bank_write(
 				&mii->bank[MII_BANK_CARD_ROM],
-				addr, c->file + 0x300, 256);
+				addr, sm->rom, 256);
+		mii_bank_write(
+				&mii->bank[MII_BANK_CARD_ROM],
+				addr + 0xd2, &trap, 1);
+		// Not a SmartPort, one read only volume
+		static const uint8_t sig = 0x3c, status = 0x03;
+		mii_bank_write(
+				&mii->bank[MII_BANK_CARD_ROM],
+				addr + 0x07, &sig, 1);
+		mii_bank_write(
+				&mii->bank[MII_BANK_CARD_ROM],
+				addr + 0xfe, &status, 1);
+		MII_DEBUG_PRINTF("%s %u blocks, block driver\n", __func__,
+				(unsigned)(c->size / 512));
+		return 0;
 	}
+#endif
+	mii_bank_write(
+			&mii->bank[MII_BANK_CARD_ROM],
+			addr, c->file + 0x300, 256);
 	return 0;
 }
 
+/*
+ * Pages the image through a 16 bytes window at $C0n0-$C0nF; the latch
+ * picks which 16 bytes. On RP2350 this reads straight from XIP flash.
+ */
 static uint8_t
 _mii_ee_access(
 	mii_t * mii, struct mii_slot_t *slot,
@@ -89,7 +218,8 @@ _mii_ee_access(
 				break;
 		}
 	} else {
-		return c->file ? c->file[(c->latch << 4) + psw] : 0xff;
+		uint32_t off = ((uint32_t)c->latch << 4) + psw;
+		return c->file && off < c->size ? c->file[off] : 0xff;
 	}
 	return 0;
 }
@@ -110,6 +240,7 @@ _mii_ee_command(
 				res = 0;
 			}
 			break;
+#if !MII_RP2350
 		case MII_SLOT_DRIVE_LOAD: {
 			const char *filename = param;
 			mii_dd_file_t *file = NULL;
@@ -121,8 +252,10 @@ _mii_ee_command(
 			mii_dd_drive_load(&c->drive[0], file);
 			mii_rom_t *rom = mii_rom_get("epromcard");
 			c->file = file ? file->map : (uint8_t*)rom->rom;
+			c->size = file ? file->size : rom->len;
 			res = 0;
 		}	break;
+#endif
 	}
 	return res;
 }
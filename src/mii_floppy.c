@@ -56,8 +56,7 @@ mii_floppy_init(
 	f->motor 		= 0;
 	f->stepper 		= 0;
 	// see spec for this.. 32 is the default for 4us.
-
-	f->bit_timing 	= 32;
+	f->bit_timing 	= MII_FLOPPY_BIT_TIMING;
 	f->qtrack 		= 15;	// just to see something at seek time
 	f->bit_position = 0;
 	f->seed_dirty = f->seed_saved = 0;
@@ -66,9 +65,11 @@ mii_floppy_init(
 		0: 0   1: 0   2:35   3: 1
 		4: 1   5: 1   6:35   7: 2
 		8: 2   9: 2  10:35  11: 3
+	   and so is everything past track 34
 	*/
 	for (int i = 0; i < (int)sizeof(f->track_id); ++i) {
-		f->track_id[i] = ((i + 1) % 4) == 3 ?
+		f->track_id[i] = ((i + 1) % 4) == 3 ||
+								(i + 2) / 4 >= MII_FLOPPY_TRACK_COUNT ?
 								MII_FLOPPY_NOISE_TRACK : ((i + 2) / 4);
 	}
 	// important, the +1 means we initialize the random track too
@@ -91,15 +92,16 @@ mii_floppy_write_track_bits(
 		uint32_t bits,
 		uint8_t count )
 {
-	while (count--) {
-		uint32_t 	byte_index 	= dst->bit_count >> 3;
-		uint8_t 	bit_index 	= 7 - (dst->bit_count & 7);
-		track_data[byte_index] &= ~(1 << bit_index);
-		track_data[byte_index] |= !!(bits & (1L << (count))) << bit_index;
-		dst->bit_count++;
-	}
+	mii_floppy_cursor_t c;
+	mii_floppy_cursor_write_init(&c, dst, track_data);
+	mii_floppy_cursor_write(&c, bits, count);
+	mii_floppy_cursor_flush(&c, dst);
 }
 
+/*
+ * One off read, anything reading more than a couple of fields in a row
+ * should keep a mii_floppy_cursor_t instead.
+ */
 uint32_t
 mii_floppy_read_track_bits(
 	mii_floppy_track_t * src,
@@ -107,38 +109,11 @@ mii_floppy_read_track_bits(
 	uint32_t pos,
 	uint8_t count )
 {
-	uint32_t bits = 0;
-	// align on 8 bits boudary
-	while (count && (pos & 7) != 0) {
-		pos = pos % src->bit_count;
-		uint32_t 	byte_index 	= pos >> 3;
-		uint8_t 	bit_index 	= 7 - (pos & 7);
-		bits <<= 1;
-		bits |= !!(track_data[byte_index] & (1 << bit_index));
-		// we CAN have a wrap around here, but it's ok
-		pos++;
-		count--;
-	}
-	// now we can read 8 bits at a time
-	while (count >= 8) {
-		pos = pos % src->bit_count;
-		uint32_t 	byte_index 	= pos >> 3;
-		bits = (bits << 8) | track_data[byte_index];
-		pos += 8;
-		count -= 8;
-	}
-	// get any remaining bits
-	while (count) {
-		pos = pos % src->bit_count;
-		uint32_t 	byte_index 	= pos >> 3;
-		uint8_t 	bit_index 	= 7 - (pos & 7);
-		bits <<= 1;
-		bits |= !!(track_data[byte_index] & (1 << bit_index));
-		// we CAN have a wrap around here, but it's ok
-		pos++;
-		count--;
-	}
-	return bits;
+	if (!count)
+		return 0;
+	mii_floppy_cursor_t c;
+	mii_floppy_cursor_read_init(&c, src, track_data, pos);
+	return mii_floppy_cursor_read(&c, count);
 }
 
 /*
@@ -158,23 +133,27 @@ mii_floppy_realign_sector_map(
 {
 	// now it is entirely possible that the sector has moved a bit,
 	// at least prodos does that, so we need to re-find it.
-	uint32_t win = mii_floppy_read_track_bits(
-						track, track_data, map->sector[sector].data, 24);
+	mii_floppy_cursor_t c;
+	mii_floppy_cursor_read_init(&c, track, track_data, map->sector[sector].data);
+	uint32_t win = mii_floppy_cursor_read(&c, 24);
 	if (win != 0xd5aaad) {
 //			printf("%s: track %2d sector %2d has moved %08x\n",
 //					__func__, track_id, i,
 //					mii_floppy_read_track_bits(track, track_data, map->sector[sector]].data, 24));
 
 		uint32_t pos = map->sector[sector].data;
-		win = mii_floppy_read_track_bits(
-						track, track_data, pos - 24, 24);
+		// back 24 bits, then slide forward one bit at a time
+		mii_floppy_cursor_read_init(&c, track, track_data,
+				pos >= 24 ? pos - 24 : pos + track->bit_count - 24);
+		win = mii_floppy_cursor_read(&c, 24);
 		for (int j = 0; j < 100; j++) {
-			win = (win << 1) | mii_floppy_read_track_bits(track, track_data, pos, 1);
+			win = (win << 1) | mii_floppy_cursor_read(&c, 1);
 			win &= 0xffffff;
 			if (win == 0xd5aaad) {
 		//		printf("%s: track %2d sector %2d found at %d (was %d)\n",
 		//				__func__, track_id, i, pos, map->sector[sector].data);
-				map->sector[sector].data = pos - 23;
+				map->sector[sector].data =
+						(pos + track->bit_count - 23) % track->bit_count;
 				break;
 			}
 			pos++;
@@ -199,15 +178,16 @@ mii_floppy_read_sector_nibbles(
 {
 	// if the data is not byte aligned, we have to
 	// read the whole lot, this will align it to 8 bits
-	int j = 0, bit = map->sector[sector].data + (3 * 8), errors = 0;
+	int j = 0, errors = 0;
+	mii_floppy_cursor_t c;
+	mii_floppy_cursor_read_init(&c, track, track_data,
+			map->sector[sector].data + (3 * 8));
 	while (j < 342 + 1) {
-		uint8_t b = mii_floppy_read_track_bits(track, track_data, bit, 8);
-		while (!(b & 0x80)) {
+		uint8_t b = mii_floppy_cursor_read(&c, 8);
+		while (!(b & 0x80)) {	// slide by one bit
 			errors++;
-			bit++;
-			b = mii_floppy_read_track_bits(track, track_data, bit, 8);
+			b = (b << 1) | mii_floppy_cursor_read(&c, 1);
 		}
-		bit += 8;
 		data_sector[j++] = b;
 	}
 	return errors;
@@ -251,36 +231,44 @@ mii_floppy_find_next_sync(
 	/* get one bit at a time until we get one sync word */
 	uint32_t wi = 0;
 	uint32_t pos = *io_pos;
+	// 'c' follows pos, 'l' looks ahead at pos + wi
+	mii_floppy_cursor_t c, l;
+	mii_floppy_cursor_read_init(&c, src, track_data, pos);
 	// give up after 2000 bits really, it's either there, or not
 	// otherwise we could be 'fooled' looping over the whole track
 	int tries = 10000;
 	do {
 		do {
-			window = (window << 1) |
-							mii_floppy_read_track_bits(src, track_data, pos, 1);
+			window = (window << 1) | mii_floppy_cursor_read(&c, 1);
 			pos++;
 			if ((window & 0x3ff) == 0b1111111100)
 				break;
 		} while (tries-- > 0 );
 		wi = 10;
-		if (mii_floppy_read_track_bits(src, track_data, pos, 1) == 0) {
+		if (mii_floppy_cursor_peek(&c, 1) == 0) {
+			mii_floppy_cursor_skip(&c, 1);
 			pos++;
 			wi++;
 		}
+		l = c;
+		mii_floppy_cursor_skip(&l, wi);
 		do {
-			uint16_t w = mii_floppy_read_track_bits(src, track_data, pos + wi, 9);
-			if (w == 0b111111110)
+			uint16_t w = mii_floppy_cursor_peek(&l, 9);
+			if (w == 0b111111110) {
 				wi += 9;
-			else if ((w & 0b111111110) == 0b111111110) {
+				mii_floppy_cursor_skip(&l, 9);
+			} else if ((w & 0b111111110) == 0b111111110) {
 				wi += 8;
 				break;
 			}
-			if (mii_floppy_read_track_bits(src, track_data, pos + wi, 1) == 0) {
+			if (mii_floppy_cursor_peek(&l, 1) == 0) {
 				wi++;
+				mii_floppy_cursor_skip(&l, 1);
 			} else
 				break;
-			if (mii_floppy_read_track_bits(src, track_data, pos + wi, 1) == 0) {
+			if (mii_floppy_cursor_peek(&l, 1) == 0) {
 				wi++;
+				mii_floppy_cursor_skip(&l, 1);
 			}
 		} while (tries-- > 0 &&  wi < 2000);
 		/* if this is a sector header, we're in sync here! */
@@ -321,7 +309,9 @@ mii_floppy_map_track(
 	int pass = 0;
 	do {
 		wi = mii_floppy_find_next_sync(src, track_data, &pos);
-		uint32_t header = mii_floppy_read_track_bits(src, track_data, pos, 24);
+		mii_floppy_cursor_t c;
+		mii_floppy_cursor_read_init(&c, src, track_data, pos);
+		uint32_t header = mii_floppy_cursor_read(&c, 24);
 		if (wi == 0) {
 			printf("T%2d pos:%5d hmap:%04x dmap:%04x done?\n",
 					track_id, pos, hmap, dmap);
@@ -353,10 +343,8 @@ mii_floppy_map_track(
 				track_id, wi, pos, src->bit_count, header);
 		uint8_t hb[8];
 		for (int hi = 0; hi < 8; hi++)
-			hb[hi] = mii_floppy_read_track_bits(src, track_data,
-						pos + 24 + (hi * 8), 8);
-		uint32_t tailer = mii_floppy_read_track_bits(src, track_data,
-						pos + 24 + (8 * 8), 20);
+			hb[hi] = mii_floppy_cursor_read(&c, 8);
+		uint32_t tailer = mii_floppy_cursor_read(&c, 20);
 		uint8_t vol 	= DE44(hb[0], hb[1]);
 		uint8_t track 	= DE44(hb[2], hb[3]);
 		uint8_t sector 	= DE44(hb[4], hb[5]);
@@ -465,12 +453,14 @@ mii_floppy_resync_track(
 
 	mii_floppy_track_t new = {.dirty = 1, .virgin = 0, .bit_count = 0};
 	uint8_t *new_track = malloc(6656);
-	while (new.bit_count < src->bit_count)	{
-		int cnt = src->bit_count - new.bit_count > 32 ? 32 : src->bit_count - new.bit_count;
-		uint32_t bits = mii_floppy_read_track_bits(src, track_data, pos, cnt);
-		mii_floppy_write_track_bits(&new, new_track, bits, cnt);
-		pos += cnt;
+	mii_floppy_cursor_t rd, wr;
+	mii_floppy_cursor_read_init(&rd, src, track_data, pos);
+	mii_floppy_cursor_write_init(&wr, &new, new_track);
+	for (uint32_t done = 0; done < src->bit_count; done += 32) {
+		int cnt = src->bit_count - done > 32 ? 32 : src->bit_count - done;
+		mii_floppy_cursor_write(&wr, mii_floppy_cursor_read(&rd, cnt), cnt);
 	}
+	mii_floppy_cursor_flush(&wr, &new);
 //		printf("%s: Track %2d has been resynced!\n", __func__, track_id);
 	memcpy(track_data, new_track, MII_FLOPPY_MAX_TRACK_SIZE);
 	free(new_track);
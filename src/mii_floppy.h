@@ -9,11 +9,14 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include "mii_dd.h"
 
 #define MII_FLOPPY_MAX_TRACK_SIZE		6656
 extern uint8_t track_buf[MII_FLOPPY_MAX_TRACK_SIZE]; // avoids malloc
 #define MII_FLOPPY_TRACK_COUNT			35
+// head positions, 40 tracks in quarter steps, the WOZ TMAP range
+#define MII_FLOPPY_QTRACK_COUNT			160
 
 
 #define DE44(a, b) 	((((a) & 0x55) << 1) | ((b) & 0x55))
@@ -77,7 +80,7 @@ typedef struct mii_floppy_t {
 	uint8_t 			write_protected : 3;
 	uint8_t				id : 2;
 
-	uint8_t 			bit_timing;		// 0=32 (default) 				// offset 1
+	uint8_t 			bit_timing;		// bit cell, 125ns units 		// offset 1
 	uint8_t				motor;			// motor is on 					// 2
 	uint8_t 			stepper;		// last step we did... 			// 3
 	uint8_t 			qtrack;			// quarter track we are on 		// 4
@@ -91,7 +94,7 @@ typedef struct mii_floppy_t {
 	// used when deciding wether to save to disk (or update texture)
 	uint32_t 			seed_dirty;										// 20
 	uint32_t			seed_saved;		// last seed we saved at		// 24
-	uint8_t 			track_id[MII_FLOPPY_TRACK_COUNT * 4];			// 28
+	uint8_t 			track_id[MII_FLOPPY_QTRACK_COUNT];				// 28
 	mii_floppy_track_t 	tracks[MII_FLOPPY_TRACK_COUNT + 1];
 	// only one active binary track per drive
 	uint8_t 			curr_track_data[MII_FLOPPY_MAX_TRACK_SIZE];
@@ -104,6 +107,158 @@ typedef struct mii_floppy_t {
 _Static_assert(offsetof(mii_floppy_t, bit_position) == 8, "ABI mismatch");
 _Static_assert(offsetof(mii_floppy_t, random) == 16, "ABI mismatch");
 
+/*
+ * Bit cursor over a track bitstream, MSB first. Reading keeps up to 64 bits
+ * in 'win' and only goes back to the track data when it runs low, a byte
+ * (or 4) at a time; the wrap at 'bit_count' is a compare per refill, not a
+ * modulo per bit. Writing shifts the bits into 'win' and stores whole bytes,
+ * the partial last byte is merged in by mii_floppy_cursor_flush().
+ * A cursor is either for reading or for writing, not both.
+ */
+typedef struct mii_floppy_cursor_t {
+	uint8_t *			data;
+	uint32_t			bit_count;	// track length, reading wraps there
+	uint32_t			next;		// read: next bit to load, write: next byte
+	uint64_t			win;
+	uint8_t				n;			// valid bits in win
+} mii_floppy_cursor_t;
+
+static inline void
+mii_floppy_cursor_read_init(
+		mii_floppy_cursor_t *c,
+		const mii_floppy_track_t *track,
+		const uint8_t *track_data,
+		uint32_t pos )
+{
+	c->data = (uint8_t *)track_data;
+	c->bit_count = track->bit_count;
+	c->next = pos < c->bit_count ? pos : pos % c->bit_count;
+	c->win = 0;
+	c->n = 0;
+}
+
+static inline void
+mii_floppy_cursor_refill(
+		mii_floppy_cursor_t *c )
+{
+	while (c->n <= 56) {
+		uint32_t next = c->next;
+		if (!(next & 7) && next + 32 <= c->bit_count && c->n <= 32) {
+			const uint8_t *d = c->data + (next >> 3);
+			c->win = (c->win << 32) | ((uint32_t)d[0] << 24) |
+					((uint32_t)d[1] << 16) | ((uint32_t)d[2] << 8) | d[3];
+			c->n += 32;
+			next += 32;
+		} else if (!(next & 7) && next + 8 <= c->bit_count) {
+			c->win = (c->win << 8) | c->data[next >> 3];
+			c->n += 8;
+			next += 8;
+		} else {	// unaligned, or the last bits before the wrap
+			c->win = (c->win << 1) |
+					((c->data[next >> 3] >> (7 - (next & 7))) & 1);
+			c->n++;
+			next++;
+		}
+		c->next = next == c->bit_count ? 0 : next;
+	}
+}
+
+/* up to 32 bits, without moving the cursor */
+static inline uint32_t
+mii_floppy_cursor_peek(
+		mii_floppy_cursor_t *c,
+		uint8_t count )
+{
+	if (c->n < count)
+		mii_floppy_cursor_refill(c);
+	return (c->win >> (c->n - count)) & (0xffffffffu >> (32 - count));
+}
+
+static inline void
+mii_floppy_cursor_skip(
+		mii_floppy_cursor_t *c,
+		uint32_t count )
+{
+	while (count > 32) {
+		mii_floppy_cursor_peek(c, 32);
+		c->n -= 32;
+		count -= 32;
+	}
+	if (c->n < count)
+		mii_floppy_cursor_refill(c);
+	c->n -= count;
+}
+
+static inline uint32_t
+mii_floppy_cursor_read(
+		mii_floppy_cursor_t *c,
+		uint8_t count )
+{
+	uint32_t bits = mii_floppy_cursor_peek(c, count);
+	c->n -= count;
+	return bits;
+}
+
+/* Appends at the end of 'track' (its bit_count) */
+static inline void
+mii_floppy_cursor_write_init(
+		mii_floppy_cursor_t *c,
+		const mii_floppy_track_t *track,
+		uint8_t *track_data )
+{
+	c->data = track_data;
+	c->next = track->bit_count >> 3;
+	c->n = track->bit_count & 7;
+	// keep the bits already there in the first byte
+	c->win = c->n ? track_data[c->next] >> (8 - c->n) : 0;
+}
+
+static inline void
+mii_floppy_cursor_write(
+		mii_floppy_cursor_t *c,
+		uint32_t bits,
+		uint8_t count )
+{
+	c->win = (c->win << count) | (bits & (0xffffffffu >> (32 - count)));
+	c->n += count;
+	while (c->n >= 8) {
+		c->n -= 8;
+		c->data[c->next++] = c->win >> c->n;
+	}
+}
+
+/* Stores the last partial byte, updates the track length */
+static inline void
+mii_floppy_cursor_flush(
+		mii_floppy_cursor_t *c,
+		mii_floppy_track_t *track )
+{
+	if (c->n) {
+		uint8_t keep = 0xff >> c->n;
+		c->data[c->next] = (c->data[c->next] & keep) |
+				((c->win << (8 - c->n)) & ~keep);
+	}
+	track->bit_count = (c->next << 3) + c->n;
+}
+
+/*
+ * Bit cell length, in 125ns units like the WOZ 'optimal bit timing': 32 is
+ * 4us, copy protected disks go a few units either way. The LSS adds 4
+ * (0.5us) per tick to a per-drive accumulator and moves the head one bit
+ * each time it gets past bit_timing, so any value costs the same.
+ * The Disk II sequencer only reads 26..36 (3.25us..4.5us) right, anything
+ * out of 24..40 is taken for a bad header; 3.5" disks (16, 2us) need an
+ * IWM, not this card.
+ */
+#define MII_FLOPPY_BIT_TIMING	32
+
+static inline uint8_t
+mii_floppy_bit_timing(
+		uint8_t timing )
+{
+	return timing >= 24 && timing <= 40 ? timing : MII_FLOPPY_BIT_TIMING;
+}
+
 /*
  * Initialize a floppy structure with random data. It is not formatted,
  * just ready to use for loading a disk image, or formatting as a
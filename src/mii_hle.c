@@ -0,0 +1,292 @@
+/*
+ * mii_hle.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The entry points themselves (SCROLL $FC70, HOME $FC58, CLREOP, COUT)
+ * are not replaced: on the enhanced ROM they dispatch into the internal
+ * $C100-$CFFF firmware, which keeps its state in the screen holes and
+ * handles 40 and 80 columns, windows and inverse. What they spend their
+ * time in is a handful of tight loops, so these are what gets trapped:
+ *
+ * $FCAA	SBC #1; BNE $FCAA				WAIT inner loop
+ * $C13F	LDA ($28),Y; STA ($2A),Y; DEY; BPL	scroll, 40 cols
+ * $CC59	LDA ($28),Y; STA ($2A),Y; DEY; BPL	scroll, 80 cols main
+ * $CC45	LDA ($28),Y; STA ($2A),Y; DEY; BNE	scroll, 80 cols aux
+ * $CCA8	STA ($28),Y; INY; CPY $21; BCC	clear to end of line
+ *
+ * The first 3 bytes of each loop are replaced with the trap sequence,
+ * nothing else ever jumps into them. A handler runs the loop to the end
+ * (or for one iteration if an IRQ is pending, so it is taken where it
+ * would have been) and leaves A, Y, the flags and PC where the 65C02
+ * would have. The trap itself costs 2 cycles (the EB NOP and the FB
+ * fetch) which stand for the first 2 cycles of the loop, the rest is
+ * added to total_cycle, so the guest timing is unchanged.
+ *
+ * Note the ROM checksum of the built-in self test won't match with
+ * this enabled.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mii.h"
+#include "mii_bank.h"
+#include "mii_hle.h"
+#include "debug_log.h"
+
+#define MII_HLE_TRAP_CYCLES	2
+// WAIT inner loop iterations per trap, it always ends well before that
+#define MII_HLE_WAIT_MAX	512
+
+static uint8_t _mii_hle_rom[16 * 1024];
+
+/*
+ * Same as the CPU access path; RAM and ROM directly through the page
+ * table, anything in $C000-$CFFF goes through the soft switch handlers.
+ */
+static inline uint8_t
+_mii_hle_peek(
+		mii_t *mii,
+		uint16_t addr)
+{
+	uint8_t page = addr >> 8;
+	uint8_t d = 0;
+	if (unlikely(page >= 0xc0 && page <= 0xcf)) {
+		mii_mem_access(mii, addr, &d, false, true);
+		return d;
+	}
+	return mii_bank_peek(&mii->bank[mii->mem[page].read], addr);
+}
+
+static inline void
+_mii_hle_poke(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t d)
+{
+	uint8_t page = addr >> 8;
+	if (unlikely(page >= 0xc0 && page <= 0xcf)) {
+		mii_mem_access(mii, addr, &d, true, true);
+		return;
+	}
+	mii_bank_t *b = &mii->bank[mii->mem[page].write];
+	if (likely(!b->ro))
+		mii_bank_poke(b, addr, d);
+}
+
+static inline uint16_t
+_mii_hle_peek_word(
+		mii_t *mii,
+		uint16_t addr)
+{
+	return _mii_hle_peek(mii, addr) | (_mii_hle_peek(mii, addr + 1) << 8);
+}
+
+/* If an IRQ is going to be taken, only run one iteration of the loop */
+static inline int
+_mii_hle_budget(
+		mii_t *mii,
+		int max)
+{
+	return mii->irq.raised && !mii->cpu.P.I ? 1 : max;
+}
+
+/*
+ * 'cycles' is what the loop took, with every branch taken. If the loop
+ * ended, the last branch wasn't and we carry on after it, otherwise we
+ * go back to the trap for the next batch.
+ */
+static inline void
+_mii_hle_done(
+		mii_t *mii,
+		uint32_t cycles,
+		bool more,
+		uint16_t head,
+		uint16_t exit)
+{
+	if (more)
+		mii->cpu.PC = head;
+	else {
+		mii->cpu.PC = exit;
+		cycles--;
+	}
+	mii->cpu.total_cycle += cycles - MII_HLE_TRAP_CYCLES;
+}
+
+/*
+ * $FCAA: SBC #1; BNE $FCAA -- 5 cycles per iteration. This is verbatim
+ * the core's SBC, decimal mode included.
+ */
+static void
+_mii_hle_wait(
+		mii_t *mii,
+		uint8_t trap)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	int max = _mii_hle_budget(mii, MII_HLE_WAIT_MAX);
+	uint32_t cycles = 0;
+	do {
+		if (unlikely(cpu->P.D)) {
+			uint8_t D = 0x99 - 1;
+			uint8_t lo = (cpu->A & 0x0f) + (D & 0x0f) + !!cpu->P.C;
+			if (lo > 9) lo += 6;
+			uint8_t hi = (cpu->A >> 4) + (D >> 4) + (lo > 0x0f);
+			cpu->P.Z = ((uint8_t)(cpu->A + D + cpu->P.C)) == 0;
+			cpu->P.V = !!((!((cpu->A ^ D) & 0x80) &&
+							((cpu->A ^ (hi << 4))) & 0x80));
+			if (hi > 9) hi += 6;
+			cpu->P.C = hi > 15;
+			cpu->A = (hi << 4) | (lo & 0x0f);
+			cpu->P.N = !!(cpu->A & 0x80);
+		} else {
+			uint16_t sum = cpu->A + 0xfe + !!cpu->P.C;
+			cpu->P.V = !!(~(cpu->A ^ 0xfe) & (cpu->A ^ sum) & 0x80);
+			cpu->P.N = !!(sum & 0x80);
+			cpu->P.Z = (sum & 0xff) == 0;
+			cpu->P.C = !!(sum & 0xff00);
+			cpu->A = sum;
+		}
+		cpu->cpu_D = 0xfe;
+		cycles += 5;
+	} while (!cpu->P.Z && --max);
+	_mii_hle_done(mii, cycles, !cpu->P.Z, 0xfcaa, 0xfcae);
+}
+
+/*
+ * LDA ($28),Y; STA ($2A),Y; DEY; Bxx -- 16 cycles per iteration, 17 when
+ * the LDA crosses a page. BPL copies Y..0, BNE copies Y..1. The pointers
+ * are reloaded if the loop ever writes over them.
+ */
+static void
+_mii_hle_copy(
+		mii_t *mii,
+		bool bpl,
+		uint16_t head,
+		uint16_t exit)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	int max = _mii_hle_budget(mii, 256);
+	uint16_t src = _mii_hle_peek_word(mii, 0x28);
+	uint16_t dst = _mii_hle_peek_word(mii, 0x2a);
+	uint32_t cycles = 0;
+	bool more;
+	do {
+		cpu->A = _mii_hle_peek(mii, src + cpu->Y);
+		cycles += 16 + ((src & 0xff) + cpu->Y > 0xff);
+		uint16_t d = dst + cpu->Y;
+		_mii_hle_poke(mii, d, cpu->A);
+		if (unlikely((d & 0xfffc) == 0x28)) {
+			src = _mii_hle_peek_word(mii, 0x28);
+			dst = _mii_hle_peek_word(mii, 0x2a);
+		}
+		cpu->Y--;
+		more = bpl ? !(cpu->Y & 0x80) : cpu->Y != 0;
+	} while (more && --max);
+	cpu->P.N = !!(cpu->Y & 0x80);
+	cpu->P.Z = cpu->Y == 0;
+	_mii_hle_done(mii, cycles, more, head, exit);
+}
+
+static void
+_mii_hle_scroll_40(
+		mii_t *mii,
+		uint8_t trap)
+{
+	_mii_hle_copy(mii, true, 0xc13f, 0xc146);
+}
+
+static void
+_mii_hle_scroll_main(
+		mii_t *mii,
+		uint8_t trap)
+{
+	_mii_hle_copy(mii, true, 0xcc59, 0xcc60);
+}
+
+static void
+_mii_hle_scroll_aux(
+		mii_t *mii,
+		uint8_t trap)
+{
+	_mii_hle_copy(mii, false, 0xcc45, 0xcc4c);
+}
+
+/*
+ * $CCA8: STA ($28),Y; INY; CPY $21; BCC $CCA8 -- 14 cycles per iteration
+ */
+static void
+_mii_hle_clreol(
+		mii_t *mii,
+		uint8_t trap)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	int max = _mii_hle_budget(mii, 256);
+	uint16_t base = _mii_hle_peek_word(mii, 0x28);
+	uint32_t cycles = 0;
+	uint8_t wndwdth;
+	do {
+		uint16_t d = base + cpu->Y;
+		_mii_hle_poke(mii, d, cpu->A);
+		if (unlikely((d & 0xfffe) == 0x28))
+			base = _mii_hle_peek_word(mii, 0x28);
+		cpu->Y++;
+		wndwdth = _mii_hle_peek(mii, 0x21);
+		cycles += 14;
+	} while (cpu->Y < wndwdth && --max);
+	uint8_t r = cpu->Y - wndwdth;
+	cpu->P.N = !!(r & 0x80);
+	cpu->P.Z = r == 0;
+	cpu->P.C = cpu->Y >= wndwdth;
+	_mii_hle_done(mii, cycles, !cpu->P.C, 0xcca8, 0xccaf);
+}
+
+static const struct {
+	uint16_t 			addr;
+	uint8_t				len;
+	uint8_t				code[7];	// expected ROM bytes
+	mii_trap_handler_cb	cb;
+} _mii_hle_patch[] = {
+	{ 0xfcaa, 4, { 0xe9, 0x01, 0xd0, 0xfc }, _mii_hle_wait },
+	{ 0xc13f, 7, { 0xb1, 0x28, 0x91, 0x2a, 0x88, 0x10, 0xf9 },
+					_mii_hle_scroll_40 },
+	{ 0xcc59, 7, { 0xb1, 0x28, 0x91, 0x2a, 0x88, 0x10, 0xf9 },
+					_mii_hle_scroll_main },
+	{ 0xcc45, 7, { 0xb1, 0x28, 0x91, 0x2a, 0x88, 0xd0, 0xf9 },
+					_mii_hle_scroll_aux },
+	{ 0xcca8, 7, { 0x91, 0x28, 0xc8, 0xc4, 0x21, 0x90, 0xf9 },
+					_mii_hle_clreol },
+};
+
+int
+mii_hle_install(
+		mii_t *mii)
+{
+	mii_rom_t *rom = mii_rom_get("iiee");
+	if (!rom || !rom->rom || rom->len < sizeof(_mii_hle_rom))
+		return -1;
+	if (rom->rom != _mii_hle_rom)
+		memcpy(_mii_hle_rom, rom->rom, sizeof(_mii_hle_rom));
+	int count = 0;
+	for (unsigned i = 0; i < sizeof(_mii_hle_patch) /
+						sizeof(_mii_hle_patch[0]); i++) {
+		uint8_t *p = _mii_hle_rom + (_mii_hle_patch[i].addr - 0xc000);
+		if (memcmp(p, _mii_hle_patch[i].code, _mii_hle_patch[i].len)) {
+			MII_DEBUG_PRINTF("%s $%04X doesn't match, skipped\n",
+					__func__, _mii_hle_patch[i].addr);
+			continue;
+		}
+		uint8_t trap = mii_register_trap(mii, _mii_hle_patch[i].cb);
+		if (trap == 0xff)
+			break;
+		p[0] = MII_TRAP >> 8;
+		p[1] = MII_TRAP & 0xff;
+		p[2] = trap;
+		count++;
+	}
+	rom->rom = _mii_hle_rom;
+	if (mii->rom == rom)
+		mii->bank[MII_BANK_ROM].ua.raw = _mii_hle_rom;
+	MII_DEBUG_PRINTF("%s %d ROM loops patched\n", __func__, count);
+	return count;
+}
@@ -0,0 +1,25 @@
+/*
+ * mii_hle.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct mii_t;
+
+/*
+ * High level emulation of the hot loops of the enhanced IIe ROM (WAIT,
+ * the 40/80 columns scroll copy and clear to end of line). The loops are
+ * replaced by traps in a SRAM copy of the ROM, and run natively with the
+ * exact cycle count the 65C02 would have taken charged to the CPU.
+ *
+ * Must be called after the "iiee" ROM is registered and before
+ * mii_reset(). A loop is only patched if the ROM bytes match the
+ * expected code, so other ROM revisions are left alone. Returns the
+ * number of loops patched, or -1 if there is no ROM.
+ */
+int
+mii_hle_install(
+		struct mii_t *mii);
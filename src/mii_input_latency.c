@@ -0,0 +1,187 @@
+/*
+ * mii_input_latency.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * There is one event in flight per channel; the drivers queue keys, but
+ * the main loop drains the queues every frame, so a second key arriving
+ * before the first was delivered is rare, and only the first of a burst
+ * is measured. An arrival that never got delivered (function keys, keys
+ * the UI ate) is forgotten after MII_LAT_STALE_US.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "mii_input_latency.h"
+
+#if MII_RP2350
+#include <pico/time.h>
+#define _now_us()	time_us_32()
+#else
+#include <time.h>
+static uint32_t
+_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+#endif
+
+#define MII_LAT_STALE_US	500000
+
+typedef struct mii_lat_stamp_t {
+	volatile bool		valid;
+	uint8_t				source;
+	uint32_t			t;
+} mii_lat_stamp_t;
+
+static struct {
+	mii_lat_stamp_t	pending[MII_LAT_CHANNEL_COUNT];	// seen by the driver
+	mii_lat_stamp_t	armed[MII_LAT_CHANNEL_COUNT];	// visible to the guest
+	uint32_t		count[MII_LAT_SOURCE_COUNT];
+	uint32_t		max[MII_LAT_SOURCE_COUNT];
+	uint16_t		hist[MII_LAT_SOURCE_COUNT][MII_LAT_BUCKETS];
+} _lat;
+
+static const char * const _mii_lat_name[MII_LAT_SOURCE_COUNT] = {
+	[MII_LAT_USB_KBD] = "USB KBD",
+	[MII_LAT_PS2_KBD] = "PS2 KBD",
+	[MII_LAT_USB_PAD] = "USB PAD",
+	[MII_LAT_NESPAD] = "NES PAD",
+};
+
+static inline uint8_t
+_mii_lat_channel(
+		uint8_t source)
+{
+	return source <= MII_LAT_PS2_KBD ? MII_LAT_KEY : MII_LAT_BUTTON;
+}
+
+void
+mii_latency_arrival(
+		uint8_t source)
+{
+	if (source >= MII_LAT_SOURCE_COUNT)
+		return;
+	mii_lat_stamp_t *p = &_lat.pending[_mii_lat_channel(source)];
+	uint32_t now = _now_us();
+	if (p->valid && (now - p->t) < MII_LAT_STALE_US)
+		return;
+	p->source = source;
+	p->t = now;
+	p->valid = true;
+}
+
+void
+mii_latency_deliver(
+		uint8_t channel)
+{
+	mii_lat_stamp_t *p = &_lat.pending[channel];
+	if (!p->valid)
+		return;
+	_lat.armed[channel] = *p;
+	p->valid = false;
+}
+
+void
+mii_latency_drop(
+		uint8_t channel)
+{
+	_lat.pending[channel].valid = false;
+}
+
+void
+mii_latency_observe(
+		uint8_t channel)
+{
+	mii_lat_stamp_t *a = &_lat.armed[channel];
+	if (!a->valid)
+		return;
+	a->valid = false;
+	uint32_t dt = _now_us() - a->t;
+	uint32_t b = dt / MII_LAT_BUCKET_US;
+	if (b >= MII_LAT_BUCKETS)
+		b = MII_LAT_BUCKETS - 1;
+	uint8_t s = a->source;
+	if (_lat.hist[s][b] != UINT16_MAX)
+		_lat.hist[s][b]++;
+	_lat.count[s]++;
+	if (dt > _lat.max[s])
+		_lat.max[s] = dt;
+}
+
+uint32_t
+mii_latency_count(
+		uint8_t source)
+{
+	return source < MII_LAT_SOURCE_COUNT ? _lat.count[source] : 0;
+}
+
+uint32_t
+mii_latency_percentile(
+		uint8_t source,
+		unsigned pct)
+{
+	if (source >= MII_LAT_SOURCE_COUNT)
+		return 0;
+	uint32_t total = 0;
+	for (int i = 0; i < MII_LAT_BUCKETS; i++)
+		total += _lat.hist[source][i];
+	if (!total)
+		return 0;
+	// rank of the sample we want, rounded up
+	uint32_t rank = (total * pct + 99) / 100;
+	uint32_t sum = 0;
+	for (int i = 0; i < MII_LAT_BUCKETS; i++) {
+		sum += _lat.hist[source][i];
+		if (sum >= rank && sum)
+			return i == MII_LAT_BUCKETS - 1 ?
+						_lat.max[source] : (i + 1) * MII_LAT_BUCKET_US;
+	}
+	return _lat.max[source];
+}
+
+int
+mii_latency_format(
+		uint8_t source,
+		char * buf,
+		unsigned size)
+{
+	if (!mii_latency_count(source))
+		return 0;
+	uint32_t p50 = mii_latency_percentile(source, 50);
+	uint32_t p99 = mii_latency_percentile(source, 99);
+	return snprintf(buf, size, "%s %2u.%u/%2u.%ums",
+			_mii_lat_name[source],
+			(unsigned)(p50 / 1000), (unsigned)(p50 % 1000) / 100,
+			(unsigned)(p99 / 1000), (unsigned)(p99 % 1000) / 100);
+}
+
+void
+mii_latency_dump(void)
+{
+	for (int s = 0; s < MII_LAT_SOURCE_COUNT; s++) {
+		if (!_lat.count[s])
+			continue;
+		printf("latency %s: n=%u p50=%uus p90=%uus p99=%uus max=%uus\n",
+				_mii_lat_name[s], (unsigned)_lat.count[s],
+				(unsigned)mii_latency_percentile(s, 50),
+				(unsigned)mii_latency_percentile(s, 90),
+				(unsigned)mii_latency_percentile(s, 99),
+				(unsigned)_lat.max[s]);
+		for (int i = 0; i < MII_LAT_BUCKETS; i++) {
+			if (_lat.hist[s][i])
+				printf("  %5u-%5uus %u\n",
+						i * MII_LAT_BUCKET_US,
+						(i + 1) * MII_LAT_BUCKET_US - 1,
+						_lat.hist[s][i]);
+		}
+	}
+}
+
+void
+mii_latency_reset(void)
+{
+	memset(&_lat, 0, sizeof(_lat));
+}
@@ -0,0 +1,93 @@
+/*
+ * mii_input_latency.h
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Input latency instrumentation: an input event is stamped when the
+ * driver first sees it (USB report, PS/2 scan, NES pad poll), again when
+ * it reaches the soft switches, and the total is accounted when the guest
+ * first reads $C000 (keys) or $C061-$C063 (buttons) and sees it.
+ *
+ * Built with -DINPUT_LATENCY=ON (WITH_INPUT_LATENCY=1); otherwise all of
+ * these are empty inlines.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+	MII_LAT_USB_KBD = 0,
+	MII_LAT_PS2_KBD,
+	MII_LAT_USB_PAD,
+	MII_LAT_NESPAD,
+	MII_LAT_SOURCE_COUNT,
+};
+
+// what the guest reads to observe the event
+enum {
+	MII_LAT_KEY = 0,	// $C000
+	MII_LAT_BUTTON,		// $C061-$C063
+	MII_LAT_CHANNEL_COUNT,
+};
+
+// Histogram buckets are MII_LAT_BUCKET_US wide, the last one is overflow
+#define MII_LAT_BUCKET_US	250
+#define MII_LAT_BUCKETS		128
+
+#if WITH_INPUT_LATENCY
+/* Driver side, an event (key down, button down) was received */
+void
+mii_latency_arrival(
+		uint8_t source);
+/* The pending event was made visible to the guest (soft switch written) */
+void
+mii_latency_deliver(
+		uint8_t channel);
+/* The pending event was consumed by the UI, it will never reach the guest */
+void
+mii_latency_drop(
+		uint8_t channel);
+/* The guest read the switch for this channel */
+void
+mii_latency_observe(
+		uint8_t channel);
+/* Latency in microseconds under which 'pct' percent of the samples are.
+ * Returns 0 when there are no samples */
+uint32_t
+mii_latency_percentile(
+		uint8_t source,
+		unsigned pct);
+uint32_t
+mii_latency_count(
+		uint8_t source);
+/* Short one line summary for 'source', for the OSD. Returns 0 if there
+ * are no samples for it yet */
+int
+mii_latency_format(
+		uint8_t source,
+		char * buf,
+		unsigned size);
+/* Print all histograms on stdout */
+void
+mii_latency_dump(void);
+void
+mii_latency_reset(void);
+#else
+static inline void mii_latency_arrival(uint8_t source) { (void)source; }
+static inline void mii_latency_deliver(uint8_t channel) { (void)channel; }
+static inline void mii_latency_drop(uint8_t channel) { (void)channel; }
+static inline void mii_latency_observe(uint8_t channel) { (void)channel; }
+static inline int mii_latency_format(uint8_t source, char *buf, unsigned size) {
+	(void)source; (void)buf; (void)size; return 0; }
+static inline void mii_latency_dump(void) {}
+static inline void mii_latency_reset(void) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -34,8 +34,10 @@ _mii_mb_timer(
 	uint64_t res = 1 + -mii_timer_get(mii, mb->timer);
 
 	uint32_t irq = mb_io_sync(mb->mb, &clock);
-	if (irq & MB_CARD_IRQ)
+	if (irq & MB_CARD_IRQ) {
 		mii->cpu_state.irq = 1;
+		mii->cpu.attention = 1;
+	}
 
 	if ((mii->cpu.total_cycle - mb->last_flush_cycle) >= mb->flush_cycle_count) {
 		mb->last_flush_cycle = mii->cpu.total_cycle;
@@ -47,6 +47,7 @@ mii_floppy_nib_render_track(
 	int state = 0;		// look for address field
 	int tid = 0, sid;
 	uint16_t hmap = 0, dmap = 0;
+	mii_floppy_cursor_t c;
 	do {
 		window = (window << 8) | src_track[srci++];
 		switch (state) {
@@ -54,8 +55,10 @@ mii_floppy_nib_render_track(
 				if (window != 0xffd5aa96)
 					break;
 				uint32_t pos = dst->bit_count;
+				mii_floppy_cursor_write_init(&c, dst, dst_track);
 				for (int i = 0; i < (seccount == 0 ? 40 : 20); i++)
-					mii_floppy_write_track_bits(dst, dst_track, 0xff << 2, 10);
+					mii_floppy_cursor_write(&c, 0xff << 2, 10);
+				mii_floppy_cursor_flush(&c, dst);
 			//	mii_floppy_write_track_bits(dst, dst_track, 0xff, 8);
 				// Points to the last sync 0xff of sync (which is 8 bits)
 				uint8_t * h = src_track + srci - 4;
@@ -72,8 +75,10 @@ mii_floppy_nib_render_track(
 				if (window != 0xffd5aaad)
 					break;
 				uint32_t pos = dst->bit_count;
+				mii_floppy_cursor_write_init(&c, dst, dst_track);
 				for (int i = 0; i < 4; i++)
-					mii_floppy_write_track_bits(dst, dst_track, 0xff << 2, 10);
+					mii_floppy_cursor_write(&c, 0xff << 2, 10);
+				mii_floppy_cursor_flush(&c, dst);
 			//	printf("\tdata at %d\n", dst->bit_count);
 				dmap |= 1 << sid;
 				uint8_t *h = src_track + srci - 4;
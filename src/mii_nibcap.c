@@ -0,0 +1,175 @@
+/*
+ * mii_nibcap.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Capture format, little endian:
+ *	"MIIN", version (1), 3 bytes padding, start cycle (8 bytes)
+ * then records, told apart by their first byte:
+ *	0x01, drive, quarter track, bit position (4 bytes), track length in
+ *	bits (4 bytes), cycle (8 bytes)
+ *		where the head is when a capture starts or it changes drive/track
+ *	nibble (0x80-0xff), cycle delta (LEB128), bit delta (LEB128)
+ *		deltas from the previous record; the bit delta wraps around the
+ *		track, so it's the number of bits the head moved over
+ * A nibble is ~3 bytes, ~100KB per second of continuous disk reading.
+ *
+ * It all goes in a PSRAM buffer, the SD card isn't touched until the
+ * capture is over (or the buffer is full).
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "mii.h"
+#include "mii_nibcap.h"
+
+#if MII_RP2350
+#include "../drivers/psram_allocator.h"
+#else
+#include <stdlib.h>
+#endif
+
+#define MII_NIBCAP_MAGIC	"MIIN"
+#define MII_NIBCAP_VERSION	1
+#define MII_NIBCAP_HEADER	16
+#define MII_NIBCAP_SIZE		(2 * 1024 * 1024)
+// a position record and a nibble with their longest deltas
+#define MII_NIBCAP_MAX		(19 + 1 + 10 + 5)
+
+enum {
+	MII_NIBCAP_OFF = 0,
+	MII_NIBCAP_ON,
+	MII_NIBCAP_DONE,
+};
+
+typedef struct mii_nibcap_t {
+	uint8_t			state;
+	uint8_t			drive, qtrack;
+	uint32_t		bit;
+	uint64_t		start, end, cycle;
+	uint32_t		count;
+	uint32_t		pos;
+	uint8_t *		buf;
+} mii_nibcap_t;
+
+static mii_nibcap_t _nibcap;
+
+static inline void
+_mii_nibcap_leb(
+		mii_nibcap_t *n,
+		uint64_t v)
+{
+	do {
+		n->buf[n->pos++] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+		v >>= 7;
+	} while (v);
+}
+
+int
+mii_nibcap_start(
+		mii_t *mii,
+		uint32_t seconds)
+{
+	mii_nibcap_t *n = &_nibcap;
+	if (!n->buf) {
+#if MII_RP2350
+		if (butter_psram_size() >= 4 * 1024 * 1024)
+			n->buf = psram_malloc(MII_NIBCAP_SIZE);
+#else
+		n->buf = malloc(MII_NIBCAP_SIZE);
+#endif
+		if (!n->buf) {
+			printf("%s no PSRAM for the capture buffer\n", __func__);
+			return -1;
+		}
+	}
+	n->start = n->cycle = mii->cpu.total_cycle;
+	n->end = n->start + (uint64_t)seconds * 1023000;
+	n->drive = n->qtrack = 0xff;
+	n->bit = 0;
+	n->count = 0;
+	memcpy(n->buf, MII_NIBCAP_MAGIC, 4);
+	n->buf[4] = MII_NIBCAP_VERSION;
+	n->buf[5] = n->buf[6] = n->buf[7] = 0;
+	for (int i = 0; i < 8; i++)
+		n->buf[8 + i] = n->start >> (i * 8);
+	n->pos = MII_NIBCAP_HEADER;
+	n->state = MII_NIBCAP_ON;
+	printf("Nibble capture: %lu seconds from cycle %llu\n",
+			(unsigned long)seconds, (unsigned long long)n->start);
+	return 0;
+}
+
+void
+mii_nibcap_byte(
+		uint64_t cycle,
+		uint8_t drive,
+		uint8_t qtrack,
+		uint32_t bit_position,
+		uint32_t bit_count,
+		uint8_t value)
+{
+	mii_nibcap_t *n = &_nibcap;
+	if (n->state != MII_NIBCAP_ON)
+		return;
+	if (cycle >= n->end || n->pos + MII_NIBCAP_MAX > MII_NIBCAP_SIZE) {
+		n->state = MII_NIBCAP_DONE;
+		return;
+	}
+	if (drive != n->drive || qtrack != n->qtrack) {
+		n->drive = drive;
+		n->qtrack = qtrack;
+		n->bit = bit_position;
+		n->cycle = cycle;
+		uint8_t *b = n->buf + n->pos;
+		b[0] = 0x01;
+		b[1] = drive;
+		b[2] = qtrack;
+		for (int i = 0; i < 4; i++) {
+			b[3 + i] = bit_position >> (i * 8);
+			b[7 + i] = bit_count >> (i * 8);
+		}
+		for (int i = 0; i < 8; i++)
+			b[11 + i] = cycle >> (i * 8);
+		n->pos += 19;
+	}
+	n->buf[n->pos++] = value;
+	_mii_nibcap_leb(n, cycle - n->cycle);
+	_mii_nibcap_leb(n, bit_position >= n->bit ?
+			bit_position - n->bit : bit_position + bit_count - n->bit);
+	n->cycle = cycle;
+	n->bit = bit_position;
+	n->count++;
+}
+
+void
+mii_nibcap_poll(
+		mii_t *mii,
+		const char *dir)
+{
+	mii_nibcap_t *n = &_nibcap;
+	if (n->state == MII_NIBCAP_ON && mii->cpu.total_cycle >= n->end)
+		n->state = MII_NIBCAP_DONE;
+	if (n->state != MII_NIBCAP_DONE)
+		return;
+	n->state = MII_NIBCAP_OFF;
+	char path[64];
+	FIL f;
+	FRESULT fr = FR_EXIST;
+	for (int i = 0; i < 1000 && fr == FR_EXIST; i++) {
+		snprintf(path, sizeof(path), "%s/nib%03d.min", dir, i);
+		fr = f_open(&f, path, FA_WRITE | FA_CREATE_NEW);
+	}
+	if (fr != FR_OK) {
+		printf("%s can't create a capture file in %s\n", __func__, dir);
+		return;
+	}
+	UINT bw = 0;
+	fr = f_write(&f, n->buf, n->pos, &bw);
+	if (f_close(&f) != FR_OK || fr != FR_OK || bw != n->pos)
+		printf("%s %s write failed\n", __func__, path);
+	else
+		printf("Nibble capture: %lu nibbles, %lu KB to %s\n",
+				(unsigned long)n->count, (unsigned long)(n->pos / 1024), path);
+}
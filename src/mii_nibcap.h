@@ -0,0 +1,45 @@
+/*
+ * mii_nibcap.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct mii_t;
+
+/*
+ * Floppy nibble stream capture: every byte the Disk II data latch
+ * completes (bit 7 set) is logged with the cycle, drive, quarter track and
+ * bit position it came from, for the first 'seconds' of guest time. Run the
+ * same image through two builds and tools/mii_nibcap_diff.py says where
+ * the guest started reading something different.
+ */
+#ifndef MII_NIBCAP_SECONDS
+#define MII_NIBCAP_SECONDS	20
+#endif
+
+/* Returns -1 if there's no memory for the buffer (needs PSRAM) */
+int
+mii_nibcap_start(
+		struct mii_t *mii,
+		uint32_t seconds);
+/* From the LSS, when the latch gets a new nibble */
+void
+mii_nibcap_byte(
+		uint64_t cycle,
+		uint8_t drive,
+		uint8_t qtrack,
+		uint32_t bit_position,
+		uint32_t bit_count,
+		uint8_t value);
+/*
+ * Once per frame; when the capture is over, writes it to the first free
+ * 'dir'/nibNNN.min. That write holds the emulation for a moment.
+ */
+void
+mii_nibcap_poll(
+		struct mii_t *mii,
+		const char *dir);
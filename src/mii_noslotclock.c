@@ -20,139 +20,210 @@
 #include <time.h>
 #include "mii.h"
 #include "mii_bank.h"
-#include "minipt.h"
+#include "mii_noslotclock.h"
+#include "debug_log.h"
+#if WITH_INPUT_REPLAY
+#include "mii_replay.h"
+#endif
+
+#if MII_RP2350
+#include <pico/time.h>
+#include <pico/aon_timer.h>
+#include <hardware/sync.h>
+#endif
 
 const uint64_t nsc_pattern = 0x5CA33AC55CA33AC5ULL;
 
+enum {
+	MII_NSC_IDLE = 0,	// shifting in the unlock pattern
+	MII_NSC_ARMED,		// pattern matched, next access picks the direction
+	MII_NSC_READ,
+	MII_NSC_WRITE,
+};
+
 typedef struct mii_nsc_t {
 	mii_t *		mii;
-	uint64_t 	pattern;
-	void * 		state;		// protothread state
-	int 		bitcount;
-	int 		mode; 		// read or write;
+	bool		enabled;
+	uint8_t		state;		// MII_NSC_*
+	uint8_t		bitcount;
+	uint64_t	shift;		// unlock shift register
+	uint64_t	data;		// latched time (read) or incoming bits (write)
+	// BCD time, refreshed asynchronously to the guest accesses
+	volatile uint64_t	bcd;
+#if MII_RP2350
+	repeating_timer_t	tick;
+#endif
 } mii_nsc_t;
 
-static void
-_mii_nsc_maketime(
-		mii_nsc_t *nsc)
+// there is only ever one of these, and it lives in SRAM on RP2350
+static mii_nsc_t _nsc;
+
+static inline uint64_t
+_bcd(
+		int v)
+{
+	return ((v / 10) << 4) | (v % 10);
+}
+
+uint64_t
+mii_nsc_bcd_from_tm(
+		const struct tm *t)
 {
 	uint64_t ret = 0;
 
-	time_t now = time(NULL);
-	struct tm t;
-	localtime_r(&now, &t);
+	ret = _bcd(t->tm_year % 100);
+	ret = (ret << 8) | _bcd(t->tm_mon + 1);
+	// Bits 4 and 5 of the day are used to control the RST and oscillator
+	// functions. These bits are shipped from the factory set to logic 1,
+	// but read as zero.
+	ret = (ret << 8) | _bcd(t->tm_mday);
+	ret = (ret << 8) | (t->tm_wday + 1);
+	// bit 7 is 24 hour mode, but zero on read.
+	ret = (ret << 8) | _bcd(t->tm_hour);
+	ret = (ret << 8) | _bcd(t->tm_min);
+	ret = (ret << 8) | _bcd(t->tm_sec);
+	ret = (ret << 8) | 0;	// centiseconds
+	return ret;
+}
 
-	int year = t.tm_year % 100;
-	ret = year / 10;
-	ret <<= 4;
-	ret += year % 10;
-	ret <<= 4;
-
-	int month = t.tm_mon + 1;
-	ret += month / 10;
-	ret <<= 4;
-	ret += month % 10;
-	ret <<= 4;
-
-	int day = t.tm_mday;
-	ret += day / 10;
-	ret <<= 4;
-	ret += day % 10;
-	ret <<= 4;
-
-	// Bits 4 and 5 of the day ret are used to control the RST and oscillator
-	// functions. These bits are shipped from the factory set to logic 1.
-	ret += 0x0; //0x3, but zero on read.
-	ret <<= 4;
-	ret += t.tm_wday + 1; // uint64(now.Weekday()) + 1
-	ret <<= 4;
-
-	int hour = t.tm_hour;
-	ret += 0x0; // 0x8 for 24 hour mode, but zero on read.
-	ret += hour / 10;
-	ret <<= 4;
-	ret += hour % 10;
-	ret <<= 4;
-
-	int minute = t.tm_min;
-	ret += minute / 10;
-	ret <<= 4;
-	ret += minute % 10;
-	ret <<= 4;
-
-	int second = t.tm_sec;
-	ret += second / 10;
-	ret <<= 4;
-	ret += second % 10;
-	ret <<= 4;
-
-	int centisecond = 0;
-	ret += centisecond / 10;
-	ret <<= 4;
-	ret += centisecond % 10;
-	nsc->pattern = ret;
+void
+mii_nsc_set_time(
+		const struct tm *t)
+{
+	uint64_t bcd = mii_nsc_bcd_from_tm(t);
+#if MII_RP2350
+	uint32_t irq = save_and_disable_interrupts();
+	_nsc.bcd = bcd;
+	restore_interrupts(irq);
+#else
+	_nsc.bcd = bcd;
+#endif
+}
+
+static uint64_t
+_mii_nsc_latch(
+		mii_nsc_t *nsc)
+{
+#if MII_RP2350
+	uint32_t irq = save_and_disable_interrupts();
+	uint64_t res = nsc->bcd;
+	restore_interrupts(irq);
+#else
+	uint64_t res = nsc->bcd;
+#endif
+#if WITH_INPUT_REPLAY
+	// the wall clock is an input too
+	mii_replay_clock(nsc->mii, &res);
+#endif
+	return res;
 }
 
 /*
- * this is a protothread, so remember no locals that will survive a yield()
+ * The DS1216E sits under the ROM; all accesses are reads, A2 selects
+ * read (1) or write (0), and A0 is the data bit that is written.
+ * Until the 64 bits unlock pattern has been shifted in, the ROM is
+ * returned as normal.
  */
-static bool
-_mii_nsc_access(
-		struct mii_bank_t *bank,
-		void *param,
+bool
+mii_nsc_access(
+		mii_t *mii,
 		uint16_t addr,
 		uint8_t * byte,
 		bool write)
 {
-	if (!bank) {
-	//	printf("%s: disposing of NSC\n", __func__);
-		free(param);
+	mii_nsc_t * nsc = &_nsc;
+	if (!nsc->enabled)
 		return false;
-	}
-	mii_nsc_t * nsc = param;
-//	printf("%s PC:%04x access %s addr %04x byte %02x write %d\n",
-//			__func__, nsc->mii->cpu.PC,
-//			bank->name, addr, *byte, write);
 	int rd = (addr & 0x4);
 	int bit = addr & 1;
-	bool res = false;
-	pt_start(nsc->state);
-	do {
-		if (rd) {
-			nsc->pattern = 0;
-		} else {
-			nsc->pattern = (nsc->pattern >> 1) | ((uint64_t)bit << 63);
-			int match = nsc->pattern == nsc_pattern;
-			if (match) {
-			//	printf("pattern %016lx %s\n", nsc->pattern, match ? "match" : "");
-				break;
+
+	switch (nsc->state) {
+		case MII_NSC_IDLE:
+			if (rd) {
+				nsc->shift = 0;
+			} else {
+				nsc->shift = (nsc->shift >> 1) | ((uint64_t)bit << 63);
+				if (nsc->shift == nsc_pattern)
+					nsc->state = MII_NSC_ARMED;
+			}
+			return false;
+		case MII_NSC_ARMED:
+			nsc->bitcount = 0;
+			nsc->state = rd ? MII_NSC_READ : MII_NSC_WRITE;
+			nsc->data = rd ? _mii_nsc_latch(nsc) : 0;
+			break;
+		default:
+			// changing direction mid transfer aborts it
+			if (!!rd != (nsc->state == MII_NSC_READ)) {
+				nsc->state = MII_NSC_IDLE;
+				nsc->shift = 0;
+				return false;
 			}
-		}
-		pt_yield(nsc->state);
-	} while (1);
-	nsc->bitcount = 0;
-	pt_yield(nsc->state);
-	nsc->mode = rd;
-//	printf("%s in %s mode\n", __func__, rd ? "read" : "write");
-	if (nsc->mode) {
-		_mii_nsc_maketime(nsc);
-	//	printf("time %016lx\n", nsc->pattern);
+			break;
 	}
-	do {
-		if (nsc->mode) {
-			*byte = (nsc->pattern >> nsc->bitcount) & 1;
-		} else {
-			nsc->pattern |= ((uint64_t)bit << nsc->bitcount);
-		}
-		res = true; // don't call ROM handler
-		pt_yield(nsc->state);
-		nsc->bitcount++;
-	} while (nsc->bitcount < 64 && nsc->mode == rd);
-//	printf("%s done\n", __func__);
-	pt_end(nsc->state);
-	return res;
+	if (nsc->state == MII_NSC_READ)
+		*byte = (nsc->data >> nsc->bitcount) & 1;
+	else
+		nsc->data |= ((uint64_t)bit << nsc->bitcount);
+	if (++nsc->bitcount == 64) {
+		nsc->state = MII_NSC_IDLE;
+		nsc->shift = 0;
+	}
+	return true; // don't call ROM handler
+}
+
+#if MII_RP2350
+static bool
+_mii_nsc_tick(
+		repeating_timer_t *rt)
+{
+	struct tm t;
+	if (aon_timer_get_time_calendar(&t))
+		mii_nsc_set_time(&t);
+	return true;
 }
 
+/*
+ * There is no battery backed clock on the boards, so if the AON timer
+ * isn't running yet, start it at the firmware build date.
+ */
+static void
+_mii_nsc_start_aon(void)
+{
+	if (aon_timer_is_running())
+		return;
+	static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	const char *date = __DATE__;	// "Mmm dd yyyy"
+	struct tm t = {
+		.tm_mday = atoi(date + 4),
+		.tm_year = atoi(date + 7) - 1900,
+		.tm_hour = 12,
+	};
+	for (int i = 0; i < 12; i++)
+		if (!strncmp(months + (i * 3), date, 3))
+			t.tm_mon = i;
+	// let mktime() work out the day of the week
+	mktime(&t);
+	aon_timer_start_calendar(&t);
+}
+#endif
+
+#if WITH_BANK_ACCESS
+static bool
+_mii_nsc_bank_access(
+		struct mii_bank_t *bank,
+		void *param,
+		uint16_t addr,
+		uint8_t * byte,
+		bool write)
+{
+	if (!bank)
+		return false;
+	mii_nsc_t * nsc = param;
+	return mii_nsc_access(nsc->mii, addr, byte, write);
+}
+#endif
+
 static int
 _mii_nsc_probe(
 		mii_t *mii,
@@ -161,15 +232,37 @@ _mii_nsc_probe(
 //	printf("%s %s\n", __func__, flags & MII_INIT_NSC ? "enabled" : "disabled");
 	if (!(flags & MII_INIT_NSC))
 		return 0;
-	mii_nsc_t * nsc = calloc(1, sizeof(*nsc));
+	mii_nsc_t * nsc = &_nsc;
+	if (nsc->enabled)
+		return 1;
 	nsc->mii = mii;
+	nsc->state = MII_NSC_IDLE;
+#if MII_RP2350
+	_mii_nsc_start_aon();
+	_mii_nsc_tick(NULL);
+	add_repeating_timer_ms(-1000, _mii_nsc_tick, NULL, &nsc->tick);
+	MII_DEBUG_PRINTF("%s: NSC enabled, BCD %016llx\n", __func__,
+			(unsigned long long)nsc->bcd);
+#else
+	// no ticker here; start from the host clock, mii_nsc_set_time() can
+	// move it afterward
+	time_t now = time(NULL);
+	struct tm t;
+	localtime_r(&now, &t);
+	mii_nsc_set_time(&t);
+#endif
+#if WITH_BANK_ACCESS
 	// This worked fine with NS.CLOCK.SYSTEM but...
 //	mii_bank_install_access_cb(&mii->bank[MII_BANK_CARD_ROM],
-//			_mii_nsc_access, nsc, 0xc1, 0);
+//			_mii_nsc_bank_access, nsc, 0xc1, 0);
 	/* ... A2Desktop requires the NSC to be on the main rom, the source
 	 * claims it probe the slots, but in fact, it doesnt */
 	mii_bank_install_access_cb(&mii->bank[MII_BANK_ROM],
-			_mii_nsc_access, nsc, 0xc8, 0);
+			_mii_nsc_bank_access, nsc, 0xc8, 0);
+#endif
+	/* Without bank callbacks, the CPU access path calls mii_nsc_access()
+	 * for $C8xx when it is mapped to the main ROM */
+	nsc->enabled = true;
 	return 1;
 }
 
@@ -0,0 +1,41 @@
+/*
+ * mii_noslotclock.h
+ *
+ * Copyright (C) 2023 Michel Pollet <buserror@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+struct mii_t;
+
+/*
+ * Convert a broken down time to the 64 bits BCD stream the DS1216E
+ * shifts out, LSB first (centiseconds first, year last).
+ */
+uint64_t
+mii_nsc_bcd_from_tm(
+		const struct tm *t);
+/*
+ * Refresh the BCD snapshot served to the guest. On RP2350 this is done
+ * once a second from a hardware timer, so the access path never does
+ * any date math.
+ */
+void
+mii_nsc_set_time(
+		const struct tm *t);
+/*
+ * Called for accesses to the $C8xx page when it is mapped to the main
+ * ROM. Returns true if the clock handled the access (*byte is then the
+ * clock data bit for reads).
+ */
+bool
+mii_nsc_access(
+		struct mii_t *mii,
+		uint16_t addr,
+		uint8_t * byte,
+		bool write);
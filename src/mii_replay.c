@@ -0,0 +1,336 @@
+/*
+ * mii_replay.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Log format, little endian:
+ *	"MIIR", version (1), 3 bytes padding, start cycle (8 bytes)
+ * then one record per event:
+ *	type, cycle delta from the previous event (LEB128), len, data[len]
+ *
+ * A key press is 4 or 5 bytes, a frame with no input change costs
+ * nothing. Every MII_REPLAY_SYNC_CYCLES a hash of main RAM and the CPU
+ * registers is logged, so a replay that went off the rails says where,
+ * and the file is synced to the card, so a recording survives a power
+ * cycle minus the last few seconds.
+ *
+ * Determinism caveat: a disk mounted read/write is modified as it is
+ * recorded, mount images read only for exact replays.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "mii.h"
+#include "mii_bank.h"
+#include "mii_replay.h"
+#include "debug_log.h"
+
+#define MII_REPLAY_MAGIC		"MIIR"
+#define MII_REPLAY_VERSION		1
+#define MII_REPLAY_HEADER		16
+// ~10 seconds of guest time
+#define MII_REPLAY_SYNC_CYCLES	(1023000 * 10)
+
+enum {
+	MII_REPLAY_OFF = 0,
+	MII_REPLAY_REC,
+	MII_REPLAY_PLAY,
+};
+
+typedef struct mii_replay_t {
+	uint8_t			mode;
+	FIL				f;
+	uint64_t		last;		// cycle of the last event written/read
+	uint64_t		next_sync;
+	uint32_t		events;
+	uint32_t		syncs, bad_syncs;
+	bool			have;		// 'head' holds the next event (playback)
+	mii_replay_ev_t	head;
+	uint16_t		pos, fill;	// I/O buffer
+	uint8_t			buf[512];
+} mii_replay_t;
+
+static mii_replay_t _replay;
+
+static uint32_t
+_mii_replay_hash(
+		mii_t *mii)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	mii_bank_t *main = &mii->bank[MII_BANK_MAIN];
+	for (uint32_t a = 0; a < 0xc000; a++)
+		h = (h ^ mii_bank_peek(main, a)) * 16777619u;
+	const uint8_t r[] = {
+		mii->cpu.A, mii->cpu.X, mii->cpu.Y, mii->cpu.S,
+		mii->cpu.PC & 0xff, mii->cpu.PC >> 8 };
+	for (unsigned i = 0; i < sizeof(r); i++)
+		h = (h ^ r[i]) * 16777619u;
+	return h;
+}
+
+static void
+_mii_replay_flush(
+		mii_replay_t *r)
+{
+	UINT bw;
+	if (r->pos && f_write(&r->f, r->buf, r->pos, &bw) != FR_OK) {
+		printf("%s write failed, recording stopped\n", __func__);
+		f_close(&r->f);
+		r->mode = MII_REPLAY_OFF;
+	}
+	r->pos = 0;
+}
+
+static void
+_mii_replay_put(
+		mii_replay_t *r,
+		uint8_t b)
+{
+	r->buf[r->pos++] = b;
+	if (r->pos == sizeof(r->buf))
+		_mii_replay_flush(r);
+}
+
+static int
+_mii_replay_get(
+		mii_replay_t *r)
+{
+	if (r->pos == r->fill) {
+		UINT br = 0;
+		if (f_read(&r->f, r->buf, sizeof(r->buf), &br) != FR_OK || !br)
+			return -1;
+		r->pos = 0;
+		r->fill = br;
+	}
+	return r->buf[r->pos++];
+}
+
+/* Read the next event into r->head, stops the playback at the end */
+static void
+_mii_replay_read(
+		mii_replay_t *r)
+{
+	mii_replay_ev_t *ev = &r->head;
+	uint64_t delta = 0;
+	int c, shift = 0;
+	r->have = false;
+	if ((c = _mii_replay_get(r)) < 0)
+		goto done;
+	ev->type = c;
+	do {
+		if ((c = _mii_replay_get(r)) < 0)
+			goto done;
+		delta |= (uint64_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	if ((c = _mii_replay_get(r)) < 0)
+		goto done;
+	ev->len = c;
+	for (int i = 0; i < ev->len; i++) {
+		if ((c = _mii_replay_get(r)) < 0)
+			goto done;
+		ev->data[i] = c;
+	}
+	r->last += delta;
+	ev->cycle = r->last;
+	r->have = true;
+	return;
+done:
+	printf("Replay: done, %lu events, %lu/%lu syncs matched\n",
+			(unsigned long)r->events,
+			(unsigned long)(r->syncs - r->bad_syncs),
+			(unsigned long)r->syncs);
+	mii_replay_stop();
+}
+
+int
+mii_replay_record(
+		mii_t *mii,
+		const char *path)
+{
+	mii_replay_t *r = &_replay;
+	mii_replay_stop();
+	if (f_open(&r->f, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+		printf("%s can't create %s\n", __func__, path);
+		return -1;
+	}
+	r->pos = 0;
+	r->mode = MII_REPLAY_REC;
+	r->last = mii->cpu.total_cycle;
+	r->next_sync = r->last;
+	r->events = 0;
+	const char *m = MII_REPLAY_MAGIC;
+	for (int i = 0; i < 4; i++)
+		_mii_replay_put(r, m[i]);
+	_mii_replay_put(r, MII_REPLAY_VERSION);
+	for (int i = 0; i < 3; i++)
+		_mii_replay_put(r, 0);
+	for (int i = 0; i < 8; i++)
+		_mii_replay_put(r, r->last >> (i * 8));
+	printf("Replay: recording to %s from cycle %llu\n", path,
+			(unsigned long long)r->last);
+	return 0;
+}
+
+int
+mii_replay_play(
+		mii_t *mii,
+		const char *path)
+{
+	mii_replay_t *r = &_replay;
+	mii_replay_stop();
+	if (f_open(&r->f, path, FA_READ) != FR_OK)
+		return -1;
+	uint8_t h[MII_REPLAY_HEADER];
+	UINT br = 0;
+	uint64_t start = 0;
+	if (f_read(&r->f, h, sizeof(h), &br) != FR_OK || br != sizeof(h) ||
+			memcmp(h, MII_REPLAY_MAGIC, 4) || h[4] != MII_REPLAY_VERSION) {
+		printf("%s %s is not a replay log\n", __func__, path);
+		f_close(&r->f);
+		return -1;
+	}
+	for (int i = 0; i < 8; i++)
+		start |= (uint64_t)h[8 + i] << (i * 8);
+	if (start != mii->cpu.total_cycle) {
+		printf("%s %s starts at cycle %llu, we're at %llu\n", __func__,
+				path, (unsigned long long)start,
+				(unsigned long long)mii->cpu.total_cycle);
+		f_close(&r->f);
+		return -1;
+	}
+	r->pos = r->fill = 0;
+	r->mode = MII_REPLAY_PLAY;
+	r->last = start;
+	r->events = r->syncs = r->bad_syncs = 0;
+	printf("Replay: playing %s from cycle %llu\n", path,
+			(unsigned long long)start);
+	_mii_replay_read(r);
+	return 0;
+}
+
+void
+mii_replay_stop(void)
+{
+	mii_replay_t *r = &_replay;
+	if (r->mode == MII_REPLAY_REC)
+		_mii_replay_flush(r);
+	if (r->mode != MII_REPLAY_OFF)
+		f_close(&r->f);
+	r->mode = MII_REPLAY_OFF;
+	r->have = false;
+}
+
+bool
+mii_replay_recording(void)
+{
+	return _replay.mode == MII_REPLAY_REC;
+}
+
+bool
+mii_replay_playing(void)
+{
+	return _replay.mode == MII_REPLAY_PLAY;
+}
+
+void
+mii_replay_log(
+		mii_t *mii,
+		uint8_t type,
+		const void *data,
+		uint8_t len)
+{
+	mii_replay_t *r = &_replay;
+	if (r->mode != MII_REPLAY_REC)
+		return;
+	uint64_t now = mii->cpu.total_cycle;
+	uint64_t delta = now - r->last;
+	r->last = now;
+	_mii_replay_put(r, type);
+	do {
+		_mii_replay_put(r, (delta & 0x7f) | (delta > 0x7f ? 0x80 : 0));
+		delta >>= 7;
+	} while (delta);
+	_mii_replay_put(r, len);
+	for (int i = 0; i < len; i++)
+		_mii_replay_put(r, ((const uint8_t *)data)[i]);
+	r->events++;
+}
+
+void
+mii_replay_frame(
+		mii_t *mii)
+{
+	mii_replay_t *r = &_replay;
+	if (r->mode != MII_REPLAY_REC || mii->cpu.total_cycle < r->next_sync)
+		return;
+	r->next_sync = mii->cpu.total_cycle + MII_REPLAY_SYNC_CYCLES;
+	uint32_t h = _mii_replay_hash(mii);
+	uint8_t d[4] = { h, h >> 8, h >> 16, h >> 24 };
+	mii_replay_log(mii, MII_REPLAY_SYNC, d, sizeof(d));
+	_mii_replay_flush(r);
+	if (r->mode == MII_REPLAY_REC)
+		f_sync(&r->f);
+}
+
+bool
+mii_replay_next(
+		mii_t *mii,
+		mii_replay_ev_t *ev)
+{
+	mii_replay_t *r = &_replay;
+	while (r->mode == MII_REPLAY_PLAY && r->have &&
+				r->head.cycle <= mii->cpu.total_cycle) {
+		mii_replay_ev_t *h = &r->head;
+		r->events++;
+		switch (h->type) {
+			case MII_REPLAY_SYNC: {
+				uint32_t want = h->data[0] | (h->data[1] << 8) |
+						(h->data[2] << 16) | ((uint32_t)h->data[3] << 24);
+				r->syncs++;
+				if (want != _mii_replay_hash(mii)) {
+					if (!r->bad_syncs)
+						printf("Replay: diverged before cycle %llu\n",
+								(unsigned long long)h->cycle);
+					r->bad_syncs++;
+				}
+			}	break;
+			case MII_REPLAY_CLOCK:
+				// the guest didn't read the clock where it did when recording
+				if (!r->bad_syncs)
+					printf("Replay: missed clock read at cycle %llu\n",
+							(unsigned long long)h->cycle);
+				r->bad_syncs++;
+				break;
+			default:
+				*ev = *h;
+				_mii_replay_read(r);
+				return true;
+		}
+		_mii_replay_read(r);
+	}
+	return false;
+}
+
+void
+mii_replay_clock(
+		mii_t *mii,
+		uint64_t *bcd)
+{
+	mii_replay_t *r = &_replay;
+	if (r->mode == MII_REPLAY_REC) {
+		uint8_t d[8];
+		for (int i = 0; i < 8; i++)
+			d[i] = *bcd >> (i * 8);
+		mii_replay_log(mii, MII_REPLAY_CLOCK, d, sizeof(d));
+	} else if (r->mode == MII_REPLAY_PLAY && r->have &&
+				r->head.type == MII_REPLAY_CLOCK) {
+		*bcd = 0;
+		for (int i = 0; i < 8; i++)
+			*bcd |= (uint64_t)r->head.data[i] << (i * 8);
+		r->events++;
+		_mii_replay_read(r);
+	}
+}
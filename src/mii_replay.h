@@ -0,0 +1,93 @@
+/*
+ * mii_replay.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct mii_t;
+
+/*
+ * Input record and replay. Every input that reaches the guest is logged
+ * with the cpu.total_cycle it was applied at; played back from the same
+ * starting state, the guest runs exactly the same instruction stream.
+ *
+ * The frontend applies the events itself, this only does the log. The
+ * No Slot Clock is the exception, its reads are substituted directly.
+ */
+enum {
+	MII_REPLAY_KEY = 1,		// [key]
+	MII_REPLAY_BUTTONS,		// [$C061, $C062, $C063]
+	MII_REPLAY_PADDLES,		// [paddle 0, paddle 1]
+	MII_REPLAY_RESET,		// [] cold reset
+	MII_REPLAY_MOUNT,		// [drive, MII_REPLAY_MOUNT_*, path...]
+	MII_REPLAY_CLOCK,		// [NSC BCD time, 8 bytes LSB first]
+	MII_REPLAY_SYNC,		// [RAM/registers hash, 4 bytes LSB first]
+};
+
+#define MII_REPLAY_MOUNT_BOOT	(1 << 0)
+#define MII_REPLAY_MOUNT_RO		(1 << 1)
+
+typedef struct mii_replay_ev_t {
+	uint64_t			cycle;
+	uint8_t				type;
+	uint8_t				len;
+	uint8_t				data[256];	// len is at most 255, +1 for a zero
+} mii_replay_ev_t;
+
+/*
+ * Start logging to 'path' (truncated). The current total_cycle is stored
+ * in the header, a replay only starts from the same cycle.
+ */
+int
+mii_replay_record(
+		struct mii_t *mii,
+		const char *path);
+/*
+ * Start playing 'path' back. Returns -1 if there is no such file or it
+ * was recorded from another starting point.
+ */
+int
+mii_replay_play(
+		struct mii_t *mii,
+		const char *path);
+void
+mii_replay_stop(void);
+bool
+mii_replay_recording(void);
+bool
+mii_replay_playing(void);
+/* Log an event at the current cycle, does nothing unless recording */
+void
+mii_replay_log(
+		struct mii_t *mii,
+		uint8_t type,
+		const void *data,
+		uint8_t len);
+/*
+ * Called once per frame before any input is applied. When recording,
+ * logs the periodic RAM hash (checked by mii_replay_next() on playback)
+ * and syncs the log to the card.
+ */
+void
+mii_replay_frame(
+		struct mii_t *mii);
+/*
+ * Playback: returns true with the next event in 'ev' as long as it is due
+ * at the current cycle. CLOCK and SYNC events are handled internally.
+ */
+bool
+mii_replay_next(
+		struct mii_t *mii,
+		mii_replay_ev_t *ev);
+/*
+ * No Slot Clock latch; logs the time when recording, replaces it with
+ * the logged one when playing back.
+ */
+void
+mii_replay_clock(
+		struct mii_t *mii,
+		uint64_t *bcd);
@@ -288,6 +288,18 @@ static const uint8_t mii_rom_smartport[] = {
 0xeb,0xfb,0x00,0x80,0x0b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
 0xb0,0x03,0xa9,0x00,0x60,0xa9,0x27,0x60,0x00,0x00,0x00,0x00,0x00,0x00,0x17,0xc0,
 };
+/*
+ * Also used by other block devices (the flash ROM disk card) as a generic
+ * trap based ProDOS boot/block driver ROM.
+ */
+static mii_rom_t _mii_rom_smartport = {
+	.name = "smartport",
+	.class = "card",
+	.description = "SmartPort card ROM",
+	.rom = mii_rom_smartport,
+	.len = sizeof(mii_rom_smartport),
+};
+MII_ROM(_mii_rom_smartport);
 
 static int
 _mii_sm_init(
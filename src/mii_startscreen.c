@@ -302,13 +302,15 @@ int mii_startscreen_show(mii_startscreen_info_t *info) {
     content_y = win_y + win_h - LINE_HEIGHT - 4;
     draw_centered_string(buffer, screen_w, content_y, "Initializing...", COLOR_GREEN);
     
-    MII_DEBUG_PRINTF("Start screen: Rendered, waiting 3s...\n");
+    MII_DEBUG_PRINTF("Start screen: Rendered, waiting %lu ms...\n", (unsigned long)info->hold_ms);
 
-    // Show for 3 seconds using busy-wait
+    // Hold using busy-wait
     // NOTE: sleep_ms() causes HDMI signal instability, likely due to low-power mode
+    // Core 1 isn't running yet when the splash is held, so this wait also
+    // restarts a stalled scanout
     uint32_t start_time = time_us_32();
-    while (time_us_32() - start_time < 3000000) {
-        tight_loop_contents();
+    while (time_us_32() - start_time < info->hold_ms * 1000) {
+        hdmi_check_and_restart();
     }
 
     MII_DEBUG_PRINTF("Start screen: Complete\n");
@@ -20,6 +20,7 @@ typedef struct {
     uint32_t psram_sz;
 #endif
     uint8_t board_variant;
+    uint32_t hold_ms;       // busy wait this long after drawing, 0 returns at once
 } mii_startscreen_info_t;
 
 /**
@@ -1079,6 +1079,10 @@ mii_video_full_refresh(
 }
 #endif // MII_RP2350
 
+#if MII_RP2350 && WITH_NTSC_COMPOSITE
+static void _mii_ntsc_init(void);
+#endif
+
 void
 mii_video_init(
 	mii_t *mii)
@@ -1102,6 +1106,9 @@ mii_video_init(
 	mii_bank_poke(sw, SWAN3_REGISTER, 1);
 	_mii_video_mode_changed(&mii->video, mii->sw_state);
 	mii_video_set_mode(mii, 0);
+#if MII_RP2350 && WITH_NTSC_COMPOSITE
+	_mii_ntsc_init();
+#endif
 }
 
 typedef struct {
@@ -1458,6 +1465,170 @@ const uint8_t rp2350_ci_to_hw[16] = {
 extern volatile int lock_y;
 static uint8_t line_buffer[320 / 2] __aligned(4) __scratch_x("line_buffer");
 
+#if WITH_NTSC_COMPOSITE
+/*
+ * Composite (NTSC) artifact colour. The video hardware shifts out 560 dots
+ * per line at 4x the colour subcarrier; what a TV shows at any one dot is
+ * the colour of the 4 dot window around it, so colour fringes follow every
+ * edge instead of snapping to 7 or 4 pixel cells.
+ *
+ * HGR, DHGR and the mixed mode text lines are all turned into that dot
+ * stream first, then converted 280 pixels wide (2 dots per pixel, 20px
+ * borders). A framebuffer byte is two pixels, the two 4 dot windows centred
+ * on them both fit in the 6 dots starting one dot before the pair, and as
+ * pairs always start on a multiple of 4 dots the subcarrier phase is the
+ * same for all of them: one lookup in a 64 entry table per byte.
+ */
+typedef struct ntsc_line_t {
+	uint32_t	dots[19];	// bit n is dot n - 1 (DHGR numbering)
+	uint64_t	acc;
+	uint8_t		n;			// bits pending in acc
+	uint8_t		w;			// next word in dots[]
+} ntsc_line_t;
+
+static uint8_t ntsc_lut[64];
+static uint16_t ntsc_dbl[128];	// 7 pixels -> 14 dots
+
+static void
+_mii_ntsc_init(void)
+{
+	for (int i = 0; i < 128; i++) {
+		uint16_t d = 0;
+		for (int b = 0; b < 7; b++)
+			if (i & (1 << b))
+				d |= 3 << (b * 2);
+		ntsc_dbl[i] = d;
+	}
+	/*
+	 * Window bit j is dot 4k - 1 + j; same phase to colour mapping as the
+	 * DHGR decoder above, so solid fills come out the same colours.
+	 */
+	for (int w = 0; w < 64; w++) {
+		uint8_t lut = 0;
+		for (int p = 0; p < 2; p++) {
+			uint8_t nib = 0;
+			for (int j = p * 2; j < p * 2 + 4; j++)
+				if (w & (1 << j))
+					nib |= 1 << (3 - ((j + 3) & 3));
+			uint8_t ci = (uint8_t)mii_base_clut.dhires[nib];
+			lut |= rp2350_ci_to_hw[ci & 0x0f] << (p * 4);
+		}
+		ntsc_lut[w] = lut;
+	}
+}
+
+/* HGR and 40 column text start one dot before DHGR and 80 columns */
+static inline void
+_mii_ntsc_start(
+		ntsc_line_t *l,
+		bool hires)
+{
+	l->acc = 0;
+	l->n = hires ? 0 : 1;
+	l->w = 0;
+}
+
+static inline void
+_mii_ntsc_put(
+		ntsc_line_t *l,
+		uint32_t dots,
+		int count)
+{
+	l->acc |= (uint64_t)dots << l->n;
+	l->n += count;
+	if (l->n >= 32) {
+		l->dots[l->w++] = (uint32_t)l->acc;
+		l->acc >>= 32;
+		l->n -= 32;
+	}
+}
+
+static void __attribute__((hot))
+_mii_ntsc_emit(
+		ntsc_line_t *l,
+		uint8_t *fb_row)
+{
+	while (l->w < 19) {
+		l->dots[l->w++] = (uint32_t)l->acc;
+		l->acc >>= 32;
+	}
+	fb_row += (320 - 280) / 2 / 2;
+	for (int k = 0; k < 140; k++) {
+		int bit = k * 4;
+		uint64_t v = l->dots[bit >> 5] |
+						((uint64_t)l->dots[(bit >> 5) + 1] << 32);
+		fb_row[k] = ntsc_lut[(v >> (bit & 31)) & 63];
+	}
+}
+
+/*
+ * HGR: each pixel is 2 dots, bit 7 delays the byte by one dot, the first
+ * one then repeats the last dot of the previous byte.
+ */
+static void __attribute__((hot))
+_mii_ntsc_hires_line(
+		const uint8_t *row,
+		uint8_t *fb_row)
+{
+	ntsc_line_t l;
+	uint32_t last = 0;
+	_mii_ntsc_start(&l, true);
+	for (int col = 0; col < 40; col++) {
+		uint8_t b = row[col];
+		uint32_t d = ntsc_dbl[b & 0x7f];
+		if (b & 0x80)
+			d = ((d << 1) | last) & 0x3fff;
+		last = (b >> 6) & 1;
+		_mii_ntsc_put(&l, d, 14);
+	}
+	_mii_ntsc_emit(&l, fb_row);
+}
+
+static void __attribute__((hot))
+_mii_ntsc_dhires_line(
+		const uint8_t *main_row,
+		const uint8_t *aux_row,
+		uint8_t *fb_row)
+{
+	ntsc_line_t l;
+	_mii_ntsc_start(&l, false);
+	for (int col = 0; col < 40; col++) {
+		_mii_ntsc_put(&l, aux_row[col] & 0x7f, 7);
+		_mii_ntsc_put(&l, main_row[col] & 0x7f, 7);
+	}
+	_mii_ntsc_emit(&l, fb_row);
+}
+
+/* One scanline ('cy') of a text row; aux_row is NULL in 40 columns */
+static void __attribute__((hot))
+_mii_ntsc_text_line(
+		const uint8_t *main_row,
+		const uint8_t *aux_row,
+		const uint8_t *rom_base,
+		int cy,
+		bool altset,
+		int flash,
+		uint8_t *fb_row)
+{
+	ntsc_line_t l;
+	_mii_ntsc_start(&l, !aux_row);
+	for (int x = 0; x < 40; x++) {
+		for (int m = aux_row ? 0 : 1; m < 2; m++) {
+			uint8_t c = m ? main_row[x] : aux_row[x];
+			if (!altset && c >= 0x40 && c <= 0x7F)
+				c = (int)c + flash;
+			// the ROM has the glyphs inverted
+			uint8_t bits = ~rom_base[(c << 3) + cy] & 0x7f;
+			if (aux_row)
+				_mii_ntsc_put(&l, bits, 7);
+			else
+				_mii_ntsc_put(&l, ntsc_dbl[bits], 14);
+		}
+	}
+	_mii_ntsc_emit(&l, fb_row);
+}
+#endif
+
 // Render text mode (40 column) to framebuffer - OPTIMIZED
 static void __attribute__((hot))
 mii_video_render_text40_rp2350(
@@ -1613,6 +1784,15 @@ mii_video_render_text40_mixed_rp2350(
 
             memset(line_buffer, 0, fb_width);
 
+#if WITH_NTSC_COMPOSITE
+			// the colour burst is on in mixed mode, text gets fringes too
+			if (!video->monochrome) {
+				if (col80)
+					mii_bank_read(aux_bank, line_addr, aux_row, 40);
+				_mii_ntsc_text_line(main_row, col80 ? aux_row : NULL,
+						rom_base, cy, altset, flash, line_buffer);
+			} else
+#endif
 			if (!col80) {
 				for (int x = 0; x < 40; x++) {
 					uint8_t c = main_row[x];
@@ -1713,51 +1893,58 @@ mii_video_render_hires_rp2350(
 		// Clear the whole row to black so borders don't retain stale pixels.
 		memset(fb_row, HW_BLACK, (size_t)(fb_width >> 1));
 
-		uint8_t b0 = 0;
-		uint8_t b1 = line_buf[0];
-		for (int col = 0; col < 40; col++) {
-			uint8_t b2 = (col == 39) ? 0 : line_buf[col + 1];
-			// last 2 pixels, current 7 pixels, next 2 pixels
-			uint16_t run = ((b0 & 0x60) >> 5) |
-						((b1 & 0x7f) << 2) |
-						((b2 & 0x03) << 9);
-			int odd = (col & 1) << 1;
-			int offset = (b1 & 0x80) >> 5; // 0 or 4
+#if WITH_NTSC_COMPOSITE
+		if (!mono)
+			_mii_ntsc_hires_line(line_buf, fb_row);
+		else
+#endif
+		{
+			uint8_t b0 = 0;
+			uint8_t b1 = line_buf[0];
+			for (int col = 0; col < 40; col++) {
+				uint8_t b2 = (col == 39) ? 0 : line_buf[col + 1];
+				// last 2 pixels, current 7 pixels, next 2 pixels
+				uint16_t run = ((b0 & 0x60) >> 5) |
+							((b1 & 0x7f) << 2) |
+							((b2 & 0x03) << 9);
+				int odd = (col & 1) << 1;
+				int offset = (b1 & 0x80) >> 5; // 0 or 4
 
-			for (int i = 0; i < 7; i++) {
-				uint8_t left = (run >> (1 + i)) & 1;
-				uint8_t pixel = (run >> (2 + i)) & 1;
-				uint8_t right = (run >> (3 + i)) & 1;
-				int idx = 0; // black
-				if (!mono) {
-					if (pixel) {
-						if (left || right) {
-							idx = 9; // white
+				for (int i = 0; i < 7; i++) {
+					uint8_t left = (run >> (1 + i)) & 1;
+					uint8_t pixel = (run >> (2 + i)) & 1;
+					uint8_t right = (run >> (3 + i)) & 1;
+					int idx = 0; // black
+					if (!mono) {
+						if (pixel) {
+							if (left || right) {
+								idx = 9; // white
+							} else {
+								idx = offset + odd + (i & 1) + 1;
+							}
 						} else {
-							idx = offset + odd + (i & 1) + 1;
+							if (left && right) {
+								idx = offset + odd + 1 - (i & 1) + 1;
+							}
 						}
+						uint8_t ci = (uint8_t)mii_base_clut.hires[idx];
+						uint8_t hw = rp2350_ci_to_hw[ci & 0x0f];
+						int x = x_off + col * 7 + i;
+						if (x & 1)
+							fb_row[x >> 1] |= hw << 4;
+						else
+							fb_row[x >> 1] |= hw;
 					} else {
-						if (left && right) {
-							idx = offset + odd + 1 - (i & 1) + 1;
-						}
+						int x = x_off + col * 7 + i;
+						if (x & 1)
+							fb_row[x >> 1] |= pixel ? (HW_WHITE << 4) : (HW_BLACK << 4);
+						else
+							fb_row[x >> 1] |= pixel ? HW_WHITE : HW_BLACK;
 					}
-					uint8_t ci = (uint8_t)mii_base_clut.hires[idx];
-					uint8_t hw = rp2350_ci_to_hw[ci & 0x0f];
-					int x = x_off + col * 7 + i;
-					if (x & 1)
-						fb_row[x >> 1] |= hw << 4;
-					else
-						fb_row[x >> 1] |= hw;
-				} else {
-					int x = x_off + col * 7 + i;
-					if (x & 1)
-						fb_row[x >> 1] |= pixel ? (HW_WHITE << 4) : (HW_BLACK << 4);
-					else
-						fb_row[x >> 1] |= pixel ? HW_WHITE : HW_BLACK;
 				}
+				b0 = b1;
+				b1 = b2;
 			}
-			b0 = b1;
-			b1 = b2;
 		}
 		for(int l = 0; l < 100 && fb_y == lock_y; ++l) {
 			tight_loop_contents();
@@ -1822,6 +2009,10 @@ mii_video_render_dhires_rp2350(
 				}
 			}
 		}
+#if WITH_NTSC_COMPOSITE
+		else
+			_mii_ntsc_dhires_line(main_row, aux_row, fb_row);
+#else
 		else {
 			// Color: build a bit buffer for 80 bytes (AUX/MAIN interleaved)
 			uint8_t bits[71] = {0};
@@ -1852,6 +2043,7 @@ mii_video_render_dhires_rp2350(
 				}
 			}
 		}
+#endif
 		for(int l = 0; l < 100 && fb_y == lock_y; ++l) {
 			tight_loop_contents();
 			sleep_ms(1); // unsure unlocked, but wait not more than 100ms, to avoid busy-lock
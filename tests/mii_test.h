@@ -0,0 +1,53 @@
+/*
+ * mii_test.h
+ *
+ * Bare bones assertions for the host tests; a failed check prints where
+ * it was and the test keeps going, main() returns TEST_DONE().
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int test_failed;
+
+#define TEST_ASSERT(_c) do { \
+		if (!(_c)) { \
+			printf("%s:%d: FAILED %s\n", __FILE__, __LINE__, #_c); \
+			test_failed++; \
+		} \
+	} while (0)
+
+#define TEST_EQ(_a, _b) do { \
+		unsigned long long _va = (_a), _vb = (_b); \
+		if (_va != _vb) { \
+			printf("%s:%d: FAILED %s == %s (%llx != %llx)\n", \
+					__FILE__, __LINE__, #_a, #_b, _va, _vb); \
+			test_failed++; \
+		} \
+	} while (0)
+
+/* the same LCG everywhere, so a failing run repeats from the seed */
+static uint32_t test_seed = 1;
+
+static inline uint32_t
+_rand(void)
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return test_seed >> 8;
+}
+
+#define TEST_DONE() (printf("%s: %s\n", __FILE__, \
+		test_failed ? "FAILED" : "passed"), !!test_failed)
+
+/* monotonic time in nanoseconds, for the benchmarks */
+static inline uint64_t
+test_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,122 @@
+/*
+ * ramdisk.c
+ *
+ * FatFs diskio.h on a RAM image, see ramdisk.h
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "ff.h"
+#include "diskio.h"
+#include "ramdisk.h"
+
+uint8_t *ramdisk;
+ramdisk_stats_t ramdisk_stats;
+long ramdisk_cut = -1;
+
+static long last_end = -1;
+static FATFS fs;
+
+DSTATUS
+disk_initialize(
+		BYTE pdrv)
+{
+	(void)pdrv;
+	if (!ramdisk)
+		ramdisk = calloc(RAMDISK_SECTORS, 512);
+	return ramdisk ? 0 : STA_NOINIT;
+}
+
+DSTATUS
+disk_status(
+		BYTE pdrv)
+{
+	(void)pdrv;
+	return ramdisk ? 0 : STA_NOINIT;
+}
+
+DRESULT
+disk_read(
+		BYTE pdrv,
+		BYTE *buff,
+		LBA_t sector,
+		UINT count)
+{
+	(void)pdrv;
+	if (sector + count > RAMDISK_SECTORS)
+		return RES_PARERR;
+	ramdisk_stats.rd_cmds++;
+	ramdisk_stats.rd_sectors += count;
+	memcpy(buff, ramdisk + sector * 512, count * 512);
+	return RES_OK;
+}
+
+DRESULT
+disk_write(
+		BYTE pdrv,
+		const BYTE *buff,
+		LBA_t sector,
+		UINT count)
+{
+	(void)pdrv;
+	if (sector + count > RAMDISK_SECTORS)
+		return RES_PARERR;
+	ramdisk_stats.wr_cmds++;
+	if ((long)sector != last_end)
+		ramdisk_stats.wr_seeks++;
+	last_end = sector + count;
+	for (UINT i = 0; i < count; i++, ramdisk_stats.wr_sectors++) {
+		if (ramdisk_cut >= 0 && (long)ramdisk_stats.wr_sectors >= ramdisk_cut)
+			continue;
+		memcpy(ramdisk + (sector + i) * 512, buff + i * 512, 512);
+	}
+	return RES_OK;
+}
+
+DRESULT
+disk_ioctl(
+		BYTE pdrv,
+		BYTE cmd,
+		void *buff)
+{
+	(void)pdrv;
+	switch (cmd) {
+		case GET_SECTOR_COUNT:
+			*(LBA_t *)buff = RAMDISK_SECTORS;
+			return RES_OK;
+		case GET_SECTOR_SIZE:
+			*(WORD *)buff = 512;
+			return RES_OK;
+		case GET_BLOCK_SIZE:
+			*(DWORD *)buff = 1;
+			return RES_OK;
+		case CTRL_SYNC:
+			return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+DWORD
+get_fattime(void)
+{
+	return 0x5a210000;
+}
+
+int
+ramdisk_format(void)
+{
+	static BYTE work[4096];
+	const MKFS_PARM opt = { FM_FAT, 0, 0, 0, 32768 };
+
+	if (f_mkfs("", &opt, work, sizeof(work)) != FR_OK)
+		return -1;
+	return f_mount(&fs, "", 1) == FR_OK ? 0 : -1;
+}
+
+int
+ramdisk_remount(void)
+{
+	f_mount(NULL, "", 0);
+	return f_mount(&fs, "", 1) == FR_OK ? 0 : -1;
+}
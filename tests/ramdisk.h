@@ -0,0 +1,35 @@
+/*
+ * ramdisk.h
+ *
+ * FatFs disk I/O on a 64MB RAM image for the host tests, counting every
+ * command the card would see. A power cut is simulated by dropping all
+ * the sectors written past ramdisk_cut.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define RAMDISK_SECTORS		(64u * 1024 * 1024 / 512)
+
+typedef struct ramdisk_stats_t {
+	unsigned long rd_cmds, rd_sectors;
+	unsigned long wr_cmds, wr_sectors;
+	/* write commands that don't carry on from where the last one ended:
+	 * each of those costs an SD card an erase block read-modify-write */
+	unsigned long wr_seeks;
+} ramdisk_stats_t;
+
+extern uint8_t *ramdisk;
+extern ramdisk_stats_t ramdisk_stats;
+/* sectors written once wr_sectors reaches this are dropped, -1 for none */
+extern long ramdisk_cut;
+
+/* formats the image FAT (16, at that size) with 32K clusters and mounts
+ * it, 0 on success */
+int
+ramdisk_format(void);
+/* drops the FatFs state and mounts again, as after a power cycle */
+int
+ramdisk_remount(void);
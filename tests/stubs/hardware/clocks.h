@@ -0,0 +1,14 @@
+/*
+ * hardware/clocks.h
+ *
+ * Host stand-in for the Pico SDK clocks API.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
+
+enum clock_index { clk_sys = 5 };
+
+static inline uint32_t clock_get_hz(enum clock_index c) { (void)c; return 252000000; }
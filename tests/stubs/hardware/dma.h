@@ -0,0 +1,86 @@
+/*
+ * hardware/dma.h
+ *
+ * Host stand-in for the Pico SDK DMA API. The registers are plain
+ * memory and the channel calls do nothing, but for the sniffer: a
+ * triggered transfer on the sniffed channel runs its CRC over the source.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
+
+enum dma_channel_transfer_size { DMA_SIZE_8, DMA_SIZE_16, DMA_SIZE_32 };
+
+#define DREQ_PIO0_TX0					0
+#define DREQ_PIO1_TX0					8
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32		0x0
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32R	0x1
+
+typedef struct {
+	volatile const void *read_addr;
+	volatile void *write_addr;
+	volatile uint32_t transfer_count;
+	volatile uint32_t ctrl_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+	dma_channel_hw_t ch[16];
+	volatile uint32_t ints0;
+} dma_hw_t;
+
+static dma_hw_t _host_dma_hw;
+#define dma_hw							(&_host_dma_hw)
+
+typedef struct { uint32_t ctrl; } dma_channel_config;
+
+#define _HOST_DMA_SIZE(_c)				((_c)->ctrl & 3)
+#define _HOST_DMA_SNIFF					(1u << 2)
+
+static struct {
+	int channel;			// -1: sniffer off
+	uint32_t acc;
+} _host_dma_sniff = { .channel = -1 };
+
+static inline int dma_claim_unused_channel(bool required) { (void)required; return 0; }
+static inline dma_channel_config dma_channel_get_default_config(uint ch)
+{ (void)ch; return (dma_channel_config){ 0 }; }
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+		enum dma_channel_transfer_size s) { c->ctrl = (c->ctrl & ~3u) | s; }
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool en)
+{ c->ctrl = en ? c->ctrl | _HOST_DMA_SNIFF : c->ctrl & ~_HOST_DMA_SNIFF; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool i) { (void)c; (void)i; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool i) { (void)c; (void)i; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint d) { (void)c; (void)d; }
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint ch) { (void)c; (void)ch; }
+static inline void dma_channel_configure(uint ch, const dma_channel_config *c,
+		volatile void *wr, const volatile void *rd, uint count, bool trigger)
+{
+	(void)wr;
+	if (!trigger || !(c->ctrl & _HOST_DMA_SNIFF) || (int)ch != _host_dma_sniff.channel)
+		return;
+	/* whatever the mode, CRC32R: CRC-32 (0x04c11db7) bit reversed, no
+	 * final xor; it's the only one the sources use */
+	const volatile uint8_t *p = (const volatile uint8_t *)rd;
+	uint32_t crc = _host_dma_sniff.acc;
+	for (uint32_t n = count << _HOST_DMA_SIZE(c); n--; ) {
+		crc ^= *p++;
+		for (int b = 0; b < 8; b++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	_host_dma_sniff.acc = crc;
+}
+static inline void dma_channel_wait_for_finish_blocking(uint ch) { (void)ch; }
+static inline void dma_sniffer_enable(uint ch, uint mode, bool force)
+{ (void)mode; (void)force; _host_dma_sniff.channel = ch; }
+static inline void dma_sniffer_disable(void) { _host_dma_sniff.channel = -1; }
+static inline void dma_sniffer_set_data_accumulator(uint32_t v) { _host_dma_sniff.acc = v; }
+static inline uint32_t dma_sniffer_get_data_accumulator(void) { return _host_dma_sniff.acc; }
+static inline void dma_channel_set_read_addr(uint ch, const volatile void *rd, bool trigger)
+{ (void)ch; (void)rd; (void)trigger; }
+static inline void dma_channel_set_trans_count(uint ch, uint32_t count, bool trigger)
+{ (void)ch; (void)count; (void)trigger; }
+static inline void dma_channel_set_irq0_enabled(uint ch, bool en) { (void)ch; (void)en; }
+static inline void dma_start_channel_mask(uint32_t mask) { (void)mask; }
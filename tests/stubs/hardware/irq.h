@@ -0,0 +1,18 @@
+/*
+ * hardware/irq.h
+ *
+ * Host stand-in for the Pico SDK interrupt API; nothing is ever raised.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
+
+#define DMA_IRQ_0						10
+#define DMA_IRQ_1						11
+
+typedef void (*irq_handler_t)(void);
+
+static inline void irq_set_exclusive_handler(uint num, irq_handler_t h) { (void)num; (void)h; }
+static inline void irq_set_enabled(uint num, bool en) { (void)num; (void)en; }
@@ -0,0 +1,61 @@
+/*
+ * hardware/pio.h
+ *
+ * Host stand-in for the Pico SDK PIO API. The registers are plain
+ * memory and the state machine calls do nothing.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
+
+#define GPIO_OUT						1
+
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE, PIO_FIFO_JOIN_TX, PIO_FIFO_JOIN_RX };
+
+struct pio_program {
+	const uint16_t *instructions;
+	uint8_t length;
+	int8_t origin;
+};
+
+typedef struct {
+	volatile uint32_t clkdiv;
+	volatile uint32_t execctrl;
+	volatile uint32_t shiftctrl;
+	volatile uint32_t pinctrl;
+} pio_sm_hw_t;
+
+typedef struct {
+	volatile uint32_t txf[4];
+	pio_sm_hw_t sm[4];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+static pio_hw_t _host_pio[2];
+#define pio0							(&_host_pio[0])
+#define pio1							(&_host_pio[1])
+
+typedef struct { uint32_t clkdiv, execctrl, shiftctrl, pinctrl; } pio_sm_config;
+
+static inline uint pio_add_program(PIO pio, const struct pio_program *p) { (void)pio; (void)p; return 0; }
+static inline int pio_claim_unused_sm(PIO pio, bool required) { (void)pio; (void)required; return 0; }
+static inline void pio_gpio_init(PIO pio, uint pin) { (void)pio; (void)pin; }
+static inline void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool out)
+{ (void)pio; (void)sm; (void)pin; (void)count; (void)out; }
+static inline pio_sm_config pio_get_default_sm_config(void) { return (pio_sm_config){ 0 }; }
+static inline void sm_config_set_wrap(pio_sm_config *c, uint target, uint wrap)
+{ (void)c; (void)target; (void)wrap; }
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join j) { (void)c; (void)j; }
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool right, bool autopull, uint threshold)
+{ (void)c; (void)right; (void)autopull; (void)threshold; }
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint base, uint count)
+{ (void)c; (void)base; (void)count; }
+static inline void pio_sm_init(PIO pio, uint sm, uint offset, const pio_sm_config *c)
+{ (void)pio; (void)sm; (void)offset; (void)c; }
+static inline void pio_sm_set_enabled(PIO pio, uint sm, bool en) { (void)pio; (void)sm; (void)en; }
+
+static inline void gpio_init(uint pin) { (void)pin; }
+static inline void gpio_set_dir(uint pin, bool out) { (void)pin; (void)out; }
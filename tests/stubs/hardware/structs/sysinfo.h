@@ -0,0 +1,10 @@
+/*
+ * hardware/structs/sysinfo.h
+ *
+ * Empty host stand-in, the sources only need it to exist.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
@@ -0,0 +1,10 @@
+/*
+ * hardware/sync.h
+ *
+ * Host stand-in for the Pico SDK barriers; the tests are single threaded.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
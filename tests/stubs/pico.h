@@ -0,0 +1,33 @@
+/*
+ * pico.h
+ *
+ * Host stand-in for the Pico SDK base header, just enough for the
+ * sources the tests build.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define __aligned(_x)					__attribute__((aligned(_x)))
+#define __not_in_flash(_x)
+#define __not_in_flash_func(_f)			_f
+#define __no_inline_not_in_flash_func(_f)	_f
+#define __time_critical_func(_f)		_f
+#define __scratch_x(_x)
+#define __scratch_y(_x)
+
+static inline void __dmb(void) {}
+static inline void tight_loop_contents(void) {}
+
+#ifndef MIN
+#define MIN(_a, _b)						((_a) < (_b) ? (_a) : (_b))
+#endif
+#ifndef MAX
+#define MAX(_a, _b)						((_a) > (_b) ? (_a) : (_b))
+#endif
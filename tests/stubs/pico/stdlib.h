@@ -0,0 +1,7 @@
+#pragma once
+#include <pico.h>
+
+#define PICO_DEFAULT_LED_PIN			25
+
+void sleep_ms(uint32_t ms);
+static inline void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
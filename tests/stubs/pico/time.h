@@ -0,0 +1,29 @@
+/*
+ * pico/time.h
+ *
+ * Host stand-in for the Pico SDK timer: a mock microsecond clock the
+ * tests move by hand, so what gets timed is exact; with PICO_HOST_CLOCK
+ * it is the host's monotonic clock, for the benchmarks.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "pico.h"
+
+#if PICO_HOST_CLOCK
+#include <time.h>
+
+static inline uint64_t time_us_64(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+#else
+static uint32_t _host_time_us;
+
+static inline uint32_t time_us_32(void) { return _host_time_us; }
+static inline uint64_t time_us_64(void) { return _host_time_us; }
+#endif
@@ -0,0 +1,338 @@
+/*
+ * test_65c02_irq.c
+ *
+ * 65C02 core interrupt entry, now that the instruction loop only tests
+ * cpu->attention: the IRQ line raised and cleared with mii_cpu_irq() (from
+ * the test and from a device on the bus), IRQ masked then unmasked by CLI,
+ * PLP and RTI, NMI, BRK, and the $EB $FB trap. Every interrupt has to be
+ * taken at the next instruction boundary, with the right return address
+ * and P on the stack, and never after the line was dropped. A fixed loop
+ * is then timed in ns per instruction, as it runs and with the attention
+ * byte forced on at every access, which costs every instruction the
+ * interrupt checks the loop used to make before each opcode fetch.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mii_test.h"
+#include "mii_65c02.h"
+
+#define MAIN	0x0400
+#define ISR		0x0800	// NOP, RTI
+#define NMI		0x0900	// NOP, RTI
+#define DEV_ISR	0x0a00	// acks the device, RTI
+#define DEV_ON	0xc0f0	// a write raises the device IRQ
+#define DEV_OFF	0xc0f1	// and this one clears it
+
+static uint8_t ram[0x10000];
+static mii_cpu_t cpu;
+static mii_cpu_state_t s;
+/* address of every opcode fetched, since the last run */
+static uint16_t ops[64];
+static int op_count;
+
+static mii_cpu_state_t
+_access(
+		struct mii_cpu_t *cpu,
+		mii_cpu_state_t access)
+{
+	if (access.sync && op_count < (int)(sizeof(ops) / sizeof(ops[0])))
+		ops[op_count++] = access.addr;
+	if (access.w) {
+		ram[access.addr] = access.data;
+		if (access.addr == DEV_ON || access.addr == DEV_OFF)
+			mii_cpu_irq(cpu, access.addr == DEV_ON);
+	} else
+		access.data = ram[access.addr];
+	return access;
+}
+
+static void
+poke(
+		uint16_t addr,
+		const uint8_t *p,
+		int len)
+{
+	memcpy(ram + addr, p, len);
+}
+
+/* fresh CPU at MAIN, I clear, NOPs everywhere in the main program */
+static void
+setup(
+		const uint8_t *prog,
+		int len)
+{
+	static const uint8_t isr[] = { 0xea, 0x40 };
+	static const uint8_t dev_isr[] = { 0x8d, DEV_OFF & 0xff, DEV_OFF >> 8, 0x40 };
+
+	memset(ram, 0xea, sizeof(ram));
+	poke(MAIN, prog, len);
+	poke(ISR, isr, sizeof(isr));
+	poke(NMI, isr, sizeof(isr));
+	poke(DEV_ISR, dev_isr, sizeof(dev_isr));
+	ram[0xfffa] = NMI & 0xff; ram[0xfffb] = NMI >> 8;
+	ram[0xfffe] = ISR & 0xff; ram[0xffff] = ISR >> 8;
+
+	memset(&cpu, 0, sizeof(cpu));
+	cpu.access = _access;
+	cpu.PC = MAIN;
+	cpu.S = 0xff;
+	MII_SET_P(&cpu, 0);
+	s = (mii_cpu_state_t) { .raw = 0 };
+}
+
+/* one instruction (after the interrupt entry, if one is taken); returns
+ * where its opcode was */
+static uint16_t
+step(void)
+{
+	op_count = 0;
+	cpu.instruction_run = 0;
+	s = mii_cpu_run(&cpu, s);
+	TEST_EQ(op_count, 1);
+	return ops[0];
+}
+
+/* what the last interrupt entry pushed */
+static uint16_t
+pushed_pc(void)
+{
+	return ram[0x100 + cpu.S + 2] | (ram[0x100 + cpu.S + 3] << 8);
+}
+
+static uint8_t
+pushed_p(void)
+{
+	return ram[0x100 + cpu.S + 1];
+}
+
+static void
+test_raise_clear(void)
+{
+	setup(NULL, 0);
+	TEST_EQ(step(), MAIN);
+	TEST_EQ(cpu.attention, 0);
+
+	/* raised and dropped between two instructions: nothing */
+	mii_cpu_irq(&cpu, 1);
+	mii_cpu_irq(&cpu, 0);
+	TEST_EQ(step(), MAIN + 1);
+
+	mii_cpu_irq(&cpu, 1);
+	TEST_EQ(cpu.attention, 1);
+	TEST_EQ(step(), ISR);
+	TEST_EQ(pushed_pc(), MAIN + 2);
+	TEST_EQ(pushed_p() & 0x10, 0);	// B clear, not a BRK
+	TEST_EQ(cpu.P.I, 1);
+	/* the line is a level: still up at the RTI, taken again right away */
+	TEST_EQ(step(), ISR + 1);
+	TEST_EQ(step(), ISR);
+	TEST_EQ(pushed_pc(), MAIN + 2);
+	/* acked in the ISR, RTI goes back for good */
+	mii_cpu_irq(&cpu, 0);
+	TEST_EQ(step(), ISR + 1);
+	TEST_EQ(step(), MAIN + 2);
+	TEST_EQ(step(), MAIN + 3);
+	TEST_EQ(cpu.attention, 0);
+}
+
+/* raised with I set: held off, and nothing to look at until unmasked;
+ * returns where the IRQ came in */
+static uint16_t
+test_unmask(
+		const char *name,
+		const uint8_t *prog,
+		int len,
+		int steps)	// instructions up to the unmasking one
+{
+	setup(prog, len);
+	TEST_EQ(step(), MAIN);	// SEI
+	mii_cpu_irq(&cpu, 1);
+	TEST_EQ(cpu.attention, 0);
+	for (int i = 0; i < steps; i++)
+		step();
+	TEST_EQ(cpu.P.I, 0);
+	uint16_t at = step();
+	if (at != ISR)
+		printf("%s: IRQ not taken after the unmask, %04x\n", name, at);
+	TEST_EQ(at, ISR);
+	const uint16_t ret = pushed_pc();
+	mii_cpu_irq(&cpu, 0);
+	TEST_EQ(step(), ISR + 1);
+	TEST_EQ(step(), ret);
+	return ret;
+}
+
+static void
+test_unmasking(void)
+{
+	static const uint8_t cli[] = { 0x78, 0xea, 0xea, 0x58 };
+	static const uint8_t plp[] = { 0x78, 0xa9, 0x00, 0x48, 0x28 };
+	/* RTI to MAIN + 16 with P = 0, from a frame pushed by hand */
+	static const uint8_t rti[] = {
+		0x78, 0xa9, MAIN >> 8, 0x48, 0xa9, 16, 0x48, 0xa9, 0x00, 0x48,
+		0x40 };
+
+	/* taken right after the unmasking instruction */
+	TEST_EQ(test_unmask("CLI", cli, sizeof(cli), 3), MAIN + 4);
+	TEST_EQ(test_unmask("PLP", plp, sizeof(plp), 3), MAIN + 5);
+	TEST_EQ(test_unmask("RTI", rti, sizeof(rti), 7), MAIN + 16);
+}
+
+/* a device raising its line with a bus write, in the middle of a run: the
+ * instruction doing the write completes, the next one is the ISR's */
+static void
+test_device(void)
+{
+	static const uint8_t prog[] = {
+		0xa9, 0x01, 0x8d, DEV_ON & 0xff, DEV_ON >> 8, 0xea, 0xea };
+	static const uint16_t want[] = {
+		MAIN, MAIN + 2, DEV_ISR, DEV_ISR + 3, MAIN + 5, MAIN + 6 };
+	const int n = sizeof(want) / sizeof(want[0]);
+
+	setup(prog, sizeof(prog));
+	ram[0xfffe] = DEV_ISR & 0xff; ram[0xffff] = DEV_ISR >> 8;
+	op_count = 0;
+	cpu.instruction_run = n - 1;
+	s = mii_cpu_run(&cpu, s);
+	TEST_EQ(op_count, n);
+	for (int i = 0; i < n && i < op_count; i++)
+		if (ops[i] != want[i]) {
+			printf("device IRQ: instruction %d at %04x, not %04x\n",
+					i, ops[i], want[i]);
+			TEST_EQ(ops[i], want[i]);
+			break;
+		}
+	TEST_EQ(cpu.irq_line, 0);
+	TEST_EQ(cpu.attention, 0);
+}
+
+static void
+test_nmi(void)
+{
+	setup(NULL, 0);
+	TEST_EQ(step(), MAIN);
+	s.nmi = 1;
+	TEST_EQ(step(), NMI);
+	TEST_EQ(pushed_pc(), MAIN + 1);
+	s.nmi = 0;	// an edge, the caller drops it
+	TEST_EQ(step(), NMI + 1);
+	TEST_EQ(step(), MAIN + 1);
+	TEST_EQ(cpu.attention, 0);
+}
+
+static void
+test_brk(void)
+{
+	static const uint8_t prog[] = { 0x00, 0x42, 0xea };
+
+	setup(prog, sizeof(prog));
+	TEST_EQ(step(), MAIN);
+	TEST_EQ(step(), ISR);
+	TEST_EQ(pushed_pc(), MAIN + 2);
+	TEST_EQ(pushed_p() & 0x10, 0x10);
+	TEST_EQ(step(), ISR + 1);
+	TEST_EQ(step(), MAIN + 2);
+}
+
+static void
+test_trap(void)
+{
+	static const uint8_t pair[] = { 0xeb, 0xfb, 0xea };
+	static const uint8_t apart[] = { 0xeb, 0xea, 0xfb, 0xea };
+
+	setup(pair, sizeof(pair));
+	cpu.trap = 0xebfb;
+	TEST_EQ(step(), MAIN);
+	TEST_EQ(s.trap, 0);
+	TEST_EQ(step(), MAIN + 1);
+	TEST_EQ(s.trap, 1);
+	TEST_EQ(cpu.PC, MAIN + 2);
+	TEST_EQ(step(), MAIN + 2);
+	TEST_EQ(s.trap, 0);
+
+	/* a run stops on the trap */
+	setup(pair, sizeof(pair));
+	cpu.trap = 0xebfb;
+	op_count = 0;
+	cpu.instruction_run = 10;
+	s = mii_cpu_run(&cpu, s);
+	TEST_EQ(s.trap, 1);
+	TEST_EQ(op_count, 2);
+	TEST_EQ(cpu.PC, MAIN + 2);
+
+	setup(apart, sizeof(apart));
+	cpu.trap = 0xebfb;
+	for (int i = 0; i < 4; i++) {
+		step();
+		TEST_EQ(s.trap, 0);
+	}
+	/* an IRQ between the two isn't a trap either */
+	setup(pair, sizeof(pair));
+	cpu.trap = 0xebfb;
+	TEST_EQ(step(), MAIN);
+	mii_cpu_irq(&cpu, 1);
+	TEST_EQ(step(), ISR);
+	mii_cpu_irq(&cpu, 0);
+	TEST_EQ(step(), ISR + 1);
+	TEST_EQ(step(), MAIN + 1);
+	TEST_EQ(s.trap, 0);
+}
+
+/* every access sets the attention byte if 'force' is, so the slow path
+ * runs before each opcode fetch */
+static uint8_t force;
+
+static mii_cpu_state_t
+_bench_access(
+		struct mii_cpu_t *cpu,
+		mii_cpu_state_t access)
+{
+	cpu->attention |= force;
+	if (access.w)
+		ram[access.addr] = access.data;
+	else
+		access.data = ram[access.addr];
+	return access;
+}
+
+static void
+bench(void)
+{
+	/* CLC, LDA $10, ADC #3, STA $10, INX, BNE -9, INY, JMP MAIN */
+	static const uint8_t prog[] = {
+		0x18, 0xa5, 0x10, 0x69, 0x03, 0x85, 0x10, 0xe8, 0xd0, 0xf7,
+		0xc8, 0x4c, MAIN & 0xff, MAIN >> 8 };
+	const uint32_t n = 4000000;
+	uint64_t t[2], cycles[2];
+
+	for (int f = 0; f < 2; f++) {
+		setup(prog, sizeof(prog));
+		cpu.access = _bench_access;
+		force = f;
+		cpu.instruction_run = n - 1;
+		t[f] = test_ns();
+		s = mii_cpu_run(&cpu, s);
+		t[f] = test_ns() - t[f];
+		cycles[f] = cpu.total_cycle;
+		TEST_ASSERT(cpu.PC >= MAIN && cpu.PC < MAIN + sizeof(prog));
+	}
+	/* the same instructions both ways, and no interrupt taken */
+	TEST_EQ(cycles[0], cycles[1]);
+	printf("%u instructions: %.2f ns each, %.2f with the checks every "
+			"instruction (%.2f ns saved)\n", n, (double)t[0] / n,
+			(double)t[1] / n, (double)((int64_t)t[1] - (int64_t)t[0]) / n);
+}
+
+int
+main()
+{
+	test_raise_clear();
+	test_unmasking();
+	test_device();
+	test_nmi();
+	test_brk();
+	test_trap();
+	bench();
+	return TEST_DONE();
+}
@@ -0,0 +1,434 @@
+/*
+ * test_65c02_vectors.c
+ *
+ * Runs mii_65c02.c against per-opcode test vectors in the SingleStepTests
+ * (65x02) JSON format: one instruction per vector, initial and final
+ * registers and RAM, and the bus cycles.
+ *
+ *	test_65c02_vectors [-v] [-s] file.json ...
+ *
+ * The CPU is built without MII_RP2350, so every bus access goes through
+ * cpu->access() onto a flat 64K array, and is logged. For each vector the
+ * registers and the final RAM are compared, the cycle count against the
+ * number of cycles in the vector, and the logged bus accesses against the
+ * vector's, cycle by cycle: address, data, read or write. The core counts
+ * some dummy reads as a cycle without making them (it saves a memory
+ * lookup per branch or stack op), so a read of the vector may have no
+ * access in the log; every access in the log has to be the next one of
+ * the vector though, and every write has to be there. Any of these fails
+ * the vector; -s only compares registers and RAM, to look at one kind of
+ * bug at a time. -v lists every mismatch.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "mii_65c02.h"
+
+#define VEC_MAX_RAM		64
+#define VEC_MAX_CYCLES	16
+
+typedef struct vec_bus_t {
+	uint16_t	addr;
+	uint8_t		data;
+	uint8_t		w;
+} vec_bus_t;
+
+typedef struct vec_state_t {
+	uint16_t	pc;
+	uint8_t		s, a, x, y, p;
+	int			ram_count;
+	struct {
+		uint16_t	addr;
+		uint8_t		data;
+	}			ram[VEC_MAX_RAM];
+} vec_state_t;
+
+typedef struct vec_t {
+	char		name[64];
+	vec_state_t	initial, final;
+	int			cycle_count;
+	vec_bus_t	cycles[VEC_MAX_CYCLES];
+} vec_t;
+
+/* very small JSON reader, only what the vector files use: objects,
+ * arrays, strings without escapes, and non negative integers */
+typedef struct json_t {
+	const char *p, *end;
+	int			error;
+} json_t;
+
+static void
+_ws(
+		json_t *j)
+{
+	while (j->p < j->end && isspace((unsigned char)*j->p))
+		j->p++;
+}
+
+static int
+_is(
+		json_t *j,
+		char c)
+{
+	_ws(j);
+	if (j->p < j->end && *j->p == c) {
+		j->p++;
+		return 1;
+	}
+	return 0;
+}
+
+static void
+_expect(
+		json_t *j,
+		char c)
+{
+	if (!_is(j, c))
+		j->error = 1;
+}
+
+static void
+_string(
+		json_t *j,
+		char *out,
+		int size)
+{
+	int l = 0;
+	_expect(j, '"');
+	while (!j->error && j->p < j->end && *j->p != '"') {
+		if (out && l < size - 1)
+			out[l++] = *j->p;
+		j->p++;
+	}
+	if (out)
+		out[l] = 0;
+	_expect(j, '"');
+}
+
+static long
+_number(
+		json_t *j)
+{
+	_ws(j);
+	char *e;
+	long v = strtol(j->p, &e, 10);
+	if (e == j->p)
+		j->error = 1;
+	j->p = e;
+	return v;
+}
+
+static void
+_skip(
+		json_t *j)
+{
+	_ws(j);
+	if (j->p >= j->end) {
+		j->error = 1;
+		return;
+	}
+	switch (*j->p) {
+		case '"':
+			_string(j, NULL, 0);
+			break;
+		case '[':
+			j->p++;
+			if (_is(j, ']'))
+				break;
+			do _skip(j); while (!j->error && _is(j, ','));
+			_expect(j, ']');
+			break;
+		case '{':
+			j->p++;
+			if (_is(j, '}'))
+				break;
+			do {
+				_string(j, NULL, 0);
+				_expect(j, ':');
+				_skip(j);
+			} while (!j->error && _is(j, ','));
+			_expect(j, '}');
+			break;
+		default:
+			_number(j);
+			break;
+	}
+}
+
+static void
+_state(
+		json_t *j,
+		vec_state_t *st)
+{
+	char key[16];
+	memset(st, 0, sizeof(*st));
+	_expect(j, '{');
+	do {
+		_string(j, key, sizeof(key));
+		_expect(j, ':');
+		if (!strcmp(key, "pc"))		st->pc = _number(j);
+		else if (!strcmp(key, "s"))	st->s = _number(j);
+		else if (!strcmp(key, "a"))	st->a = _number(j);
+		else if (!strcmp(key, "x"))	st->x = _number(j);
+		else if (!strcmp(key, "y"))	st->y = _number(j);
+		else if (!strcmp(key, "p"))	st->p = _number(j);
+		else if (!strcmp(key, "ram")) {
+			_expect(j, '[');
+			if (!_is(j, ']')) {
+				do {
+					_expect(j, '[');
+					uint16_t addr = _number(j);
+					_expect(j, ',');
+					uint8_t data = _number(j);
+					_expect(j, ']');
+					if (st->ram_count < VEC_MAX_RAM) {
+						st->ram[st->ram_count].addr = addr;
+						st->ram[st->ram_count].data = data;
+						st->ram_count++;
+					} else
+						j->error = 1;
+				} while (!j->error && _is(j, ','));
+				_expect(j, ']');
+			}
+		} else
+			_skip(j);
+	} while (!j->error && _is(j, ','));
+	_expect(j, '}');
+}
+
+/* returns 1 when a vector was read, 0 at the end of the array */
+static int
+_vector(
+		json_t *j,
+		vec_t *v)
+{
+	char key[16];
+	_ws(j);
+	if (_is(j, ']'))
+		return 0;
+	_expect(j, '{');
+	memset(v, 0, sizeof(*v));
+	do {
+		_string(j, key, sizeof(key));
+		_expect(j, ':');
+		if (!strcmp(key, "name"))
+			_string(j, v->name, sizeof(v->name));
+		else if (!strcmp(key, "initial"))
+			_state(j, &v->initial);
+		else if (!strcmp(key, "final"))
+			_state(j, &v->final);
+		else if (!strcmp(key, "cycles")) {
+			// [address, data, "read" or "write"] per cycle
+			_expect(j, '[');
+			if (!_is(j, ']')) {
+				do {
+					char rw[8];
+					vec_bus_t c;
+					_expect(j, '[');
+					c.addr = _number(j);
+					_expect(j, ',');
+					c.data = _number(j);
+					_expect(j, ',');
+					_string(j, rw, sizeof(rw));
+					_expect(j, ']');
+					c.w = !strcmp(rw, "write");
+					if (v->cycle_count < VEC_MAX_CYCLES)
+						v->cycles[v->cycle_count++] = c;
+					else
+						j->error = 1;
+				} while (!j->error && _is(j, ','));
+				_expect(j, ']');
+			}
+		} else
+			_skip(j);
+	} while (!j->error && _is(j, ','));
+	_expect(j, '}');
+	_is(j, ',');
+	return !j->error;
+}
+
+static uint8_t ram[0x10000];
+static vec_bus_t bus[VEC_MAX_CYCLES];
+static int bus_count;
+
+static mii_cpu_state_t
+_access(
+		struct mii_cpu_t *cpu,
+		mii_cpu_state_t access)
+{
+	if (access.w)
+		ram[access.addr] = access.data;
+	else
+		access.data = ram[access.addr];
+	if (bus_count < VEC_MAX_CYCLES)
+		bus[bus_count] = (vec_bus_t) {
+			.addr = access.addr, .data = access.data, .w = access.w };
+	bus_count++;
+	return access;
+}
+
+static int verbose;
+
+enum {
+	VEC_BAD_STATE	= (1 << 0),	// registers or RAM
+	VEC_BAD_CYCLES	= (1 << 1),	// count, or bus activity
+};
+
+/* B and bit 5 are not flip-flops in the CPU, only what gets pushed */
+#define P_MASK	0xcf
+
+static int
+_run(
+		const vec_t *v)
+{
+	mii_cpu_t cpu = {
+		.A = v->initial.a, .X = v->initial.x, .Y = v->initial.y,
+		.S = v->initial.s, .PC = v->initial.pc,
+		// trap stays 0, $EB $FB is then a pair of NOPs
+		.access = _access,
+	};
+	MII_SET_P(&cpu, v->initial.p);
+	for (int i = 0; i < v->initial.ram_count; i++)
+		ram[v->initial.ram[i].addr] = v->initial.ram[i].data;
+
+	bus_count = 0;
+	mii_cpu_state_t s = { .raw = 0 };
+	s = mii_cpu_run(&cpu, s);
+	// the opcode fetch is counted before cpu->cycle is reset
+	int cycles = cpu.cycle + 1;
+
+	uint8_t p;
+	MII_GET_P(&cpu, p);
+	const vec_state_t *f = &v->final;
+	int bad = 0;
+	char msg[256];
+	int l = 0;
+#define CHECK(_name, _got, _want, _mask) \
+	if (((_got) & (_mask)) != ((_want) & (_mask))) { \
+		bad |= !strcmp(_name, "cycles") ? \
+					VEC_BAD_CYCLES : VEC_BAD_STATE; \
+		if (l < (int)sizeof(msg) - 32) \
+			l += snprintf(msg + l, sizeof(msg) - l, " %s %04x/%04x", \
+					_name, (_got), (_want)); \
+	}
+	CHECK("PC", cpu.PC, f->pc, 0xffff);
+	CHECK("S", cpu.S, f->s, 0xff);
+	CHECK("A", cpu.A, f->a, 0xff);
+	CHECK("X", cpu.X, f->x, 0xff);
+	CHECK("Y", cpu.Y, f->y, 0xff);
+	CHECK("P", p, f->p, P_MASK);
+	for (int i = 0; i < f->ram_count; i++) {
+		char n[8];
+		sprintf(n, "$%04x", f->ram[i].addr);
+		CHECK(n, ram[f->ram[i].addr], f->ram[i].data, 0xff);
+	}
+	CHECK("cycles", cycles, v->cycle_count, 0xff);
+	// more accesses than the log holds can't match anyway
+	const int logged = bus_count < VEC_MAX_CYCLES ? bus_count : VEC_MAX_CYCLES;
+	int k = 0, i = 0;
+	for (; i < v->cycle_count; i++) {
+		const vec_bus_t *w = &v->cycles[i];
+		const vec_bus_t *g = k < logged ? &bus[k] : NULL;
+		if (g && g->addr == w->addr && g->data == w->data && g->w == w->w)
+			k++;
+		else if (w->w)
+			break;	// a write the core didn't make, or not there
+	}
+	if (k != bus_count || i != v->cycle_count) {
+		bad |= VEC_BAD_CYCLES;
+		const vec_bus_t *g = k < logged ? &bus[k] : NULL;
+		if (l < (int)sizeof(msg) - 48)
+			l += snprintf(msg + l, sizeof(msg) - l,
+					" bus access %d %04x %02x %c", k + 1,
+					g ? g->addr : 0, g ? g->data : 0,
+					!g ? '-' : g->w ? 'w' : 'r');
+	}
+#undef CHECK
+	if (bad && verbose)
+		printf("  %-12s (got/want)%s\n", v->name, msg);
+
+	// leave the array clean for the next vector
+	for (int i = 0; i < v->initial.ram_count; i++)
+		ram[v->initial.ram[i].addr] = 0;
+	for (int i = 0; i < f->ram_count; i++)
+		ram[f->ram[i].addr] = 0;
+	return bad;
+}
+
+static int state_only;
+
+/* returns the number of failed vectors, -1 on error */
+static int
+_run_file(
+		const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *buf = malloc(size);
+	if (!buf || fread(buf, 1, size, fp) != (size_t)size) {
+		perror(path);
+		fclose(fp);
+		free(buf);
+		return -1;
+	}
+	fclose(fp);
+
+	json_t j = { .p = buf, .end = buf + size };
+	int count = 0, failed = 0, cycles = 0;
+	vec_t v;
+	_expect(&j, '[');
+	while (!j.error && _vector(&j, &v)) {
+		int bad = _run(&v);
+		count++;
+		cycles += !!(bad & VEC_BAD_CYCLES);
+		if (state_only)
+			failed += !!(bad & VEC_BAD_STATE);
+		else
+			failed += bad != 0;
+	}
+	free(buf);
+	if (j.error) {
+		printf("%s: parse error after %d vectors\n", path, count);
+		return -1;
+	}
+	printf("%s: %d vectors, %d failed, %d cycle or bus mismatches\n",
+			path, count, failed, cycles);
+	return failed;
+}
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	int failed = 0, files = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-v")) {
+			verbose = 1;
+			continue;
+		}
+		if (!strcmp(argv[i], "-s")) {
+			state_only = 1;
+			continue;
+		}
+		int r = _run_file(argv[i]);
+		failed += r < 0 ? 1 : r;
+		files++;
+	}
+	if (!files) {
+		fprintf(stderr, "%s: [-v] [-s] file.json ...\n", argv[0]);
+		return 2;
+	}
+	return failed != 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * test_bench.c
+ *
+ * The guest benchmarks (mii_bench.c) on the host, the RP2350 build of
+ * mii.c on the host's monotonic clock: every workload has to assemble
+ * and run all its cycles in its own code (mii_bench_run() fails one that
+ * BRKs or wanders into the ROM), its emulated MHz is printed the way the
+ * firmware prints it on serial. The cycles per workload can be given as
+ * the first argument.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include "mii_test.h"
+#include "mii.h"
+#include "mii_bench.h"
+
+volatile int lock_y;
+void sleep_ms(uint32_t ms) {}
+bool ps2kbd_is_show_speed(void) { return false; }
+int mii_disk2_get_motor_state(void) { return 0; }
+void mii_speaker_click(mii_speaker_t *speaker) {}
+int mii_cpu_disasm_one(char *buf, size_t buflen, mii_cpu_t *cpu,
+		uint8_t (*read_byte)(void *, uint16_t), void *param) { return 0; }
+
+static mii_t mii;
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	uint32_t cycles = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+
+	mii_init(&mii);
+	TEST_EQ(mii_bench_run(&mii, cycles), 6);
+	return TEST_DONE();
+}
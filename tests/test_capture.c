@@ -0,0 +1,252 @@
+/*
+ * test_capture.c
+ *
+ * Gameplay capture (mii_capture.c) to a RAM FatFs volume (ramdisk.c):
+ * frames of every kind (unchanged, sprites, bands, a full screen fill,
+ * noise) and the audio alongside are captured, then the file is decoded
+ * the way tools/mii_capture_decode.py does it and every recorded frame
+ * and sample has to come back bit-exact. The SD card is also left out
+ * for a while: a frame is dropped exactly when the ring has no room for a
+ * worst case one, the frames after are still deltas of the last one
+ * recorded, and the lost audio shows as a gap in the sample indexes.
+ * With a path argument the capture is copied there, for the decoder.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "ramdisk.h"
+#include "mii_capture.c"
+
+#define FRAMES		300
+#define SAMPLES		184		// per frame, 11025Hz at 60Hz
+
+static uint32_t palette[16];
+static uint8_t fb[MII_CAPTURE_FB];
+static uint8_t (*model)[MII_CAPTURE_FB];	// every frame, by number
+static bool kept[FRAMES];
+static uint32_t samples;
+
+static uint32_t
+sample(
+		uint32_t i)
+{
+	return (uint16_t)(i * 37) | (uint32_t)(uint16_t)(5 - i * 11) << 16;
+}
+
+/* the next frame rendered; 'noise' for one the RLE can't shrink */
+static void
+render(
+		uint32_t frame,
+		bool noise)
+{
+	int kind = noise ? 8 : frame % 10;
+
+	if (kind == 0)
+		;
+	else if (kind <= 5) {		// sprites
+		for (int s = 0; s < 20; s++) {
+			uint32_t at = _rand() % (MII_CAPTURE_FB - 16);
+			for (int i = 0; i < 16; i++)
+				fb[at + i] = _rand();
+		}
+	} else if (kind == 6) {		// a band of rows in one colour
+		uint32_t y = _rand() % (MII_CAPTURE_H - 40);
+		memset(fb + y * (MII_CAPTURE_W / 2), (_rand() % 16) * 0x11,
+				40 * (MII_CAPTURE_W / 2));
+	} else if (kind == 7)		// cleared, runs longer than a token
+		memset(fb, (_rand() % 16) * 0x11, sizeof(fb));
+	else if (kind == 8) {
+		for (int i = 0; i < MII_CAPTURE_FB; i++)
+			fb[i] = _rand();
+	} else {					// a few pixels
+		for (int i = 0; i < 5; i++)
+			fb[_rand() % MII_CAPTURE_FB] ^= 1 << (_rand() % 8);
+	}
+	memcpy(model[frame], fb, sizeof(fb));
+	for (int i = 0; i < SAMPLES; i++, samples++)
+		mii_capture_audio(sample(samples), sample(samples) >> 16);
+
+	/* dropped only when the ring can't take a worst case frame */
+	uint32_t room = MII_CAPTURE_RING - (_capture.head - _capture.tail);
+	uint32_t n = _capture.frames;
+	mii_capture_frame(fb, frame);
+	kept[frame] = _capture.frames != n;
+	TEST_EQ(kept[frame], room >= MII_CAPTURE_FRAME_MAX);
+}
+
+/* the slack at the end of an emulated frame, long enough for all of it */
+static void
+idle(void)
+{
+	mii_capture_idle(_now_us() + 1000000);
+}
+
+static uint32_t
+le(
+		const uint8_t *p,
+		int n)
+{
+	uint32_t v = 0;
+	for (int i = n; i-- > 0;)
+		v = v << 8 | p[i];
+	return v;
+}
+
+/* XORs the RLE coded 'd' into 'out', false if it isn't one frame */
+static bool
+apply_delta(
+		uint8_t *out,
+		const uint8_t *d,
+		uint32_t len)
+{
+	uint32_t i = 0, o = 0;
+
+	while (i < len) {
+		uint8_t c = d[i];
+		uint32_t n;
+		if (c < 0x80) {
+			n = c + 1;
+			if (o + n > MII_CAPTURE_FB)
+				return false;
+			for (uint32_t k = 0; k < n; k++)
+				out[o + k] ^= d[i + 1 + k];
+			i += 1 + n;
+		} else {
+			n = ((c & 0x3f) << 8 | d[i + 1]) + 1;
+			if (o + n > MII_CAPTURE_FB)
+				return false;
+			if (c >= 0xc0)
+				for (uint32_t k = 0; k < n; k++)
+					out[o + k] ^= d[i + 2];
+			i += c < 0xc0 ? 2 : 3;
+		}
+		o += n;
+	}
+	return i == len && o == MII_CAPTURE_FB;
+}
+
+static void
+decode(
+		const uint8_t *cap,
+		uint32_t size)
+{
+	static uint8_t out[MII_CAPTURE_FB];
+	uint32_t frames = 0, wrong = 0, next = 0, gaps = 0, got = 0;
+	int32_t last = -1;
+
+	TEST_ASSERT(size >= MII_CAPTURE_HEADER);
+	TEST_ASSERT(!memcmp(cap, "MIIC\x01\x04\x02", 7));
+	TEST_EQ(le(cap + 8, 2), MII_CAPTURE_W);
+	TEST_EQ(le(cap + 10, 2), MII_CAPTURE_H);
+	TEST_EQ(le(cap + 12, 4), 11025);
+	for (int i = 0; i < 16; i++)
+		TEST_EQ(cap[16 + i * 3] << 16 | cap[17 + i * 3] << 8 | cap[18 + i * 3],
+				palette[i]);
+
+	for (uint32_t pos = MII_CAPTURE_HEADER; pos < size;) {
+		const uint8_t *r = cap + pos;
+		uint32_t len = le(r + 1, 3);
+		TEST_ASSERT(pos + 4 + len <= size);
+		if (pos + 4 + len > size)
+			break;
+		pos += 4 + len;
+		uint32_t n = le(r + 4, 4);
+		if (r[0] == 'V') {
+			TEST_ASSERT((int32_t)n > last && n < FRAMES);
+			if ((int32_t)n <= last || n >= FRAMES)
+				break;
+			for (uint32_t f = last + 1; f < n; f++)
+				TEST_EQ(kept[f], 0);
+			last = n;
+			frames++;
+			if (!apply_delta(out, r + 8, len - 4) ||
+					memcmp(out, model[n], sizeof(out))) {
+				if (!wrong)
+					printf("frame %u doesn't decode to what was captured\n", n);
+				wrong++;
+				memcpy(out, model[n], sizeof(out));
+			}
+		} else if (r[0] == 'A') {
+			TEST_ASSERT(n >= next);
+			gaps += n - next;
+			for (uint32_t i = 0; i < (len - 4) / 4; i++)
+				if (le(r + 8 + i * 4, 4) != sample(n + i)) {
+					if (!wrong)
+						printf("sample %u doesn't decode\n", n + i);
+					wrong++;
+				}
+			got += (len - 4) / 4;
+			next = n + (len - 4) / 4;
+		} else {
+			printf("record '%c' at %u\n", r[0], (unsigned)(r - cap));
+			TEST_ASSERT(0);
+			break;
+		}
+	}
+	uint32_t want = 0;
+	for (int f = 0; f < FRAMES; f++)
+		want += kept[f];
+	printf("%u frames and %u samples decoded, %u samples lost\n",
+			frames, got, gaps);
+	TEST_EQ(wrong, 0);
+	TEST_EQ(frames, want);
+	TEST_EQ(got + gaps, samples);
+	TEST_EQ(gaps, _capture.a_lost);
+}
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	FIL f;
+	UINT br;
+
+	TEST_EQ(ramdisk_format(), 0);
+	model = calloc(FRAMES, sizeof(*model));
+	for (int i = 0; i < 16; i++)
+		palette[i] = i * 0x0f0f0f ^ 0x102030;
+	TEST_EQ(mii_capture_start("", palette, 11025), 0);
+	TEST_ASSERT(mii_capture_active());
+
+	uint32_t frame = 0;
+	for (; frame < 200; frame++) {
+		render(frame, false);
+		idle();
+	}
+	/* the card is busy for a while: the ring fills with noise frames */
+	for (; frame < 224; frame++)
+		render(frame, true);
+	TEST_ASSERT(_capture.dropped > 0);
+	TEST_ASSERT(_capture.a_head - _capture.a_tail > MII_CAPTURE_AUDIO);
+	for (; frame < FRAMES; frame++) {
+		render(frame, false);
+		idle();
+	}
+	const uint32_t dropped = _capture.dropped;
+	mii_capture_stop();
+	TEST_ASSERT(!mii_capture_active());
+	TEST_ASSERT(_capture.a_lost > 0);
+
+	TEST_EQ(f_open(&f, "/cap000.mic", FA_READ), FR_OK);
+	uint32_t size = f_size(&f);
+	uint8_t *cap = malloc(size);
+	TEST_EQ(f_read(&f, cap, size, &br), FR_OK);
+	TEST_EQ(br, size);
+	f_close(&f);
+	printf("%u frames, %u dropped, %.1f KB per frame\n", FRAMES, dropped,
+			size / 1024.0 / (FRAMES - dropped));
+	decode(cap, size);
+
+	if (argc > 1) {
+		FILE *o = fopen(argv[1], "wb");
+		TEST_ASSERT(o && fwrite(cap, 1, size, o) == size);
+		if (o)
+			fclose(o);
+	}
+	free(cap);
+	free(model);
+	return TEST_DONE();
+}
@@ -0,0 +1,82 @@
+/*
+ * test_cpu_c8.c
+ *
+ * The RP2350 inline fetch/store in mii_65c02.c only calls cpu->access()
+ * for the pages that need it: $C0xx I/O, and $C8xx for the No Slot Clock.
+ * Everything else has to be served straight from the banks.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mii_test.h"
+#include "mii.h"
+
+static mii_t mii;
+static uint8_t ram[0x10000];
+static uint16_t seen[64];
+static int seen_count;
+
+void
+mii_timer_run(
+		mii_t *mii,
+		uint64_t cycles)
+{
+}
+
+static mii_cpu_state_t
+_access(
+		struct mii_cpu_t *cpu,
+		mii_cpu_state_t access)
+{
+	if (seen_count < 64)
+		seen[seen_count++] = access.addr;
+	if (access.w)
+		ram[access.addr] = access.data;
+	else
+		access.data = ram[access.addr];
+	return access;
+}
+
+static int
+_seen(
+		uint16_t addr)
+{
+	for (int i = 0; i < seen_count; i++)
+		if (seen[i] == addr)
+			return 1;
+	return 0;
+}
+
+int
+main()
+{
+	mii.bank[0].ua.raw = ram;
+	mii.cpu.access = _access;
+	mii.cpu.access_param = &mii;
+
+	static const uint8_t prog[] = {
+		0xad, 0x04, 0xc8,	// LDA $C804	clock, read
+		0x8d, 0x01, 0xc8,	// STA $C801	clock, write
+		0xad, 0x34, 0x12,	// LDA $1234	RAM
+		0xad, 0x80, 0xc0,	// LDA $C080	I/O
+		0xad, 0x00, 0xc9,	// LDA $C900	ROM
+		0xad, 0x00, 0xd8,	// LDA $D800	ROM, same low bits as $C8
+	};
+	memcpy(ram + 0x300, prog, sizeof(prog));
+	mii.cpu.PC = 0x300;
+	mii_cpu_state_t s = { .raw = 0 };
+	for (int i = 0; i < 6; i++)
+		s = mii_cpu_run(&mii.cpu, s);
+
+	TEST_EQ(mii.cpu.PC, 0x300 + sizeof(prog));
+	TEST_ASSERT(_seen(0xc804));
+	TEST_ASSERT(_seen(0xc801));
+	TEST_ASSERT(_seen(0xc080));
+	TEST_ASSERT(!_seen(0x1234));
+	TEST_ASSERT(!_seen(0xc900));
+	TEST_ASSERT(!_seen(0xd800));
+	// opcode fetches are in RAM too
+	TEST_ASSERT(!_seen(0x300));
+
+	return TEST_DONE();
+}
@@ -0,0 +1,645 @@
+/*
+ * test_disk2.c
+ *
+ * Disk II card (mii_disk2.c). The LSS reads a synthetic track at 28, 32
+ * and 36 (3.5, 4 and 4.5us) bit cells: past the self sync, D5 AA 96 and
+ * 6000 random disk nibbles must all come out in order, exactly 8 cells
+ * apart. Prints the cost of an LSS tick.
+ *
+ * Then the card's drives get their disks from disk_loader.c on a RAM
+ * FatFs volume (ramdisk.c), mounted from a .dsk like on the device.
+ * A write heavy guest trace is replayed, with a given share of the
+ * written tracks the same as on the card: exactly those are skipped,
+ * and the .bdsk reads back as the last data written. Prints the SD
+ * sectors the trace writes.
+ *
+ * Last, a whole-disk copy from drive 1 to drive 2, stepping and
+ * selecting through the card's soft switches like Copy II+: steps and
+ * drive switches alone must not read the card, both drives' images are
+ * resident, and the copy must read back the same as the source. Prints
+ * the SD KB moved per copy.
+ *
+ * Then a WOZ2 with whole tracks 0-2, half tracks 3.5 to 33.5, track 36
+ * and a quarter track whose TRKS entry is missing: the head is swept out
+ * to quarter track 159 and back through the soft switches after its
+ * conversion, and from the .bdsk in either drive; every position must
+ * read its TRKS data or noise, without reading the card. A WOZ that
+ * needs a 36th slot mounts with its last track reading noise, and a v1
+ * .bdsk reads whole track N at
+ * quarter tracks 4N-1..4N+1 and stays v1 after a write-back.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#define _GNU_SOURCE		// asprintf
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "ramdisk.h"
+#include "mii_disk2.c"
+#include "mii_woz.h"
+#include "disk_loader.h"
+
+mii_slot_drv_t *mii_slot_drv_list;
+void mii_bank_write(mii_bank_t *b, uint16_t a, const uint8_t *d, uint16_t l) {}
+mii_rom_t * mii_rom_get(const char *name) { return NULL; }
+void mii_dd_register_drives(mii_dd_system_t *dd, mii_dd_t *drives,
+		uint8_t count) {}
+int mii_dd_drive_load(mii_dd_t *dd, mii_dd_file_t *file) { return 0; }
+mii_dd_file_t * mii_dd_file_load(mii_dd_system_t *dd, const char *filename,
+		uint16_t flags) { return NULL; }
+mii_signal_t * mii_alloc_signal(mii_signal_pool_t *pool, uint32_t base,
+		uint32_t count, const char **names)
+{ static mii_signal_t sig[SIG_COUNT]; return sig; }
+int mii_vcd_init(struct mii_t *mii, const char *filename, mii_vcd_t *vcd,
+		uint32_t cycle_to_nsec) { return -1; }
+int mii_vcd_add_signal(mii_vcd_t *vcd, mii_signal_t *signal_sig,
+		uint signal_bit_size, const char *name) { return 0; }
+int mii_vcd_start(mii_vcd_t *vcd) { return 0; }
+void mii_vcd_close(mii_vcd_t *vcd) {}
+uint8_t mii_timer_register(mii_t *mii, mii_timer_p cb, void *param,
+		int64_t when, const char *name) { return 0; }
+int64_t mii_timer_get(mii_t *mii, uint8_t id) { return 0; }
+int mii_timer_set(mii_t *mii, uint8_t id, int64_t when) { return 0; }
+
+static mii_card_disk2_t card;
+static mii_slot_t slot = { .id = 5, .drv_priv = &card };
+static mii_t mii;
+
+/* what disk_loader.c wants from the emulator */
+uint8_t vram[2 * RAM_PAGES_PER_POOL * RAM_PAGE_SIZE];
+int g_disk2_slot = 6;
+int mii_slot_command(mii_t *m, uint8_t slot_id, uint8_t cmd, void *param)
+{ return _mii_disk2_command(m, &slot, cmd, param); }
+void mii_video_reset_vbl_timer(mii_t *m) {}
+
+#define SYNC_NIBBLES	40
+#define TRACK_NIBBLES	6000
+
+static uint8_t nibbles[TRACK_NIBBLES];
+static uint8_t track[MII_FLOPPY_MAX_TRACK_SIZE];
+static mii_floppy_track_t track_desc;
+
+/* 40 10 bit FFs, D5 AA 96, then random 6-and-2 disk bytes */
+static void
+make_track(void)
+{
+	extern const uint8_t TRANS62[];
+	int n = 0;
+	nibbles[n++] = 0xd5;
+	nibbles[n++] = 0xaa;
+	nibbles[n++] = 0x96;
+	while (n < TRACK_NIBBLES)
+		nibbles[n++] = TRANS62[_rand() % 64];
+
+	mii_floppy_cursor_t w;
+	memset(&track_desc, 0, sizeof(track_desc));
+	mii_floppy_cursor_write_init(&w, &track_desc, track);
+	for (int i = 0; i < SYNC_NIBBLES; i++)
+		mii_floppy_cursor_write(&w, 0xff << 2, 10);
+	for (int i = 0; i < TRACK_NIBBLES; i++)
+		mii_floppy_cursor_write(&w, nibbles[i], 8);
+	mii_floppy_cursor_flush(&w, &track_desc);
+	TEST_EQ(track_desc.bit_count, SYNC_NIBBLES * 10 + TRACK_NIBBLES * 8);
+}
+
+/*
+ * One revolution, a tick at a time so every nibble the data register
+ * latches is seen, as the boot ROM's read loop would.
+ */
+static void
+test_timing(
+		uint8_t timing)
+{
+	static uint8_t out[2 * (TRACK_NIBBLES + SYNC_NIBBLES)];
+	static int at[2 * (TRACK_NIBBLES + SYNC_NIBBLES)];
+	mii_floppy_t *f = &card.floppy[0];
+	const int ticks = (int)((uint64_t)track_desc.bit_count * timing / 4);
+	/* the last nibble latches a few cells after the end of the track */
+	const int read_ticks = ticks + ticks / 100;
+	int got = 0;
+	uint8_t latch = 0;
+
+	memset(&card, 0, sizeof(card));
+	f->bit_timing = mii_floppy_bit_timing(timing);
+	TEST_EQ(f->bit_timing, timing);
+	for (int tick = 1; tick <= read_ticks; tick++) {
+		_mii_disk2_lss_batch(&card, f, track, track_desc.bit_count, 1);
+		if (card.data_register & ~latch & 0x80) {
+			if (got < (int)sizeof(out)) {
+				out[got] = card.data_register;
+				at[got++] = tick;
+			}
+		}
+		latch = card.data_register;
+	}
+	int start = -1;
+	for (int i = 0; i + 2 < got && start < 0; i++)
+		if (out[i] == 0xd5 && out[i + 1] == 0xaa && out[i + 2] == 0x96)
+			start = i;
+	int in_order = 0;
+	while (start >= 0 && start + in_order < got && in_order < TRACK_NIBBLES &&
+			out[start + in_order] == nibbles[in_order])
+		in_order++;
+	/* D5 to the last nibble, a tick is 4 timing units */
+	const double expect = 8.0 * timing / 4;
+	const double per = in_order > 1 ? (double)(at[start + in_order - 1] -
+			at[start]) / (in_order - 1) : 0;
+
+	struct mii_card_disk2_t c = { 0 };
+	c.floppy[0].bit_timing = timing;
+	uint64_t t = test_ns();
+	for (int r = 0; r < 20; r++)
+		_mii_disk2_lss_batch(&c, &c.floppy[0], track, track_desc.bit_count,
+				ticks);
+	t = test_ns() - t;
+
+	printf("timing %d (%.3fus): %d nibbles, %d/%d in order, "
+			"%.2f ticks per nibble (%.2f), %.2f ns per tick\n",
+			timing, timing / 8.0, got, in_order, TRACK_NIBBLES,
+			per, expect, (double)t / (20.0 * ticks));
+	TEST_ASSERT(start >= 0);
+	TEST_EQ(in_order, TRACK_NIBBLES);
+	TEST_ASSERT(per > expect - 0.01 && per < expect + 0.01);
+}
+
+/* /apple/<name> selected and mounted in 'drive', converted again if
+ * 'recreate'; what disk_mount_to_emulator() returns */
+static int
+mount(
+		int drive,
+		const char *name,
+		bool recreate)
+{
+	disk_scan_directory("/apple");
+	int index = -1;
+	for (int i = 0; i < g_disk_count; i++)
+		if (!strcmp(g_disk_list[i].filename, name))
+			index = i;
+	TEST_ASSERT(index >= 0);
+	TEST_EQ(disk_load_image(drive, index, true), 0);
+	return disk_mount_to_emulator(drive, &mii, 6, 0, false, recreate);
+}
+
+/* a random 140K .dsk in /apple, selected and mounted in 'drive' */
+static void
+mount_dsk(
+		int drive,
+		const char *name,
+		bool recreate)
+{
+	char path[64];
+	static uint8_t dsk[143360];
+	FIL f;
+	UINT bw;
+
+	if (recreate) {
+		snprintf(path, sizeof(path), "/apple/%s", name);
+		for (unsigned i = 0; i < sizeof(dsk); i++)
+			dsk[i] = _rand();
+		TEST_EQ(f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS), FR_OK);
+		TEST_EQ(f_write(&f, dsk, sizeof(dsk), &bw), FR_OK);
+		TEST_EQ(f_close(&f), FR_OK);
+	}
+	TEST_EQ(mount(drive, name, recreate), 0);
+}
+
+static uint8_t model[BDSK_TRACKS][BDSK_TRACK_DATA_SIZE];
+static uint32_t model_bits[BDSK_TRACKS];
+
+/* head on track 't', its data in curr_track_data */
+static mii_floppy_t *
+load_track(
+		int drive,
+		int t)
+{
+	mii_floppy_t *f = &card.floppy[drive];
+	f->qtrack = t * 4;
+	disk_reload_track(drive, f->track_id[f->qtrack], &mii);
+	return f;
+}
+
+static int
+tracks_differ(
+		int drive)
+{
+	int bad = 0;
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		mii_floppy_t *f = load_track(drive, t);
+		uint8_t id = f->track_id[f->qtrack];
+		bad += f->tracks[id].bit_count != model_bits[t] ||
+				memcmp(f->curr_track_data, model[t], BDSK_TRACK_DATA_SIZE);
+	}
+	return bad;
+}
+
+/*
+ * A DOS SAVE session: every third write is the catalog track, the
+ * others go to data tracks; 'same' percent of the writes put back what
+ * the track already held, as DOS does with the VTOC and catalog.
+ */
+static void
+test_write_trace(
+		int same)
+{
+	const int n = 400;
+	disk_write_stats_t w0, w1;
+	int unchanged = 0;
+
+	mount_dsk(0, "trace.dsk", true);
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		mii_floppy_t *f = load_track(0, t);
+		memcpy(model[t], f->curr_track_data, BDSK_TRACK_DATA_SIZE);
+		model_bits[t] = f->tracks[f->track_id[f->qtrack]].bit_count;
+	}
+	disk_get_write_stats(&w0);
+	ramdisk_stats_t s0 = ramdisk_stats;
+	for (int i = 0; i < n; i++) {
+		int t = i % 3 ? 3 + _rand() % 32 : 17;
+		mii_floppy_t *f = load_track(0, t);
+		uint8_t id = f->track_id[f->qtrack];
+		if ((int)(_rand() % 100) < same)
+			unchanged++;
+		else
+			f->curr_track_data[_rand() % (f->tracks[id].bit_count / 8)] ^=
+					1 + _rand() % 255;
+		f->tracks[id].dirty = 1;
+		f->seed_dirty++;
+		disk_write_track(0, id, &mii);
+		TEST_ASSERT(!f->tracks[id].dirty);
+		memcpy(model[t], f->curr_track_data, BDSK_TRACK_DATA_SIZE);
+	}
+	disk_get_write_stats(&w1);
+	printf("trace, %2d%% unchanged: %3u written, %3u skipped, "
+			"SD %4lu sectors in %4lu commands\n", same,
+			w1.writes - w0.writes, w1.unchanged - w0.unchanged,
+			ramdisk_stats.wr_sectors - s0.wr_sectors,
+			ramdisk_stats.wr_cmds - s0.wr_cmds);
+	TEST_EQ(w1.unchanged - w0.unchanged, unchanged);
+	TEST_EQ(w1.writes - w0.writes, n - unchanged);
+	TEST_EQ(w1.bytes_avoided - w0.bytes_avoided,
+			unchanged * BDSK_TRACK_DATA_SIZE);
+
+	/* the .bdsk has it all: mount it again */
+	disk_eject_from_emulator(0, &mii, 6);
+	mount_dsk(0, "trace.dsk", false);
+	TEST_EQ(tracks_differ(0), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+}
+
+static void
+io(
+		uint16_t addr)
+{
+	_mii_disk2_access(&mii, &slot, addr, 0, false);
+}
+
+/* drive on, motor on */
+static void
+select_drive(
+		int drive)
+{
+	io(0x0a + drive);
+	io(0x09);
+}
+
+/* half track steps through the phases, as RWTS does */
+static void
+seek(
+		int t)
+{
+	mii_floppy_t *f = &card.floppy[card.selected];
+	while (f->qtrack != t * 4) {
+		int p = (f->stepper + (f->qtrack < t * 4 ? 1 : 3)) % 4;
+		io(p * 2 + 1);
+		io(p * 2);
+	}
+}
+
+/* against the stop, from wherever the head is */
+static void
+recalibrate(
+		int drive)
+{
+	select_drive(drive);
+	for (int i = 0; i < 80; i++) {
+		int p = (card.floppy[drive].stepper + 3) % 4;
+		io(p * 2 + 1);
+		io(p * 2);
+	}
+}
+
+static void
+test_copy(
+		int per_pass)
+{
+	static uint8_t buf[5][BDSK_TRACK_DATA_SIZE];
+	static uint32_t buf_bits[5];
+
+	mount_dsk(0, "source.dsk", per_pass == 1);
+	mount_dsk(1, "copy.dsk", true);
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		mii_floppy_t *f = load_track(0, t);
+		memcpy(model[t], f->curr_track_data, BDSK_TRACK_DATA_SIZE);
+		model_bits[t] = f->tracks[f->track_id[f->qtrack]].bit_count;
+	}
+	recalibrate(0);
+	recalibrate(1);
+
+	/* both heads across the disk, switching drives at every track */
+	ramdisk_stats_t s0 = ramdisk_stats;
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		select_drive(0);
+		seek(t);
+		select_drive(1);
+		seek(t);
+	}
+	TEST_EQ(ramdisk_stats.rd_sectors - s0.rd_sectors, 0);
+	TEST_EQ(ramdisk_stats.wr_sectors - s0.wr_sectors, 0);
+
+	s0 = ramdisk_stats;
+	for (int t0 = 0; t0 < BDSK_TRACKS; t0 += per_pass) {
+		int n = t0 + per_pass > BDSK_TRACKS ? BDSK_TRACKS - t0 : per_pass;
+		select_drive(0);
+		for (int i = 0; i < n; i++) {
+			seek(t0 + i);
+			mii_floppy_t *f = &card.floppy[0];
+			memcpy(buf[i], f->curr_track_data, BDSK_TRACK_DATA_SIZE);
+			buf_bits[i] = f->tracks[f->track_id[f->qtrack]].bit_count;
+		}
+		select_drive(1);
+		for (int i = 0; i < n; i++) {
+			seek(t0 + i);
+			mii_floppy_t *f = &card.floppy[1];
+			uint8_t id = f->track_id[f->qtrack];
+			memcpy(f->curr_track_data, buf[i], BDSK_TRACK_DATA_SIZE);
+			f->tracks[id].bit_count = buf_bits[i];
+			f->tracks[id].dirty = 1;
+			f->seed_dirty++;
+		}
+	}
+	/* stepping off the last track writes it back; with the steps at
+	 * zero reads, what the copy reads is the write-back's own FatFs
+	 * traffic (partial sectors, FAT and directory) */
+	seek(0);
+	printf("copy, %d track%s per pass: SD read %4lu KB, written %4lu KB\n",
+			per_pass, per_pass > 1 ? "s" : " ",
+			(ramdisk_stats.rd_sectors - s0.rd_sectors) / 2,
+			(ramdisk_stats.wr_sectors - s0.wr_sectors) / 2);
+	TEST_ASSERT(ramdisk_stats.wr_sectors - s0.wr_sectors >=
+			BDSK_TRACKS * BDSK_TRACK_DATA_SIZE / 512);
+
+	disk_eject_from_emulator(1, &mii, 6);
+	mount_dsk(1, "copy.dsk", false);
+	TEST_EQ(tracks_differ(1), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+	disk_eject_from_emulator(1, &mii, 6);
+}
+
+static uint8_t woz_tmap[160];
+static uint8_t woz_bits[160][BDSK_TRACK_DATA_SIZE];
+static uint32_t woz_bit_count[160];
+
+/* WOZ2 entry 100 - n for the n-th track from the outside, so the TRKS
+ * numbering isn't the slot numbering */
+static void
+woz_track(
+		int q0,
+		int q1,
+		int *n)
+{
+	for (int q = q0; q <= q1; q++)
+		woz_tmap[q] = 100 - *n;
+	(*n)++;
+}
+
+/*
+ * /apple/<name>: whole tracks 0-2, half tracks 3.5-33.5, track 36, and
+ * one more whole track if 'extra' (36 tracks, one too many). Half track
+ * 2.5 (quarter tracks 10-12) points at TRKS 120, which has no data.
+ * Returns the number of TRKS entries with data.
+ */
+static int
+make_woz(
+		const char *name,
+		bool extra)
+{
+	static mii_woz2_trks_t trks;
+	char path[64];
+	FIL f;
+	UINT bw;
+	int n = 0;
+
+	memset(woz_tmap, 0xff, sizeof(woz_tmap));
+	memset(woz_bit_count, 0, sizeof(woz_bit_count));
+	memset(&trks, 0, sizeof(trks));
+	woz_track(0, 1, &n);
+	for (int t = 1; t <= 2; t++)
+		woz_track(t * 4 - 1, t * 4 + 1, &n);
+	for (int h = 3; h <= 33; h++)
+		woz_track(h * 4 + 1, h * 4 + 3, &n);
+	woz_track(36 * 4 - 1, 36 * 4 + 1, &n);
+	if (extra)
+		woz_track(37 * 4 - 1, 37 * 4 + 1, &n);
+	for (int q = 10; q <= 12; q++)
+		woz_tmap[q] = 120;
+
+	mii_woz_header_t hdr = { .padding = { 0xff, 0x0a, 0x0d, 0x0a } };
+	// INFO is 60 bytes, the struct has what this loader reads of it
+	union {
+		mii_woz2_info_t	i;
+		uint8_t			b[sizeof(mii_woz_chunk_t) + 60];
+	} info = { .i = {
+		.chunk.size_le = 60,
+		.version = 2, .disk_type = 1, .optimal_bit_timing = 32,
+	} };
+	mii_woz_tmap_t tmap = { .chunk.size_le = sizeof(tmap.track_id) };
+	memcpy(&hdr.magic_le, "WOZ2", 4);
+	memcpy(&info.i.chunk.id_le, "INFO", 4);
+	memcpy(&tmap.chunk.id_le, "TMAP", 4);
+	memcpy(tmap.track_id, woz_tmap, sizeof(woz_tmap));
+	memcpy(&trks.chunk.id_le, "TRKS", 4);
+
+	uint16_t block = (sizeof(hdr) + sizeof(info) + sizeof(tmap) +
+			sizeof(trks)) / 512;
+	uint32_t size = sizeof(trks) - sizeof(trks.chunk);
+	for (int e = 100 - n + 1; e <= 100; e++) {
+		woz_bit_count[e] = 50000 + e * 8;
+		for (int i = 0; i < BDSK_TRACK_DATA_SIZE; i++)
+			woz_bits[e][i] = _rand();
+		trks.track[e].start_block_le = block;
+		trks.track[e].block_count_le = (woz_bit_count[e] / 8 + 511) / 512;
+		trks.track[e].bit_count_le = woz_bit_count[e];
+		block += trks.track[e].block_count_le;
+		size += trks.track[e].block_count_le * 512;
+	}
+	trks.chunk.size_le = size;
+
+	snprintf(path, sizeof(path), "/apple/%s", name);
+	TEST_EQ(f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS), FR_OK);
+	f_write(&f, &hdr, sizeof(hdr), &bw);
+	f_write(&f, &info, sizeof(info), &bw);
+	f_write(&f, &tmap, sizeof(tmap), &bw);
+	f_write(&f, &trks, sizeof(trks), &bw);
+	TEST_EQ(f_tell(&f) % 512, 0);
+	for (int e = 0; e < 160; e++) {
+		if (!woz_bit_count[e])
+			continue;
+		TEST_EQ(f_tell(&f), trks.track[e].start_block_le * 512u);
+		f_write(&f, woz_bits[e], trks.track[e].block_count_le * 512, &bw);
+	}
+	TEST_EQ(f_close(&f), FR_OK);
+	return n;
+}
+
+/* the head on quarter track 'q' reads TRKS tmap[q], noise if it has none */
+static int
+woz_position_differs(
+		mii_floppy_t *f)
+{
+	uint8_t e = woz_tmap[f->qtrack];
+	uint8_t id = f->track_id[f->qtrack];
+	if (e == 0xff || !woz_bit_count[e])
+		return id != MII_FLOPPY_NOISE_TRACK ||
+				memcmp(f->curr_track_data, noize, sizeof(noize));
+	return id >= MII_FLOPPY_TRACK_COUNT ||
+			f->tracks[id].bit_count != woz_bit_count[e] ||
+			memcmp(f->curr_track_data, woz_bits[e], woz_bit_count[e] / 8);
+}
+
+/* out to the last quarter track a phase at a time and back: the even
+ * positions going out, the odd ones coming back */
+static int
+woz_sweep(
+		int drive)
+{
+	mii_floppy_t *f = &card.floppy[drive];
+	uint8_t seen[160] = {};
+	int bad = 0;
+
+	recalibrate(drive);
+	ramdisk_stats_t s0 = ramdisk_stats;
+	for (int dir = 1; dir >= -1; dir -= 2) {
+		for (int i = 0; i < 80; i++) {
+			int p = (f->stepper + (dir > 0 ? 1 : 3)) % 4;
+			io(p * 2 + 1);
+			io(p * 2);
+			seen[f->qtrack] = 1;
+			bad += woz_position_differs(f);
+		}
+	}
+	TEST_EQ(ramdisk_stats.rd_sectors - s0.rd_sectors, 0);
+	for (int q = 1; q < 160; q++)
+		bad += !seen[q];
+	return bad;
+}
+
+static int
+bdsk_version(
+		const char *path)
+{
+	FIL f;
+	UINT br;
+	bdsk_header_t h = {};
+	TEST_EQ(f_open(&f, path, FA_READ), FR_OK);
+	f_read(&f, &h, sizeof(h), &br);
+	f_close(&f);
+	return h.version;
+}
+
+static void
+test_woz_qtracks(void)
+{
+	FILINFO fno;
+
+	make_woz("qt.woz", false);
+	TEST_EQ(mount(0, "qt.woz", true), 0);
+	TEST_EQ(bdsk_version("/apple/qt.woz.bdsk"), BDSK_VERSION);
+	TEST_EQ(woz_sweep(0), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+	TEST_EQ(mount(0, "qt.woz", false), 0);
+	TEST_EQ(woz_sweep(0), 0);
+	TEST_EQ(mount(1, "qt.woz", false), 0);
+	TEST_EQ(woz_sweep(1), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+	disk_eject_from_emulator(1, &mii, 6);
+
+	/* one track too many: it mounts, the outermost one (the last TRKS
+	 * entry) reads noise, the same from the .bdsk next time */
+	int n = make_woz("big.woz", true);
+	TEST_EQ(mount(0, "big.woz", true), 0);
+	TEST_EQ(f_stat("/apple/big.woz.bdsk", &fno), FR_OK);
+	woz_bit_count[100 - (n - 1)] = 0;
+	TEST_EQ(woz_sweep(0), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+	TEST_EQ(mount(0, "big.woz", false), 0);
+	TEST_EQ(woz_sweep(0), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+
+	/* a v1 .bdsk: no quarter track map, whole tracks only */
+	FIL f;
+	UINT bw;
+	bdsk_header_t h = { .version = 1, .tracks = BDSK_TRACKS };
+	memcpy(h.magic, BDSK_MAGIC, 4);
+	TEST_EQ(f_open(&f, "/apple/v1.bdsk", FA_WRITE | FA_CREATE_ALWAYS), FR_OK);
+	f_write(&f, &h, sizeof(h), &bw);
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		model_bits[t] = 50000 + t;
+		for (int i = 0; i < BDSK_TRACK_DATA_SIZE; i++)
+			model[t][i] = _rand();
+		f_write(&f, &model_bits[t], 4, &bw);
+		f_write(&f, model[t], BDSK_TRACK_DATA_SIZE, &bw);
+	}
+	TEST_EQ(f_size(&f), BDSK_QMAP_OFFSET);
+	TEST_EQ(f_close(&f), FR_OK);
+	TEST_EQ(mount(0, "v1.bdsk", false), 0);
+	int bad = 0;
+	mii_floppy_t *fl = &card.floppy[0];
+	for (int q = 0; q < 160; q++) {
+		int t = (q + 1) / 4;
+		bool whole = (q + 1) % 4 != 3 && t < BDSK_TRACKS;
+		bad += fl->track_id[q] != (whole ? t : MII_FLOPPY_NOISE_TRACK);
+	}
+	TEST_EQ(bad, 0);
+	TEST_EQ(tracks_differ(0), 0);
+	fl = load_track(0, 0);
+	fl->curr_track_data[100] ^= 0x55;
+	model[0][100] ^= 0x55;
+	fl->tracks[0].dirty = 1;
+	fl->seed_dirty++;
+	disk_write_track(0, 0, &mii);
+	TEST_EQ(bdsk_version("/apple/v1.bdsk"), 1);
+	disk_eject_from_emulator(0, &mii, 6);
+	TEST_EQ(mount(0, "v1.bdsk", false), 0);
+	TEST_EQ(tracks_differ(0), 0);
+	disk_eject_from_emulator(0, &mii, 6);
+}
+
+int
+main()
+{
+	make_track();
+	test_timing(28);
+	test_timing(32);
+	test_timing(36);
+
+	memset(&card, 0, sizeof(card));
+	for (int i = 0; i < 2; i++) {
+		mii_floppy_init(&card.floppy[i]);
+		card.floppy[i].id = i;
+	}
+	TEST_EQ(ramdisk_format(), 0);
+	TEST_EQ(disk_loader_init(), 0);
+	test_write_trace(0);
+	test_write_trace(60);
+	test_write_trace(90);
+	test_copy(1);
+	test_copy(5);
+	test_woz_qtracks();
+	/* what a .bdsk or WOZ INFO can ask for */
+	TEST_EQ(mii_floppy_bit_timing(0), MII_FLOPPY_BIT_TIMING);
+	TEST_EQ(mii_floppy_bit_timing(23), MII_FLOPPY_BIT_TIMING);
+	TEST_EQ(mii_floppy_bit_timing(41), MII_FLOPPY_BIT_TIMING);
+	TEST_EQ(mii_floppy_bit_timing(24), 24);
+	TEST_EQ(mii_floppy_bit_timing(40), 40);
+	return TEST_DONE();
+}
@@ -0,0 +1,192 @@
+/*
+ * test_floppy_cursor.c
+ *
+ * mii_floppy_cursor_* (mii_floppy.h) against a bit-by-bit reference:
+ * random reads and skips on tracks of odd lengths, wrap included, and
+ * appends of random widths. A sector header that straddles the end of
+ * the track is re-found from a stale position on either side. Then a
+ * 140K DSK image is converted the way a disk mount does it (render every
+ * sector, map every track, read every sector back) and timed.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "mii_floppy.c"
+#include "mii_dsk.h"
+
+const uint8_t noize[MII_FLOPPY_MAX_TRACK_SIZE];
+
+static int
+_ref_bit(
+		const uint8_t *data,
+		uint32_t pos)
+{
+	return (data[pos >> 3] >> (7 - (pos & 7))) & 1;
+}
+
+static uint8_t data[MII_FLOPPY_MAX_TRACK_SIZE];
+static uint8_t ref[MII_FLOPPY_MAX_TRACK_SIZE];
+
+static void
+_test_read(void)
+{
+	int bad = 0;
+	for (int t = 0; t < 200; t++) {
+		for (int i = 0; i < (int)sizeof(data); i++)
+			data[i] = _rand();
+		mii_floppy_track_t track = {
+			.bit_count = 100 + _rand() % (sizeof(data) * 8 - 100),
+		};
+		uint32_t pos = _rand() % (track.bit_count * 2);
+		mii_floppy_cursor_t c;
+		mii_floppy_cursor_read_init(&c, &track, data, pos);
+		pos %= track.bit_count;
+		for (int r = 0; r < 1000; r++) {
+			uint8_t count = 1 + _rand() % 32;
+			if (_rand() & 3) {
+				uint32_t want = 0;
+				for (int b = 0; b < count; b++) {
+					want = (want << 1) | _ref_bit(data, pos);
+					pos = pos + 1 == track.bit_count ? 0 : pos + 1;
+				}
+				bad += mii_floppy_cursor_read(&c, count) != want;
+			} else {
+				uint32_t skip = 1 + _rand() % 100;
+				mii_floppy_cursor_skip(&c, skip);
+				pos = (pos + skip) % track.bit_count;
+			}
+		}
+	}
+	TEST_EQ(bad, 0);
+}
+
+static void
+_test_write(void)
+{
+	int bad = 0;
+	for (int t = 0; t < 200; t++) {
+		for (int i = 0; i < (int)sizeof(data); i++)
+			data[i] = ref[i] = _rand();
+		mii_floppy_track_t track = { .bit_count = _rand() % 2000 };
+		uint32_t pos = track.bit_count;
+		mii_floppy_cursor_t c;
+		mii_floppy_cursor_write_init(&c, &track, data);
+		while (pos < sizeof(data) * 8 - 64) {
+			uint8_t count = 1 + _rand() % 32;
+			uint32_t bits = _rand() ^ (_rand() << 16);
+			mii_floppy_cursor_write(&c, bits, count);
+			for (int b = count - 1; b >= 0; b--, pos++) {
+				uint8_t m = 0x80 >> (pos & 7);
+				ref[pos >> 3] = (bits >> b) & 1 ?
+						ref[pos >> 3] | m : ref[pos >> 3] & ~m;
+			}
+			// now and then, start over from a flushed track
+			if (!(_rand() % 50)) {
+				mii_floppy_cursor_flush(&c, &track);
+				mii_floppy_cursor_write_init(&c, &track, data);
+			}
+		}
+		mii_floppy_cursor_flush(&c, &track);
+		bad += track.bit_count != pos;
+		// the bits after the end are left as they were
+		bad += memcmp(data, ref, (pos + 7) / 8) != 0;
+	}
+	TEST_EQ(bad, 0);
+}
+
+static void
+_put_bits(
+		uint8_t *d,
+		uint32_t bit_count,
+		uint32_t pos,
+		uint32_t bits,
+		int count)
+{
+	for (int b = count - 1; b >= 0; b--, pos = (pos + 1) % bit_count) {
+		uint8_t m = 0x80 >> (pos & 7);
+		d[pos >> 3] = (bits >> b) & 1 ? d[pos >> 3] | m : d[pos >> 3] & ~m;
+	}
+}
+
+/* D5 AA AD starting 10 bits before the end of the track */
+static void
+_test_realign_wrap(void)
+{
+	mii_floppy_track_t track = { .bit_count = 50000 };
+	mii_floppy_track_map_t map = {};
+	const uint32_t start = track.bit_count - 10;
+
+	memset(data, 0, sizeof(data));
+	_put_bits(data, track.bit_count, start, 0xd5aaad, 24);
+	// stale position just after the wrap, found at pos < 23
+	map.sector[0].data = 5;
+	TEST_EQ(mii_floppy_realign_sector_map(&track, data, &map, 0), 0);
+	TEST_EQ(map.sector[0].data, start);
+	// stale position before the header, found past bit_count
+	map.sector[0].data = start - 20;
+	TEST_EQ(mii_floppy_realign_sector_map(&track, data, &map, 0), 0);
+	TEST_EQ(map.sector[0].data, start);
+	// and from there it reads in place
+	TEST_EQ(mii_floppy_realign_sector_map(&track, data, &map, 0), 0);
+	TEST_EQ(map.sector[0].data, start);
+}
+
+static uint8_t image[35][16][256];
+static uint8_t tracks[35][MII_FLOPPY_MAX_TRACK_SIZE];
+static mii_floppy_track_map_t maps[35];
+static mii_floppy_t floppy;
+
+static void
+_bench_image(void)
+{
+	for (int t = 0; t < 35; t++)
+		for (int s = 0; s < 16; s++)
+			for (int i = 0; i < 256; i++)
+				image[t][s][i] = _rand();
+	const int runs = 20;
+	uint64_t render = 0, map = 0, read = 0;
+	int bad = 0;
+	for (int run = 0; run < runs; run++) {
+		uint64_t t0 = test_ns();
+		for (int t = 0; t < 35; t++) {
+			floppy.tracks[t].bit_count = 0;
+			for (int s = 0; s < 16; s++)
+				mii_floppy_dsk_render_sector(254, t, s, image[t][s],
+						&floppy.tracks[t], tracks[t]);
+		}
+		uint64_t t1 = test_ns();
+		for (int t = 0; t < 35; t++) {
+			memcpy(floppy.curr_track_data, tracks[t], sizeof(tracks[t]));
+			uint64_t m0 = test_ns();
+			bad += mii_floppy_map_track(&floppy, t, &maps[t], 0) != 0;
+			map += test_ns() - m0;
+		}
+		uint64_t t2 = test_ns();
+		for (int t = 0; t < 35; t++) {
+			for (int s = 0; s < 16; s++) {
+				uint8_t sector[256];
+				bad += mii_floppy_read_sector(&floppy.tracks[t], tracks[t],
+						&maps[t], s, sector) != 0;
+				bad += memcmp(sector, image[t][s], 256) != 0;
+			}
+		}
+		uint64_t t3 = test_ns();
+		render += t1 - t0;
+		read += t3 - t2;
+	}
+	TEST_EQ(bad, 0);
+	printf("140K image: render %.2f ms, map %.2f ms, sector read %.2f ms\n",
+			render / 1e6 / runs, map / 1e6 / runs, read / 1e6 / runs);
+}
+
+int
+main()
+{
+	_test_read();
+	_test_write();
+	_test_realign_wrap();
+	_bench_image();
+	return TEST_DONE();
+}
@@ -0,0 +1,367 @@
+/*
+ * test_hle.c
+ *
+ * The ROM loop HLE (mii_hle.c) against the 65C02 running the ROM
+ * unpatched, on the RP2350 build of mii.c: every case runs twice from the
+ * same state, on mii_rom_iiee and on the patched copy, and has to end with
+ * the same A, X, Y, P, S, PC, memory and cycle count. WAIT for every A,
+ * binary and decimal; 200000 single loops with random registers, pointers
+ * and window width (page crossings, the loop writing over its own
+ * pointers); COUT printing a few screens of text, bells included, in 40
+ * and 80 columns.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mii_test.h"
+#include "mii_hle.c"
+
+volatile int lock_y;
+void sleep_ms(uint32_t ms) {}
+bool ps2kbd_is_show_speed(void) { return false; }
+int mii_disk2_get_motor_state(void) { return 0; }
+void mii_speaker_click(mii_speaker_t *speaker) {}
+int mii_cpu_disasm_one(char *buf, size_t buflen, mii_cpu_t *cpu,
+		uint8_t (*read_byte)(void *, uint16_t), void *param) { return 0; }
+
+extern const uint8_t mii_rom_iiee[16384];
+extern uint8_t vram[];	// main RAM, then aux
+
+#define PROG		0x0300
+#define TEXT		0x6000
+#define CAP			20000000	// cycles a case may take
+#define LOOPS		(sizeof(_mii_hle_patch) / sizeof(_mii_hle_patch[0]))
+
+static mii_t mii;
+static mii_trap_t traps;
+static uint8_t stop;			// trap that ends a case
+static int stopped;
+static mii_trap_handler_cb hle_cb[32];
+static uint32_t hits[32];
+/* the ROM as is and patched, then both again with the stop trap at every
+ * loop exit, for running one loop on its own */
+static uint8_t rom[2][16384], loop_rom[2][16384];
+/* the memory a case may change, before and after the first run */
+static uint8_t before[0x20000], after[0x20000];
+
+typedef struct run_t {
+	uint8_t		a, x, y, p, s;
+	uint16_t	pc;
+	uint64_t	cycles;
+} run_t;
+
+static void
+_stop(
+		mii_t *mii,
+		uint8_t trap)
+{
+	stopped = 1;
+}
+
+static void
+_count(
+		mii_t *mii,
+		uint8_t trap)
+{
+	hits[trap]++;
+	hle_cb[trap](mii, trap);
+}
+
+/* the trap number the patched ROM has for a loop */
+static uint8_t
+trap_of(
+		int i)
+{
+	return rom[1][_mii_hle_patch[i].addr - 0xc000 + 2];
+}
+
+static void
+put_stop(
+		uint8_t *r,
+		uint16_t addr)
+{
+	r[addr - 0xc000] = MII_TRAP >> 8;
+	r[addr - 0xc000 + 1] = MII_TRAP & 0xff;
+	r[addr - 0xc000 + 2] = stop;
+}
+
+static void
+setup(void)
+{
+	mii_init(&mii);
+	TEST_EQ(mii_hle_install(&mii), LOOPS);
+	stop = mii_register_trap(&mii, _stop);
+	for (int i = 0; i < 32; i++)
+		if ((mii.trap.map & (1u << i)) && i != stop) {
+			hle_cb[i] = mii.trap.trap[i].cb;
+			mii.trap.trap[i].cb = _count;
+		}
+	traps = mii.trap;
+
+	memcpy(rom[0], mii_rom_iiee, sizeof(rom[0]));
+	memcpy(rom[1], _mii_hle_rom, sizeof(rom[1]));
+	for (int r = 0; r < 2; r++) {
+		memcpy(loop_rom[r], rom[r], sizeof(loop_rom[r]));
+		for (unsigned i = 0; i < LOOPS; i++)
+			put_stop(loop_rom[r],
+					_mii_hle_patch[i].addr + _mii_hle_patch[i].len);
+	}
+}
+
+/* a fresh CPU at 'pc', the cycle count from zero */
+static void
+set_cpu(
+		uint16_t pc,
+		uint8_t a,
+		uint8_t y,
+		uint8_t p)
+{
+	mii.cpu_state.reset = 0;
+	mii.cpu.IRQ = 0;
+	mii.cpu.trap_pc = 0;
+	mii.cpu.S = 0xff;
+	mii.cpu.A = a;
+	mii.cpu.X = 0x5a;
+	mii.cpu.Y = y;
+	p |= 0x04;	// I set, no IRQ in here
+	MII_SET_P(&mii.cpu, p);
+	mii.cpu.PC = pc;
+	mii.cpu.cycle = 0;
+	mii.cpu.total_cycle = 0;
+	mii.timer.last_run = 0;
+}
+
+/* runs until the stop trap, on ROM 'r' */
+static void
+run(
+		const uint8_t *r,
+		run_t *o)
+{
+	mii.bank[MII_BANK_ROM].ua.raw = (uint8_t *)r;
+	stopped = 0;
+	while (!stopped && mii.cpu.total_cycle < CAP)
+		mii_run(&mii);
+	TEST_ASSERT(stopped);
+	o->a = mii.cpu.A;
+	o->x = mii.cpu.X;
+	o->y = mii.cpu.Y;
+	MII_GET_P(&mii.cpu, o->p);
+	o->s = mii.cpu.S;
+	o->pc = mii.cpu.PC;
+	o->cycles = mii.cpu.total_cycle + mii.cpu.cycle;
+}
+
+/* prints what differs, returns 1 if anything does */
+static int
+differ(
+		const char *what,
+		const run_t *n,
+		const run_t *h,
+		const uint8_t *mem,
+		const uint8_t *want,
+		uint32_t at,
+		uint32_t len)
+{
+	int bad = n->a != h->a || n->x != h->x || n->y != h->y ||
+			n->p != h->p || n->s != h->s || n->pc != h->pc ||
+			n->cycles != h->cycles;
+	if (bad)
+		printf("%s: A %02x X %02x Y %02x P %02x S %02x PC %04x %llu cycles, "
+				"not A %02x X %02x Y %02x P %02x S %02x PC %04x %llu cycles\n",
+				what, h->a, h->x, h->y, h->p, h->s, h->pc,
+				(unsigned long long)h->cycles, n->a, n->x, n->y, n->p, n->s,
+				n->pc, (unsigned long long)n->cycles);
+	for (uint32_t i = at; i < at + len; i++)
+		if (mem[i] != want[i]) {
+			printf("%s: %s $%04x is $%02x, not $%02x\n", what,
+					i < 0x10000 ? "main" : "aux", i & 0xffff, mem[i], want[i]);
+			return 1;
+		}
+	return bad;
+}
+
+/* JSR WAIT for every A, with D clear and set (WAIT does its own SEC) */
+static void
+test_wait(void)
+{
+	const uint8_t prog[] = {
+		0x20, 0xa8, 0xfc, MII_TRAP >> 8, MII_TRAP & 0xff, stop };
+	const uint32_t hit = hits[trap_of(0)];
+	int wrong = 0;
+	run_t n, h;
+
+	mii_bank_write(&mii.bank[MII_BANK_MAIN], PROG, prog, sizeof(prog));
+	for (int d = 0; d < 2; d++)
+		for (int a = 0; a < 256; a++) {
+			char what[32];
+			snprintf(what, sizeof(what), "WAIT A=$%02x%s", a, d ? " D" : "");
+			memcpy(before, vram + 0x100, 0x100);
+			set_cpu(PROG, a, 0, d ? 0x08 : 0);
+			run(rom[0], &n);
+			memcpy(after, vram + 0x100, 0x100);
+			memcpy(vram + 0x100, before, 0x100);
+			set_cpu(PROG, a, 0, d ? 0x08 : 0);
+			run(rom[1], &h);
+			if (differ(what, &n, &h, vram + 0x100, after, 0, 0x100) &&
+					++wrong > 8)
+				break;
+		}
+	TEST_EQ(wrong, 0);
+	TEST_ASSERT(hits[trap_of(0)] > hit);
+}
+
+/* one loop at a time, from its head to its exit, everything random */
+static void
+test_random(
+		int count)
+{
+	uint32_t per_loop[LOOPS] = {};
+	int wrong = 0;
+	run_t n, h;
+
+	test_seed = 0x4c45;
+	for (uint32_t i = 0; i < 0xc000; i++)
+		vram[i] = _rand();
+	for (int c = 0; c < count && wrong < 8; c++) {
+		const int l = _rand() % LOOPS;
+		uint16_t src = _rand() % 0xbf00, dst = _rand() % 0xbf00;
+		/* now and then over the zero page, and the pointers themselves */
+		if (_rand() % 32 == 0)
+			dst = _rand() & 0xff;
+		const int clreol = _mii_hle_patch[l].cb == _mii_hle_clreol;
+		if (clreol && _rand() % 32 == 0)
+			src = _rand() & 0xff;
+		const uint8_t a = _rand(), y = _rand(), p = _rand();
+		vram[0x21] = _rand();
+		vram[0x28] = src; vram[0x29] = src >> 8;
+		vram[0x2a] = dst; vram[0x2b] = dst >> 8;
+		/* all of main RAM if a pointer is in the zero page, they can move */
+		const uint16_t w = clreol ? src : dst;
+		const uint32_t at = w < 0x200 ? 0 : w, len = w < 0x200 ? 0xc000 : 0x100;
+
+		memcpy(before, vram, 0x100);
+		memcpy(before + at, vram + at, len);
+		set_cpu(_mii_hle_patch[l].addr, a, y, p);
+		run(loop_rom[0], &n);
+		memcpy(after, vram, 0x100);
+		memcpy(after + at, vram + at, len);
+		memcpy(vram + at, before + at, len);
+		memcpy(vram, before, 0x100);
+		set_cpu(_mii_hle_patch[l].addr, a, y, p);
+		run(loop_rom[1], &h);
+		per_loop[l]++;
+
+		char what[64];
+		snprintf(what, sizeof(what), "$%04X A=$%02x Y=$%02x P=$%02x "
+				"($28)=$%04x ($2A)=$%04x $21=$%02x", _mii_hle_patch[l].addr,
+				a, y, p | 0x24, src, dst, before[0x21]);
+		if (differ(what, &n, &h, vram, after, 0, 0x100) ||
+				differ(what, &n, &h, vram, after, at, len))
+			wrong++;
+	}
+	TEST_EQ(wrong, 0);
+	printf("%d random loops:", count);
+	for (unsigned l = 0; l < LOOPS; l++)
+		printf(" %u at $%04X", per_loop[l], _mii_hle_patch[l].addr);
+	printf("\n");
+}
+
+/* prints the text at TEXT from a clean machine, 80 columns if 'col80',
+ * returns the host time it took */
+static uint64_t
+cout(
+		int col80,
+		const uint8_t *r,
+		run_t *o)
+{
+	const uint8_t prog[] = {
+		0x20, 0x2f, 0xfb,		// JSR INIT
+		0x20, 0x93, 0xfe,		// JSR SETVID
+		0x20, 0x89, 0xfe,		// JSR SETKBD
+		0x20, 0x84, 0xfe,		// JSR SETNORM
+		0x20, 0x58, 0xfc,		// JSR HOME
+		0xa9, TEXT & 0xff, 0x85, 0x06, 0xa9, TEXT >> 8, 0x85, 0x07,
+		0xa0, 0x00,				// loop: LDY #0
+		0xb1, 0x06,				// LDA ($06),Y
+		0xf0, 0x0b,				// BEQ done
+		0x20, 0xed, 0xfd,		// JSR COUT
+		0xe6, 0x06,				// INC $06
+		0xd0, 0xf5,				// BNE loop
+		0xe6, 0x07,				// INC $07
+		0xd0, 0xf1,				// BNE loop
+		MII_TRAP >> 8, MII_TRAP & 0xff, stop,	// done
+	};
+	const uint8_t pr3[] = { 0x20, 0x00, 0xc3 };	// JSR $C300
+	uint8_t text[4096];
+
+	mii_init(&mii);
+	mii.trap = traps;
+	mii_bank_write(&mii.bank[MII_BANK_MAIN], PROG, prog, sizeof(prog));
+	if (col80)	// in place of the HOME, which it does itself
+		mii_bank_write(&mii.bank[MII_BANK_MAIN], PROG + 12, pr3, sizeof(pr3));
+	/* lines of 0 to 119 characters, a bell now and then */
+	test_seed = 0x434f;
+	int i = 0;
+	while (i < (int)sizeof(text) - 128) {
+		int n = _rand() % 120;
+		for (int j = 0; j < n; j++)
+			text[i++] = 0xa0 + _rand() % 0x5f;
+		text[i++] = _rand() % 16 ? 0x8d : 0x87;
+	}
+	text[i] = 0;
+	mii_bank_write(&mii.bank[MII_BANK_MAIN], TEXT, text, i + 1);
+	set_cpu(PROG, 0, 0, 0);
+	uint64_t t = test_ns();
+	run(r, o);
+	return test_ns() - t;
+}
+
+static void
+test_cout(
+		int col80)
+{
+	const char *name = col80 ? "COUT 80 columns" : "COUT 40 columns";
+	const uint32_t size = 0x20000;
+	uint32_t hit[LOOPS];
+	run_t n, h;
+
+	uint64_t tn = cout(col80, rom[0], &n);
+	memcpy(after, vram, size);
+	for (unsigned l = 0; l < LOOPS; l++)
+		hit[l] = hits[trap_of(l)];
+	uint64_t th = cout(col80, rom[1], &h);
+	TEST_EQ(differ(name, &n, &h, vram, after, 0, size), 0);
+	/* the firmware went through the loops of its mode: 40 columns scrolls
+	 * at $C13F, rings the bell with WAIT and clears lines at $CCA8; 80
+	 * columns does neither of the last two there, and scrolls both halves
+	 * at $CC59 and $CC45 */
+	printf("%s: %llu cycles, %.2f ms native, %.2f ms HLE, traps", name,
+			(unsigned long long)n.cycles, tn / 1e6, th / 1e6);
+	for (unsigned l = 0; l < LOOPS; l++) {
+		const mii_trap_handler_cb cb = _mii_hle_patch[l].cb;
+		const int used = col80 ?
+				cb == _mii_hle_scroll_main || cb == _mii_hle_scroll_aux :
+				cb == _mii_hle_wait || cb == _mii_hle_scroll_40 ||
+				cb == _mii_hle_clreol;
+		hit[l] = hits[trap_of(l)] - hit[l];
+		printf(" $%04X %u", _mii_hle_patch[l].addr, hit[l]);
+		TEST_ASSERT(!used || hit[l]);
+	}
+	printf("\n");
+	/* and it is the screen it was printed to, in normal characters */
+	int chars = 0;
+	for (int a = 0x400; a < 0x800; a++)
+		chars += (vram[a] > 0xa0) + (col80 && vram[0x10000 + a] > 0xa0);
+	TEST_ASSERT(chars > 500);
+}
+
+int
+main()
+{
+	setup();
+	test_wait();
+	test_random(200000);
+	test_cout(0);
+	test_cout(1);
+	return TEST_DONE();
+}
@@ -0,0 +1,210 @@
+/*
+ * test_input_latency.c
+ *
+ * Input latency histograms (mii_input_latency.c) on a mock clock: device
+ * events are stamped at arrival, delivered the way main.c does (keypress,
+ * button poke) and observed by guest reads of $C000 and $C061-$C063
+ * through mii_mem_access(). Every sample has to land in the bucket of
+ * its latency, percentiles on the bucket bounds of a reference sort;
+ * dropped, stale, burst and clock wrap cases too.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "mii_input_latency.c"
+#include "mii.c"
+
+const uint8_t mii_rom_iiee[16384];
+void init_ram_pages_for(vram_t *v, uint8_t *raw, uint32_t raw_size) {}
+void mii_analog_init(struct mii_t *mii, mii_analog_t *analog) {}
+void mii_analog_access(struct mii_t *mii, mii_analog_t *analog,
+		uint16_t addr, uint8_t *byte, bool write) {}
+void mii_bank_write(mii_bank_t *bank, uint16_t addr, const uint8_t *data,
+		uint16_t len) {}
+bool mii_bank_access(mii_bank_t *bank, uint16_t addr, const uint8_t *data,
+		uint16_t len, bool write) { return false; }
+mii_rom_t * mii_rom_get(const char *name) { return NULL; }
+void mii_speaker_click(mii_speaker_t *speaker) {}
+void mii_video_init(struct mii_t *mii) {}
+uint8_t mii_video_get_vapor(struct mii_t *mii) { return 0; }
+bool mii_access_video(struct mii_t *mii, uint16_t addr, uint8_t *byte,
+		bool write) { return false; }
+int mii_cpu_disasm_one(const uint8_t *prog, uint16_t addr, char *out,
+		size_t out_len, uint16_t flags) { return 0; }
+
+static mii_t mii;
+
+static uint8_t
+guest_read(
+		uint16_t addr)
+{
+	uint8_t d = 0;
+	mii_mem_access(&mii, addr, &d, false, true);
+	return d;
+}
+
+/* what main.c does when the event gets to the soft switches */
+static void
+deliver(
+		uint8_t source)
+{
+	if (source <= MII_LAT_PS2_KBD) {
+		mii_keypress(&mii, 'A');
+		mii_latency_deliver(MII_LAT_KEY);
+	} else {
+		mii_bank_poke(&mii.bank[MII_BANK_SW], 0xc061, 0x80);
+		mii_latency_deliver(MII_LAT_BUTTON);
+	}
+}
+
+/* one event all the way, 'to_sw' then 'to_read' microseconds apart */
+static void
+event(
+		uint8_t source,
+		uint32_t to_sw,
+		uint32_t to_read)
+{
+	mii_latency_arrival(source);
+	_host_time_us += to_sw;
+	deliver(source);
+	_host_time_us += to_read;
+	if (source <= MII_LAT_PS2_KBD) {
+		TEST_EQ(guest_read(0xc000), 0x80 | 'A');
+		guest_read(0xc010);		// strobe
+	} else
+		TEST_EQ(guest_read(0xc061) & 0x80, 0x80);
+	/* the next frames of polling aren't samples */
+	_host_time_us += 16000;
+	guest_read(0xc000);
+	guest_read(0xc061);
+	guest_read(0xc062);
+}
+
+static int
+_cmp(
+		const void *a,
+		const void *b)
+{
+	return *(const uint32_t *)a - *(const uint32_t *)b;
+}
+
+/* random latencies per source against a histogram and sort kept here */
+static void
+test_histogram(void)
+{
+	enum { N = 3000 };
+	static uint32_t lat[MII_LAT_SOURCE_COUNT][N];
+	static uint16_t want[MII_LAT_SOURCE_COUNT][MII_LAT_BUCKETS];
+	int wrong = 0;
+
+	mii_latency_reset();
+	test_seed = 1;
+	for (int i = 0; i < N; i++)
+		for (int s = 0; s < MII_LAT_SOURCE_COUNT; s++) {
+			/* mostly a frame or two, some long ones past the last bucket */
+			uint32_t to_sw = _rand() % (_rand() % 16 ? 20000 : 60000);
+			uint32_t to_read = _rand() % 2000;
+			uint32_t dt = to_sw + to_read;
+			lat[s][i] = dt;
+			uint32_t b = dt / MII_LAT_BUCKET_US;
+			want[s][b < MII_LAT_BUCKETS ? b : MII_LAT_BUCKETS - 1]++;
+			event(s, to_sw, to_read);
+		}
+	for (int s = 0; s < MII_LAT_SOURCE_COUNT; s++) {
+		TEST_EQ(mii_latency_count(s), N);
+		wrong += memcmp(_lat.hist[s], want[s], sizeof(want[s])) != 0;
+		qsort(lat[s], N, sizeof(lat[s][0]), _cmp);
+		TEST_EQ(_lat.max[s], lat[s][N - 1]);
+		for (unsigned pct = 1; pct <= 100; pct++) {
+			uint32_t v = lat[s][(N * pct + 99) / 100 - 1];
+			uint32_t b = v / MII_LAT_BUCKET_US;
+			uint32_t p = mii_latency_percentile(s, pct);
+			if (b >= MII_LAT_BUCKETS - 1 ? p != lat[s][N - 1] :
+					p != (b + 1) * MII_LAT_BUCKET_US) {
+				printf("source %d p%u: %u, sample %u\n", s, pct, p, v);
+				wrong++;
+			}
+		}
+	}
+	char line[64];
+	for (int s = 0; s < MII_LAT_SOURCE_COUNT; s++)
+		if (mii_latency_format(s, line, sizeof(line)))
+			printf("%s (p50/p99)\n", line);
+	TEST_EQ(wrong, 0);
+}
+
+static void
+test_cases(void)
+{
+	char line[64];
+
+	/* dropped by the UI: never a sample, the next event is measured */
+	mii_latency_reset();
+	mii_latency_arrival(MII_LAT_USB_KBD);
+	_host_time_us += 3000;
+	mii_latency_drop(MII_LAT_KEY);
+	deliver(MII_LAT_USB_KBD);
+	guest_read(0xc000);
+	TEST_EQ(mii_latency_count(MII_LAT_USB_KBD), 0);
+	TEST_EQ(mii_latency_format(MII_LAT_USB_KBD, line, sizeof(line)), 0);
+	event(MII_LAT_USB_KBD, 700, 100);
+	TEST_EQ(mii_latency_count(MII_LAT_USB_KBD), 1);
+	TEST_EQ(_lat.hist[MII_LAT_USB_KBD][3], 1);
+
+	/* a burst: only the first arrival is timed */
+	mii_latency_reset();
+	mii_latency_arrival(MII_LAT_PS2_KBD);
+	_host_time_us += 1000;
+	mii_latency_arrival(MII_LAT_USB_KBD);
+	_host_time_us += 500;
+	deliver(MII_LAT_PS2_KBD);
+	guest_read(0xc000);
+	TEST_EQ(mii_latency_count(MII_LAT_PS2_KBD), 1);
+	TEST_EQ(mii_latency_count(MII_LAT_USB_KBD), 0);
+	TEST_EQ(_lat.hist[MII_LAT_PS2_KBD][1500 / MII_LAT_BUCKET_US], 1);
+
+	/* an arrival never delivered goes stale, the next one replaces it */
+	mii_latency_reset();
+	mii_latency_arrival(MII_LAT_NESPAD);
+	_host_time_us += MII_LAT_STALE_US + 1;
+	event(MII_LAT_USB_PAD, 400, 100);
+	TEST_EQ(mii_latency_count(MII_LAT_NESPAD), 0);
+	TEST_EQ(mii_latency_count(MII_LAT_USB_PAD), 1);
+	TEST_EQ(_lat.hist[MII_LAT_USB_PAD][2], 1);
+
+	/* keys and buttons are separate channels */
+	mii_latency_reset();
+	mii_latency_arrival(MII_LAT_USB_KBD);
+	mii_latency_arrival(MII_LAT_NESPAD);
+	_host_time_us += 300;
+	deliver(MII_LAT_NESPAD);
+	guest_read(0xc000);		// the key isn't delivered yet
+	guest_read(0xc062);
+	_host_time_us += 300;
+	deliver(MII_LAT_USB_KBD);
+	guest_read(0xc061);
+	guest_read(0xc000);
+	TEST_EQ(mii_latency_count(MII_LAT_NESPAD), 1);
+	TEST_EQ(_lat.hist[MII_LAT_NESPAD][300 / MII_LAT_BUCKET_US], 1);
+	TEST_EQ(_lat.hist[MII_LAT_USB_KBD][600 / MII_LAT_BUCKET_US], 1);
+
+	/* the 32 bit microsecond clock wraps every 71 minutes */
+	mii_latency_reset();
+	_host_time_us = UINT32_MAX - 200;
+	event(MII_LAT_USB_KBD, 300, 300);
+	TEST_EQ(_lat.hist[MII_LAT_USB_KBD][600 / MII_LAT_BUCKET_US], 1);
+	TEST_EQ(_lat.max[MII_LAT_USB_KBD], 600);
+}
+
+int
+main()
+{
+	for (int i = 0; i < MII_BANK_COUNT; i++)
+		mii.bank[i] = _mii_banks_init[i];
+	_host_time_us = 1000;
+	test_histogram();
+	test_cases();
+	return TEST_DONE();
+}
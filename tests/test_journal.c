@@ -0,0 +1,350 @@
+/*
+ * test_journal.c
+ *
+ * .bdsk track journal (disk_journal.c) on a FatFs volume in RAM
+ * (ramdisk.c). Random track writes, in place and through the journal,
+ * must read back as the last data written, compaction included. Then
+ * the power is cut at every sector of a journal append and of a fold:
+ * the volume is mounted again, the log replayed and every track has to
+ * hold either its old or its new data, never a mix. Prints what one
+ * track write costs the card both ways, and how an in-place write
+ * fares against the same cuts.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mii_test.h"
+#include "ramdisk.h"
+#include "disk_journal.h"
+
+uint8_t track_buf[BDSK_TRACK_DATA_SIZE];
+
+static const char *name = "/t.bdsk";
+static uint8_t model[BDSK_TRACKS][BDSK_TRACK_DATA_SIZE];
+static uint32_t model_bits[BDSK_TRACKS];
+static uint8_t image[BDSK_BYTES];
+static disk_journal_t jr;
+
+static uint32_t
+slot(
+		int track)
+{
+	return sizeof(bdsk_header_t) +
+			track * (sizeof(bdsk_track_desc_t) + BDSK_TRACK_DATA_SIZE);
+}
+
+static void
+fill(
+		uint8_t *d,
+		uint32_t seed)
+{
+	for (int i = 0; i < BDSK_TRACK_DATA_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		d[i] = seed >> 16;
+	}
+}
+
+/* replay prints the records it found, once per mount */
+static void
+quiet(
+		int on)
+{
+	static int quiet_fd = -1, null = -1;
+	if (on) {
+		fflush(stdout);
+		quiet_fd = dup(1);
+		null = open("/dev/null", O_WRONLY);
+		dup2(null, 1);
+	} else {
+		fflush(stdout);
+		dup2(quiet_fd, 1);
+		close(null);
+		close(quiet_fd);
+	}
+}
+
+/* a fresh v2 sidecar, track t holding fill(t) */
+static void
+create(void)
+{
+	FIL f;
+	UINT bw;
+	bdsk_header_t h = { .version = BDSK_VERSION, .tracks = BDSK_TRACKS };
+	uint8_t qmap[BDSK_QTRACKS];
+
+	memcpy(h.magic, BDSK_MAGIC, 4);
+	f_unlink(name);
+	TEST_EQ(f_open(&f, name, FA_READ | FA_WRITE | FA_CREATE_ALWAYS), FR_OK);
+	f_write(&f, &h, sizeof(h), &bw);
+	for (int t = 0; t < BDSK_TRACKS; t++) {
+		fill(model[t], t);
+		model_bits[t] = 50000 + t;
+		f_write(&f, &model_bits[t], 4, &bw);
+		f_write(&f, model[t], BDSK_TRACK_DATA_SIZE, &bw);
+	}
+	for (int q = 0; q < BDSK_QTRACKS; q++)
+		qmap[q] = (q & 3) == 0 && q / 4 < BDSK_TRACKS ? q / 4 : BDSK_QMAP_NONE;
+	f_write(&f, qmap, sizeof(qmap), &bw);
+	TEST_EQ(f_close(&f), FR_OK);
+	memset(&jr, 0, sizeof(jr));
+	jr.end = BDSK_JOURNAL_BASE;
+}
+
+/* what disk_loader does for one written track */
+static int
+write_track(
+		int journal,
+		int t,
+		const uint8_t *d,
+		uint32_t bits)
+{
+	FIL f;
+	UINT bw;
+	int res = 0;
+
+	if (f_open(&f, name, FA_READ | FA_WRITE) != FR_OK)
+		return -1;
+	if (journal)
+		res = disk_journal_append(&jr, &f, t, bits, d);
+	else if (f_lseek(&f, slot(t)) != FR_OK ||
+			f_write(&f, &bits, 4, &bw) != FR_OK ||
+			f_write(&f, d, BDSK_TRACK_DATA_SIZE, &bw) != FR_OK)
+		res = -1;
+	if (f_sync(&f) != FR_OK)
+		res = -1;
+	f_close(&f);
+	return res;
+}
+
+static int
+compact(void)
+{
+	FIL f;
+	if (f_open(&f, name, FA_READ | FA_WRITE) != FR_OK)
+		return -1;
+	int res = disk_journal_compact(&jr, &f);
+	f_close(&f);
+	return res;
+}
+
+/* power on: mount, read the slots and replay the log over them */
+static int
+load(void)
+{
+	FIL f;
+	UINT br;
+	int res = -1;
+
+	quiet(1);
+	if (ramdisk_remount() == 0 &&
+			f_open(&f, name, FA_READ | FA_WRITE) == FR_OK) {
+		memset(image, 0, sizeof(image));
+		if (f_read(&f, image, BDSK_BYTES, &br) == FR_OK && br == BDSK_BYTES)
+			res = disk_journal_replay(&jr, &f, image);
+		f_close(&f);
+	}
+	quiet(0);
+	return res;
+}
+
+static int
+track_is(
+		int t,
+		const uint8_t *d,
+		uint32_t bits)
+{
+	return !memcmp(image + slot(t), &bits, 4) &&
+			!memcmp(image + slot(t) + 4, d, BDSK_TRACK_DATA_SIZE);
+}
+
+static int
+tracks_differ(
+		int skip)
+{
+	int bad = 0;
+	for (int t = 0; t < BDSK_TRACKS; t++)
+		if (t != skip && !track_is(t, model[t], model_bits[t]))
+			bad++;
+	return bad;
+}
+
+/* adds what the card saw since 'from' to 'acc' */
+static void
+stats_add(
+		ramdisk_stats_t *acc,
+		const ramdisk_stats_t *from)
+{
+	acc->rd_cmds += ramdisk_stats.rd_cmds - from->rd_cmds;
+	acc->rd_sectors += ramdisk_stats.rd_sectors - from->rd_sectors;
+	acc->wr_cmds += ramdisk_stats.wr_cmds - from->wr_cmds;
+	acc->wr_sectors += ramdisk_stats.wr_sectors - from->wr_sectors;
+	acc->wr_seeks += ramdisk_stats.wr_seeks - from->wr_seeks;
+}
+
+/*
+ * The log is folded back whenever it is full here, the way the idle time
+ * compactor keeps it short; the appends and the folds are counted apart.
+ */
+static void
+test_writes(
+		int journal)
+{
+	const int n = 1000;
+	uint8_t d[BDSK_TRACK_DATA_SIZE];
+	ramdisk_stats_t w = {}, c = {}, s;
+	int folds = 0;
+
+	test_seed = 1;	// same tracks for both runs
+	create();
+	if (journal) {
+		/* what a conversion does: the log area is made once */
+		FIL f;
+		s = ramdisk_stats;
+		TEST_EQ(f_open(&f, name, FA_READ | FA_WRITE), FR_OK);
+		TEST_EQ(disk_journal_reset(&jr, &f), 0);
+		f_close(&f);
+		printf("journal  log area: %lu cmds, %lu seeks, once\n",
+				ramdisk_stats.wr_cmds - s.wr_cmds,
+				ramdisk_stats.wr_seeks - s.wr_seeks);
+	}
+	uint64_t t0 = test_ns();
+	for (int i = 0; i < n; i++) {
+		if (journal && jr.seq == BDSK_JOURNAL_MAX) {
+			folds += jr.pending;
+			s = ramdisk_stats;
+			TEST_EQ(compact(), 0);
+			stats_add(&c, &s);
+		}
+		int t = _rand() % BDSK_TRACKS;
+		fill(d, 1000 + i);
+		s = ramdisk_stats;
+		TEST_EQ(write_track(journal, t, d, 51000 + i), 0);
+		stats_add(&w, &s);
+		memcpy(model[t], d, sizeof(d));
+		model_bits[t] = 51000 + i;
+	}
+	uint64_t t1 = test_ns();
+	printf("%-8s %d writes: %.1f cmds, %.1f sectors, %.2f seeks, %.1f reads, "
+			"%.1f us host per write\n", journal ? "journal" : "in place", n,
+			(double)w.wr_cmds / n, (double)w.wr_sectors / n,
+			(double)w.wr_seeks / n, (double)w.rd_cmds / n,
+			(t1 - t0) / 1000.0 / n);
+	if (folds)
+		printf("         folds of full logs, %d tracks: %.1f cmds, %.2f seeks "
+				"per track\n", folds, (double)c.wr_cmds / folds,
+				(double)c.wr_seeks / folds);
+	/* what a reboot sees, log and all */
+	TEST_EQ(load(), 0);
+	TEST_EQ(tracks_differ(-1), 0);
+	if (!journal)
+		return;
+	TEST_ASSERT(jr.pending > 0);
+
+	folds = jr.pending;
+	s = ramdisk_stats;
+	TEST_EQ(compact(), 0);
+	printf("         compaction of %d tracks: %.1f cmds, %.2f seeks per track\n",
+			folds, (double)(ramdisk_stats.wr_cmds - s.wr_cmds) / folds,
+			(double)(ramdisk_stats.wr_seeks - s.wr_seeks) / folds);
+	TEST_EQ(load(), 0);
+	TEST_EQ(jr.pending, 0);
+	TEST_EQ(jr.end, BDSK_JOURNAL_BASE);
+	TEST_EQ(tracks_differ(-1), 0);
+}
+
+/*
+ * Five tracks logged, two of them twice, then one more track write (or
+ * the fold of the log) cut short after 'cut' sectors, for every cut up to
+ * the whole operation. What was recovered is folded and a track logged
+ * after: nothing of the old log may replay with it.
+ */
+static void
+test_crash(
+		int journal,
+		int fold)
+{
+	const int t = 3;
+	int old = 0, new = 0, corrupt = 0, cuts = 0;
+	uint8_t d[BDSK_TRACK_DATA_SIZE], again[BDSK_TRACK_DATA_SIZE];
+	long span = -1;
+
+	for (long cut = 0; span < 0 || cut <= span; cut++) {
+		create();
+		for (int i = 0; i < 7; i++) {
+			const int lt = i < 5 ? i * 3 : (i - 5) * 6;	// 0 and 6 again
+			fill(d, 500 + i);
+			write_track(journal, lt, d, 52000 + i);
+			memcpy(model[lt], d, sizeof(d));
+			model_bits[lt] = 52000 + i;
+		}
+		fill(d, 9999);
+		unsigned long w0 = ramdisk_stats.wr_sectors;
+		/* the first pass isn't cut, it measures the operation */
+		ramdisk_cut = span < 0 ? -1 : (long)w0 + cut;
+		if (fold)
+			compact();
+		else
+			write_track(journal, t, d, 53000);
+		ramdisk_cut = -1;
+		if (span < 0) {
+			span = ramdisk_stats.wr_sectors - w0;
+			cut = -1;
+			continue;
+		}
+		cuts++;
+		if (load() < 0 || tracks_differ(fold ? -1 : t)) {
+			corrupt++;
+			continue;
+		}
+		if (fold)
+			old++;
+		else if (track_is(t, model[t], model_bits[t]))
+			old++;
+		else if (track_is(t, d, 53000))
+			new++;
+		else
+			corrupt++;
+		if (!journal)
+			continue;
+		/* what was recovered folds back cleanly */
+		const int was_new = !fold && track_is(t, d, 53000);
+		TEST_EQ(compact(), 0);
+		TEST_EQ(load(), 0);
+		TEST_EQ(jr.pending, 0);
+		TEST_EQ(tracks_differ(t), 0);
+		TEST_ASSERT(was_new ? track_is(t, d, 53000) :
+				track_is(t, model[t], model_bits[t]));
+		fill(again, 8888);
+		TEST_EQ(write_track(journal, t, again, 53100), 0);
+		TEST_EQ(load(), 0);
+		TEST_EQ(jr.seq, 1);
+		TEST_EQ(tracks_differ(t), 0);
+		TEST_ASSERT(track_is(t, again, 53100));
+	}
+	printf("power cut %-8s %s: %d cuts, %d old, %d new, %d corrupt\n",
+			journal ? "journal" : "in place", fold ? "fold  " : "append",
+			cuts, old, new, corrupt);
+	TEST_ASSERT(cuts > 1);
+	if (!journal)
+		return;
+	TEST_EQ(corrupt, 0);
+	if (!fold) {
+		TEST_ASSERT(old > 0);
+		TEST_ASSERT(new > 0);
+	}
+}
+
+int
+main()
+{
+	TEST_EQ(ramdisk_format(), 0);
+	test_writes(0);
+	test_writes(1);
+	test_crash(0, 0);
+	test_crash(1, 0);
+	test_crash(1, 1);
+	return TEST_DONE();
+}
@@ -0,0 +1,207 @@
+/*
+ * test_mem_map.c
+ *
+ * mii.c mem[] page map, rebuilt by region from the switches that changed
+ * (mii_page_table_update): a soft switch trace is replayed through
+ * mii_mem_access(), the way the CPU hits $C0xx, and after every access
+ * mem[] has to be the same as a full rebuild from the switch state. The
+ * trace is a scripted boot-like run (language card, 80 column, aux moves)
+ * then random accesses; both the //e and //c mappings. Prints the time of
+ * a switch access with the update, and with a full rebuild instead.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "mii.c"
+
+const uint8_t mii_rom_iiee[16384];
+void init_ram_pages_for(vram_t *v, uint8_t *raw, uint32_t raw_size) {}
+void mii_analog_init(struct mii_t *mii, mii_analog_t *analog) {}
+void mii_analog_access(struct mii_t *mii, mii_analog_t *analog,
+		uint16_t addr, uint8_t *byte, bool write) {}
+void mii_bank_write(mii_bank_t *bank, uint16_t addr, const uint8_t *data,
+		uint16_t len) {}
+bool mii_bank_access(mii_bank_t *bank, uint16_t addr, const uint8_t *data,
+		uint16_t len, bool write) { return false; }
+mii_rom_t * mii_rom_get(const char *name) { return NULL; }
+void mii_speaker_click(mii_speaker_t *speaker) {}
+void mii_video_init(struct mii_t *mii) {}
+uint8_t mii_video_get_vapor(struct mii_t *mii) { return 0; }
+int mii_cpu_disasm_one(const uint8_t *prog, uint16_t addr, char *out,
+		size_t out_len, uint16_t flags) { return 0; }
+
+/* only the switches mii_access_video() flips for the mapping */
+bool
+mii_access_video(
+		struct mii_t *mii,
+		uint16_t addr,
+		uint8_t *byte,
+		bool write)
+{
+	switch (addr) {
+		case SWHIRESOFF:
+		case SWHIRESON:
+			SW_SETSTATE(mii, SWHIRES, addr & 1);
+			break;
+		case SWPAGE2OFF:
+		case SWPAGE2ON:
+			SW_SETSTATE(mii, SWPAGE2, addr & 1);
+			break;
+	}
+	return false;
+}
+
+static mii_t mii;
+static int accesses, differ;
+
+static void
+setup(
+		int emu)
+{
+	memset(&mii, 0, sizeof(mii));
+	for (int i = 0; i < MII_BANK_COUNT; i++)
+		mii.bank[i] = _mii_banks_init[i];
+	mii.emu = emu;
+	mii.sw_state = M_BSRWRITE | M_BSRPAGE2 | M_SWINTCXROM;
+	mii.mem_dirty = 1;
+	mii_page_table_update(&mii);
+}
+
+/* mem[] as mii_page_table_update() builds it from nothing */
+static void
+full_rebuild(
+		typeof(mii.mem[0]) *out)
+{
+	typeof(mii.mem) save;
+	uint32_t map = mii.mem_map;
+
+	memcpy(save, mii.mem, sizeof(save));
+	memset(mii.mem, 0xff, sizeof(mii.mem));
+	mii.mem_map = 0;
+	mii.mem_dirty = 1;
+	mii_page_table_update(&mii);
+	memcpy(out, mii.mem, sizeof(mii.mem));
+	memcpy(mii.mem, save, sizeof(save));
+	mii.mem_map = map;
+}
+
+/* $C0xx, $CFFF, or a $C3xx read (INTC8ROM on, what the desktop build's
+ * ROM bank callback does) */
+static void
+sw_access(
+		uint16_t addr,
+		bool write)
+{
+	uint8_t d = 0;
+	if ((addr >> 8) == 0xc3)
+		_mii_select_c3introm(&mii.bank[MII_BANK_ROM], &mii, addr, &d, write);
+	else
+		mii_mem_access(&mii, addr, &d, write, true);
+}
+
+/* one access of the trace, then the check */
+static void
+access(
+		uint16_t addr,
+		bool write)
+{
+	typeof(mii.mem) want;
+
+	sw_access(addr, write);
+	accesses++;
+
+	full_rebuild(want);
+	if (memcmp(mii.mem, want, sizeof(want))) {
+		if (!differ)
+			printf("%04x %c, switches %05x: mem[] isn't a full rebuild\n",
+					addr, write ? 'w' : 'r', mii.sw_state);
+		differ++;
+		memcpy(mii.mem, want, sizeof(want));
+	}
+}
+
+/* addresses that move the mapping, and some that must not */
+static const uint16_t trace_sw[] = {
+	0xc000, 0xc001, 0xc002, 0xc003, 0xc004, 0xc005, 0xc006, 0xc007,
+	0xc008, 0xc009, 0xc00a, 0xc00b, 0xc00c, 0xc00d, 0xc00e, 0xc00f,
+	0xc050, 0xc051, 0xc052, 0xc053, 0xc054, 0xc055, 0xc056, 0xc057,
+	0xc05e, 0xc05f,
+	0xc080, 0xc081, 0xc082, 0xc083, 0xc084, 0xc085, 0xc086, 0xc087,
+	0xc088, 0xc089, 0xc08a, 0xc08b, 0xc08c, 0xc08d, 0xc08e, 0xc08f,
+	0xc011, 0xc012, 0xc013, 0xc014, 0xc016, 0xc018,
+	0xc300, 0xcfff,
+};
+
+/* language card setup, 80 column text and DHGR page flips, aux moves */
+static const struct {
+	uint16_t addr;
+	bool write;
+} trace_boot[] = {
+	{ 0xc006, 1 }, { 0xc00a, 1 },		// slot ROMs, slot 3 internal
+	{ 0xc300, 0 }, { 0xcfff, 0 },
+	{ 0xc08b, 0 }, { 0xc08b, 0 },		// LC bank 1, read/write
+	{ 0xc083, 0 }, { 0xc083, 0 },		// bank 2
+	{ 0xc081, 0 }, { 0xc081, 0 },		// ROM, write RAM
+	{ 0xc001, 1 }, { 0xc055, 0 }, { 0xc054, 0 },	// 80STORE, PAGE2
+	{ 0xc057, 0 }, { 0xc055, 1 }, { 0xc054, 1 },	// with HIRES
+	{ 0xc000, 1 }, { 0xc055, 0 }, { 0xc056, 0 },	// without
+	{ 0xc003, 1 }, { 0xc005, 1 }, { 0xc002, 1 }, { 0xc004, 1 },
+	{ 0xc009, 1 }, { 0xc08b, 0 }, { 0xc008, 1 },	// ALTZP and the LC
+	{ 0xc080, 0 }, { 0xc082, 0 }, { 0xc007, 1 },
+};
+
+static void
+replay(
+		int emu)
+{
+	const int n = 200000;
+
+	setup(emu);
+	for (unsigned i = 0; i < sizeof(trace_boot) / sizeof(trace_boot[0]); i++)
+		access(trace_boot[i].addr, trace_boot[i].write);
+	test_seed = 1;
+	for (int i = 0; i < n; i++) {
+		uint32_t r = _rand();
+		access(trace_sw[r % (sizeof(trace_sw) / sizeof(trace_sw[0]))],
+				(r >> 16) & 1);
+	}
+}
+
+/* the random trace again, timed; 'full' rebuilds all of mem[] whenever
+ * it is dirty, what mii_page_table_update() did before the regions */
+static void
+bench(void)
+{
+	const int n = 1000000;
+	uint64_t t[2];
+
+	for (int full = 0; full < 2; full++) {
+		setup(MII_EMU_IIEE);
+		test_seed = 1;
+		t[full] = test_ns();
+		for (int i = 0; i < n; i++) {
+			uint32_t r = _rand();
+			if (full)
+				mii.mem_map = 0;
+			sw_access(trace_sw[r % (sizeof(trace_sw) / sizeof(trace_sw[0]))],
+					(r >> 16) & 1);
+		}
+		t[full] = test_ns() - t[full];
+	}
+	printf("switch access: %.1f ns by region, %.1f ns full rebuild\n",
+			(double)t[0] / n, (double)t[1] / n);
+}
+
+int
+main()
+{
+	replay(MII_EMU_IIEE);
+	replay(MII_EMU_IIC);
+	printf("%d accesses, %d differ from a full rebuild\n", accesses, differ);
+	TEST_EQ(differ, 0);
+	TEST_ASSERT(accesses > 0);
+	bench();
+	return TEST_DONE();
+}
@@ -0,0 +1,309 @@
+/*
+ * test_nibcap.c
+ *
+ * Floppy nibble stream capture (mii_nibcap.c) written to a RAM FatFs
+ * volume (ramdisk.c): a made up stream of nibbles, with drive and quarter
+ * track changes, bit positions wrapping around the track and cycle gaps
+ * up to five LEB128 bytes long, is captured and decoded back the
+ * way tools/mii_nibcap_diff.py does it. Stopped by the guest time, and by
+ * a full buffer: the log has to be exactly the first nibbles of the
+ * stream, never a partial record, and nothing is logged after; the
+ * longest records are tried at every fill of the end of the buffer. With a
+ * directory argument both captures are copied there, for the diff tool.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "ramdisk.h"
+#include "mii_nibcap.c"
+
+#define START		1000
+#define STREAM		(MII_NIBCAP_SIZE / 2)
+
+typedef struct nib_t {
+	uint8_t		drive, qtrack, value;
+	uint32_t	bit, bit_count;
+	uint64_t	cycle;
+} nib_t;
+
+static mii_t mii;
+static nib_t *stream, *out;
+
+/* the same stream every time: mostly a nibble every 32 cycles and 8 bits,
+ * now and then a seek, a drive switch, a jump around the track (and past
+ * its end) or a long wait */
+static void
+make_stream(void)
+{
+	nib_t n = { .qtrack = 0, .bit_count = 50000, .cycle = START };
+
+	test_seed = 1;
+	for (int i = 0; i < STREAM; i++) {
+		uint32_t r = _rand();
+		if (r % 500 == 0) {
+			n.drive = _rand() & 1;
+			n.qtrack = _rand() % 140;
+			n.bit_count = 50000 + n.qtrack * 13;	// a track keeps its length
+			n.bit = _rand() % n.bit_count;
+		} else if (r % 500 == 1)
+			n.drive ^= 1;
+		else if (r % 100 == 2)
+			n.bit = (n.bit + _rand() % n.bit_count) % n.bit_count;
+		else
+			n.bit = (n.bit + 8 + _rand() % 4) % n.bit_count;
+		if (r % 5000 == 3)
+			n.cycle += (uint64_t)(_rand() & 0xffff) << (_rand() % 14);
+		else
+			n.cycle += 28 + _rand() % 8;
+		n.value = 0x80 | _rand();
+		stream[i] = n;
+	}
+}
+
+/* feeds the stream from the LSS side, returns how many went in */
+static int
+feed(void)
+{
+	int i = 0;
+	for (; i < STREAM && _nibcap.state == MII_NIBCAP_ON; i++)
+		mii_nibcap_byte(stream[i].cycle, stream[i].drive, stream[i].qtrack,
+				stream[i].bit, stream[i].bit_count, stream[i].value);
+	return i;
+}
+
+static uint64_t
+le(
+		const uint8_t *p,
+		int n)
+{
+	uint64_t v = 0;
+	for (int i = n; i-- > 0;)
+		v = v << 8 | p[i];
+	return v;
+}
+
+static uint64_t
+leb(
+		const uint8_t *cap,
+		uint32_t *pos)
+{
+	uint64_t v = 0;
+	for (int shift = 0;; shift += 7) {
+		uint8_t b = cap[(*pos)++];
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return v;
+	}
+}
+
+/* the file the last capture left, decoded into out[]; -1 if it doesn't
+ * parse */
+static int
+load(
+		const char *path,
+		uint8_t **file,
+		uint32_t *size)
+{
+	FIL f;
+	UINT br;
+
+	*file = NULL;
+	if (f_open(&f, path, FA_READ) != FR_OK)
+		return -1;
+	*size = f_size(&f);
+	uint8_t *cap = *file = malloc(*size);
+	f_read(&f, cap, *size, &br);
+	f_close(&f);
+	if (br != *size || *size < MII_NIBCAP_HEADER ||
+			memcmp(cap, "MIIN\x01", 5) || le(cap + 8, 8) != START)
+		return -1;
+
+	nib_t n = { .bit_count = 1, .cycle = START };
+	int count = 0;
+	for (uint32_t pos = MII_NIBCAP_HEADER; pos < *size;) {
+		uint8_t kind = cap[pos];
+		if (kind == 0x01) {
+			if (pos + 19 > *size)
+				return -1;
+			n.drive = cap[pos + 1];
+			n.qtrack = cap[pos + 2];
+			n.bit = le(cap + pos + 3, 4);
+			n.bit_count = le(cap + pos + 7, 4);
+			n.cycle = le(cap + pos + 11, 8);
+			pos += 19;
+		} else if (kind & 0x80) {
+			pos++;
+			n.cycle += leb(cap, &pos);
+			n.bit = (n.bit + leb(cap, &pos)) % n.bit_count;
+			n.value = kind;
+			if (pos > *size)
+				return -1;
+			out[count++] = n;
+		} else
+			return -1;
+	}
+	return count;
+}
+
+/* out[] is the start of the stream */
+static int
+differ(
+		int count)
+{
+	for (int i = 0; i < count; i++)
+		if (out[i].value != stream[i].value ||
+				out[i].drive != stream[i].drive ||
+				out[i].qtrack != stream[i].qtrack ||
+				out[i].bit != stream[i].bit ||
+				out[i].cycle != stream[i].cycle) {
+			printf("nibble %d: $%02x drive %d qtrack %d bit %u cycle %llu, "
+					"not $%02x drive %d qtrack %d bit %u cycle %llu\n", i,
+					out[i].value, out[i].drive, out[i].qtrack, out[i].bit,
+					(unsigned long long)out[i].cycle, stream[i].value,
+					stream[i].drive, stream[i].qtrack, stream[i].bit,
+					(unsigned long long)stream[i].cycle);
+			return 1;
+		}
+	return 0;
+}
+
+static void
+copy_out(
+		const char *dir,
+		const char *name,
+		const uint8_t *file,
+		uint32_t size)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *o = fopen(path, "wb");
+	TEST_ASSERT(o && fwrite(file, 1, size, o) == size);
+	if (o)
+		fclose(o);
+}
+
+/* the whole seconds of guest time the first 20000 nibbles take, the
+ * buffer far from full */
+static void
+test_time(
+		const char *dir)
+{
+	const uint32_t secs = (stream[20000].cycle - START) / 1023000 + 1;
+	const uint64_t end = START + (uint64_t)secs * 1023000;
+	uint8_t *file;
+	uint32_t size;
+
+	mii.cpu.total_cycle = START;
+	TEST_EQ(mii_nibcap_start(&mii, secs), 0);
+	int fed = feed();
+	TEST_EQ(_nibcap.state, MII_NIBCAP_DONE);
+	TEST_ASSERT(_nibcap.pos + MII_NIBCAP_MAX <= MII_NIBCAP_SIZE);
+	TEST_ASSERT(stream[fed - 1].cycle >= end);
+	TEST_ASSERT(stream[fed - 2].cycle < end);
+	const uint32_t count = _nibcap.count;
+	TEST_EQ(count, fed - 1);
+	TEST_ASSERT(count >= 20000);
+
+	mii_nibcap_poll(&mii, "");
+	TEST_EQ(_nibcap.state, MII_NIBCAP_OFF);
+	TEST_EQ(load("/nib000.min", &file, &size), count);
+	TEST_EQ(size, _nibcap.pos);
+	TEST_EQ(differ(count), 0);
+	printf("%u nibbles over %u s: %.2f bytes per nibble\n", count, secs,
+			(double)(size - MII_NIBCAP_HEADER) / count);
+	if (dir)
+		copy_out(dir, "nib_time.min", file, size);
+	free(file);
+}
+
+/* until the buffer is full, with a deadline it never gets to */
+static void
+test_full(
+		const char *dir)
+{
+	uint8_t *file;
+	uint32_t size;
+
+	mii.cpu.total_cycle = START;
+	TEST_EQ(mii_nibcap_start(&mii, 1000000), 0);
+	/* still on, the poll leaves it be */
+	mii_nibcap_poll(&mii, "");
+	TEST_EQ(_nibcap.state, MII_NIBCAP_ON);
+	uint64_t t0 = test_ns();
+	int fed = feed();
+	uint64_t t1 = test_ns();
+	TEST_EQ(_nibcap.state, MII_NIBCAP_DONE);
+	TEST_ASSERT(fed < STREAM);
+	TEST_ASSERT(_nibcap.pos <= MII_NIBCAP_SIZE);
+	TEST_ASSERT(_nibcap.pos + MII_NIBCAP_MAX > MII_NIBCAP_SIZE);
+	const uint32_t count = _nibcap.count, pos = _nibcap.pos;
+	TEST_EQ(count, fed - 1);
+	/* nothing more once it's over, nor after it is written */
+	mii_nibcap_byte(stream[fed].cycle, 0, 0, 0, 1, 0xff);
+	TEST_EQ(_nibcap.count, count);
+	TEST_EQ(_nibcap.pos, pos);
+
+	mii_nibcap_poll(&mii, "");
+	mii_nibcap_byte(stream[fed].cycle, 0, 0, 0, 1, 0xff);
+	mii_nibcap_poll(&mii, "");
+	TEST_EQ(load("/nib002.min", &file, &size), -1);
+	free(file);
+	TEST_EQ(load("/nib001.min", &file, &size), count);
+	TEST_EQ(size, pos);
+	TEST_EQ(differ(count), 0);
+	printf("%u nibbles to fill %u KB, %.1f ns per nibble logged\n", count,
+			MII_NIBCAP_SIZE / 1024, (double)(t1 - t0) / fed);
+	if (dir)
+		copy_out(dir, "nib_full.min", file, size);
+	free(file);
+}
+
+/* the longest records there are, a seek (position record and a nibble)
+ * and a nibble with a 64 and a 32 bit LEB128 delta, at every fill of the
+ * end of the buffer: they go in as long as MII_NIBCAP_MAX is left, never
+ * past the end */
+static void
+test_edge(void)
+{
+	int wrong = 0;
+
+	for (int seek = 0; seek < 2; seek++)
+		for (uint32_t room = 0; room <= MII_NIBCAP_MAX + 8; room++) {
+			mii.cpu.total_cycle = START;
+			mii_nibcap_start(&mii, UINT32_MAX);
+			_nibcap.end = UINT64_MAX;
+			mii_nibcap_byte(START, 0, 0, 1, 0xffffffff, 0xd5);
+			_nibcap.pos = MII_NIBCAP_SIZE - room;
+			mii_nibcap_byte(UINT64_MAX - 1, seek, 0, 0, 0xffffffff, 0xaa);
+			bool in = _nibcap.count == 2;
+			if (_nibcap.pos > MII_NIBCAP_SIZE || (room >= MII_NIBCAP_MAX && !in)) {
+				if (!wrong)
+					printf("%s, %u bytes left: %s, %u past the end\n",
+							seek ? "seek" : "long deltas", room,
+							in ? "logged" : "dropped",
+							_nibcap.pos - MII_NIBCAP_SIZE);
+				wrong++;
+			}
+		}
+	TEST_EQ(wrong, 0);
+	_nibcap.state = MII_NIBCAP_OFF;
+}
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	TEST_EQ(ramdisk_format(), 0);
+	stream = malloc(STREAM * sizeof(*stream));
+	out = malloc(STREAM * sizeof(*out));
+	make_stream();
+	test_time(argc > 1 ? argv[1] : NULL);
+	test_full(argc > 1 ? argv[1] : NULL);
+	test_edge();
+	free(stream);
+	free(out);
+	return TEST_DONE();
+}
@@ -0,0 +1,84 @@
+/*
+ * test_nsc.c
+ *
+ * No Slot Clock, driven from a mock clock: the guest side has to read
+ * back exactly what mii_nsc_set_time() was given, never the host time.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "mii_test.h"
+#include "mii_noslotclock.c"
+
+mii_slot_drv_t * mii_slot_drv_list;
+static mii_t mii;
+
+/* shift the unlock pattern in, the same way NS.CLOCK.SYSTEM does: reads
+ * of $C800 with A2 clear and A0 the data bit */
+static void
+_unlock(void)
+{
+	for (int i = 0; i < 64; i++) {
+		uint8_t b = 0xff;
+		uint16_t addr = 0xc800 | ((nsc_pattern >> i) & 1);
+		TEST_ASSERT(!mii_nsc_access(&mii, addr, &b, false));
+	}
+}
+
+static uint64_t
+_read_clock(void)
+{
+	uint64_t res = 0;
+	_unlock();
+	for (int i = 0; i < 64; i++) {
+		uint8_t b = 0xfe;
+		TEST_ASSERT(mii_nsc_access(&mii, 0xc804, &b, false));
+		res |= (uint64_t)(b & 1) << i;
+	}
+	return res;
+}
+
+int
+main()
+{
+	uint8_t b = 0;
+	// not probed yet, the ROM is left alone
+	TEST_ASSERT(!mii_nsc_access(&mii, 0xc804, &b, false));
+	TEST_ASSERT(_mii_nsc_probe(&mii, MII_INIT_NSC) == 1);
+
+	struct tm t = {
+		.tm_year = 126, .tm_mon = 9, .tm_mday = 18, .tm_wday = 0,
+		.tm_hour = 13, .tm_min = 45, .tm_sec = 7,
+	};
+	mii_nsc_set_time(&t);
+	TEST_EQ(mii_nsc_bcd_from_tm(&t), 0x2610180113450700ULL);
+	TEST_EQ(_read_clock(), 0x2610180113450700ULL);
+
+	// moving the mock clock moves what the guest reads
+	t.tm_year = 99; t.tm_mon = 11; t.tm_mday = 31; t.tm_wday = 5;
+	t.tm_hour = 23; t.tm_min = 59; t.tm_sec = 59;
+	mii_nsc_set_time(&t);
+	TEST_EQ(_read_clock(), 0x9912310623595900ULL);
+	// and a second read, no new set_time, returns the same
+	TEST_EQ(_read_clock(), 0x9912310623595900ULL);
+
+	// a read in the middle of the pattern starts it over
+	for (int i = 0; i < 32; i++) {
+		uint16_t addr = 0xc800 | ((nsc_pattern >> i) & 1);
+		TEST_ASSERT(!mii_nsc_access(&mii, addr, &b, false));
+	}
+	TEST_ASSERT(!mii_nsc_access(&mii, 0xc804, &b, false));
+	for (int i = 32; i < 64; i++) {
+		uint16_t addr = 0xc800 | ((nsc_pattern >> i) & 1);
+		TEST_ASSERT(!mii_nsc_access(&mii, addr, &b, false));
+	}
+	TEST_ASSERT(!mii_nsc_access(&mii, 0xc804, &b, false));
+
+	// a write transfer takes 64 bits, then the clock is back to idle
+	_unlock();
+	for (int i = 0; i < 64; i++)
+		TEST_ASSERT(mii_nsc_access(&mii, 0xc800 | (i & 1), &b, false));
+	TEST_ASSERT(!mii_nsc_access(&mii, 0xc804, &b, false));
+	TEST_EQ(_read_clock(), 0x9912310623595900ULL);
+
+	return TEST_DONE();
+}
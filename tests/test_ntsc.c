@@ -0,0 +1,159 @@
+/*
+ * test_ntsc.c
+ *
+ * NTSC composite rendering (WITH_NTSC_COMPOSITE) against the fixed cell
+ * decoders it replaces: solid HGR and DHGR colours have to come out the
+ * same, only edges differ. A few whole lines are also checked against
+ * golden hashes, so any change to the window LUT or the dot stream shows.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "mii_test.h"
+#include "mii_video.c"
+
+volatile int lock_y;
+void sleep_ms(uint32_t ms) {}
+bool ps2kbd_is_show_speed(void) { return false; }
+int mii_disk2_get_motor_state(void) { return 0; }
+mii_rom_t * mii_rom_get(const char *name) { return NULL; }
+void mii_bank_read(mii_bank_t *b, uint16_t a, uint8_t *d, uint16_t l) {}
+uint8_t mii_timer_register(mii_t *mii, mii_timer_p cb, void *param,
+		int64_t when, const char *name) { return 0; }
+int64_t mii_timer_get(mii_t *mii, uint8_t id) { return 0; }
+int mii_timer_set(mii_t *mii, uint8_t id, int64_t when) { return 0; }
+
+#define BORDER	((320 - 280) / 2)
+
+static uint8_t
+_px(
+		const uint8_t *fb_row,
+		int x)	// 0..279
+{
+	x += BORDER;
+	return (fb_row[x >> 1] >> ((x & 1) * 4)) & 0xf;
+}
+
+/* the fixed 7 pixel cell HGR decoder, 280 pixels of hardware colours */
+static void
+_ref_hires(
+		const uint8_t *row,
+		uint8_t *px)
+{
+	uint8_t b0 = 0, b1 = row[0];
+	for (int col = 0; col < 40; col++) {
+		uint8_t b2 = col == 39 ? 0 : row[col + 1];
+		uint16_t run = ((b0 & 0x60) >> 5) | ((b1 & 0x7f) << 2) |
+						((b2 & 0x03) << 9);
+		int odd = (col & 1) << 1;
+		int offset = (b1 & 0x80) >> 5;
+		for (int i = 0; i < 7; i++) {
+			int left = (run >> (1 + i)) & 1;
+			int pixel = (run >> (2 + i)) & 1;
+			int right = (run >> (3 + i)) & 1;
+			int idx = 0;
+			if (pixel)
+				idx = (left || right) ? 9 : offset + odd + (i & 1) + 1;
+			else if (left && right)
+				idx = offset + odd + 1 - (i & 1) + 1;
+			px[col * 7 + i] = rp2350_ci_to_hw[mii_base_clut.hires[idx]];
+		}
+		b0 = b1;
+		b1 = b2;
+	}
+}
+
+static void
+_hires_solid(
+		uint8_t even,
+		uint8_t odd)
+{
+	uint8_t row[40], ref[280], fb[160] = {0};
+	for (int c = 0; c < 40; c++)
+		row[c] = (c & 1) ? odd : even;
+	_ref_hires(row, ref);
+	_mii_ntsc_hires_line(row, fb);
+	int bad = 0;
+	// the first and last few pixels see the border, the cells don't
+	for (int x = 4; x < 276; x++)
+		bad += _px(fb, x) != ref[x];
+	if (bad)
+		printf("HGR %02x/%02x: %d pixels differ\n", even, odd, bad);
+	TEST_EQ(bad, 0);
+}
+
+static uint32_t
+_fnv(
+		const uint8_t *b,
+		int len)
+{
+	uint32_t h = 2166136261u;
+	while (len--)
+		h = (h ^ *b++) * 16777619u;
+	return h;
+}
+
+int
+main()
+{
+	_mii_ntsc_init();
+	// LUT: a window of all ones is white, all zeroes black, both pixels
+	TEST_EQ(ntsc_lut[0], 0x00);
+	TEST_EQ(ntsc_lut[63], 0xff);
+	TEST_EQ(ntsc_dbl[0x01], 0x0003);
+	TEST_EQ(ntsc_dbl[0x40], 0x3000);
+	TEST_EQ(ntsc_dbl[0x7f], 0x3fff);
+
+	_hires_solid(0x55, 0x2a);	// purple
+	_hires_solid(0x2a, 0x55);	// green
+	_hires_solid(0xd5, 0xaa);	// blue
+	_hires_solid(0xaa, 0xd5);	// orange
+	_hires_solid(0x7f, 0x7f);	// white
+	_hires_solid(0xff, 0xff);
+	_hires_solid(0x00, 0x80);	// black
+
+	// DHGR: every colour, as a solid fill, is its DHGR palette entry
+	for (int n = 0; n < 16; n++) {
+		uint8_t m[40], a[40], fb[160] = {0};
+		uint32_t pat = 0;
+		// dot p of the line has phase p & 3, that is bit 3 - phase
+		for (int i = 0; i < 28; i++)
+			if (n & (1 << (3 - (i & 3))))
+				pat |= 1u << i;
+		for (int c = 0; c < 40; c++) {
+			a[c] = ((c & 1) ? pat >> 14 : pat) & 0x7f;
+			m[c] = ((c & 1) ? pat >> 21 : pat >> 7) & 0x7f;
+		}
+		_mii_ntsc_dhires_line(m, a, fb);
+		uint8_t want = rp2350_ci_to_hw[mii_base_clut.dhires[n]];
+		int bad = 0;
+		for (int x = 4; x < 276; x++)
+			bad += _px(fb, x) != want;
+		if (bad)
+			printf("DHGR colour %x: %d pixels differ\n", n, bad);
+		TEST_EQ(bad, 0);
+	}
+
+	// golden lines: an edge, and a pseudo random HGR and DHGR line
+	uint8_t row[40] = {0}, aux[40], fb[160] = {0};
+	row[20] = row[21] = 0x7f;
+	_mii_ntsc_hires_line(row, fb);
+	// pixels 138..155, white from 140 with a purple fringe before it,
+	// and the last pixel goes green as the window slides off it
+	static const uint8_t edge[] = {
+		0x30, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xcf, 0x00,
+	};
+	for (int i = 0; i < (int)sizeof(edge); i++)
+		TEST_EQ(fb[(BORDER + 138) / 2 + i], edge[i]);
+	uint32_t seed = 1;
+	for (int c = 0; c < 40; c++) {
+		seed = seed * 1103515245 + 12345;
+		row[c] = seed >> 16;
+		aux[c] = seed >> 24;
+	}
+	_mii_ntsc_hires_line(row, fb);
+	TEST_EQ(_fnv(fb, sizeof(fb)), 0x07a4d0fb);
+	_mii_ntsc_dhires_line(row, aux, fb);
+	TEST_EQ(_fnv(fb, sizeof(fb)), 0x55d5f7c7);
+
+	return TEST_DONE();
+}
@@ -0,0 +1,211 @@
+/*
+ * test_psram.c
+ *
+ * PSRAM heap (drivers/psram_allocator.c) on a host arena: disk mount and
+ * unmount allocation patterns on both drives, with small long lived
+ * allocations in between, then random malloc/realloc/free. Every block is
+ * filled and checked, the heap has to be back to one free block at the
+ * end. Prints the fragmentation seen (1 - largest free block / free
+ * bytes) and the allocation latency.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "mii_test.h"
+#include "psram_allocator.h"
+
+typedef struct blk_t {
+	uint8_t *	p;
+	size_t		size;
+	uint8_t		tag;
+} blk_t;
+
+static uint64_t alloc_ns, alloc_max, alloc_count;
+static int corrupt, failed;
+
+static int
+_alloc(
+		blk_t *b,
+		size_t size)
+{
+	uint64_t t0 = test_ns();
+	b->p = psram_malloc(size);
+	uint64_t t = test_ns() - t0;
+	alloc_ns += t;
+	alloc_count++;
+	if (t > alloc_max)
+		alloc_max = t;
+	if (!b->p) {
+		failed++;
+		return -1;
+	}
+	b->size = size;
+	b->tag = _rand();
+	memset(b->p, b->tag, size);
+	return 0;
+}
+
+static void
+_free(
+		blk_t *b)
+{
+	if (!b->p)
+		return;
+	for (size_t i = 0; i < b->size; i += 61)
+		if (b->p[i] != b->tag) {
+			corrupt++;
+			break;
+		}
+	if (b->p[b->size - 1] != b->tag)
+		corrupt++;
+	psram_free(b->p);
+	b->p = NULL;
+}
+
+/* what a mount keeps around: the image, its track buffers, and for some
+ * a nibble capture buffer */
+typedef struct mount_t {
+	blk_t		image;
+	blk_t		track[35];
+	blk_t		extra;
+} mount_t;
+
+static const size_t image_sizes[] = {
+	143360,		// DSK/PO
+	232960,		// NIB
+	235008,		// WOZ, 35 tracks
+	819200,		// 800K PO on SmartPort
+};
+
+static void
+_mount(
+		mount_t *m)
+{
+	_alloc(&m->image, image_sizes[_rand() % 4]);
+	for (int t = 0; t < 35; t++)
+		_alloc(&m->track[t], 6656 + 16);
+	if (!(_rand() % 4))
+		_alloc(&m->extra, 256 * 1024);
+}
+
+static void
+_unmount(
+		mount_t *m)
+{
+	// tracks first, then the image, like the loader
+	for (int t = 0; t < 35; t++)
+		_free(&m->track[t]);
+	_free(&m->image);
+	_free(&m->extra);
+}
+
+static double frag_max;
+
+static void
+_sample_frag(void)
+{
+	psram_stats_t st;
+	psram_get_stats(&st);
+	double frag = st.free ? 1.0 - (double)st.largest_free / st.free : 0;
+	if (frag > frag_max)
+		frag_max = frag;
+}
+
+int
+main()
+{
+	psram_stats_t st0, st;
+	psram_get_stats(&st0);
+
+	// large allocations are logged by the allocator, keep that quiet
+	fflush(stdout);
+	int out = dup(1);
+	int null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+
+	mount_t drive[2] = {0};
+	blk_t small[200] = {0};
+	for (int i = 0; i < 2000; i++) {
+		int d = _rand() & 1;
+		_unmount(&drive[d]);
+		_mount(&drive[d]);
+		// UI strings, file lists, state: small and long lived
+		for (int k = 0; k < 4; k++) {
+			blk_t *b = &small[_rand() % 200];
+			_free(b);
+			_alloc(b, 16 + _rand() % 2000);
+		}
+		_sample_frag();
+	}
+	_unmount(&drive[0]);
+	_unmount(&drive[1]);
+	for (int i = 0; i < 200; i++)
+		_free(&small[i]);
+	uint64_t mount_count = alloc_count, mount_ns = alloc_ns;
+	uint64_t mount_max = alloc_max;
+	double mount_frag = frag_max;
+
+	// random sizes, with realloc: mostly small, 1 in 8 up to 60K
+	blk_t rnd[300] = {0};
+	alloc_max = 0;
+	frag_max = 0;
+	for (int i = 0; i < 500000; i++) {
+		if (!(i % 1000))
+			_sample_frag();
+		blk_t *b = &rnd[_rand() % 300];
+		if (!b->p) {
+			_alloc(b, 1 + _rand() % ((_rand() & 7) ? 2000 : 60000));
+			continue;
+		}
+		if (_rand() % 3) {
+			_free(b);
+			continue;
+		}
+		size_t ns = 1 + _rand() % ((_rand() & 7) ? 2000 : 60000);
+		uint8_t *q = psram_realloc(b->p, ns);
+		if (!q) {
+			failed++;
+			continue;
+		}
+		size_t keep = ns < b->size ? ns : b->size;
+		for (size_t k = 0; k < keep; k += 61)
+			if (q[k] != b->tag) {
+				corrupt++;
+				break;
+			}
+		b->p = q;
+		b->size = ns;
+		memset(q, b->tag, ns);
+	}
+	for (int i = 0; i < 300; i++)
+		_free(&rnd[i]);
+
+	fflush(stdout);
+	dup2(out, 1);
+	close(null);
+	close(out);
+
+	psram_get_stats(&st);
+	TEST_EQ(corrupt, 0);
+	TEST_EQ(failed, 0);
+	TEST_EQ(st.failed, 0);
+	TEST_EQ(st.used, st0.used);
+	// everything merged back into the one block
+	TEST_EQ(st.free_blocks, 1);
+	TEST_EQ(st.largest_free, st.free);
+
+	printf("mounts: %llu allocations, %.0f ns average, %llu ns worst,"
+			" fragmentation up to %.1f%%\n",
+			(unsigned long long)mount_count,
+			(double)mount_ns / mount_count,
+			(unsigned long long)mount_max, mount_frag * 100);
+	printf("random: %llu allocations, %.0f ns average, %llu ns worst,"
+			" fragmentation up to %.1f%%\n",
+			(unsigned long long)(alloc_count - mount_count),
+			(double)(alloc_ns - mount_ns) / (alloc_count - mount_count),
+			(unsigned long long)alloc_max, frag_max * 100);
+	return TEST_DONE();
+}
@@ -0,0 +1,114 @@
+/*
+ * test_vga.c
+ *
+ * drivers/vga.c convert_line (one palette_pair lookup per framebuffer
+ * byte, REV16 for the second phase) against the two lookups per byte
+ * loop it replaced, over random palettes with and without the 16 colour
+ * mask, every width up to a full line and both phases. Prints the time
+ * per line of both.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "mii_test.h"
+#include "vga.c"
+
+/* what dma_handler_VGA did before palette_pair */
+static void
+old_loop(
+		uint16_t *out,
+		const uint8_t *in,
+		int width,
+		int phase)
+{
+	const uint16_t *current_palette = palette[phase];
+	for (int x = width / 2; x--; in++) {
+		*out++ = current_palette[*in & 15];
+		*out++ = current_palette[*in >> 4];
+	}
+}
+
+static void
+random_palette(
+		int round)
+{
+	palette16_mask = (round & 1) ? 0xc0c0 : 0;
+	for (int i = 0; i < 256; i++)
+		graphics_set_palette(i, _rand() & 0xffffff);
+	/* graphics_set_mode reapplies the mask and refreshes every pair */
+	if (round % 7 == 0)
+		for (int i = 0; i < 16; i++)
+			update_palette_pair(i);
+}
+
+static void
+test_equal(void)
+{
+	static uint8_t fb[SCREEN_WIDTH / 2 * 8] __aligned(4);
+	/* a guard past the longest line, both sides must leave it alone */
+	static uint32_t a[SCREEN_WIDTH / 2 + 16], b[SCREEN_WIDTH / 2 + 16];
+	int lines = 0, differ = 0;
+
+	for (int round = 0; round < 2000; round++) {
+		random_palette(round);
+		for (unsigned i = 0; i < sizeof(fb); i++)
+			fb[i] = _rand();
+		for (int phase = 0; phase < 2; phase++)
+			for (int w = 0; w <= SCREEN_WIDTH; w += w < 16 ? 1 : 17) {
+				const uint8_t *row = fb + (_rand() % 8) * SCREEN_WIDTH / 2;
+				memset(a, 0x55, sizeof(a));
+				memset(b, 0x55, sizeof(b));
+				old_loop((uint16_t *)a, row, w, phase);
+				convert_line(b, row, w / 2, phase);
+				if (memcmp(a, b, sizeof(a)))
+					differ++;
+				lines++;
+			}
+	}
+	printf("%d lines compared, %d differ\n", lines, differ);
+	TEST_EQ(differ, 0);
+	TEST_ASSERT(lines > 0);
+}
+
+static void
+bench(void)
+{
+	static uint8_t fb[SCREEN_WIDTH * SCREEN_HEIGHT / 2] __aligned(4);
+	static uint32_t out[SCREEN_WIDTH / 2];
+	const int frames = 200;
+	uint64_t t_old, t_new;
+	uint32_t sum = 0;
+
+	random_palette(0);
+	for (unsigned i = 0; i < sizeof(fb); i++)
+		fb[i] = _rand();
+
+	uint64_t t = test_ns();
+	for (int f = 0; f < frames; f++)
+		for (int y = 0; y < SCREEN_HEIGHT; y++) {
+			old_loop((uint16_t *)out, fb + y * SCREEN_WIDTH / 2,
+					SCREEN_WIDTH, y & 1);
+			sum += out[y % (SCREEN_WIDTH / 2)];
+		}
+	t_old = test_ns() - t;
+	t = test_ns();
+	for (int f = 0; f < frames; f++)
+		for (int y = 0; y < SCREEN_HEIGHT; y++) {
+			convert_line(out, fb + y * SCREEN_WIDTH / 2,
+					SCREEN_WIDTH / 2, y & 1);
+			sum += out[y % (SCREEN_WIDTH / 2)];
+		}
+	t_new = test_ns() - t;
+	printf("line: two lookups %.1f ns, palette_pair %.1f ns (%x)\n",
+			(double)t_old / (frames * SCREEN_HEIGHT),
+			(double)t_new / (frames * SCREEN_HEIGHT), sum & 0xf);
+}
+
+int
+main()
+{
+	test_equal();
+	bench();
+	return TEST_DONE();
+}
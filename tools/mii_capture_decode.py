@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Convert a gameplay capture (capNNN.mic, see src/mii_capture.c) to one PNG
+per captured frame and a WAV of the audio.
+
+    tools/mii_capture_decode.py cap000.mic out/
+
+Frames are named after the guest frame number (60 per second); gaps in the
+numbering are frames that weren't rendered, or were dropped while the SD
+card was busy.
+Only the Python standard library is needed.
+"""
+import os
+import struct
+import sys
+import wave
+import zlib
+
+# PNG packs the leftmost pixel in the high nibble, the framebuffer in the low
+SWAP = bytes(((b & 0x0f) << 4) | (b >> 4) for b in range(256))
+
+
+def png_chunk(kind, data):
+    c = kind + data
+    return struct.pack('>I', len(data)) + c + struct.pack('>I', zlib.crc32(c))
+
+
+def write_png(path, w, h, palette, fb):
+    stride = w // 2
+    raw = bytearray()
+    for y in range(h):
+        raw.append(0)   # no filter
+        raw += fb[y * stride:(y + 1) * stride].translate(SWAP)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(png_chunk(b'IHDR', struct.pack('>IIBBBBB', w, h, 4, 3, 0, 0, 0)))
+        f.write(png_chunk(b'PLTE', palette))
+        f.write(png_chunk(b'IDAT', zlib.compress(bytes(raw), 6)))
+        f.write(png_chunk(b'IEND', b''))
+
+
+def apply_delta(fb, data):
+    """XOR the RLE coded delta 'data' into 'fb'"""
+    i = o = 0
+    while i < len(data):
+        c = data[i]
+        if c < 0x80:
+            n = c + 1
+            for k in range(n):
+                fb[o + k] ^= data[i + 1 + k]
+            i += 1 + n
+        else:
+            n = (((c & 0x3f) << 8) | data[i + 1]) + 1
+            if c < 0xc0:
+                i += 2
+            else:
+                v = data[i + 2]
+                for k in range(n):
+                    fb[o + k] ^= v
+                i += 3
+        o += n
+    if o != len(fb):
+        raise ValueError('frame decodes to %d bytes, not %d' % (o, len(fb)))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: %s capture.mic outdir' % sys.argv[0])
+    with open(sys.argv[1], 'rb') as f:
+        cap = f.read()
+    out = sys.argv[2]
+    os.makedirs(out, exist_ok=True)
+
+    if cap[:4] != b'MIIC' or cap[4] != 1:
+        sys.exit('%s is not a capture' % sys.argv[1])
+    bpp, channels = cap[5], cap[6]
+    w, h, rate = struct.unpack_from('<HHI', cap, 8)
+    palette = cap[16:64]
+    if bpp != 4:
+        sys.exit('%d bits per pixel not supported' % bpp)
+
+    fb = bytearray(w * h // 2)
+    audio = bytearray()
+    frames = first = last = 0
+    pos = 64
+    while pos + 4 <= len(cap):
+        kind = cap[pos]
+        length = cap[pos + 1] | (cap[pos + 2] << 8) | (cap[pos + 3] << 16)
+        body = cap[pos + 4:pos + 4 + length]
+        pos += 4 + length
+        if len(body) != length:
+            print('truncated record at the end, ignored')
+            break
+        if kind == ord('V'):
+            frame, = struct.unpack_from('<I', body)
+            apply_delta(fb, body[4:])
+            write_png(os.path.join(out, 'frame_%06d.png' % frame),
+                      w, h, palette, fb)
+            if not frames:
+                first = frame
+            last = frame
+            frames += 1
+        elif kind == ord('A'):
+            index, = struct.unpack_from('<I', body)
+            at = index * 2 * channels
+            if at > len(audio):     # lost samples, silence
+                audio += bytes(at - len(audio))
+            audio[at:at + len(body) - 4] = body[4:]
+        else:
+            print('unknown record %r, ignored' % chr(kind))
+
+    with wave.open(os.path.join(out, 'audio.wav'), 'wb') as wav:
+        wav.setnchannels(channels)
+        wav.setsampwidth(2)
+        wav.setframerate(rate)
+        wav.writeframes(bytes(audio))
+    span = last - first + 1 if frames else 0
+    print('%d frames over %d guest frames, %.1f s of audio' %
+          (frames, span, len(audio) / (2 * channels * rate)))
+
+
+if __name__ == '__main__':
+    main()
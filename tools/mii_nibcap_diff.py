@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Compare two floppy nibble stream captures (nibNNN.min, see src/mii_nibcap.c)
+and show where the guest first read something different.
+
+    tools/mii_nibcap_diff.py before.min after.min
+
+Nibble values and head positions (drive, quarter track, bit) have to match
+for the captures to be the same; cycles that differ are only reported,
+a change of timing alone is not a divergence. Exits 1 if the streams
+diverge, so it can be run over a corpus of images from a script.
+"""
+import struct
+import sys
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        cap = f.read()
+    if cap[:4] != b'MIIN' or cap[4] != 1:
+        sys.exit('%s is not a nibble capture' % path)
+    start, = struct.unpack_from('<Q', cap, 8)
+    out = []
+    drive = qtrack = bit = 0
+    bit_count = 1
+    cycle = start
+    pos = 16
+
+    def leb():
+        nonlocal pos
+        v = shift = 0
+        while True:
+            b = cap[pos]
+            pos += 1
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    while pos < len(cap):
+        kind = cap[pos]
+        if kind == 0x01:
+            drive, qtrack = cap[pos + 1], cap[pos + 2]
+            bit, bit_count, cycle = struct.unpack_from('<IIQ', cap, pos + 3)
+            pos += 19
+        elif kind & 0x80:
+            pos += 1
+            cycle += leb()
+            bit = (bit + leb()) % bit_count
+            out.append((drive, qtrack, bit, cycle, kind))
+        else:
+            sys.exit('%s: bad record 0x%02x at offset %d' % (path, kind, pos))
+    return start, out
+
+
+def where(n):
+    drive, qtrack, bit, cycle, _ = n
+    return 'drive %d track %d.%02d bit %d, cycle %d' % (
+        drive + 1, qtrack // 4, (qtrack % 4) * 25, bit, cycle)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: %s a.min b.min' % sys.argv[0])
+    sa, a = load(sys.argv[1])
+    sb, b = load(sys.argv[2])
+    print('%s: %d nibbles, %s: %d nibbles' %
+          (sys.argv[1], len(a), sys.argv[2], len(b)))
+    if sa != sb:
+        print('captures start at different cycles (%d, %d)' % (sa, sb))
+
+    first_timing = None
+    for i in range(min(len(a), len(b))):
+        na, nb = a[i], b[i]
+        if na[3] - sa != nb[3] - sb and first_timing is None:
+            first_timing = i
+        if na[:3] != nb[:3] or na[4] != nb[4]:
+            print('diverge at nibble %d:' % i)
+            print('  a: $%02X %s' % (na[4], where(na)))
+            print('  b: $%02X %s' % (nb[4], where(nb)))
+            lo = max(0, i - 8)
+            print('  before: ' + ' '.join('%02X' % n[4] for n in a[lo:i]))
+            print('  a next: ' + ' '.join('%02X' % n[4] for n in a[i:i + 8]))
+            print('  b next: ' + ' '.join('%02X' % n[4] for n in b[i:i + 8]))
+            if first_timing is not None and first_timing < i:
+                print('  (timing already differed from nibble %d, %s)' %
+                      (first_timing, where(a[first_timing])))
+            sys.exit(1)
+
+    if first_timing is not None:
+        print('same nibbles; timing differs from nibble %d, %s' %
+              (first_timing, where(a[first_timing])))
+    if len(a) != len(b):
+        print('one capture is a prefix of the other (%d common nibbles)' %
+              min(len(a), len(b)))
+    else:
+        print('identical')
+
+
+if __name__ == '__main__':
+    main()